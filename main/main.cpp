@@ -1,5 +1,7 @@
 #include "./src/module.hpp"
 
+#include <cstdlib>
+
 #ifndef CEmbeddedFusion
 EmbeddedFusion::Context *CEmbeddedFusion = NULL;
 #endif
@@ -10,10 +12,17 @@ public:
     // Create the context pointer of this modulse
     EmbeddedFusion::CreateContext();
 
+    // EFUSION_TRACE=<file>: trace from now on, exported by destroy()
+    if (std::getenv("EFUSION_TRACE"))
+      EmbeddedFusion::EnableTracing(true);
+
     // Get the interface pointer (for GUI launcher, from other modules)
     CEmbeddedFusion->m_interface =
         ModuleInterface::GetEditorModuleByName(this->m_name);
 
+    // The editor runs from the project directory
+    EmbeddedFusion::IndexProject(fs::current_path().string());
+
     LogInfo(EmbeddedFusion::GetPath("resources/images/main_sketch.png"));
     // Content browser (HIGH LEVEL)
     AddContentBrowserItemIdentifier(ItemIdentifierInterface(
@@ -34,19 +43,32 @@ public:
     // Content browser (LOW LEVEL), inside HIGH LEVEL components
     // Function
     // Entity
+
+    // Windows and parsed libraries of the library this one replaces
+    EmbeddedFusion::RestoreReloadState(EmbeddedFusion::ReloadStatePath());
   }
 
   void destroy() override {
-    // Reset module
-    this->ResetModule();
+    if (!CEmbeddedFusion)
+      return;
+
+    if (const char *trace = std::getenv("EFUSION_TRACE")) {
+      EmbeddedFusion::LogTraceSummary();
+      EmbeddedFusion::ExportTrace(trace);
+      EmbeddedFusion::EnableTracing(false);
+    }
+
+    // Keep what a rebuilt module needs to come back as it was
+    EmbeddedFusion::SaveReloadState(EmbeddedFusion::ReloadStatePath());
 
     // Clear windows
-    // for (auto i : CEmbeddedFusion->m_text_editor_instances) {
-    //  CherryApp.DeleteAppWindow(i->GetAppWindow());
-    //}
+    EmbeddedFusion::CloseMainSketchWindows();
+
+    // Reset module
+    this->ResetModule();
 
-    // Clear context
-    // DestroyContext();
+    // Clear context (stops the sketch index, drops the libraries)
+    EmbeddedFusion::DestroyContext();
   }
 };
 
@@ -1,17 +1,104 @@
 #include "module.hpp"
 
+#include <algorithm>
+#include <iostream>
+
 void EmbeddedFusion::CreateContext() {
   EmbeddedFusion::Context *ctx = VX_NEW(EmbeddedFusion::Context);
   CEmbeddedFusion = ctx;
 }
 
-void EmbeddedFusion::DestroyContext() { VX_FREE(CEmbeddedFusion); }
+void EmbeddedFusion::DestroyContext() {
+  VX_FREE(CEmbeddedFusion);
+  CEmbeddedFusion = NULL;
+}
 
 std::string EmbeddedFusion::GetPath(const std::string &path) {
   return CEmbeddedFusion->m_interface->GetBinaryPath() + "/" + path;
 }
 
+namespace {
+
+fs::path Canonical(const fs::path &path) {
+  std::error_code ec;
+  fs::path canonical = fs::weakly_canonical(path, ec);
+  return ec ? fs::absolute(path).lexically_normal() : canonical;
+}
+
+// Schema folders a sketch kept itself before the project library: copied
+// (never moved) into the project's, entries already there win. Returns the
+// number of schemas copied.
+size_t CopySketchSchemas(const fs::path &sketch, const fs::path &root) {
+  size_t copied = 0;
+  for (const char *dir : {"types", "primitives", "functions", "machines"}) {
+    std::error_code ec;
+    for (fs::directory_iterator it(sketch / dir, ec), end; !ec && it != end;
+         it.increment(ec)) {
+      const fs::path target = root / dir / it->path().filename();
+      std::error_code copyEc;
+      if (fs::exists(target, copyEc))
+        continue;
+      fs::create_directories(target.parent_path(), copyEc);
+      fs::copy(it->path(), target, fs::copy_options::recursive, copyEc);
+      if (copyEc)
+        std::cerr << "AcquireSchemaLibrary: failed to copy " << it->path()
+                  << " to " << target << ": " << copyEc.message()
+                  << std::endl;
+      else
+        ++copied;
+    }
+  }
+  return copied;
+}
+
+} // namespace
+
+fs::path EmbeddedFusion::SchemaRoot(const std::string &path) {
+  const fs::path sketch = Canonical(path);
+  if (CEmbeddedFusion && CEmbeddedFusion->m_sketch_index) {
+    const fs::path project =
+        Canonical(CEmbeddedFusion->m_sketch_index->Root());
+    const fs::path rel = sketch.lexically_relative(project);
+    if (!rel.empty() && *rel.begin() != "..")
+      return project / "schemas";
+  }
+  return sketch;
+}
+
+std::shared_ptr<ModuleUI::SchemaLibrary>
+EmbeddedFusion::AcquireSchemaLibrary(const std::string &path) {
+  const fs::path sketch = Canonical(path);
+  const fs::path root = SchemaRoot(path);
+  const size_t copied = root == sketch ? 0 : CopySketchSchemas(sketch, root);
+
+  std::lock_guard<std::mutex> lock(CEmbeddedFusion->m_schema_libraries_mutex);
+  auto &libraries = CEmbeddedFusion->m_schema_libraries;
+  for (auto it = libraries.begin(); it != libraries.end();) {
+    if (it->second.expired())
+      it = libraries.erase(it);
+    else
+      ++it;
+  }
+
+  auto &slot = libraries[root.string()];
+  if (auto library = slot.lock()) {
+    // This sketch brought schemas the shared library has not read yet
+    if (copied)
+      library->Reload();
+    return library;
+  }
+
+  auto library = std::make_shared<ModuleUI::SchemaLibrary>(root);
+  slot = library;
+  return library;
+}
+
 bool EmbeddedFusion::IsMainSketch(const std::string &path) {
+  if (CEmbeddedFusion && CEmbeddedFusion->m_sketch_index) {
+    if (auto known = CEmbeddedFusion->m_sketch_index->IsMainSketch(path))
+      return *known;
+  }
+
   fs::path base(path);
 
   if (!fs::is_regular_file(base / "main_sketch.json"))
@@ -37,6 +124,15 @@ void EmbeddedFusion::CreateMainSketch(const std::string &path) {
   createFile(sketchRoot / "src/setup/pin_setup.json");
   createFile(sketchRoot / "src/main/main_sketch.json");
   createFile(sketchRoot / "main_sketch.json");
+
+  if (CEmbeddedFusion->m_sketch_index)
+    CEmbeddedFusion->m_sketch_index->Refresh(sketchRoot.string());
+}
+
+void EmbeddedFusion::IndexProject(const std::string &root) {
+  auto index = std::make_unique<SketchIndex>(root);
+  index->Start();
+  CEmbeddedFusion->m_sketch_index = std::move(index);
 }
 
 void EmbeddedFusion::OpenMainSketch(const std::string &path) {
@@ -47,10 +143,46 @@ void EmbeddedFusion::OpenMainSketch(const std::string &path) {
     filename = filename.substr(0, maxLen - 3) + "...";
   }
 
-  std::string window_name =
-      filename + "####" +
-      std::to_string(CEmbeddedFusion->m_main_sketch_instances.size());
+  // The id is what follows "###". Closed windows leave the list, so its
+  // size alone could reuse the id of a window still open.
+  const auto &windows = CEmbeddedFusion->m_main_sketch_instances;
+  std::string id;
+  for (size_t n = windows.size();; ++n) {
+    id = "####" + std::to_string(n);
+    if (std::none_of(windows.begin(), windows.end(), [&](const auto &w) {
+          const std::string &name = w->GetName();
+          const size_t at = name.rfind("####");
+          return at != std::string::npos && name.substr(at) == id;
+        }))
+      break;
+  }
+  OpenMainSketchWindow(path, filename + id);
+}
+
+void EmbeddedFusion::OpenMainSketchWindow(const std::string &path,
+                                          const std::string &name) {
   std::shared_ptr<ModuleUI::MainSketchAppWindow> big_win =
-      ModuleUI::MainSketchAppWindow::Create(path, window_name);
+      ModuleUI::MainSketchAppWindow::Create(path, name);
   Cherry::AddAppWindow(big_win->GetAppWindow());
+  CEmbeddedFusion->m_main_sketch_instances.push_back(big_win);
+}
+
+void EmbeddedFusion::CloseMainSketchWindows() {
+  // Close() forgets each window, which edits the list
+  auto windows = std::move(CEmbeddedFusion->m_main_sketch_instances);
+  CEmbeddedFusion->m_main_sketch_instances.clear();
+  for (auto &window : windows)
+    window->Close();
+}
+
+void EmbeddedFusion::ForgetMainSketchWindow(
+    const ModuleUI::MainSketchAppWindow *window) {
+  if (!CEmbeddedFusion)
+    return;
+  auto &windows = CEmbeddedFusion->m_main_sketch_instances;
+  windows.erase(std::remove_if(windows.begin(), windows.end(),
+                               [window](const auto &w) {
+                                 return w.get() == window;
+                               }),
+                windows.end());
 }
\ No newline at end of file
@@ -1,9 +1,14 @@
 #include "../ui/instances/main_sketch/main_sketch.hpp"
+#include "./reload_state.hpp"
+#include "./sketch_index.hpp"
+#include "./trace.hpp"
 #include <filesystem>
 #include <fstream>
 #include <main/include/vortex.h>
 #include <main/include/vortex_internals.h>
+#include <mutex>
 #include <string>
+#include <unordered_map>
 #include <ui/editor/app/src/editor.hpp>
 
 #ifndef SAMPLE_MODULE_HPP
@@ -12,8 +17,19 @@
 namespace EmbeddedFusion {
 struct Context {
   std::shared_ptr<ModuleInterface> m_interface;
+  // Open windows, closed and saved for a reload by destroy()
   std::vector<std::shared_ptr<ModuleUI::MainSketchAppWindow>>
       m_main_sketch_instances;
+
+  // Parsed schema libraries, keyed by schema root (see SchemaRoot()).
+  // Windows hold the strong references, a library is dropped with its last
+  // window and its entry on the next acquire.
+  std::mutex m_schema_libraries_mutex;
+  std::unordered_map<std::string, std::weak_ptr<ModuleUI::SchemaLibrary>>
+      m_schema_libraries;
+
+  // Sketch roots of the project, answers IsMainSketch()
+  std::unique_ptr<SketchIndex> m_sketch_index;
 };
 } // namespace EmbeddedFusion
 
@@ -40,12 +56,21 @@ EMBEDDED_FUSION_API void DestroyContext();
 
 // API
 EMBEDDED_FUSION_API void OpenMainSketch(const std::string &path);
+// Opens a window with a given name (a restored one keeps its docking).
+EMBEDDED_FUSION_API void OpenMainSketchWindow(const std::string &path,
+                                              const std::string &name);
+EMBEDDED_FUSION_API void CloseMainSketchWindows();
+// Removes a window from the open list once it has been closed.
+EMBEDDED_FUSION_API void
+ForgetMainSketchWindow(const ModuleUI::MainSketchAppWindow *window);
 // EMBEDDED_FUSION_API void OpenSketchFunction();
 // EMBEDDED_FUSION_API void OpenSketchEvent();
 
 // Content browser
 EMBEDDED_FUSION_API bool IsMainSketch(const std::string &path);
 EMBEDDED_FUSION_API void CreateMainSketch(const std::string &path);
+// Builds the sketch index of `root` in the background and keeps it current.
+EMBEDDED_FUSION_API void IndexProject(const std::string &root);
 
 // EMBEDDED_FUSION_API void IsSketchFunction();
 // EMBEDDED_FUSION_API void CreateSketchFunction();
@@ -59,6 +84,15 @@ EMBEDDED_FUSION_API void CreateMainSketch(const std::string &path);
 // EMBEDDED_FUSION_API void SpawnSketchFunctionEditor();
 
 EMBEDDED_FUSION_API std::string GetPath(const std::string &path);
+
+// Folder the types, primitives, functions and machines of the sketch at
+// `path` live in: "schemas" at the root of the indexed project for every
+// sketch inside it, the sketch folder itself otherwise.
+EMBEDDED_FUSION_API fs::path SchemaRoot(const std::string &path);
+// Shared schema library of SchemaRoot(path), created on first use, so the
+// sketches of one project parse and hold their schemas once.
+EMBEDDED_FUSION_API std::shared_ptr<ModuleUI::SchemaLibrary>
+AcquireSchemaLibrary(const std::string &path);
 } // namespace EmbeddedFusion
 
 // The code of the module.
@@ -0,0 +1,156 @@
+#include "reload_state.hpp"
+#include "../ui/instances/main_sketch/child/viewport/document_format.hpp"
+#include "module.hpp"
+
+#include <chrono>
+#include <iostream>
+
+#ifdef _WIN32
+#include <process.h>
+#else
+#include <unistd.h>
+#endif
+
+namespace EmbeddedFusion {
+
+namespace {
+
+constexpr int kReloadStateVersion = 1;
+// Between destroy() of the old library and execute() of the new one
+constexpr int64_t kReloadStateMaxAgeSeconds = 60;
+
+int64_t Now() {
+  return std::chrono::duration_cast<std::chrono::seconds>(
+             std::chrono::system_clock::now().time_since_epoch())
+      .count();
+}
+
+constexpr const char *kReloadStatePrefix = "embedded_fusion_reload_";
+
+// Files of other processes are never read back by this one: remove those
+// too old to be a reload in progress (a crash, or an exit of a session
+// that ran before this one).
+void RemoveStaleReloadStates(const fs::path &dir) {
+  std::error_code ec;
+  const auto now = fs::file_time_type::clock::now();
+  for (fs::directory_iterator it(dir, ec), end; !ec && it != end;
+       it.increment(ec)) {
+    const std::string name = it->path().filename().string();
+    if (name.rfind(kReloadStatePrefix, 0) != 0 ||
+        it->path().extension() != ".msgpack")
+      continue;
+    std::error_code fileEc;
+    const auto written = fs::last_write_time(it->path(), fileEc);
+    if (!fileEc &&
+        now - written > std::chrono::seconds(kReloadStateMaxAgeSeconds))
+      fs::remove(it->path(), fileEc);
+  }
+}
+
+} // namespace
+
+fs::path ReloadStatePath() {
+#ifdef _WIN32
+  const int pid = _getpid();
+#else
+  const int pid = static_cast<int>(getpid());
+#endif
+  std::error_code ec;
+  fs::path dir = fs::temp_directory_path(ec);
+  if (ec)
+    dir = fs::current_path();
+  return dir / (kReloadStatePrefix + std::to_string(pid) + ".msgpack");
+}
+
+bool SaveReloadState(const fs::path &file) {
+  if (!CEmbeddedFusion || CEmbeddedFusion->m_main_sketch_instances.empty())
+    return false;
+  try {
+    json state;
+    state["version"] = kReloadStateVersion;
+    state["saved"] = Now();
+
+    state["windows"] = json::array();
+    for (const auto &window : CEmbeddedFusion->m_main_sketch_instances)
+      if (window->IsOpen())
+        state["windows"].push_back(
+            {{"path", window->GetSketchPath()}, {"name", window->GetName()}});
+
+    state["libraries"] = json::array();
+    std::lock_guard<std::mutex> lock(CEmbeddedFusion->m_schema_libraries_mutex);
+    for (const auto &entry : CEmbeddedFusion->m_schema_libraries) {
+      auto library = entry.second.lock();
+      if (!library)
+        continue;
+      // The loader thread runs code of the library about to be unloaded:
+      // it has to finish anyway, and the catalog is then complete.
+      library->WaitForComplete();
+      json j = library->Export();
+      j["key"] = entry.first;
+      state["libraries"].push_back(std::move(j));
+    }
+
+    if (!ModuleUI::WriteDocument(file, state,
+                                 ModuleUI::DocumentFormat::MsgPack)) {
+      std::cerr << "SaveReloadState: failed to write " << file << std::endl;
+      return false;
+    }
+    return true;
+  } catch (const std::exception &e) {
+    std::cerr << "SaveReloadState exception: " << e.what() << std::endl;
+    return false;
+  }
+}
+
+bool RestoreReloadState(const fs::path &file) {
+  RemoveStaleReloadStates(file.parent_path());
+
+  std::error_code ec;
+  if (!fs::exists(file, ec))
+    return false;
+  auto state = ModuleUI::ReadDocument(file);
+  fs::remove(file, ec); // one shot, also when unusable
+
+  try {
+    if (!state || !state->is_object() ||
+        state->value("version", 0) != kReloadStateVersion) {
+      std::cerr << "RestoreReloadState: ignoring " << file
+                << " (unreadable or other version)" << std::endl;
+      return false;
+    }
+    if (Now() - state->value("saved", int64_t(0)) > kReloadStateMaxAgeSeconds)
+      return false; // left by an exit, not a reload
+
+    // Held until the windows acquire them
+    std::vector<std::shared_ptr<ModuleUI::SchemaLibrary>> libraries;
+    {
+      std::lock_guard<std::mutex> lock(
+          CEmbeddedFusion->m_schema_libraries_mutex);
+      for (const auto &j : state->value("libraries", json::array())) {
+        const std::string key = j.value("key", "");
+        if (key.empty())
+          continue;
+        auto library = std::make_shared<ModuleUI::SchemaLibrary>(fs::path(key));
+        library->Restore(j);
+        CEmbeddedFusion->m_schema_libraries[key] = library;
+        libraries.push_back(std::move(library));
+      }
+    }
+
+    for (const auto &w : state->value("windows", json::array())) {
+      const std::string path = w.value("path", "");
+      if (!fs::is_directory(path, ec)) {
+        std::cerr << "RestoreReloadState: " << path
+                  << " is gone, window not reopened" << std::endl;
+        continue;
+      }
+      OpenMainSketchWindow(path, w.value("name", ""));
+    }
+    return true;
+  } catch (const std::exception &e) {
+    std::cerr << "RestoreReloadState exception: " << e.what() << std::endl;
+    return false;
+  }
+}
+
+} // namespace EmbeddedFusion
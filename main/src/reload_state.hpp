@@ -0,0 +1,27 @@
+#pragma once
+#include <main/include/vortex.h>
+
+#ifndef RELOAD_STATE_MODULE_HPP
+#define RELOAD_STATE_MODULE_HPP
+
+namespace EmbeddedFusion {
+
+// Hot reload of the module library. destroy() saves what the module has
+// built up since it was loaded (the parsed schema libraries and the open
+// main sketch windows) to a MessagePack file before the library is
+// unloaded; execute() of the rebuilt library restores it right away, so
+// windows come back without re-parsing any schema folder. Unsaved graph
+// edits need nothing here: the reopened viewport replays its journal.
+//
+// The file is keyed by process id and only honoured when it is recent, so
+// an exit (which also calls destroy()) never reopens windows in a later
+// session. It is removed once read, and files left by other processes are
+// removed once they are too old to be honoured.
+fs::path ReloadStatePath();
+bool SaveReloadState(const fs::path &file);
+// False when there is nothing (valid) to restore.
+bool RestoreReloadState(const fs::path &file);
+
+} // namespace EmbeddedFusion
+
+#endif // RELOAD_STATE_MODULE_HPP
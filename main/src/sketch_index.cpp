@@ -0,0 +1,350 @@
+#include "sketch_index.hpp"
+
+#include <iostream>
+#include <mutex>
+#include <vector>
+
+#ifdef __linux__
+#include <cerrno>
+#include <poll.h>
+#include <sys/eventfd.h>
+#include <sys/inotify.h>
+#include <unistd.h>
+#endif
+
+namespace EmbeddedFusion {
+
+namespace {
+
+bool IsUnder(const std::string &key, const std::string &dir) {
+  if (key.size() <= dir.size() || key.compare(0, dir.size(), dir) != 0)
+    return false;
+  return dir.back() == '/' || key[dir.size()] == '/';
+}
+
+} // namespace
+
+SketchIndex::SketchIndex(const fs::path &root)
+    : m_Root(fs::absolute(root).lexically_normal()),
+      m_RootKey(Key(m_Root.string())) {}
+
+SketchIndex::~SketchIndex() { Stop(); }
+
+void SketchIndex::Start() {
+  if (m_Thread.joinable())
+    return;
+  m_Stop = false;
+  m_Reliable = true;
+#ifdef __linux__
+  m_Inotify = inotify_init1(IN_NONBLOCK | IN_CLOEXEC);
+  m_Wake = eventfd(0, EFD_NONBLOCK | EFD_CLOEXEC);
+  if (m_Inotify < 0 || m_Wake < 0)
+    m_Reliable = false;
+#else
+  // No change notifications: the walk would go stale, keep stat lookups
+  m_Reliable = false;
+#endif
+  m_Thread = std::thread(&SketchIndex::Run, this);
+}
+
+void SketchIndex::Stop() {
+  m_Stop = true;
+#ifdef __linux__
+  if (m_Wake >= 0) {
+    uint64_t one = 1;
+    (void)!write(m_Wake, &one, sizeof(one));
+  }
+#endif
+  if (m_Thread.joinable())
+    m_Thread.join();
+#ifdef __linux__
+  if (m_Inotify >= 0)
+    close(m_Inotify);
+  if (m_Wake >= 0)
+    close(m_Wake);
+  m_Inotify = m_Wake = -1;
+  m_WatchDirs.clear();
+  m_DirWatches.clear();
+#endif
+  m_Ready = false;
+}
+
+std::string SketchIndex::Key(const std::string &path) {
+  std::string key = fs::path(path).lexically_normal().string();
+  while (key.size() > 1 && key.back() == '/')
+    key.pop_back();
+  return key;
+}
+
+std::optional<SketchIndex::Item>
+SketchIndex::ItemFromName(const std::string &name) {
+  if (name == "src")
+    return Src;
+  if (name == "functions")
+    return Functions;
+  if (name == "primitives")
+    return Primitives;
+  if (name == "types")
+    return Types;
+  return std::nullopt;
+}
+
+std::optional<uint8_t> SketchIndex::ReadSketch(const fs::path &dir) {
+  std::error_code ec;
+  if (!fs::is_regular_file(dir / "main_sketch.json", ec))
+    return std::nullopt;
+  uint8_t items = 0;
+  for (const char *name : {"src", "functions", "primitives", "types"})
+    if (fs::is_directory(dir / name, ec))
+      items |= *ItemFromName(name);
+  return items;
+}
+
+bool SketchIndex::Covers(const std::string &key) const {
+  if (!IsReady() || !m_Reliable.load(std::memory_order_acquire) ||
+      m_Rescanning.load(std::memory_order_acquire))
+    return false;
+  if (key != m_RootKey && !IsUnder(key, m_RootKey))
+    return false;
+  // Hidden directories are not walked
+  if (key.find("/.", m_RootKey.size()) != std::string::npos)
+    return false;
+  // Neither are symlinked ones, nor what is reached through them
+  std::shared_lock<std::shared_mutex> lock(m_Mutex);
+  if (m_Symlinks.empty())
+    return true;
+  for (size_t end = key.size(); end > m_RootKey.size();
+       end = key.rfind('/', end - 1))
+    if (m_Symlinks.count(key.substr(0, end)))
+      return false;
+  return true;
+}
+
+// Keeps m_Symlinks current for an entry created in (or moved into) `dir`.
+void SketchIndex::NoteEntry(const std::string &dir, const std::string &name) {
+  if (name.empty() || name[0] == '.')
+    return;
+  const fs::path path = fs::path(dir) / name;
+  std::error_code ec;
+  if (!fs::is_symlink(path, ec) || !fs::is_directory(path, ec))
+    return;
+  std::unique_lock<std::shared_mutex> lock(m_Mutex);
+  m_Symlinks.insert(Key(path.string()));
+}
+
+std::optional<bool> SketchIndex::IsMainSketch(const std::string &path) const {
+  const std::string key = Key(path);
+  if (!Covers(key))
+    return std::nullopt;
+  std::shared_lock<std::shared_mutex> lock(m_Mutex);
+  return m_Sketches.count(key) != 0;
+}
+
+std::optional<uint8_t> SketchIndex::Items(const std::string &path) const {
+  const std::string key = Key(path);
+  if (!Covers(key))
+    return std::nullopt;
+  std::shared_lock<std::shared_mutex> lock(m_Mutex);
+  auto it = m_Sketches.find(key);
+  if (it == m_Sketches.end())
+    return std::nullopt;
+  return it->second;
+}
+
+void SketchIndex::Refresh(const std::string &path) {
+  const std::string key = Key(path);
+  if (Covers(key))
+    RescanDir(key);
+}
+
+void SketchIndex::RescanDir(const std::string &dir) {
+  std::optional<uint8_t> items = ReadSketch(dir);
+  std::unique_lock<std::shared_mutex> lock(m_Mutex);
+  if (items)
+    m_Sketches[dir] = *items;
+  else
+    m_Sketches.erase(dir);
+}
+
+void SketchIndex::ScanTree(const fs::path &dir) {
+  std::vector<fs::path> stack{dir};
+  while (!stack.empty() && !m_Stop) {
+    fs::path current = std::move(stack.back());
+    stack.pop_back();
+    const std::string key = Key(current.string());
+
+    // Watch before listing so nothing created in between is missed
+    Watch(key);
+
+    bool sketch = false;
+    uint8_t items = 0;
+    std::error_code ec;
+    fs::directory_iterator it(
+        current, fs::directory_options::skip_permission_denied, ec);
+    for (; !ec && it != fs::directory_iterator(); it.increment(ec)) {
+      const std::string name = it->path().filename().string();
+      if (name == "main_sketch.json") {
+        sketch = it->is_regular_file(ec);
+        continue;
+      }
+      if (!it->is_directory(ec))
+        continue;
+      if (it->is_symlink(ec)) {
+        if (!name.empty() && name[0] != '.') {
+          std::unique_lock<std::shared_mutex> lock(m_Mutex);
+          m_Symlinks.insert(Key(it->path().string()));
+        }
+        continue;
+      }
+      if (auto item = ItemFromName(name))
+        items |= *item;
+      if (!name.empty() && name[0] != '.')
+        stack.push_back(it->path());
+    }
+
+    std::unique_lock<std::shared_mutex> lock(m_Mutex);
+    if (sketch)
+      m_Sketches[key] = items;
+    else
+      m_Sketches.erase(key);
+  }
+}
+
+void SketchIndex::RemoveTree(const std::string &dir) {
+  {
+    std::unique_lock<std::shared_mutex> lock(m_Mutex);
+    for (auto it = m_Sketches.begin(); it != m_Sketches.end();) {
+      if (it->first == dir || IsUnder(it->first, dir))
+        it = m_Sketches.erase(it);
+      else
+        ++it;
+    }
+    for (auto it = m_Symlinks.begin(); it != m_Symlinks.end();) {
+      if (*it == dir || IsUnder(*it, dir))
+        it = m_Symlinks.erase(it);
+      else
+        ++it;
+    }
+  }
+#ifdef __linux__
+  // Deleted directories drop their watch by themselves (IN_IGNORED), moved
+  // ones keep it and would report under a stale path.
+  for (auto it = m_DirWatches.begin(); it != m_DirWatches.end();) {
+    if (it->first == dir || IsUnder(it->first, dir)) {
+      inotify_rm_watch(m_Inotify, it->second);
+      m_WatchDirs.erase(it->second);
+      it = m_DirWatches.erase(it);
+    } else {
+      ++it;
+    }
+  }
+#endif
+}
+
+void SketchIndex::Watch(const std::string &dir) {
+#ifdef __linux__
+  if (m_Inotify < 0 || !m_Reliable)
+    return;
+  int wd = inotify_add_watch(m_Inotify, dir.c_str(),
+                             IN_CREATE | IN_DELETE | IN_MOVED_FROM |
+                                 IN_MOVED_TO | IN_ONLYDIR);
+  if (wd < 0) {
+    if (errno == ENOSPC || errno == ENOMEM) {
+      // Out of inotify watches, the index can not be trusted anymore
+      std::cerr << "SketchIndex: inotify watch limit reached under "
+                << m_RootKey << ", falling back to direct lookups"
+                << std::endl;
+      m_Reliable = false;
+    }
+    return;
+  }
+  m_WatchDirs[wd] = dir;
+  m_DirWatches[dir] = wd;
+#else
+  (void)dir;
+#endif
+}
+
+void SketchIndex::HandleEvent(int wd, uint32_t mask, const std::string &name) {
+#ifdef __linux__
+  if (mask & IN_Q_OVERFLOW) {
+    // Events were dropped, walk everything again. Queries fall back to
+    // stat meanwhile, the half built index would answer a wrong "no".
+    m_Rescanning.store(true, std::memory_order_release);
+    {
+      std::unique_lock<std::shared_mutex> lock(m_Mutex);
+      m_Sketches.clear();
+      m_Symlinks.clear();
+    }
+    ScanTree(m_Root);
+    m_Rescanning.store(false, std::memory_order_release);
+    return;
+  }
+
+  auto it = m_WatchDirs.find(wd);
+  if (it == m_WatchDirs.end())
+    return;
+  if (mask & IN_IGNORED) {
+    m_DirWatches.erase(it->second);
+    m_WatchDirs.erase(it);
+    return;
+  }
+
+  const std::string dir = it->second;
+  if (!(mask & IN_ISDIR)) {
+    // A symlink, even to a directory, is reported as a file
+    if (mask & (IN_CREATE | IN_MOVED_TO))
+      NoteEntry(dir, name);
+    else if (mask & (IN_DELETE | IN_MOVED_FROM)) {
+      std::unique_lock<std::shared_mutex> lock(m_Mutex);
+      m_Symlinks.erase(Key((fs::path(dir) / name).string()));
+    }
+  }
+  if (mask & IN_ISDIR) {
+    const std::string child = (fs::path(dir) / name).string();
+    if (mask & (IN_CREATE | IN_MOVED_TO)) {
+      if (!name.empty() && name[0] != '.')
+        ScanTree(child);
+    } else if (mask & (IN_DELETE | IN_MOVED_FROM)) {
+      RemoveTree(child);
+    }
+  }
+
+  if (name == "main_sketch.json" || ItemFromName(name))
+    RescanDir(dir);
+#else
+  (void)wd;
+  (void)mask;
+  (void)name;
+#endif
+}
+
+void SketchIndex::Run() {
+  ScanTree(m_Root);
+  m_Ready.store(true, std::memory_order_release);
+
+#ifdef __linux__
+  alignas(inotify_event) char buffer[64 * 1024];
+  while (!m_Stop && m_Reliable) {
+    pollfd fds[2] = {{m_Inotify, POLLIN, 0}, {m_Wake, POLLIN, 0}};
+    if (poll(fds, 2, -1) < 0) {
+      if (errno == EINTR)
+        continue;
+      break;
+    }
+    if (fds[1].revents & POLLIN)
+      break;
+
+    ssize_t n = read(m_Inotify, buffer, sizeof(buffer));
+    if (n <= 0)
+      continue;
+    for (char *p = buffer; p < buffer + n;) {
+      const auto *ev = reinterpret_cast<const inotify_event *>(p);
+      p += sizeof(inotify_event) + ev->len;
+      HandleEvent(ev->wd, ev->mask, ev->len ? std::string(ev->name) : "");
+    }
+  }
+#endif
+}
+
+} // namespace EmbeddedFusion
@@ -0,0 +1,96 @@
+#pragma once
+#include <main/include/vortex.h>
+
+#include <atomic>
+#include <cstdint>
+#include <optional>
+#include <shared_mutex>
+#include <string>
+#include <thread>
+#include <unordered_map>
+#include <unordered_set>
+
+#ifndef SKETCH_INDEX_MODULE_HPP
+#define SKETCH_INDEX_MODULE_HPP
+
+namespace EmbeddedFusion {
+
+// Project-wide index of main sketch roots, used by the content browser so
+// that IsMainSketch() is a hash lookup instead of a stat per displayed
+// folder (slow on network filesystems).
+//
+// The tree under the project root is walked once on a background thread,
+// then kept current with inotify: every directory gets a watch, and only
+// the directories an event touches are re-read. Until the first walk is
+// done, while a lost event forces a new walk, for paths outside the root or
+// reached through a symlinked directory (not walked), and on platforms
+// without inotify the index has no answer and callers stat as before.
+class SketchIndex {
+public:
+  // Sketch items present in a sketch root.
+  enum Item : uint8_t {
+    Src = 1 << 0,        // src/
+    Functions = 1 << 1,  // functions/
+    Primitives = 1 << 2, // primitives/
+    Types = 1 << 3,      // types/
+  };
+
+  explicit SketchIndex(const fs::path &root);
+  ~SketchIndex();
+
+  SketchIndex(const SketchIndex &) = delete;
+  SketchIndex &operator=(const SketchIndex &) = delete;
+
+  void Start();
+  void Stop();
+
+  bool IsReady() const { return m_Ready.load(std::memory_order_acquire); }
+  const fs::path &Root() const { return m_Root; }
+
+  // std::nullopt when the index can not answer for this path.
+  std::optional<bool> IsMainSketch(const std::string &path) const;
+  // Item bits of the sketch at `path`, std::nullopt if it is not a known
+  // sketch root.
+  std::optional<uint8_t> Items(const std::string &path) const;
+
+  // Re-reads one directory right away, for changes made by the module
+  // itself that must be visible before the watcher reports them.
+  void Refresh(const std::string &path);
+
+private:
+  void Run();
+  void Watch(const std::string &dir);
+  void HandleEvent(int wd, uint32_t mask, const std::string &name);
+  void ScanTree(const fs::path &dir);
+  void RescanDir(const std::string &dir);
+  void RemoveTree(const std::string &dir);
+  bool Covers(const std::string &key) const;
+  void NoteEntry(const std::string &dir, const std::string &name);
+
+  static std::string Key(const std::string &path);
+  static std::optional<uint8_t> ReadSketch(const fs::path &dir);
+  static std::optional<Item> ItemFromName(const std::string &name);
+
+  fs::path m_Root;
+  std::string m_RootKey;
+
+  mutable std::shared_mutex m_Mutex;
+  std::unordered_map<std::string, uint8_t> m_Sketches; // root -> Item bits
+  std::unordered_set<std::string> m_Symlinks; // to directories, not walked
+
+  std::atomic<bool> m_Ready{false};
+  std::atomic<bool> m_Reliable{true};
+  std::atomic<bool> m_Rescanning{false};
+  std::atomic<bool> m_Stop{false};
+  std::thread m_Thread;
+
+  // Watcher state, only touched by the index thread.
+  int m_Inotify = -1;
+  int m_Wake = -1;
+  std::unordered_map<int, std::string> m_WatchDirs;
+  std::unordered_map<std::string, int> m_DirWatches;
+};
+
+} // namespace EmbeddedFusion
+
+#endif // SKETCH_INDEX_MODULE_HPP
@@ -0,0 +1,232 @@
+#include "trace.hpp"
+
+#include <algorithm>
+#include <chrono>
+#include <fstream>
+#include <iostream>
+#include <map>
+#include <memory>
+#include <mutex>
+#include <vector>
+
+#if __has_include(<spdlog/spdlog.h>)
+#include <spdlog/spdlog.h>
+#define EFUSION_TRACE_SPDLOG 1
+#endif
+
+namespace EmbeddedFusion {
+
+std::atomic<bool> g_TraceEnabled{false};
+
+namespace {
+
+const char *const kCounterNames[] = {"files read", "files written",
+                                     "bytes emitted"};
+constexpr size_t kCounters = sizeof(kCounterNames) / sizeof(kCounterNames[0]);
+
+struct TraceEvent {
+  const char *name = nullptr; // null for a counter sample
+  std::string detail;
+  uint64_t start_ns = 0;
+  uint64_t value = 0; // duration of a span, new total of a counter
+  TraceCounter counter = TraceCounter::FilesRead;
+};
+
+// One per thread that ever recorded. The lock is only contended by
+// export and clear.
+struct TraceBuffer {
+  std::mutex mutex;
+  uint32_t tid = 0;
+  std::vector<TraceEvent> events;
+  size_t dropped = 0;
+};
+
+struct TraceRegistry {
+  std::mutex mutex;
+  // Kept until the module unloads: threads hold raw pointers to them
+  std::vector<std::unique_ptr<TraceBuffer>> buffers;
+  std::atomic<uint64_t> totals[kCounters] = {};
+};
+
+TraceRegistry &Registry() {
+  static TraceRegistry registry;
+  return registry;
+}
+
+// Trivially destructible, so no thread exit handler points into the module
+// after a hot reload
+thread_local TraceBuffer *t_Buffer = nullptr;
+
+TraceBuffer &ThisThreadBuffer() {
+  if (!t_Buffer) {
+    TraceRegistry &r = Registry();
+    std::lock_guard<std::mutex> lock(r.mutex);
+    r.buffers.push_back(std::make_unique<TraceBuffer>());
+    t_Buffer = r.buffers.back().get();
+    t_Buffer->tid = static_cast<uint32_t>(r.buffers.size());
+  }
+  return *t_Buffer;
+}
+
+void Push(TraceEvent event) {
+  TraceBuffer &b = ThisThreadBuffer();
+  std::lock_guard<std::mutex> lock(b.mutex);
+  if (b.events.size() >= kTraceBufferEvents) {
+    ++b.dropped;
+    return;
+  }
+  b.events.push_back(std::move(event));
+}
+
+// Calls `fn(buffer)` for every buffer, each locked in turn
+template <typename Fn> void ForEachBuffer(Fn &&fn) {
+  TraceRegistry &r = Registry();
+  std::lock_guard<std::mutex> lock(r.mutex);
+  for (auto &b : r.buffers) {
+    std::lock_guard<std::mutex> bufferLock(b->mutex);
+    fn(*b);
+  }
+}
+
+void LogLine(const std::string &line) {
+#ifdef EFUSION_TRACE_SPDLOG
+  spdlog::info("{}", line);
+#else
+  std::cout << line << std::endl;
+#endif
+}
+
+double Micros(uint64_t ns) { return static_cast<double>(ns) / 1000.0; }
+
+} // namespace
+
+uint64_t TraceNow() {
+  static const auto origin = std::chrono::steady_clock::now();
+  // Never 0: spans use 0 for "not recording"
+  return static_cast<uint64_t>(
+             std::chrono::duration_cast<std::chrono::nanoseconds>(
+                 std::chrono::steady_clock::now() - origin)
+                 .count()) +
+         1;
+}
+
+void EnableTracing(bool enabled) {
+  if (enabled && !TracingEnabled()) {
+    ForEachBuffer([](TraceBuffer &b) {
+      b.events.clear();
+      b.dropped = 0;
+    });
+    for (auto &total : Registry().totals)
+      total = 0;
+  }
+  g_TraceEnabled.store(enabled, std::memory_order_relaxed);
+}
+
+void RecordTraceSpan(const char *name, const std::string *detail,
+                     uint64_t start_ns, uint64_t end_ns) {
+  TraceEvent e;
+  e.name = name;
+  if (detail)
+    e.detail = *detail;
+  e.start_ns = start_ns;
+  e.value = end_ns - start_ns;
+  Push(std::move(e));
+}
+
+void RecordTraceCount(TraceCounter counter, uint64_t n) {
+  TraceEvent e;
+  e.counter = counter;
+  e.value =
+      Registry().totals[static_cast<size_t>(counter)].fetch_add(n) + n;
+  e.start_ns = TraceNow();
+  Push(std::move(e));
+}
+
+bool ExportTrace(const fs::path &file) {
+  json events = json::array();
+  size_t dropped = 0;
+  ForEachBuffer([&](TraceBuffer &b) {
+    dropped += b.dropped;
+    if (b.events.empty())
+      return;
+    events.push_back({{"name", "thread_name"},
+                      {"ph", "M"},
+                      {"pid", 1},
+                      {"tid", b.tid},
+                      {"args", {{"name", "thread " + std::to_string(b.tid)}}}});
+    for (const auto &e : b.events) {
+      if (e.name) {
+        json x = {{"name", e.name}, {"cat", "efusion"},
+                  {"ph", "X"},      {"ts", Micros(e.start_ns)},
+                  {"dur", Micros(e.value)}, {"pid", 1},
+                  {"tid", b.tid}};
+        if (!e.detail.empty())
+          x["args"] = {{"detail", e.detail}};
+        events.push_back(std::move(x));
+      } else {
+        const char *name = kCounterNames[static_cast<size_t>(e.counter)];
+        events.push_back({{"name", name},
+                          {"ph", "C"},
+                          {"ts", Micros(e.start_ns)},
+                          {"pid", 1},
+                          {"args", {{"value", e.value}}}});
+      }
+    }
+  });
+
+  json doc = {{"traceEvents", std::move(events)},
+              {"displayTimeUnit", "ms"},
+              {"otherData", {{"dropped_events", dropped}}}};
+  std::ofstream out(file, std::ios::binary | std::ios::trunc);
+  if (!out.is_open()) {
+    std::cerr << "ExportTrace: unable to write " << file << std::endl;
+    return false;
+  }
+  out << doc.dump();
+  return static_cast<bool>(out);
+}
+
+void LogTraceSummary() {
+  struct Stats {
+    size_t calls = 0;
+    uint64_t total = 0;
+    uint64_t longest = 0;
+  };
+  std::map<std::string, Stats> spans;
+  size_t dropped = 0;
+  ForEachBuffer([&](TraceBuffer &b) {
+    dropped += b.dropped;
+    for (const auto &e : b.events) {
+      if (!e.name)
+        continue;
+      Stats &s = spans[e.name];
+      ++s.calls;
+      s.total += e.value;
+      s.longest = std::max(s.longest, e.value);
+    }
+  });
+
+  std::vector<std::pair<std::string, Stats>> sorted(spans.begin(),
+                                                    spans.end());
+  std::sort(sorted.begin(), sorted.end(), [](const auto &a, const auto &b) {
+    return a.second.total > b.second.total;
+  });
+  char line[256];
+  for (const auto &entry : sorted) {
+    std::snprintf(line, sizeof(line),
+                  "trace: %-32s %6zu calls %10.3f ms total %9.3f ms max",
+                  entry.first.c_str(), entry.second.calls,
+                  Micros(entry.second.total) / 1000.0,
+                  Micros(entry.second.longest) / 1000.0);
+    LogLine(line);
+  }
+  std::string counters = "trace:";
+  for (size_t c = 0; c < kCounters; ++c)
+    counters += std::string(c ? ", " : " ") + kCounterNames[c] + " " +
+                std::to_string(Registry().totals[c].load());
+  if (dropped)
+    counters += ", " + std::to_string(dropped) + " events dropped";
+  LogLine(counters);
+}
+
+} // namespace EmbeddedFusion
@@ -0,0 +1,106 @@
+#pragma once
+#include <main/include/vortex.h>
+
+#include <atomic>
+#include <cstdint>
+#include <string>
+
+#ifndef TRACE_MODULE_HPP
+#define TRACE_MODULE_HPP
+
+namespace EmbeddedFusion {
+
+// Scoped spans and counters of the module's hot paths, for
+// chrome://tracing or Perfetto.
+//
+// Off by default: a span or counter then costs one relaxed atomic load.
+// Once enabled (EnableTracing(), or the EFUSION_TRACE environment variable
+// naming the file destroy() exports to), each thread records into its own
+// buffer, so recording threads never contend; the buffers are only locked
+// together by ExportTrace() and LogTraceSummary(). A buffer stops
+// recording when full (kTraceBufferEvents) and counts what it dropped.
+//
+// Building with EFUSION_NO_TRACE defined compiles every EFUSION_TRACE_*
+// macro away.
+enum class TraceCounter : uint8_t { FilesRead, FilesWritten, BytesEmitted };
+
+constexpr size_t kTraceBufferEvents = 1 << 16;
+
+extern std::atomic<bool> g_TraceEnabled;
+inline bool TracingEnabled() {
+  return g_TraceEnabled.load(std::memory_order_relaxed);
+}
+
+// Starting clears what a previous session recorded.
+void EnableTracing(bool enabled);
+// Complete ("X") events per span and counter ("C") events per change, as
+// a Chrome trace json file.
+bool ExportTrace(const fs::path &file);
+// Per span name: calls, total and longest; and the counter totals. Logged
+// through spdlog when it is available.
+void LogTraceSummary();
+
+void RecordTraceSpan(const char *name, const std::string *detail,
+                     uint64_t start_ns, uint64_t end_ns);
+void RecordTraceCount(TraceCounter counter, uint64_t n);
+uint64_t TraceNow();
+
+class TraceSpan {
+public:
+  explicit TraceSpan(const char *name) : m_Name(name) {
+    if (TracingEnabled())
+      m_Start = TraceNow();
+  }
+  // `detail` (a path, a window name) is copied only when tracing.
+  TraceSpan(const char *name, const std::string &detail) : m_Name(name) {
+    if (TracingEnabled()) {
+      m_Detail = detail;
+      m_Start = TraceNow();
+    }
+  }
+  ~TraceSpan() {
+    if (m_Start)
+      RecordTraceSpan(m_Name, m_Detail.empty() ? nullptr : &m_Detail,
+                      m_Start, TraceNow());
+  }
+  TraceSpan(const TraceSpan &) = delete;
+  TraceSpan &operator=(const TraceSpan &) = delete;
+
+private:
+  const char *m_Name;
+  std::string m_Detail;
+  uint64_t m_Start = 0; // 0 when not recording
+};
+
+inline void TraceCount(TraceCounter counter, uint64_t n = 1) {
+  if (TracingEnabled())
+    RecordTraceCount(counter, n);
+}
+
+// One file of `bytes` written
+inline void TraceWrite(uint64_t bytes) {
+  if (TracingEnabled()) {
+    RecordTraceCount(TraceCounter::FilesWritten, 1);
+    RecordTraceCount(TraceCounter::BytesEmitted, bytes);
+  }
+}
+
+} // namespace EmbeddedFusion
+
+#define EFUSION_TRACE_CAT2(a, b) a##b
+#define EFUSION_TRACE_CAT(a, b) EFUSION_TRACE_CAT2(a, b)
+#ifndef EFUSION_NO_TRACE
+// Span from here to the end of the enclosing scope. `name` must be a
+// string literal; an optional second argument adds a detail string.
+#define EFUSION_TRACE_SCOPE(...)                                              \
+  ::EmbeddedFusion::TraceSpan EFUSION_TRACE_CAT(efusion_trace_,               \
+                                                __LINE__)(__VA_ARGS__)
+#define EFUSION_TRACE_COUNT(...) ::EmbeddedFusion::TraceCount(__VA_ARGS__)
+#define EFUSION_TRACE_WRITE(bytes) ::EmbeddedFusion::TraceWrite(bytes)
+#else
+#define EFUSION_TRACE_SCOPE(...) ((void)0)
+#define EFUSION_TRACE_COUNT(...) ((void)0)
+#define EFUSION_TRACE_WRITE(bytes) ((void)0)
+#endif
+
+#endif // TRACE_MODULE_HPP
@@ -41,6 +41,7 @@ void MySketchMainSketchAppWindow::SetupRenderCallback() {
 }
 
 void MySketchMainSketchAppWindow::Render() {
+  EFUSION_TRACE_SCOPE("MySketch::Render");
   CherryKit::TextSimple("Hello world from my sketch");
 }
 
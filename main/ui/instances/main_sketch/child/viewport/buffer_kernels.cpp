@@ -0,0 +1,381 @@
+#include "buffer_kernels.hpp"
+
+#include <sstream>
+
+namespace ModuleUI {
+
+namespace {
+
+constexpr const char *kOpNames[] = {"push",           "sum",
+                                    "min_max",        "moving_average",
+                                    "threshold_count", "scale"};
+static_assert(sizeof(kOpNames) / sizeof(kOpNames[0]) ==
+                  static_cast<size_t>(BufferOp::Count),
+              "one name per BufferOp");
+
+// Arithmetic of one element type. Sums accumulate in a wider type and are
+// narrowed (saturated for fixed point) once at the end.
+struct ElementOps {
+  std::string elem;
+  std::string acc;
+
+  static ElementOps For(const std::string &elementCpp) {
+    if (elementCpp == "efx_q")
+      return {elementCpp, "int64_t"};
+    if (elementCpp == "float")
+      return {elementCpp, "float"};
+    return {elementCpp, "long"};
+  }
+  bool Fixed() const { return elem == "efx_q"; }
+
+  std::string Narrow(const std::string &acc) const {
+    if (Fixed())
+      return "efx_sat(" + acc + ")";
+    if (elem == "float")
+      return acc;
+    return "(" + elem + ")(" + acc + ")";
+  }
+  std::string Mul(const std::string &a, const std::string &b) const {
+    return Fixed() ? "efx_mul(" + a + ", " + b + ")" : a + " * " + b;
+  }
+};
+
+// Index and counter type of the generated code, wide enough to count to
+// the buffer's length: a narrower one would wrap and never end the loop.
+std::string IndexType(const PinTypeInfo &type) {
+  return type.length <= UINT16_MAX ? "uint16_t" : "uint32_t";
+}
+
+// Emits `body(i)` for every valid index of the buffer: straight-line for
+// small arrays, a loop otherwise. `body` gets the index expression.
+void ForEachElement(std::ostringstream &o, const PinTypeInfo &type,
+                    uint32_t first,
+                    const std::function<std::string(const std::string &)>
+                        &body) {
+  const bool ring = type.layout_id == PinLayout::Ring;
+  if (!ring && type.length <= kBufferUnrollMax) {
+    for (uint32_t i = first; i < type.length; ++i)
+      o << "    " << body(std::to_string(i)) << "\n";
+    return;
+  }
+  o << "    for (" << IndexType(type) << " i = " << first << "; i < "
+    << (ring ? std::string("b.count") : std::to_string(type.length))
+    << "; ++i)\n";
+  o << "        " << body("i") << "\n";
+}
+
+void EmitStruct(std::ostringstream &o, const PinTypeInfo &type,
+                const ElementOps &ops) {
+  o << "struct " << type.id << " {\n";
+  o << "    " << ops.elem << " v[" << type.length << "];\n";
+  if (type.layout_id == PinLayout::Ring) {
+    const std::string index = IndexType(type);
+    o << "    " << index << " head;  // next slot to write\n";
+    o << "    " << index
+      << " count; // valid samples, v[0..count) until full\n";
+  }
+  o << "};\n";
+}
+
+void EmitPush(std::ostringstream &o, const PinTypeInfo &type,
+              const ElementOps &ops) {
+  const std::string &n = type.id;
+  const uint32_t len = type.length;
+  o << "static inline void " << n << "_push(" << n << " &b, " << ops.elem
+    << " x) {\n";
+  if (type.layout_id == PinLayout::Ring) {
+    o << "    b.v[b.head] = x;\n";
+    o << "    b.head = b.head + 1 == " << len << " ? 0 : b.head + 1;\n";
+    o << "    if (b.count < " << len << ")\n";
+    o << "        ++b.count;\n";
+  } else {
+    // Oldest sample first
+    if (len <= kBufferUnrollMax) {
+      for (uint32_t i = 1; i < len; ++i)
+        o << "    b.v[" << i - 1 << "] = b.v[" << i << "];\n";
+    } else {
+      o << "    for (" << IndexType(type) << " i = 1; i < " << len
+        << "; ++i)\n";
+      o << "        b.v[i - 1] = b.v[i];\n";
+    }
+    o << "    b.v[" << len - 1 << "] = x;\n";
+  }
+  o << "}\n";
+}
+
+void EmitSum(std::ostringstream &o, const PinTypeInfo &type,
+             const ElementOps &ops) {
+  const std::string &n = type.id;
+  const bool ring = type.layout_id == PinLayout::Ring;
+  o << "static inline " << ops.elem << " " << n << "_sum(const " << n
+    << " &b) {\n";
+  o << "    " << ops.acc << " s = 0;\n";
+  auto add = [](const std::string &i) { return "s += b.v[" + i + "];"; };
+  if (type.length <= kBufferUnrollMax) {
+    ForEachElement(o, type, 0, add);
+  } else {
+    // Host builds: independent lanes let the compiler vectorize the sum
+    // without reassociating float additions.
+    const std::string count =
+        ring ? std::string("b.count") : std::to_string(type.length);
+    o << "#ifdef EFUSION_SIM\n";
+    o << "    " << ops.acc << " lane[8] = {};\n";
+    o << "    " << IndexType(type) << " i = 0;\n";
+    o << "    for (; i + 8 <= " << count << "; i += 8)\n";
+    o << "        for (uint16_t l = 0; l < 8; ++l)\n";
+    o << "            lane[l] += b.v[i + l];\n";
+    o << "    for (; i < " << count << "; ++i)\n";
+    o << "        lane[0] += b.v[i];\n";
+    o << "    for (uint16_t l = 0; l < 8; ++l)\n";
+    o << "        s += lane[l];\n";
+    o << "#else\n";
+    ForEachElement(o, type, 0, add);
+    o << "#endif\n";
+  }
+  o << "    return " << ops.Narrow("s") << ";\n";
+  o << "}\n";
+}
+
+void EmitMinMax(std::ostringstream &o, const PinTypeInfo &type,
+                const ElementOps &ops) {
+  const std::string &n = type.id;
+  o << "static inline void " << n << "_min_max(const " << n << " &b, "
+    << ops.elem << " &lo, " << ops.elem << " &hi) {\n";
+  if (type.layout_id == PinLayout::Ring) {
+    o << "    if (b.count == 0) {\n";
+    o << "        lo = hi = 0;\n";
+    o << "        return;\n";
+    o << "    }\n";
+  }
+  o << "    " << ops.elem << " l = b.v[0], h = b.v[0];\n";
+  ForEachElement(o, type, 1, [](const std::string &i) {
+    const std::string v = "b.v[" + i + "]";
+    return "l = " + v + " < l ? " + v + " : l, h = " + v + " > h ? " + v +
+           " : h;";
+  });
+  o << "    lo = l;\n";
+  o << "    hi = h;\n";
+  o << "}\n";
+}
+
+void EmitMovingAverage(std::ostringstream &o, const PinTypeInfo &type,
+                       const ElementOps &ops) {
+  const std::string &n = type.id;
+  const uint32_t len = type.length;
+  const bool ring = type.layout_id == PinLayout::Ring;
+  const std::string count = ring ? std::string("b.count") : std::to_string(len);
+  o << "// Mean of the `window` newest samples (clamped to the valid ones)\n";
+  o << "static inline " << ops.elem << " " << n << "_moving_average(const "
+    << n << " &b, int window) {\n";
+  if (ring) {
+    o << "    if (b.count == 0)\n";
+    o << "        return 0;\n";
+  }
+  const std::string index = IndexType(type);
+  o << "    const " << index << " w = window < 1 ? 1 : (window > " << count
+    << " ? " << count << " : window);\n";
+  o << "    " << ops.acc << " s = 0;\n";
+  if (ring) {
+    // Newest sample is v[head - 1], the window may wrap around the end
+    o << "    if (w <= b.head) {\n";
+    o << "        for (" << index << " i = b.head - w; i < b.head; ++i)\n";
+    o << "            s += b.v[i];\n";
+    o << "    } else {\n";
+    o << "        for (" << index << " i = 0; i < b.head; ++i)\n";
+    o << "            s += b.v[i];\n";
+    o << "        for (" << index << " i = " << len << " - (w - b.head); i < "
+      << len << "; ++i)\n";
+    o << "            s += b.v[i];\n";
+    o << "    }\n";
+  } else {
+    o << "    for (" << index << " i = " << len << " - w; i < " << len
+      << "; ++i)\n";
+    o << "        s += b.v[i];\n";
+  }
+  o << "    return " << ops.Narrow("s / w") << ";\n";
+  o << "}\n";
+}
+
+void EmitThresholdCount(std::ostringstream &o, const PinTypeInfo &type,
+                        const ElementOps &ops) {
+  const std::string &n = type.id;
+  o << "static inline int " << n << "_threshold_count(const " << n << " &b, "
+    << ops.elem << " threshold) {\n";
+  o << "    int c = 0;\n";
+  ForEachElement(o, type, 0, [](const std::string &i) {
+    return "c += b.v[" + i + "] > threshold;";
+  });
+  o << "    return c;\n";
+  o << "}\n";
+}
+
+void EmitScale(std::ostringstream &o, const PinTypeInfo &type,
+               const ElementOps &ops) {
+  const std::string &n = type.id;
+  // Distinct globals in generated code; lets the loop vectorize without a
+  // runtime overlap check
+  o << "static inline void " << n << "_scale(const " << n << " &__restrict b, "
+    << ops.elem << " factor, " << n << " &__restrict out) {\n";
+  if (type.layout_id == PinLayout::Ring) {
+    o << "    out.head = b.head;\n";
+    o << "    out.count = b.count;\n";
+  }
+  ForEachElement(o, type, 0, [&](const std::string &i) {
+    return "out.v[" + i + "] = " + ops.Mul("b.v[" + i + "]", "factor") + ";";
+  });
+  o << "}\n";
+}
+
+} // namespace
+
+const char *BufferOpName(BufferOp op) {
+  return op < BufferOp::Count ? kOpNames[static_cast<size_t>(op)] : "";
+}
+
+bool IsBufferType(const PinTypeInfo &type) {
+  return type.layout_id != PinLayout::Scalar && type.length > 0 &&
+         (type.element_id == BuiltinPinType::Int ||
+          type.element_id == BuiltinPinType::Float);
+}
+
+std::vector<SchemaInfo> BufferPrimitives(const PinTypeInfo &type) {
+  std::vector<SchemaInfo> schemas;
+  if (!IsBufferType(type))
+    return schemas;
+
+  const std::string &elem = type.element;
+  for (size_t k = 0; k < static_cast<size_t>(BufferOp::Count); ++k) {
+    const auto op = static_cast<BufferOp>(k);
+    SchemaInfo s;
+    s.id = type.id + "_" + BufferOpName(op);
+    s.kind = "buffer";
+    s.kind_id = SchemaKindFromString(s.kind);
+    s.name_secondary = type.name;
+    s.hexcolheader = type.colorHex;
+    s.hexcolbg = "def";
+    s.hexcolborder = "def";
+    s.hexcoltext = "#CCCCCC";
+    s.hexcoltextsecondary = "#CCCCCC";
+
+    const PinDef buffer = MakePinDef("buffer", "Buffer", type.id);
+    switch (op) {
+    case BufferOp::Push:
+      s.name = "Push";
+      s.description = "Appends a sample to " + type.id;
+      s.inputs = {MakePinDef("exec", "", "exec"),
+                  MakePinDef("sample", "Sample", elem, 0)};
+      s.outputs = {MakePinDef("then", "", "exec"), buffer};
+      break;
+    case BufferOp::Sum:
+      s.name = "Sum";
+      s.description = "Sum of the samples of " + type.id;
+      s.inputs = {buffer};
+      s.outputs = {MakePinDef("sum", "Sum", elem)};
+      break;
+    case BufferOp::MinMax:
+      s.name = "Min / max";
+      s.description = "Smallest and largest sample of " + type.id;
+      s.inputs = {buffer};
+      s.outputs = {MakePinDef("min", "Min", elem),
+                   MakePinDef("max", "Max", elem)};
+      break;
+    case BufferOp::MovingAverage:
+      s.name = "Moving average";
+      s.description = "Mean of the newest samples of " + type.id;
+      s.inputs = {buffer, MakePinDef("window", "Window", "int", type.length)};
+      s.outputs = {MakePinDef("average", "Average", elem)};
+      break;
+    case BufferOp::ThresholdCount:
+      s.name = "Threshold count";
+      s.description = "Number of samples of " + type.id + " above a threshold";
+      s.inputs = {buffer, MakePinDef("threshold", "Threshold", elem, 0)};
+      s.outputs = {MakePinDef("count", "Count", "int")};
+      break;
+    case BufferOp::Scale:
+      s.name = "Scale";
+      s.description = "Every sample of " + type.id + " times a factor";
+      s.inputs = {buffer, MakePinDef("factor", "Factor", elem, 1)};
+      s.outputs = {MakePinDef("scaled", "Scaled", type.id)};
+      break;
+    case BufferOp::Count:
+      break;
+    }
+    s.proper_name = s.name + " (" + type.id + ")";
+    schemas.push_back(std::move(s));
+  }
+  return schemas;
+}
+
+bool SplitBufferPrimitiveId(const std::string &schemaId, std::string &typeId,
+                            BufferOp &op) {
+  for (size_t k = 0; k < static_cast<size_t>(BufferOp::Count); ++k) {
+    const std::string suffix = std::string("_") + kOpNames[k];
+    if (schemaId.size() > suffix.size() &&
+        schemaId.compare(schemaId.size() - suffix.size(), suffix.size(),
+                         suffix) == 0) {
+      typeId = schemaId.substr(0, schemaId.size() - suffix.size());
+      op = static_cast<BufferOp>(k);
+      return true;
+    }
+  }
+  return false;
+}
+
+const PinTypeInfo *FindBufferPrimitive(const SchemaCatalog &catalog,
+                                       const std::string &schemaId,
+                                       BufferOp &op) {
+  std::string typeId;
+  if (!SplitBufferPrimitiveId(schemaId, typeId, op))
+    return nullptr;
+  const PinTypeId id = PinTypeRegistry::Find(typeId);
+  if (id == kInvalidPinType)
+    return nullptr;
+  const PinTypeInfo *type = catalog.FindType(id);
+  return type && IsBufferType(*type) ? type : nullptr;
+}
+
+std::string BufferTypeDefinition(const PinTypeInfo &type,
+                                 const std::string &elementCpp) {
+  const ElementOps ops = ElementOps::For(elementCpp);
+  std::ostringstream o;
+  o << "// ---- " << type.id << ": " << PinLayoutName(type.layout_id) << " of "
+    << type.length << " " << type.element << " ----\n";
+  EmitStruct(o, type, ops);
+  EmitPush(o, type, ops);
+  EmitSum(o, type, ops);
+  EmitMinMax(o, type, ops);
+  EmitMovingAverage(o, type, ops);
+  EmitThresholdCount(o, type, ops);
+  EmitScale(o, type, ops);
+  o << "\n";
+  return o.str();
+}
+
+std::string
+BufferKernelCall(const PinTypeInfo &type, BufferOp op,
+                 const std::function<std::string(const std::string &)> &arg) {
+  const std::string fn = type.id + "_" + BufferOpName(op);
+  switch (op) {
+  case BufferOp::Push:
+    return fn + "(" + arg("buffer") + ", " + arg("sample") + ");";
+  case BufferOp::Sum:
+    return arg("sum") + " = " + fn + "(" + arg("buffer") + ");";
+  case BufferOp::MinMax:
+    return fn + "(" + arg("buffer") + ", " + arg("min") + ", " + arg("max") +
+           ");";
+  case BufferOp::MovingAverage:
+    return arg("average") + " = " + fn + "(" + arg("buffer") + ", " +
+           arg("window") + ");";
+  case BufferOp::ThresholdCount:
+    return arg("count") + " = " + fn + "(" + arg("buffer") + ", " +
+           arg("threshold") + ");";
+  case BufferOp::Scale:
+    return fn + "(" + arg("buffer") + ", " + arg("factor") + ", " +
+           arg("scaled") + ");";
+  case BufferOp::Count:
+    break;
+  }
+  return "";
+}
+
+} // namespace ModuleUI
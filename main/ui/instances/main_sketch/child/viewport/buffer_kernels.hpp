@@ -0,0 +1,69 @@
+#pragma once
+#include "./schema_types.hpp"
+
+#include <cstdint>
+#include <functional>
+#include <string>
+#include <vector>
+
+#ifndef BUFFER_KERNELS_MAIN_SKETCH_HPP
+#define BUFFER_KERNELS_MAIN_SKETCH_HPP
+
+namespace ModuleUI {
+
+// Buffer pin types are declared in types/<id>/type.json with a layout:
+//   { "id": "window16", "layout": "ring", "element": "float", "length": 16 }
+// An "array" keeps its samples in time order (push shifts), a "ring"
+// overwrites the oldest one in O(1). Each buffer type gets a generated
+// struct named after its id and a set of batch primitives named
+// <id>_<op>, which the transpiler lowers to calls of the kernels below
+// instead of per-element node chains.
+enum class BufferOp : uint8_t {
+  Push,
+  Sum,
+  MinMax,
+  MovingAverage,
+  ThresholdCount,
+  Scale,
+  Count
+};
+
+const char *BufferOpName(BufferOp op); // schema id suffix
+
+// True for well-formed buffer types: array or ring of int or float with a
+// non-zero length.
+bool IsBufferType(const PinTypeInfo &type);
+
+// Batch primitive schemas of `type` (kind "buffer", not saved with the
+// sketch's primitives, regenerated whenever the type is loaded).
+std::vector<SchemaInfo> BufferPrimitives(const PinTypeInfo &type);
+
+// Splits "<type>_<op>" at a known op suffix. Does not check that the type
+// exists.
+bool SplitBufferPrimitiveId(const std::string &schemaId, std::string &typeId,
+                            BufferOp &op);
+
+// Buffer type and op behind a generated schema id, null if `schemaId` is
+// not a batch primitive of a buffer type of `catalog`.
+const PinTypeInfo *FindBufferPrimitive(const SchemaCatalog &catalog,
+                                       const std::string &schemaId,
+                                       BufferOp &op);
+
+// Struct and kernels of `type`, emitted once per main.cpp before the pin
+// globals. `elementCpp` is the C++ type of an element ("efx_q" when floats
+// are lowered to fixed point). Loops over up to kBufferUnrollMax elements
+// are unrolled; host builds (EFUSION_SIM) get lane-split loops the
+// compiler can vectorize.
+constexpr uint32_t kBufferUnrollMax = 8;
+std::string BufferTypeDefinition(const PinTypeInfo &type,
+                                 const std::string &elementCpp);
+
+// Statement(s) calling the kernel of `op`, `arg` maps a pin id of the
+// generated schema to the variable holding it.
+std::string
+BufferKernelCall(const PinTypeInfo &type, BufferOp op,
+                 const std::function<std::string(const std::string &)> &arg);
+
+} // namespace ModuleUI
+
+#endif // BUFFER_KERNELS_MAIN_SKETCH_HPP
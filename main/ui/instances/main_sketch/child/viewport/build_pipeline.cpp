@@ -0,0 +1,813 @@
+#include "build_pipeline.hpp"
+
+#include <algorithm>
+#include <chrono>
+#include <cstdio>
+#include <cstdlib>
+#include <fstream>
+#include <functional>
+#include <iostream>
+#include <map>
+#include <mutex>
+#include <thread>
+
+#ifndef _WIN32
+#include <cerrno>
+#include <csignal>
+#include <poll.h>
+#include <sys/wait.h>
+#include <unistd.h>
+#endif
+
+namespace ModuleUI {
+
+namespace {
+
+// Arduino API subset the transpiler output relies on, enough to run a
+// sketch on the host. Pins are plain memory.
+constexpr const char *kSimHeader = R"sim(// Generated by Embedded Fusion: Arduino simulator runtime (host builds)
+#pragma once
+#include <cmath>
+#include <cstdint>
+#include <cstdlib>
+#include <iostream>
+#include <string>
+
+typedef bool boolean;
+typedef uint8_t byte;
+
+#define LOW 0x0
+#define HIGH 0x1
+#define INPUT 0x0
+#define OUTPUT 0x1
+#define INPUT_PULLUP 0x2
+#define LED_BUILTIN 13
+
+unsigned long millis();
+unsigned long micros();
+void delay(unsigned long ms);
+void delayMicroseconds(unsigned int us);
+void pinMode(uint8_t pin, uint8_t mode);
+void digitalWrite(uint8_t pin, uint8_t value);
+int digitalRead(uint8_t pin);
+int analogRead(uint8_t pin);
+void analogWrite(uint8_t pin, int value);
+long random(long max);
+long random(long min, long max);
+long map(long x, long in_min, long in_max, long out_min, long out_max);
+
+template <typename T> T constrain(T v, T lo, T hi) {
+  return v < lo ? lo : (hi < v ? hi : v);
+}
+
+class SimSerial {
+public:
+  void begin(unsigned long) {}
+  template <typename T> size_t print(const T &v) {
+    std::cout << v;
+    return 1;
+  }
+  template <typename T> size_t println(const T &v) {
+    std::cout << v << '\n';
+    return 1;
+  }
+  size_t println() {
+    std::cout << '\n';
+    return 1;
+  }
+  size_t write(uint8_t b) {
+    std::cout.put(static_cast<char>(b));
+    return 1;
+  }
+  size_t write(const uint8_t *p, size_t n) {
+    std::cout.write(reinterpret_cast<const char *>(p), n);
+    std::cout.flush();
+    return n;
+  }
+  int availableForWrite() { return 64; } // a typical UART buffer
+  int available();
+  int read();
+  void flush() { std::cout.flush(); }
+  explicit operator bool() const { return true; }
+};
+extern SimSerial Serial;
+
+// Simulator only: records a value for fixed-point accuracy comparisons
+void efusion_sim_probe(const char *name, double value);
+
+void setup();
+void loop();
+)sim";
+
+constexpr const char *kSimMain = R"sim(// Generated by Embedded Fusion: Arduino simulator runtime (host builds)
+#include "Arduino.h"
+
+#include <chrono>
+#include <cstdio>
+#include <fstream>
+#include <thread>
+
+// --loops N (or EFUSION_SIM_LOOPS) bounds the number of loop() calls,
+// default forever. --trace (EFUSION_SIM_TRACE) logs pin writes to stderr.
+// --probe prints efusion_sim_probe() values and runs on virtual time:
+// delay() advances millis() instead of sleeping, so two builds of a sketch
+// see the same clock. --serial PATH sends Serial to PATH (the terminal side
+// of a pseudo-terminal, for telemetry) instead of stdout.
+namespace {
+const auto g_start = std::chrono::steady_clock::now();
+int g_pins[256] = {};
+bool g_trace = std::getenv("EFUSION_SIM_TRACE") != nullptr;
+bool g_probe = false;
+unsigned long long g_virtual_us = 0;
+} // namespace
+
+SimSerial Serial;
+
+unsigned long micros() {
+  if (g_probe)
+    return static_cast<unsigned long>(g_virtual_us);
+  return static_cast<unsigned long>(
+      std::chrono::duration_cast<std::chrono::microseconds>(
+          std::chrono::steady_clock::now() - g_start)
+          .count());
+}
+unsigned long millis() {
+  if (g_probe)
+    return static_cast<unsigned long>(g_virtual_us / 1000);
+  return static_cast<unsigned long>(
+      std::chrono::duration_cast<std::chrono::milliseconds>(
+          std::chrono::steady_clock::now() - g_start)
+          .count());
+}
+void delay(unsigned long ms) {
+  if (g_probe)
+    g_virtual_us += 1000ull * ms;
+  else
+    std::this_thread::sleep_for(std::chrono::milliseconds(ms));
+}
+void delayMicroseconds(unsigned int us) {
+  if (g_probe)
+    g_virtual_us += us;
+  else
+    std::this_thread::sleep_for(std::chrono::microseconds(us));
+}
+void pinMode(uint8_t, uint8_t) {}
+void digitalWrite(uint8_t pin, uint8_t value) {
+  g_pins[pin] = value;
+  if (g_trace)
+    std::cerr << "[sim] " << millis() << " ms pin " << int(pin) << " = "
+              << int(value) << '\n';
+}
+int digitalRead(uint8_t pin) { return g_pins[pin] ? HIGH : LOW; }
+int analogRead(uint8_t pin) { return g_pins[pin]; }
+void analogWrite(uint8_t pin, int value) { digitalWrite(pin, value); }
+long random(long max) { return max > 0 ? std::rand() % max : 0; }
+long random(long min, long max) {
+  return max > min ? min + std::rand() % (max - min) : min;
+}
+long map(long x, long in_min, long in_max, long out_min, long out_max) {
+  return (x - in_min) * (out_max - out_min) / (in_max - in_min) + out_min;
+}
+
+int SimSerial::available() {
+  return static_cast<int>(std::cin.rdbuf()->in_avail());
+}
+int SimSerial::read() { return available() > 0 ? std::cin.get() : -1; }
+
+void efusion_sim_probe(const char *name, double value) {
+  if (g_probe)
+    std::printf("@probe %s %.9g\n", name, value);
+}
+
+int main(int argc, char **argv) {
+  const char *limit = std::getenv("EFUSION_SIM_LOOPS");
+  unsigned long loops = limit ? std::strtoul(limit, nullptr, 10) : 0;
+  std::ofstream serial;
+  for (int i = 1; i < argc; ++i) {
+    const std::string arg = argv[i];
+    if (arg == "--loops" && i + 1 < argc)
+      loops = std::strtoul(argv[++i], nullptr, 10);
+    else if (arg == "--trace")
+      g_trace = true;
+    else if (arg == "--probe")
+      g_probe = true;
+    else if (arg == "--serial" && i + 1 < argc) {
+      serial.open(argv[++i], std::ios::binary);
+      if (!serial.is_open()) {
+        std::cerr << "cannot open " << argv[i] << '\n';
+        return 1;
+      }
+    }
+  }
+  std::streambuf *const console = std::cout.rdbuf();
+  if (serial.is_open())
+    std::cout.rdbuf(serial.rdbuf());
+  setup();
+  for (unsigned long i = 0; loops == 0 || i < loops; ++i)
+    loop();
+  std::cout.rdbuf(console); // before `serial` closes
+  return 0;
+}
+)sim";
+
+// FNV-1a over length-prefixed parts, so ("ab", "c") and ("a", "bc") differ.
+class CacheKey {
+public:
+  CacheKey &Add(const std::string &part) {
+    const uint64_t n = part.size();
+    Mix(&n, sizeof(n));
+    Mix(part.data(), part.size());
+    return *this;
+  }
+  std::string Hex() const {
+    char buf[17];
+    std::snprintf(buf, sizeof(buf), "%016llx",
+                  static_cast<unsigned long long>(m_Hash));
+    return buf;
+  }
+
+private:
+  void Mix(const void *data, size_t size) {
+    const auto *p = static_cast<const unsigned char *>(data);
+    for (size_t i = 0; i < size; ++i) {
+      m_Hash ^= p[i];
+      m_Hash *= 1099511628211ull;
+    }
+  }
+  uint64_t m_Hash = 1469598103934665603ull;
+};
+
+std::optional<std::string> ReadText(const fs::path &path) {
+  std::ifstream in(path, std::ios::binary);
+  if (!in.is_open())
+    return std::nullopt;
+  return std::string((std::istreambuf_iterator<char>(in)),
+                     std::istreambuf_iterator<char>());
+}
+
+fs::path TempPath(const fs::path &path) {
+  fs::path tmp = path;
+  tmp += ".tmp" + std::to_string(std::hash<std::thread::id>{}(
+                      std::this_thread::get_id()));
+  return tmp;
+}
+
+// Leaves the file (and its mtime) alone when the content is unchanged.
+// Written aside and renamed over `path`, so a concurrent build of another
+// window never compiles a half written file.
+bool WriteIfChanged(const fs::path &path, const std::string &content) {
+  if (auto existing = ReadText(path))
+    if (*existing == content)
+      return true;
+  const fs::path tmp = TempPath(path);
+  {
+    std::ofstream out(tmp, std::ios::binary | std::ios::trunc);
+    if (!out.is_open())
+      return false;
+    out << content;
+    if (!out)
+      return false;
+  }
+  std::error_code ec;
+  fs::rename(tmp, path, ec);
+  if (ec)
+    fs::remove(tmp, ec);
+  return !ec;
+}
+
+bool FindInPath(const std::string &exe) {
+  const char *path = std::getenv("PATH");
+  if (!path)
+    return false;
+#ifdef _WIN32
+  const char sep = ';';
+  const std::string name = exe + ".exe";
+#else
+  const char sep = ':';
+  const std::string &name = exe;
+#endif
+  std::string dirs = path;
+  size_t start = 0;
+  while (start <= dirs.size()) {
+    size_t end = dirs.find(sep, start);
+    if (end == std::string::npos)
+      end = dirs.size();
+    std::error_code ec;
+    if (end > start &&
+        fs::is_regular_file(fs::path(dirs.substr(start, end - start)) / name,
+                            ec))
+      return true;
+    start = end + 1;
+  }
+  return false;
+}
+
+// First line of `<tool> <arg>`, part of every cache key so a compiler
+// upgrade invalidates the cache. Empty when the tool does not run.
+std::string ToolIdentity(const std::string &tool, const std::string &arg) {
+  static std::mutex mutex;
+  static std::map<std::string, std::string> known;
+  const std::string cmd = ShellQuote(tool) + " " + arg;
+  {
+    std::lock_guard<std::mutex> lock(mutex);
+    auto it = known.find(cmd);
+    if (it != known.end())
+      return it->second;
+  }
+  std::string out;
+  std::string id;
+  if (RunCommand(cmd, out, std::chrono::seconds(30)) == 0)
+    id = out.substr(0, out.find('\n'));
+  std::lock_guard<std::mutex> lock(mutex);
+  return known[cmd] = id;
+}
+
+void Touch(const fs::path &path) {
+  std::error_code ec;
+  fs::last_write_time(path, fs::file_time_type::clock::now(), ec);
+}
+
+// Drops least recently used entries (object files, arduino output
+// directories) until the cache fits in `limit` bytes.
+void TrimCache(const fs::path &cacheDir, uint64_t limit) {
+  struct Entry {
+    fs::path path;
+    uint64_t size;
+    fs::file_time_type used;
+  };
+  std::vector<Entry> entries;
+  uint64_t total = 0;
+  std::error_code ec;
+
+  for (const char *sub : {"objects", "arduino"}) {
+    fs::path dir = cacheDir / sub;
+    if (!fs::is_directory(dir, ec))
+      continue;
+    for (const auto &e : fs::directory_iterator(dir, ec)) {
+      Entry entry{e.path(), 0, e.last_write_time(ec)};
+      if (e.is_directory(ec)) {
+        for (const auto &f : fs::recursive_directory_iterator(e.path(), ec))
+          if (f.is_regular_file(ec))
+            entry.size += f.file_size(ec);
+        entry.used = fs::last_write_time(e.path() / ".complete", ec);
+      } else {
+        entry.size = e.file_size(ec);
+      }
+      total += entry.size;
+      entries.push_back(std::move(entry));
+    }
+  }
+  if (total <= limit)
+    return;
+
+  std::sort(entries.begin(), entries.end(),
+            [](const Entry &a, const Entry &b) { return a.used < b.used; });
+  for (const auto &e : entries) {
+    if (total <= limit)
+      break;
+    fs::remove_all(e.path, ec);
+    total -= e.size;
+  }
+}
+
+BuildResult BuildHost(const fs::path &root, const fs::path &mainCpp,
+                      const fs::path &artifact, const BuildSettings &settings) {
+  BuildResult r;
+  r.toolchain = "host " + settings.cxx;
+
+  const std::string identity = ToolIdentity(settings.cxx, "--version");
+  if (identity.empty()) {
+    r.log = "compiler '" + settings.cxx + "' not found\n";
+    return r;
+  }
+
+  const fs::path simDir = root / "transpilation" / "sim";
+  const fs::path objDir = root / "transpilation" / "cache" / "objects";
+  fs::create_directories(simDir);
+  fs::create_directories(objDir);
+  if (!WriteIfChanged(simDir / "Arduino.h", kSimHeader) ||
+      !WriteIfChanged(simDir / "sim_main.cpp", kSimMain)) {
+    r.log = "cannot write the simulator runtime to " + simDir.string() + "\n";
+    return r;
+  }
+
+  // Sketches with tasks run them on threads in the simulator
+  std::string flags = " -DEFUSION_SIM -pthread";
+  for (const auto &f : settings.flags)
+    flags += " " + f;
+
+  // The transpiler inlines skeletons into main.cpp, so a unit's own text
+  // plus the runtime header is everything it depends on (system headers
+  // are covered by the compiler identity).
+  const fs::path units[] = {mainCpp, simDir / "sim_main.cpp"};
+  std::vector<fs::path> objects;
+  CacheKey linkKey;
+  linkKey.Add(identity);
+  for (const auto &unit : units) {
+    auto source = ReadText(unit);
+    if (!source) {
+      r.log += "missing " + unit.string() + "\n";
+      return r;
+    }
+    const std::string key = CacheKey()
+                                .Add(identity)
+                                .Add(settings.cxx)
+                                .Add(flags)
+                                .Add(kSimHeader)
+                                .Add(*source)
+                                .Hex();
+    const fs::path object = objDir / (key + ".o");
+    linkKey.Add(key);
+    objects.push_back(object);
+    ++r.units;
+
+    std::error_code ec;
+    if (fs::is_regular_file(object, ec)) {
+      ++r.cache_hits;
+      Touch(object);
+      continue;
+    }
+
+    const fs::path tmp = TempPath(object);
+    std::string cmd = ShellQuote(settings.cxx) + flags + " -I" +
+                      ShellQuote(simDir.string()) + " -c " +
+                      ShellQuote(unit.string()) + " -o " +
+                      ShellQuote(tmp.string());
+    if (RunCommand(cmd, r.log) != 0) {
+      fs::remove(tmp, ec);
+      return r;
+    }
+    fs::rename(tmp, object, ec);
+    if (ec) {
+      r.log += "cannot store " + object.string() + ": " + ec.message() + "\n";
+      return r;
+    }
+  }
+
+  r.artifact = artifact;
+  // Relink only when the set of objects changed
+  fs::path linkStamp = artifact;
+  linkStamp += ".key";
+  const std::string link = linkKey.Hex();
+  std::error_code ec;
+  if (fs::is_regular_file(r.artifact, ec) && ReadText(linkStamp) == link) {
+    r.ok = true;
+    return r;
+  }
+  std::string cmd = ShellQuote(settings.cxx);
+  for (const auto &o : objects)
+    cmd += " " + ShellQuote(o.string());
+  cmd += flags + " -o " + ShellQuote(r.artifact.string());
+  if (RunCommand(cmd, r.log) != 0)
+    return r;
+  WriteIfChanged(linkStamp, link);
+  r.ok = true;
+  return r;
+}
+
+BuildResult BuildArduino(const fs::path &root, const BuildSettings &settings) {
+  BuildResult r;
+  r.toolchain = "arduino-cli " + settings.fqbn;
+
+  const std::string identity = ToolIdentity("arduino-cli", "version");
+  if (identity.empty()) {
+    r.log = "arduino-cli not found\n";
+    return r;
+  }
+
+  // arduino-cli wants a sketch folder holding <folder>.ino, main.cpp is
+  // compiled alongside it.
+  const fs::path sketchDir =
+      root / "transpilation" / "arduino" / "efusion_sketch";
+  fs::create_directories(sketchDir);
+  auto source = ReadText(root / "transpilation" / "build" / "main.cpp");
+  if (!source) {
+    r.log = "missing transpilation/build/main.cpp\n";
+    return r;
+  }
+  if (!WriteIfChanged(sketchDir / "efusion_sketch.ino",
+                      "// Generated by Embedded Fusion, see main.cpp\n") ||
+      !WriteIfChanged(sketchDir / "main.cpp", *source)) {
+    r.log = "cannot write " + sketchDir.string() + "\n";
+    return r;
+  }
+
+  const std::string key =
+      CacheKey().Add(identity).Add(settings.fqbn).Add(*source).Hex();
+  const fs::path outDir = root / "transpilation" / "cache" / "arduino" / key;
+  const fs::path stamp = outDir / ".complete";
+  r.artifact = outDir;
+  r.units = 1;
+
+  std::error_code ec;
+  if (fs::is_regular_file(stamp, ec)) {
+    ++r.cache_hits;
+    Touch(stamp);
+    r.ok = true;
+    return r;
+  }
+
+  std::string cmd = "arduino-cli compile --fqbn " + ShellQuote(settings.fqbn) +
+                    " --output-dir " + ShellQuote(outDir.string()) + " " +
+                    ShellQuote(sketchDir.string());
+  if (RunCommand(cmd, r.log) != 0) {
+    fs::remove_all(outDir, ec);
+    return r;
+  }
+  WriteIfChanged(stamp, key);
+  r.ok = true;
+  return r;
+}
+
+// Sized symbols of the linked binary, for the per-node size report.
+std::vector<SymbolSize> ListSymbols(const BuildResult &r, bool arduino,
+                                    const BuildSettings &settings) {
+  fs::path elf = r.artifact;
+  std::error_code ec;
+  if (fs::is_directory(elf, ec)) {
+    elf.clear();
+    for (const auto &e : fs::directory_iterator(r.artifact, ec))
+      if (e.path().extension() == ".elf")
+        elf = e.path();
+  }
+  if (elf.empty())
+    return {};
+
+  std::string nm = settings.nm;
+  if (nm.empty())
+    nm = arduino && FindInPath("avr-nm") ? "avr-nm" : "nm";
+  std::string out;
+  if (RunCommand(ShellQuote(nm) + " -S --size-sort -C " + ShellQuote(elf.string()),
+                 out) != 0)
+    return {};
+  return ParseNmSizes(out);
+}
+
+} // namespace
+
+std::string ShellQuote(const std::string &s) {
+#ifdef _WIN32
+  std::string q = "\"";
+  for (char c : s) {
+    if (c == '"' || c == '\\')
+      q += '\\';
+    q += c;
+  }
+  return q + "\"";
+#else
+  // Nothing expands inside single quotes, a quote itself is closed,
+  // escaped and reopened.
+  std::string q = "'";
+  for (char c : s) {
+    if (c == '\'')
+      q += "'\\''";
+    else
+      q += c;
+  }
+  return q + "'";
+#endif
+}
+
+namespace {
+
+thread_local std::shared_ptr<std::atomic<bool>> t_CommandCancel;
+
+bool CommandCancelled() {
+  return t_CommandCancel && t_CommandCancel->load();
+}
+
+} // namespace
+
+CommandCancelScope::CommandCancelScope(
+    std::shared_ptr<std::atomic<bool>> flag)
+    : m_Previous(std::exchange(t_CommandCancel, std::move(flag))) {}
+
+CommandCancelScope::~CommandCancelScope() {
+  t_CommandCancel = std::move(m_Previous);
+}
+
+int RunCommand(const std::string &cmd, std::string &output,
+               std::chrono::milliseconds timeout) {
+  if (CommandCancelled()) {
+    output += "\ncancelled: " + cmd + "\n";
+    return -1;
+  }
+#ifdef _WIN32
+  (void)timeout; // no process group to kill, the command runs to its end
+  FILE *pipe = _popen((cmd + " 2>&1").c_str(), "r");
+  if (!pipe)
+    return -1;
+  char buf[4096];
+  size_t n;
+  while ((n = std::fread(buf, 1, sizeof(buf), pipe)) > 0)
+    output.append(buf, n);
+  return _pclose(pipe);
+#else
+  int fds[2];
+  if (::pipe(fds) != 0)
+    return -1;
+  const pid_t pid = ::fork();
+  if (pid < 0) {
+    ::close(fds[0]);
+    ::close(fds[1]);
+    return -1;
+  }
+  if (pid == 0) {
+    // Own process group, so a timeout takes down whatever the shell started
+    ::setpgid(0, 0);
+    ::dup2(fds[1], STDOUT_FILENO);
+    ::dup2(fds[1], STDERR_FILENO);
+    ::close(fds[0]);
+    ::close(fds[1]);
+    ::execl("/bin/sh", "sh", "-c", cmd.c_str(), static_cast<char *>(nullptr));
+    ::_exit(127);
+  }
+  ::setpgid(pid, pid); // also here, the child may not have run yet
+  ::close(fds[1]);
+
+  const auto deadline = std::chrono::steady_clock::now() + timeout;
+  bool timedOut = false, cancelled = false;
+  char buf[4096];
+  for (;;) {
+    const auto left = std::chrono::duration_cast<std::chrono::milliseconds>(
+                          deadline - std::chrono::steady_clock::now())
+                          .count();
+    if (left <= 0) {
+      timedOut = true;
+      break;
+    }
+    if (CommandCancelled()) {
+      cancelled = true;
+      break;
+    }
+    // Short waits, a cancel is noticed within one
+    pollfd p{fds[0], POLLIN, 0};
+    const int ready =
+        ::poll(&p, 1, static_cast<int>(std::min<long long>(left, 100)));
+    if (ready < 0 && errno != EINTR)
+      break;
+    if (ready <= 0)
+      continue;
+    const ssize_t n = ::read(fds[0], buf, sizeof(buf));
+    if (n > 0)
+      output.append(buf, static_cast<size_t>(n));
+    else if (n == 0 || errno != EINTR)
+      break; // end of output
+  }
+  ::close(fds[0]);
+  if (timedOut || cancelled)
+    ::kill(-pid, SIGKILL);
+  int status = 0;
+  while (::waitpid(pid, &status, 0) < 0 && errno == EINTR) {
+  }
+  if (timedOut) {
+    output += "\nkilled after " + std::to_string(timeout.count()) +
+              " ms: " + cmd + "\n";
+    return -1;
+  }
+  if (cancelled) {
+    output += "\ncancelled: " + cmd + "\n";
+    return -1;
+  }
+  return WIFEXITED(status) ? WEXITSTATUS(status) : -1;
+#endif
+}
+
+BuildSettings BuildSettings::FromJson(const json &j) {
+  BuildSettings s;
+  if (!j.is_object())
+    return s;
+  s.toolchain = j.value("toolchain", s.toolchain);
+  s.cxx = j.value("cxx", s.cxx);
+  s.fqbn = j.value("fqbn", s.fqbn);
+  s.nm = j.value("nm", s.nm);
+  if (j.contains("flags") && j["flags"].is_array()) {
+    s.flags.clear();
+    for (const auto &f : j["flags"])
+      if (f.is_string())
+        s.flags.push_back(f.get<std::string>());
+  }
+  if (j.contains("cache_limit_mb") && j["cache_limit_mb"].is_number_unsigned())
+    s.cache_limit = j["cache_limit_mb"].get<uint64_t>() << 20;
+  return s;
+}
+
+std::string SimExecutableName() {
+#ifdef _WIN32
+  return "sketch_sim.exe";
+#else
+  return "sketch_sim";
+#endif
+}
+
+BuildPipeline::BuildPipeline(fs::path sketchRoot)
+    : m_Root(std::move(sketchRoot)) {}
+
+bool BuildPipeline::Start(const BuildSettings &settings,
+                          std::optional<ProbeJob> probe, bool build) {
+  if (m_Pending.valid() || (!probe && !build))
+    return false;
+  m_Pending = std::async(
+      std::launch::async, [root = m_Root, cancel = m_Cancel, settings,
+                           probe = std::move(probe), build]() {
+        CommandCancelScope scope(cancel);
+        Job job;
+        if (probe)
+          job.probe = RunProbe(root, *probe, settings);
+        if (build)
+          job.build = Run(root, settings);
+        return job;
+      });
+  return true;
+}
+
+bool BuildPipeline::Poll() {
+  if (!m_Pending.valid() || m_Pending.wait_for(std::chrono::seconds(0)) !=
+                                std::future_status::ready)
+    return false;
+  Job job = m_Pending.get();
+  if (job.probe)
+    m_Probe = std::move(job.probe);
+  if (!job.build)
+    return false;
+  m_Last = std::move(job.build);
+  m_Units += m_Last->units;
+  m_Hits += m_Last->cache_hits;
+  return true;
+}
+
+BuildResult BuildPipeline::Run(const fs::path &sketchRoot,
+                               const BuildSettings &settings) {
+  auto start = std::chrono::steady_clock::now();
+  BuildResult r;
+  try {
+    const bool arduino =
+        settings.toolchain == "arduino-cli" ||
+        (settings.toolchain == "auto" && FindInPath("arduino-cli"));
+    const fs::path buildDir = sketchRoot / "transpilation" / "build";
+    r = arduino ? BuildArduino(sketchRoot, settings)
+                : BuildHost(sketchRoot, buildDir / "main.cpp",
+                            buildDir / SimExecutableName(), settings);
+    if (r.ok)
+      r.symbols = ListSymbols(r, arduino, settings);
+    TrimCache(sketchRoot / "transpilation" / "cache", settings.cache_limit);
+  } catch (const std::exception &e) {
+    r.ok = false;
+    r.log += std::string("build exception: ") + e.what() + "\n";
+  }
+  r.compile_ms = std::chrono::duration<double, std::milli>(
+                     std::chrono::steady_clock::now() - start)
+                     .count();
+  return r;
+}
+
+BuildResult BuildPipeline::RunHost(const fs::path &sketchRoot,
+                                   const fs::path &mainCpp,
+                                   const fs::path &artifact,
+                                   const BuildSettings &settings) {
+  auto start = std::chrono::steady_clock::now();
+  BuildResult r;
+  try {
+    r = BuildHost(sketchRoot, mainCpp, artifact, settings);
+    TrimCache(sketchRoot / "transpilation" / "cache", settings.cache_limit);
+  } catch (const std::exception &e) {
+    r.ok = false;
+    r.log += std::string("build exception: ") + e.what() + "\n";
+  }
+  r.compile_ms = std::chrono::duration<double, std::milli>(
+                     std::chrono::steady_clock::now() - start)
+                     .count();
+  return r;
+}
+
+ProbeResult BuildPipeline::RunProbe(const fs::path &sketchRoot,
+                                    const ProbeJob &probe,
+                                    const BuildSettings &settings) {
+  ProbeResult p;
+  const fs::path source = probe.dir / "main.cpp";
+  const fs::path exe = probe.dir / SimExecutableName();
+  try {
+    fs::create_directories(probe.dir);
+    if (!WriteIfChanged(source, probe.source)) {
+      p.log = "cannot write " + source.string() + "\n";
+      return p;
+    }
+    const BuildResult r = RunHost(sketchRoot, source, exe, settings);
+    if (!r.ok) {
+      p.log = "probe build failed:\n" + r.log;
+      return p;
+    }
+    if (RunCommand(ShellQuote(exe.string()) + " " + probe.args, p.output,
+                   probe.timeout) != 0) {
+      p.log = "probe run failed:\n" + p.output;
+      p.output.clear();
+      return p;
+    }
+    p.ok = true;
+  } catch (const std::exception &e) {
+    p.log += std::string("probe exception: ") + e.what() + "\n";
+  }
+  return p;
+}
+
+} // namespace ModuleUI
@@ -0,0 +1,155 @@
+#pragma once
+#include "../../../../../../lib/vortex/main/include/vortex.h"
+#include "./size_report.hpp"
+
+#include <atomic>
+#include <chrono>
+#include <future>
+#include <memory>
+#include <optional>
+#include <string>
+#include <utility>
+#include <vector>
+
+#ifndef BUILD_PIPELINE_MAIN_SKETCH_HPP
+#define BUILD_PIPELINE_MAIN_SKETCH_HPP
+
+namespace ModuleUI {
+
+// "build" object of the sketch's main_sketch.json. Every field is optional.
+struct BuildSettings {
+  std::string toolchain = "auto"; // "auto", "host" or "arduino-cli"
+  std::string cxx = "g++";        // host compiler
+  std::vector<std::string> flags = {"-std=gnu++17", "-O2"};
+  std::string fqbn = "arduino:avr:uno";
+  std::string nm; // symbol lister, default avr-nm (arduino, if found) or nm
+  uint64_t cache_limit = 256ull << 20; // bytes kept in transpilation/cache
+
+  static BuildSettings FromJson(const json &j);
+};
+
+struct BuildResult {
+  bool ok = false;
+  std::string toolchain; // toolchain actually used
+  fs::path artifact;     // host executable, or arduino-cli output directory
+  std::string log;       // compiler output
+  double compile_ms = 0.0;
+  size_t units = 0;      // translation units (or arduino-cli builds) needed
+  size_t cache_hits = 0; // of which served from the cache
+  std::vector<SymbolSize> symbols; // sized symbols of the linked binary
+};
+
+// Host program run ahead of a build in the same background job, e.g. the
+// lookup table probe of a transpilation (see TranspileOptions::lut).
+struct ProbeJob {
+  std::string source; // main.cpp of the probe
+  fs::path dir;       // where it is written and built
+  std::string args;   // command line of the executable
+  std::chrono::milliseconds timeout{5000};
+};
+
+struct ProbeResult {
+  bool ok = false;
+  std::string output; // stdout of the probe
+  std::string log;    // why it failed
+};
+
+// Compiles the transpiled sketch (transpilation/build/main.cpp).
+//
+// The host toolchain builds it against a small Arduino simulator runtime
+// (generated in transpilation/sim) into an executable; arduino-cli builds
+// it for `fqbn`. Outputs are kept in a content-addressed cache under
+// transpilation/cache, keyed by the hash of the sources, the flags and the
+// compiler identity, so rebuilding an unchanged sketch, or switching back
+// to a previous version of it, costs no compilation.
+class BuildPipeline {
+public:
+  explicit BuildPipeline(fs::path sketchRoot);
+  // Cancels the running job rather than waiting up to kCommandTimeout for
+  // it.
+  ~BuildPipeline() { Cancel(); }
+
+  // Starts a background job: `probe` if any, then the build unless `build`
+  // is false. Returns false if a job is already running.
+  bool Start(const BuildSettings &settings,
+             std::optional<ProbeJob> probe = std::nullopt, bool build = true);
+  // Collects a finished job, never blocks. True when a build result came
+  // in; the probe result of the job is kept for TakeProbe().
+  bool Poll();
+  bool IsRunning() const { return m_Pending.valid(); }
+  // Kills the toolchain command of the running job and fails the ones it
+  // would start next, for good: the window is going away. Background work
+  // of the same window started elsewhere joins through CancelFlag().
+  void Cancel() { m_Cancel->store(true); }
+  const std::shared_ptr<std::atomic<bool>> &CancelFlag() const {
+    return m_Cancel;
+  }
+
+  const std::optional<BuildResult> &LastResult() const { return m_Last; }
+  std::optional<ProbeResult> TakeProbe() { return std::exchange(m_Probe, {}); }
+  // Cumulative over the session
+  size_t Units() const { return m_Units; }
+  size_t CacheHits() const { return m_Hits; }
+  double HitRate() const {
+    return m_Units ? static_cast<double>(m_Hits) / m_Units : 0.0;
+  }
+
+  // Runs a build synchronously, used by the background task.
+  static BuildResult Run(const fs::path &sketchRoot,
+                         const BuildSettings &settings);
+  // Host build of any transpiled file against the simulator runtime,
+  // sharing the object cache.
+  static BuildResult RunHost(const fs::path &sketchRoot,
+                             const fs::path &mainCpp, const fs::path &artifact,
+                             const BuildSettings &settings);
+  // Host build of `probe`, then runs it; a probe still running after its
+  // timeout is killed and fails.
+  static ProbeResult RunProbe(const fs::path &sketchRoot, const ProbeJob &probe,
+                              const BuildSettings &settings);
+
+private:
+  struct Job {
+    std::optional<ProbeResult> probe;
+    std::optional<BuildResult> build;
+  };
+
+  fs::path m_Root;
+  std::shared_ptr<std::atomic<bool>> m_Cancel =
+      std::make_shared<std::atomic<bool>>(false);
+  std::future<Job> m_Pending;
+  std::optional<BuildResult> m_Last;
+  std::optional<ProbeResult> m_Probe;
+  size_t m_Units = 0;
+  size_t m_Hits = 0;
+};
+
+// sketch_sim, with the platform's executable suffix.
+std::string SimExecutableName();
+
+// Longest a toolchain command may run before it is considered hung.
+constexpr std::chrono::seconds kCommandTimeout{600};
+
+// Runs `cmd` through the shell, stderr folded into `output`. Returns the
+// exit status, -1 if the command could not be run, was killed after
+// `timeout` or was cancelled (noted in `output`).
+int RunCommand(const std::string &cmd, std::string &output,
+               std::chrono::milliseconds timeout = kCommandTimeout);
+// While alive, RunCommand() on this thread gives up as soon as `flag` is
+// set, killing the command it is running. Background jobs hold one for the
+// flag of their window.
+class CommandCancelScope {
+public:
+  explicit CommandCancelScope(std::shared_ptr<std::atomic<bool>> flag);
+  ~CommandCancelScope();
+  CommandCancelScope(const CommandCancelScope &) = delete;
+  CommandCancelScope &operator=(const CommandCancelScope &) = delete;
+
+private:
+  std::shared_ptr<std::atomic<bool>> m_Previous;
+};
+// Quotes `s` as one literal shell word.
+std::string ShellQuote(const std::string &s);
+
+} // namespace ModuleUI
+
+#endif // BUILD_PIPELINE_MAIN_SKETCH_HPP
@@ -0,0 +1,165 @@
+#include "document_format.hpp"
+#include "../../../../../src/trace.hpp"
+
+#include <fstream>
+#include <iostream>
+
+namespace ModuleUI {
+
+namespace {
+
+constexpr uint8_t kCborSelfDescribe[3] = {0xd9, 0xd9, 0xf7};
+
+} // namespace
+
+const char *DocumentFormatName(DocumentFormat format) {
+  switch (format) {
+  case DocumentFormat::Json:
+    return "json";
+  case DocumentFormat::Cbor:
+    return "cbor";
+  case DocumentFormat::MsgPack:
+    return "msgpack";
+  }
+  return "json";
+}
+
+DocumentFormat DocumentFormatFromString(const std::string &name) {
+  if (name == "cbor")
+    return DocumentFormat::Cbor;
+  if (name == "msgpack")
+    return DocumentFormat::MsgPack;
+  return DocumentFormat::Json;
+}
+
+DocumentFormat DetectDocumentFormat(const uint8_t *data, size_t size) {
+  if (DocumentHeaderSize(data, size, DocumentFormat::Cbor) != 0)
+    return DocumentFormat::Cbor;
+  for (size_t i = 0; i < size; ++i) {
+    const uint8_t b = data[i];
+    if (b == ' ' || b == '\t' || b == '\r' || b == '\n')
+      continue;
+    if (b == '{' || b == '[')
+      return DocumentFormat::Json;
+    // fixmap, fixarray, map16/32, array16/32
+    if ((b & 0xf0) == 0x80 || (b & 0xf0) == 0x90 || b == 0xde || b == 0xdf ||
+        b == 0xdc || b == 0xdd)
+      return DocumentFormat::MsgPack;
+    // untagged CBOR map (untagged arrays are indistinguishable from
+    // MessagePack, which is why CBOR is always written tagged)
+    if ((b & 0xe0) == 0xa0)
+      return DocumentFormat::Cbor;
+    break;
+  }
+  return DocumentFormat::Json;
+}
+
+DocumentFormat DetectDocumentFormat(const std::vector<uint8_t> &bytes) {
+  return DetectDocumentFormat(bytes.data(), bytes.size());
+}
+
+size_t DocumentHeaderSize(const uint8_t *data, size_t size,
+                          DocumentFormat format) {
+  if (format == DocumentFormat::Cbor && size >= 3 &&
+      data[0] == kCborSelfDescribe[0] && data[1] == kCborSelfDescribe[1] &&
+      data[2] == kCborSelfDescribe[2])
+    return 3;
+  return 0;
+}
+
+std::vector<uint8_t> EncodeDocument(const json &doc, DocumentFormat format,
+                                    bool pretty) {
+  switch (format) {
+  case DocumentFormat::Cbor: {
+    std::vector<uint8_t> out(std::begin(kCborSelfDescribe),
+                             std::end(kCborSelfDescribe));
+    json::to_cbor(doc, out);
+    return out;
+  }
+  case DocumentFormat::MsgPack:
+    return json::to_msgpack(doc);
+  case DocumentFormat::Json:
+    break;
+  }
+  std::string text = doc.dump(pretty ? 4 : -1);
+  return std::vector<uint8_t>(text.begin(), text.end());
+}
+
+json DecodeDocument(const std::vector<uint8_t> &bytes, DocumentFormat format) {
+  switch (format) {
+  case DocumentFormat::Cbor: {
+    auto begin = bytes.begin() + DocumentHeaderSize(bytes.data(), bytes.size(),
+                                                    DocumentFormat::Cbor);
+    return json::from_cbor(begin, bytes.end(), true, false);
+  }
+  case DocumentFormat::MsgPack:
+    return json::from_msgpack(bytes.begin(), bytes.end(), true, false);
+  case DocumentFormat::Json:
+    break;
+  }
+  return json::parse(bytes.begin(), bytes.end(), nullptr, false);
+}
+
+std::optional<std::vector<uint8_t>> ReadFileBytes(const fs::path &path) {
+  std::ifstream in(path, std::ios::binary | std::ios::ate);
+  if (!in.is_open())
+    return std::nullopt;
+  std::streamsize size = in.tellg();
+  if (size < 0)
+    return std::nullopt;
+  std::vector<uint8_t> bytes(static_cast<size_t>(size));
+  in.seekg(0);
+  if (size > 0 && !in.read(reinterpret_cast<char *>(bytes.data()), size))
+    return std::nullopt;
+  EFUSION_TRACE_COUNT(EmbeddedFusion::TraceCounter::FilesRead);
+  return bytes;
+}
+
+bool WriteFileBytes(const fs::path &path, const uint8_t *data, size_t size) {
+  fs::path tmp = path;
+  tmp += ".tmp";
+  {
+    std::ofstream out(tmp, std::ios::binary | std::ios::trunc);
+    if (!out.is_open())
+      return false;
+    out.write(reinterpret_cast<const char *>(data),
+              static_cast<std::streamsize>(size));
+    if (!out)
+      return false;
+  }
+  std::error_code ec;
+  fs::rename(tmp, path, ec);
+  if (ec) {
+    std::cerr << "WriteFileBytes: cannot replace " << path << ": "
+              << ec.message() << std::endl;
+    fs::remove(tmp, ec);
+    return false;
+  }
+  EFUSION_TRACE_WRITE(size);
+  return true;
+}
+
+bool WriteFileBytes(const fs::path &path, const std::vector<uint8_t> &bytes) {
+  return WriteFileBytes(path, bytes.data(), bytes.size());
+}
+
+std::optional<json> ReadDocument(const fs::path &path,
+                                 DocumentFormat *detected) {
+  auto bytes = ReadFileBytes(path);
+  if (!bytes)
+    return std::nullopt;
+  DocumentFormat format = DetectDocumentFormat(*bytes);
+  if (detected)
+    *detected = format;
+  json doc = DecodeDocument(*bytes, format);
+  if (doc.is_discarded())
+    return std::nullopt;
+  return doc;
+}
+
+bool WriteDocument(const fs::path &path, const json &doc,
+                   DocumentFormat format, bool pretty) {
+  return WriteFileBytes(path, EncodeDocument(doc, format, pretty));
+}
+
+} // namespace ModuleUI
@@ -0,0 +1,49 @@
+#pragma once
+#include "../../../../../../lib/vortex/main/include/vortex.h"
+
+#include <cstdint>
+#include <optional>
+#include <string>
+#include <vector>
+
+#ifndef DOCUMENT_FORMAT_MAIN_SKETCH_HPP
+#define DOCUMENT_FORMAT_MAIN_SKETCH_HPP
+
+namespace ModuleUI {
+
+// On-disk encodings of sketch documents (graph, pin setup). Files keep
+// their .json name whatever the encoding; readers detect it from the first
+// bytes, so a sketch can switch format without renaming anything.
+enum class DocumentFormat : uint8_t { Json, Cbor, MsgPack };
+
+const char *DocumentFormatName(DocumentFormat format);
+DocumentFormat DocumentFormatFromString(const std::string &name);
+
+// JSON starts with '{' or '[' (after whitespace), CBOR is written with the
+// self-describe tag (d9 d9 f7), MessagePack documents are maps or arrays.
+DocumentFormat DetectDocumentFormat(const uint8_t *data, size_t size);
+DocumentFormat DetectDocumentFormat(const std::vector<uint8_t> &bytes);
+// Bytes in front of the encoded value (the CBOR self-describe tag).
+size_t DocumentHeaderSize(const uint8_t *data, size_t size,
+                          DocumentFormat format);
+
+std::vector<uint8_t> EncodeDocument(const json &doc, DocumentFormat format,
+                                    bool pretty = false);
+// Returns a discarded value on malformed input.
+json DecodeDocument(const std::vector<uint8_t> &bytes, DocumentFormat format);
+
+std::optional<std::vector<uint8_t>> ReadFileBytes(const fs::path &path);
+// Writes through a temporary file and a rename, so readers never see a
+// half-written document.
+bool WriteFileBytes(const fs::path &path, const uint8_t *data, size_t size);
+bool WriteFileBytes(const fs::path &path, const std::vector<uint8_t> &bytes);
+
+// Reads and decodes a document in any supported format.
+std::optional<json> ReadDocument(const fs::path &path,
+                                 DocumentFormat *detected = nullptr);
+bool WriteDocument(const fs::path &path, const json &doc,
+                   DocumentFormat format, bool pretty = false);
+
+} // namespace ModuleUI
+
+#endif // DOCUMENT_FORMAT_MAIN_SKETCH_HPP
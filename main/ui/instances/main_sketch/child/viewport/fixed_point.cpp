@@ -0,0 +1,177 @@
+#include "fixed_point.hpp"
+
+#include <algorithm>
+#include <cmath>
+#include <sstream>
+#include <unordered_map>
+
+namespace ModuleUI {
+
+TranspileOptions TranspileOptions::FromJson(const json &transpile,
+                                            const std::string &fqbn) {
+  TranspileOptions o;
+  if (!transpile.is_object())
+    return o;
+  const std::string floats = transpile.value("floats", "float");
+  if (floats == "fixed" || (floats == "auto" && IsFpuLessBoard(fqbn)))
+    o.floats = FloatLowering::Fixed;
+  if (transpile.contains("fixed_frac_bits") &&
+      transpile["fixed_frac_bits"].is_number_integer())
+    o.frac_bits = std::clamp(transpile["fixed_frac_bits"].get<int>(), 1, 30);
+  if (transpile.value("execution", "polled") == "reactive")
+    o.execution = ExecutionMode::Reactive;
+  o.lut = LookupTableProfile::ForBoard(fqbn);
+  if (transpile.contains("lookup_tables") &&
+      transpile["lookup_tables"].is_boolean())
+    o.lut.enabled = transpile["lookup_tables"].get<bool>();
+  if (transpile.contains("lut_max_bytes") &&
+      transpile["lut_max_bytes"].is_number_unsigned())
+    o.lut.max_bytes = transpile["lut_max_bytes"].get<uint32_t>();
+  if (transpile.contains("lut_min_cost") &&
+      transpile["lut_min_cost"].is_number_unsigned())
+    o.lut.min_cost = transpile["lut_min_cost"].get<uint32_t>();
+  if (transpile.contains("lut_probe_timeout_ms") &&
+      transpile["lut_probe_timeout_ms"].is_number_unsigned())
+    o.lut.probe_timeout_ms =
+        transpile["lut_probe_timeout_ms"].get<uint32_t>();
+  return o;
+}
+
+bool IsFpuLessBoard(const std::string &fqbn) {
+  // vendor:architecture:board
+  const size_t a = fqbn.find(':');
+  if (a == std::string::npos)
+    return false;
+  const size_t b = fqbn.find(':', a + 1);
+  const std::string arch = fqbn.substr(a + 1, b == std::string::npos
+                                                  ? std::string::npos
+                                                  : b - a - 1);
+  static const char *const fpuLess[] = {"avr", "megaavr", "samd", "rp2040",
+                                        "mbed_rp2040"};
+  return std::find(std::begin(fpuLess), std::end(fpuLess), arch) !=
+         std::end(fpuLess);
+}
+
+std::string FixedPointPrelude(int fracBits) {
+  std::ostringstream out;
+  out << "// ---- Fixed-point float lowering: Q" << (31 - fracBits) << "."
+      << fracBits << " in int32_t ----\n";
+  out << R"efx(// Results saturate to [EFX_MIN, EFX_MAX] instead of wrapping. Division
+// by zero gives EFX_MAX or EFX_MIN by the sign of the dividend (0 for 0/0).
+// Conversions to int truncate toward zero, like a float cast.
+typedef int32_t efx_q;
+)efx";
+  out << "#define EFX_FRAC " << fracBits << "\n";
+  out << R"efx(#define EFX_ONE ((int64_t)1 << EFX_FRAC)
+#define EFX_MAX ((efx_q)INT32_MAX)
+#define EFX_MIN ((efx_q)INT32_MIN)
+static inline efx_q efx_sat(int64_t v) {
+    return v > INT32_MAX ? EFX_MAX : (v < INT32_MIN ? EFX_MIN : (efx_q)v);
+}
+static inline efx_q efx_from_int(long v) { return efx_sat((int64_t)v * EFX_ONE); }
+static inline int efx_to_int(efx_q v) {
+    return (int)(v < 0 ? -(-(int64_t)v >> EFX_FRAC) : (v >> EFX_FRAC));
+}
+static inline efx_q efx_add(efx_q a, efx_q b) {
+    efx_q r;
+    return __builtin_add_overflow(a, b, &r) ? (a < 0 ? EFX_MIN : EFX_MAX) : r;
+}
+static inline efx_q efx_sub(efx_q a, efx_q b) {
+    efx_q r;
+    return __builtin_sub_overflow(a, b, &r) ? (a < 0 ? EFX_MIN : EFX_MAX) : r;
+}
+static inline efx_q efx_mul(efx_q a, efx_q b) {
+    return efx_sat(((int64_t)a * b) >> EFX_FRAC);
+}
+static inline efx_q efx_div(efx_q a, efx_q b) {
+    if (b == 0)
+        return a > 0 ? EFX_MAX : (a < 0 ? EFX_MIN : 0);
+    return efx_sat((int64_t)a * EFX_ONE / b);
+}
+// Boundary with code that still works in float (primitive skeletons);
+// only these two pull in float emulation.
+static inline efx_q efx_from_float(float f) {
+    const float scaled = f * (float)EFX_ONE;
+    if (!(scaled == scaled))
+        return 0;
+    if (scaled >= 2147483647.0f)
+        return EFX_MAX;
+    if (scaled <= -2147483648.0f)
+        return EFX_MIN;
+    return (efx_q)(scaled + (scaled < 0 ? -0.5f : 0.5f));
+}
+static inline float efx_to_float(efx_q v) { return (float)v / (float)EFX_ONE; }
+
+)efx";
+  return out.str();
+}
+
+std::string FixedLiteral(double value, int fracBits) {
+  const double scaled = std::round(value * std::ldexp(1.0, fracBits));
+  long long q;
+  if (std::isnan(scaled))
+    q = 0;
+  else if (scaled >= 2147483647.0)
+    q = 2147483647LL;
+  else if (scaled <= -2147483648.0)
+    q = -2147483648LL;
+  else
+    q = static_cast<long long>(scaled);
+  // INT32_MIN has no literal form
+  if (q == -2147483648LL)
+    return "EFX_MIN";
+  return "((efx_q)" + std::to_string(q) + ")";
+}
+
+namespace {
+
+std::unordered_map<std::string, std::vector<double>>
+ParseProbes(const std::string &output) {
+  std::unordered_map<std::string, std::vector<double>> probes;
+  std::istringstream in(output);
+  std::string line;
+  while (std::getline(in, line)) {
+    if (line.rfind("@probe ", 0) != 0)
+      continue;
+    std::istringstream fields(line.substr(7));
+    std::string name;
+    double value;
+    if (fields >> name >> value)
+      probes[name].push_back(value);
+  }
+  return probes;
+}
+
+} // namespace
+
+std::vector<ProbeStats> CompareProbes(const std::string &reference,
+                                      const std::string &candidate) {
+  const auto ref = ParseProbes(reference);
+  const auto cand = ParseProbes(candidate);
+
+  std::vector<ProbeStats> stats;
+  for (const auto &[name, expected] : ref) {
+    auto it = cand.find(name);
+    if (it == cand.end())
+      continue;
+    ProbeStats s;
+    s.name = name;
+    s.samples = std::min(expected.size(), it->second.size());
+    double sum = 0.0;
+    for (size_t i = 0; i < s.samples; ++i) {
+      const double err = std::fabs(expected[i] - it->second[i]);
+      s.max_abs = std::max(s.max_abs, err);
+      sum += err;
+    }
+    s.mean_abs = s.samples ? sum / s.samples : 0.0;
+    stats.push_back(std::move(s));
+  }
+  std::sort(stats.begin(), stats.end(),
+            [](const ProbeStats &a, const ProbeStats &b) {
+              return a.max_abs != b.max_abs ? a.max_abs > b.max_abs
+                                            : a.name < b.name;
+            });
+  return stats;
+}
+
+} // namespace ModuleUI
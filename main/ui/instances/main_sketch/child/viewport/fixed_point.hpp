@@ -0,0 +1,73 @@
+#pragma once
+#include "../../../../../../lib/vortex/main/include/vortex.h"
+#include "./lookup_table.hpp"
+#include "./telemetry.hpp"
+
+#include <cstdint>
+#include <string>
+#include <vector>
+
+#ifndef FIXED_POINT_MAIN_SKETCH_HPP
+#define FIXED_POINT_MAIN_SKETCH_HPP
+
+namespace ModuleUI {
+
+enum class FloatLowering : uint8_t { Float, Fixed };
+enum class ExecutionMode : uint8_t { Polled, Reactive };
+
+// Options of one transpilation, from the "transpile" object of the
+// sketch's main_sketch.json:
+//   "floats": "float" (default), "fixed", or "auto" (fixed when the board
+//             of the build settings has no FPU)
+//   "fixed_frac_bits": fractional bits of the Q format (default 16)
+//   "execution": "polled" (default, loop() runs the whole loop chain) or
+//                "reactive" (only what changed, see ReactivePlan)
+//   "lookup_tables": true to tabulate pure subgraphs (default false, the
+//                tables are evaluated by a host build of the sketch)
+//   "lut_max_bytes", "lut_min_cost", "lut_probe_timeout_ms": override the
+//                board's LookupTableProfile
+//
+// In fixed mode every float pin is an efx_q (int32_t holding value *
+// 2^frac_bits) and the generated arithmetic saturates instead of wrapping.
+// Skeletons keep their float ports: values are converted when they enter
+// and leave a primitive, so only nodes without a skeleton are float-free.
+
+struct TranspileOptions {
+  FloatLowering floats = FloatLowering::Float;
+  int frac_bits = 16; // Q(31 - frac_bits).frac_bits in an int32_t
+  ExecutionMode execution = ExecutionMode::Polled;
+  LookupTableProfile lut;
+  // From the sketch's "telemetry" object, see telemetry.hpp
+  TelemetrySettings telemetry;
+  // Internal: the host pass evaluating the tables of a transpilation
+  bool lut_probe = false;
+
+  static TranspileOptions FromJson(const json &transpile,
+                                   const std::string &fqbn);
+};
+
+// True for boards whose cores emulate float in software (AVR, Cortex-M0+).
+bool IsFpuLessBoard(const std::string &fqbn);
+
+// efx_q typedef and the saturating helpers, emitted once at the top of a
+// fixed-point main.cpp.
+std::string FixedPointPrelude(int fracBits);
+// `value` as a saturated Q constant.
+std::string FixedLiteral(double value, int fracBits);
+
+// Per-variable error of a fixed-point run against the float run, from the
+// "@probe <name> <value>" lines the simulator prints.
+struct ProbeStats {
+  std::string name;
+  size_t samples = 0;
+  double max_abs = 0.0;
+  double mean_abs = 0.0;
+};
+
+// Sorted by decreasing max_abs. Samples are matched by order per name.
+std::vector<ProbeStats> CompareProbes(const std::string &reference,
+                                      const std::string &candidate);
+
+} // namespace ModuleUI
+
+#endif // FIXED_POINT_MAIN_SKETCH_HPP
@@ -0,0 +1,135 @@
+#include "graph_history.hpp"
+
+namespace ModuleUI {
+
+namespace {
+
+// Rough in-memory size of a json value, good enough for the cap.
+size_t JsonBytes(const json &j) {
+  switch (j.type()) {
+  case json::value_t::object: {
+    size_t n = sizeof(json);
+    for (auto it = j.begin(); it != j.end(); ++it)
+      n += it.key().size() + JsonBytes(it.value());
+    return n;
+  }
+  case json::value_t::array: {
+    size_t n = sizeof(json);
+    for (const auto &v : j)
+      n += JsonBytes(v);
+    return n;
+  }
+  case json::value_t::string:
+    return sizeof(json) + j.get_ref<const std::string &>().size();
+  default:
+    return sizeof(json);
+  }
+}
+
+} // namespace
+
+size_t NodeDelta::Bytes() const {
+  size_t n = sizeof(NodeDelta) + instance_id.size();
+  switch (kind) {
+  case Kind::Add:
+  case Kind::Remove:
+    n += node.TypeID.size() + node.InstanceID.size() + JsonBytes(node.Datas);
+    break;
+  case Kind::Data:
+    n += JsonBytes(before) + JsonBytes(after);
+    break;
+  case Kind::LinkAdd:
+  case Kind::LinkRemove:
+    n += link.src_instance.size() + link.src_pin.size() +
+         link.dst_instance.size() + link.dst_pin.size();
+    break;
+  case Kind::Move:
+    break;
+  }
+  return n;
+}
+
+bool HistoryEntry::IsMoveOnly() const {
+  for (const auto &d : deltas)
+    if (d.kind != NodeDelta::Kind::Move)
+      return false;
+  return !deltas.empty();
+}
+
+void GraphHistory::Record(std::vector<NodeDelta> deltas) {
+  if (deltas.empty())
+    return;
+
+  for (const auto &e : m_Redo)
+    m_Bytes -= e.bytes;
+  m_Redo.clear();
+
+  HistoryEntry entry;
+  entry.deltas = std::move(deltas);
+
+  const auto now = std::chrono::steady_clock::now();
+  const bool coalescing = m_Coalescing && now - m_LastRecord < kCoalesceGap;
+  m_Coalescing = true;
+  m_LastRecord = now;
+
+  // Still dragging the same nodes extends the previous move
+  if (coalescing && !m_Undo.empty() && entry.IsMoveOnly() &&
+      m_Undo.back().IsMoveOnly() &&
+      m_Undo.back().deltas.size() == entry.deltas.size()) {
+    HistoryEntry &last = m_Undo.back();
+    bool same = true;
+    for (size_t i = 0; i < entry.deltas.size() && same; ++i)
+      same = last.deltas[i].instance_id == entry.deltas[i].instance_id;
+    if (same) {
+      for (size_t i = 0; i < entry.deltas.size(); ++i)
+        last.deltas[i].to = entry.deltas[i].to;
+      return;
+    }
+  }
+
+  for (const auto &d : entry.deltas)
+    entry.bytes += d.Bytes();
+  m_Bytes += entry.bytes;
+  m_Undo.push_back(std::move(entry));
+  Trim();
+}
+
+const HistoryEntry *GraphHistory::Undo() {
+  if (m_Undo.empty())
+    return nullptr;
+  m_Coalescing = false;
+  m_Redo.push_back(std::move(m_Undo.back()));
+  m_Undo.pop_back();
+  return &m_Redo.back();
+}
+
+const HistoryEntry *GraphHistory::Redo() {
+  if (m_Redo.empty())
+    return nullptr;
+  m_Coalescing = false;
+  m_Undo.push_back(std::move(m_Redo.back()));
+  m_Redo.pop_back();
+  return &m_Undo.back();
+}
+
+void GraphHistory::Clear() {
+  m_Undo.clear();
+  m_Redo.clear();
+  m_Bytes = 0;
+  m_Coalescing = false;
+}
+
+void GraphHistory::SetMemoryCap(size_t bytes) {
+  m_Cap = bytes;
+  Trim();
+}
+
+void GraphHistory::Trim() {
+  // Keep at least the latest step, even if it alone exceeds the cap
+  while (m_Bytes > m_Cap && m_Undo.size() > 1) {
+    m_Bytes -= m_Undo.front().bytes;
+    m_Undo.pop_front();
+  }
+}
+
+} // namespace ModuleUI
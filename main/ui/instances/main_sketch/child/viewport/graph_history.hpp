@@ -0,0 +1,93 @@
+#pragma once
+#include "../../../../../../lib/vortex/main/include/vortex.h"
+#include "../../../../../../lib/vortex/main/include/vortex_internals.h"
+
+#include <chrono>
+#include <cstddef>
+#include <deque>
+#include <string>
+#include <vector>
+
+#ifndef GRAPH_HISTORY_MAIN_SKETCH_HPP
+#define GRAPH_HISTORY_MAIN_SKETCH_HPP
+
+namespace ModuleUI {
+
+// Output pin to input pin, by instance id and pin key as the node graph
+// knows them (a collapsed group by its own pins).
+struct PinLink {
+  std::string src_instance;
+  std::string src_pin;
+  std::string dst_instance;
+  std::string dst_pin;
+};
+
+// One change to one node or link. Add/Remove carry the whole instance,
+// Move and Data only the before/after values, LinkAdd/LinkRemove the link,
+// so an entry costs what it changed, not the size of the graph.
+struct NodeDelta {
+  enum class Kind : uint8_t { Add, Remove, Move, Data, LinkAdd, LinkRemove };
+
+  Kind kind = Kind::Add;
+  std::string instance_id;               // source instance for links
+  Cherry::NodeSystem::NodeInstance node; // Add / Remove
+  ImVec2 from, to;                       // Move
+  json before, after;                    // Data
+  PinLink link;                          // LinkAdd / LinkRemove
+
+  size_t Bytes() const;
+};
+
+// One undo step: the deltas of one user edit, applied in order.
+struct HistoryEntry {
+  std::vector<NodeDelta> deltas;
+  size_t bytes = 0;
+
+  bool IsMoveOnly() const;
+};
+
+// Undo/redo log of graph edits with a memory cap. When the recorded deltas
+// exceed the cap, the oldest undo steps are dropped.
+class GraphHistory {
+public:
+  static constexpr size_t kDefaultMemoryCap = 8 * 1024 * 1024;
+  static constexpr std::chrono::milliseconds kCoalesceGap{500};
+
+  // Records a new step and clears the redo side. A move-only step over the
+  // same nodes as the previous move-only step is merged into it, as long as
+  // they belong to one interaction: no EndInteraction() in between and less
+  // than kCoalesceGap apart.
+  void Record(std::vector<NodeDelta> deltas);
+  // Closes the current interaction (mouse released), the next step starts
+  // a new undo entry.
+  void EndInteraction() { m_Coalescing = false; }
+
+  bool CanUndo() const { return !m_Undo.empty(); }
+  bool CanRedo() const { return !m_Redo.empty(); }
+
+  // Moves the latest step to the other side and returns it; the caller
+  // applies it (in reverse for undo).
+  const HistoryEntry *Undo();
+  const HistoryEntry *Redo();
+
+  void Clear();
+
+  void SetMemoryCap(size_t bytes);
+  size_t MemoryCap() const { return m_Cap; }
+  size_t MemoryUsed() const { return m_Bytes; }
+  size_t UndoCount() const { return m_Undo.size(); }
+
+private:
+  void Trim();
+
+  std::deque<HistoryEntry> m_Undo;
+  std::deque<HistoryEntry> m_Redo;
+  size_t m_Bytes = 0;
+  size_t m_Cap = kDefaultMemoryCap;
+  bool m_Coalescing = false;
+  std::chrono::steady_clock::time_point m_LastRecord;
+};
+
+} // namespace ModuleUI
+
+#endif // GRAPH_HISTORY_MAIN_SKETCH_HPP
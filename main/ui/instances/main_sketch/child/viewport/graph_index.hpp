@@ -0,0 +1,136 @@
+#pragma once
+#include "./pin_types.hpp"
+
+#include <cstdint>
+#include <string>
+#include <unordered_map>
+#include <vector>
+
+#ifndef GRAPH_INDEX_MAIN_SKETCH_HPP
+#define GRAPH_INDEX_MAIN_SKETCH_HPP
+
+namespace ModuleUI {
+
+// Flat, index-based snapshot of a node graph. Built once per graph mutation
+// from the NodeGraph/SchemaInfo caches, then shared by every pass that needs
+// to walk the graph (validation, transpilation, explorer) so none of them
+// has to call back into the node graph per pin.
+struct GraphIndex {
+  static constexpr uint32_t npos = UINT32_MAX;
+
+  struct PinSlot {
+    std::string id;       // pin id as used for generated variable names
+    std::string key;      // pin name as registered in the NodeContext
+    PinTypeId type = kInvalidPinType;
+    PinTypeId storage = kInvalidPinType; // interned C++ type, matches aliases
+    bool exec = false;
+    bool has_default = false;
+  };
+
+  struct NodeEntry {
+    std::string instance_id;
+    std::string type_id;
+    bool known_schema = false;
+    std::vector<PinSlot> inputs;
+    std::vector<PinSlot> outputs;
+
+    // No exec pin: evaluated on demand wherever its outputs are read. The
+    // transpiler, the task partition and the reactive and lookup table
+    // passes all schedule nodes by this rule.
+    bool IsPure() const {
+      if (!known_schema)
+        return false;
+      for (const auto *pins : {&inputs, &outputs})
+        for (const auto &p : *pins)
+          if (p.exec)
+            return false;
+      return true;
+    }
+
+    // Slot of the pin registered as `key`, npos if there is none.
+    uint32_t FindPin(const std::string &key, bool input) const {
+      const auto &pins = input ? inputs : outputs;
+      for (uint32_t p = 0; p < pins.size(); ++p)
+        if (pins[p].key == key)
+          return p;
+      return npos;
+    }
+  };
+
+  struct Link {
+    uint32_t src_node;
+    uint32_t src_pin;
+    uint32_t dst_node;
+    uint32_t dst_pin;
+  };
+
+  std::vector<NodeEntry> nodes;
+  std::vector<Link> links;
+  std::unordered_map<std::string, uint32_t> by_instance;
+
+  // CSR adjacency: links leaving/entering node n are
+  // out_links[out_offsets[n] .. out_offsets[n + 1]) (same for in_*).
+  std::vector<uint32_t> out_offsets;
+  std::vector<uint32_t> out_links;
+  std::vector<uint32_t> in_offsets;
+  std::vector<uint32_t> in_links;
+
+  void Clear() {
+    nodes.clear();
+    links.clear();
+    by_instance.clear();
+    out_offsets.clear();
+    out_links.clear();
+    in_offsets.clear();
+    in_links.clear();
+  }
+
+  uint32_t AddNode(NodeEntry entry) {
+    uint32_t idx = static_cast<uint32_t>(nodes.size());
+    by_instance.emplace(entry.instance_id, idx);
+    nodes.push_back(std::move(entry));
+    return idx;
+  }
+
+  uint32_t Find(const std::string &instance_id) const {
+    auto it = by_instance.find(instance_id);
+    return it == by_instance.end() ? npos : it->second;
+  }
+
+  // Builds the CSR arrays with a counting sort, O(V + E).
+  void Finalize() {
+    const size_t n = nodes.size();
+    out_offsets.assign(n + 1, 0);
+    in_offsets.assign(n + 1, 0);
+    for (const auto &l : links) {
+      ++out_offsets[l.src_node + 1];
+      ++in_offsets[l.dst_node + 1];
+    }
+    for (size_t i = 0; i < n; ++i) {
+      out_offsets[i + 1] += out_offsets[i];
+      in_offsets[i + 1] += in_offsets[i];
+    }
+    out_links.assign(links.size(), 0);
+    in_links.assign(links.size(), 0);
+    std::vector<uint32_t> outFill(out_offsets.begin(), out_offsets.end() - 1);
+    std::vector<uint32_t> inFill(in_offsets.begin(), in_offsets.end() - 1);
+    for (uint32_t i = 0; i < links.size(); ++i) {
+      out_links[outFill[links[i].src_node]++] = i;
+      in_links[inFill[links[i].dst_node]++] = i;
+    }
+  }
+
+  template <typename F> void ForEachOutLink(uint32_t node, F &&fn) const {
+    for (uint32_t i = out_offsets[node]; i < out_offsets[node + 1]; ++i)
+      fn(links[out_links[i]]);
+  }
+
+  template <typename F> void ForEachInLink(uint32_t node, F &&fn) const {
+    for (uint32_t i = in_offsets[node]; i < in_offsets[node + 1]; ++i)
+      fn(links[in_links[i]]);
+  }
+};
+
+} // namespace ModuleUI
+
+#endif // GRAPH_INDEX_MAIN_SKETCH_HPP
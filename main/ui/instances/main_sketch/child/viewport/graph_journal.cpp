@@ -0,0 +1,200 @@
+#include "graph_journal.hpp"
+#include "./subgraph.hpp"
+
+#include <fstream>
+#include <iostream>
+
+#ifndef _WIN32
+#include <unistd.h>
+#endif
+
+namespace ModuleUI {
+
+namespace {
+
+constexpr int kJournalVersion = 1;
+
+json RecordFor(const NodeDelta &d, bool inverse) {
+  using Kind = NodeDelta::Kind;
+  switch (d.kind) {
+  case Kind::Add:
+  case Kind::Remove:
+    if ((d.kind == Kind::Add) != inverse)
+      return {{"k", "add"}, {"n", NodeInstanceToJson(d.node)}};
+    return {{"k", "remove"}, {"id", d.instance_id}};
+  case Kind::Move: {
+    const ImVec2 &p = inverse ? d.from : d.to;
+    return {{"k", "move"}, {"id", d.instance_id}, {"p", {p.x, p.y}}};
+  }
+  case Kind::Data:
+    return {{"k", "data"},
+            {"id", d.instance_id},
+            {"d", inverse ? d.before : d.after}};
+  case Kind::LinkAdd:
+  case Kind::LinkRemove: {
+    const PinLink &l = d.link;
+    return {{"k", (d.kind == Kind::LinkAdd) != inverse ? "link" : "unlink"},
+            {"l", {l.src_instance, l.src_pin, l.dst_instance, l.dst_pin}}};
+  }
+  }
+  return {};
+}
+
+bool DeltaFromRecord(const json &r, NodeDelta &d) {
+  const std::string k = r.value("k", "");
+  if (k == "add" && r.contains("n")) {
+    d.kind = NodeDelta::Kind::Add;
+    d.node = NodeInstanceFromJson(r["n"]);
+    d.instance_id = d.node.InstanceID;
+  } else if (k == "remove") {
+    d.kind = NodeDelta::Kind::Remove;
+    d.instance_id = r.value("id", "");
+  } else if (k == "move" && r.contains("p") && r["p"].size() == 2) {
+    d.kind = NodeDelta::Kind::Move;
+    d.instance_id = r.value("id", "");
+    d.to = {r["p"][0].get<float>(), r["p"][1].get<float>()};
+  } else if (k == "data" && r.contains("d")) {
+    d.kind = NodeDelta::Kind::Data;
+    d.instance_id = r.value("id", "");
+    d.after = r["d"];
+  } else if ((k == "link" || k == "unlink") && r.contains("l") &&
+             r["l"].is_array() && r["l"].size() == 4) {
+    d.kind = k == "link" ? NodeDelta::Kind::LinkAdd
+                         : NodeDelta::Kind::LinkRemove;
+    const json &l = r["l"];
+    d.link = {l[0].get<std::string>(), l[1].get<std::string>(),
+              l[2].get<std::string>(), l[3].get<std::string>()};
+    d.instance_id = d.link.src_instance;
+  } else {
+    return false;
+  }
+  return !d.instance_id.empty();
+}
+
+} // namespace
+
+GraphJournal::~GraphJournal() { Close(); }
+
+std::string GraphJournal::BaseOf(const fs::path &graphFile) {
+  std::error_code ec;
+  auto size = fs::file_size(graphFile, ec);
+  if (ec)
+    return "missing";
+  auto mtime = fs::last_write_time(graphFile, ec);
+  if (ec)
+    return "missing";
+  return std::to_string(size) + ":" +
+         std::to_string(mtime.time_since_epoch().count());
+}
+
+bool GraphJournal::Open(const fs::path &path, const fs::path &graphFile) {
+  Close();
+  m_Path = path;
+
+  std::error_code ec;
+  const bool fresh = !fs::exists(path, ec) || fs::file_size(path, ec) == 0;
+  m_File = std::fopen(path.string().c_str(), "ab");
+  if (!m_File) {
+    std::cerr << "GraphJournal: cannot open " << path << std::endl;
+    return false;
+  }
+  if (fresh)
+    WriteHeader(graphFile);
+  return true;
+}
+
+void GraphJournal::Close() {
+  if (m_File) {
+    std::fclose(m_File);
+    m_File = nullptr;
+  }
+}
+
+void GraphJournal::WriteHeader(const fs::path &graphFile) {
+  json header = {{"journal", kJournalVersion}, {"base", BaseOf(graphFile)}};
+  std::string line = header.dump() + "\n";
+  std::fwrite(line.data(), 1, line.size(), m_File);
+  Flush();
+}
+
+void GraphJournal::Flush() {
+  std::fflush(m_File);
+#ifndef _WIN32
+  fdatasync(fileno(m_File));
+#endif
+}
+
+void GraphJournal::Append(const std::vector<NodeDelta> &deltas, bool inverse) {
+  if (!m_File || deltas.empty())
+    return;
+
+  // One write per step, records in application order
+  std::string chunk;
+  const size_t count = deltas.size();
+  for (size_t k = 0; k < count; ++k) {
+    const NodeDelta &d = deltas[inverse ? count - 1 - k : k];
+    chunk += RecordFor(d, inverse).dump();
+    chunk += '\n';
+  }
+  std::fwrite(chunk.data(), 1, chunk.size(), m_File);
+  Flush();
+}
+
+void GraphJournal::Compact(const fs::path &graphFile) {
+  Close();
+  m_File = std::fopen(m_Path.string().c_str(), "wb");
+  if (!m_File) {
+    std::cerr << "GraphJournal: cannot truncate " << m_Path << std::endl;
+    return;
+  }
+  WriteHeader(graphFile);
+}
+
+size_t
+GraphJournal::Replay(const fs::path &path, const fs::path &graphFile,
+                     const std::function<void(const NodeDelta &)> &apply) {
+  std::ifstream in(path, std::ios::binary);
+  if (!in.is_open())
+    return 0;
+
+  std::string line;
+  if (!std::getline(in, line))
+    return 0;
+  json header = json::parse(line, nullptr, false);
+  if (header.is_discarded() || header.value("journal", 0) != kJournalVersion)
+    return 0;
+
+  const std::string base = header.value("base", "");
+  if (base != BaseOf(graphFile)) {
+    // Written against another version of the graph file, keep it aside
+    in.close();
+    std::error_code ec;
+    bool hasRecords = fs::file_size(path, ec) > line.size() + 1;
+    if (hasRecords) {
+      fs::path stale = path;
+      stale += ".stale";
+      fs::rename(path, stale, ec);
+      std::cerr << "GraphJournal: " << path
+                << " does not match the graph file, moved to " << stale
+                << std::endl;
+    }
+    return 0;
+  }
+
+  size_t replayed = 0;
+  while (std::getline(in, line)) {
+    if (line.empty())
+      continue;
+    json record = json::parse(line, nullptr, false);
+    if (record.is_discarded())
+      break; // torn write, nothing valid can follow
+    NodeDelta d;
+    if (!DeltaFromRecord(record, d))
+      continue;
+    apply(d);
+    ++replayed;
+  }
+  return replayed;
+}
+
+} // namespace ModuleUI
@@ -0,0 +1,55 @@
+#pragma once
+#include "./graph_history.hpp"
+
+#include <cstdio>
+#include <functional>
+#include <string>
+#include <vector>
+
+#ifndef GRAPH_JOURNAL_MAIN_SKETCH_HPP
+#define GRAPH_JOURNAL_MAIN_SKETCH_HPP
+
+namespace ModuleUI {
+
+// Write-ahead log of graph edits, kept next to main_sketch.json. Every
+// recorded edit is appended as one json line and flushed to disk; Save
+// compacts it away once the graph file is written. After a crash the
+// journal is replayed on top of the graph file it was started against.
+//
+// The first line identifies that graph file (size and mtime). A journal
+// whose base does not match the graph on disk is set aside instead of
+// being replayed onto a different graph.
+class GraphJournal {
+public:
+  ~GraphJournal();
+
+  // Opens `path` for appending, starting a new journal when it is missing
+  // or empty.
+  bool Open(const fs::path &path, const fs::path &graphFile);
+  void Close();
+
+  // Appends the effect of `deltas`; with `inverse` the deltas are written
+  // as their undo (used when a history step is undone).
+  void Append(const std::vector<NodeDelta> &deltas, bool inverse = false);
+
+  // Empties the journal after the graph file has been rewritten.
+  void Compact(const fs::path &graphFile);
+
+  // Calls `apply` for every complete record of a journal based on
+  // `graphFile`. A torn last line (crash during a write) is ignored.
+  // Returns the number of replayed deltas.
+  static size_t Replay(const fs::path &path, const fs::path &graphFile,
+                       const std::function<void(const NodeDelta &)> &apply);
+
+private:
+  static std::string BaseOf(const fs::path &graphFile);
+  void WriteHeader(const fs::path &graphFile);
+  void Flush();
+
+  fs::path m_Path;
+  std::FILE *m_File = nullptr;
+};
+
+} // namespace ModuleUI
+
+#endif // GRAPH_JOURNAL_MAIN_SKETCH_HPP
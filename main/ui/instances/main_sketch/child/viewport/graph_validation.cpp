@@ -0,0 +1,262 @@
+#include "graph_validation.hpp"
+
+#include <algorithm>
+#include <chrono>
+
+namespace ModuleUI {
+
+namespace {
+
+bool IsExecLink(const GraphIndex &index, const GraphIndex::Link &l) {
+  return index.nodes[l.src_node].outputs[l.src_pin].exec &&
+         index.nodes[l.dst_node].inputs[l.dst_pin].exec;
+}
+
+void Report(ValidationReport &report, DiagnosticSeverity severity,
+            DiagnosticKind kind, const std::string &instance,
+            const std::string &pin, std::string message,
+            std::vector<std::string> related = {}) {
+  GraphDiagnostic d;
+  d.severity = severity;
+  d.kind = kind;
+  d.instance_id = instance;
+  d.pin = pin;
+  d.message = std::move(message);
+  d.related = std::move(related);
+
+  if (severity == DiagnosticSeverity::Error)
+    ++report.errors;
+  else
+    ++report.warnings;
+
+  auto mark = [&](const std::string &id) {
+    auto it = report.worst_by_instance.find(id);
+    if (it == report.worst_by_instance.end())
+      report.worst_by_instance.emplace(id, severity);
+    else if (severity == DiagnosticSeverity::Error)
+      it->second = severity;
+  };
+  mark(d.instance_id);
+  for (const auto &r : d.related)
+    mark(r);
+
+  report.diagnostics.push_back(std::move(d));
+}
+
+// Iterative Tarjan restricted to exec links, so deep exec chains cannot
+// overflow the stack. Every SCC with more than one node (or a node linked to
+// itself) is an exec cycle and would become infinite recursion between the
+// generated node_* functions.
+void CheckExecCycles(const GraphIndex &index, ValidationReport &report) {
+  const uint32_t n = static_cast<uint32_t>(index.nodes.size());
+  std::vector<uint32_t> order(n, GraphIndex::npos);
+  std::vector<uint32_t> low(n, 0);
+  std::vector<bool> onStack(n, false);
+  std::vector<uint32_t> sccStack;
+  struct Frame {
+    uint32_t node;
+    uint32_t cursor; // position in out_links
+  };
+  std::vector<Frame> callStack;
+  uint32_t counter = 0;
+
+  for (uint32_t root = 0; root < n; ++root) {
+    if (order[root] != GraphIndex::npos)
+      continue;
+
+    callStack.push_back({root, index.out_offsets[root]});
+    order[root] = low[root] = counter++;
+    sccStack.push_back(root);
+    onStack[root] = true;
+
+    while (!callStack.empty()) {
+      Frame &f = callStack.back();
+      const uint32_t v = f.node;
+
+      if (f.cursor < index.out_offsets[v + 1]) {
+        const auto &l = index.links[index.out_links[f.cursor++]];
+        if (!IsExecLink(index, l))
+          continue;
+        const uint32_t w = l.dst_node;
+        if (order[w] == GraphIndex::npos) {
+          order[w] = low[w] = counter++;
+          sccStack.push_back(w);
+          onStack[w] = true;
+          callStack.push_back({w, index.out_offsets[w]});
+        } else if (onStack[w]) {
+          low[v] = std::min(low[v], order[w]);
+        }
+        continue;
+      }
+
+      // v is done: pop its SCC if it is a root
+      if (low[v] == order[v]) {
+        std::vector<std::string> members;
+        uint32_t w;
+        do {
+          w = sccStack.back();
+          sccStack.pop_back();
+          onStack[w] = false;
+          members.push_back(index.nodes[w].instance_id);
+        } while (w != v);
+
+        bool selfLoop = false;
+        if (members.size() == 1) {
+          index.ForEachOutLink(v, [&](const GraphIndex::Link &l) {
+            if (l.dst_node == v && IsExecLink(index, l))
+              selfLoop = true;
+          });
+        }
+
+        if (members.size() > 1 || selfLoop) {
+          std::string msg = "Exec cycle through " +
+                            std::to_string(members.size()) +
+                            " node(s); generated code would recurse forever";
+          std::string head = members.back();
+          Report(report, DiagnosticSeverity::Error, DiagnosticKind::ExecCycle,
+                 head, "", std::move(msg), std::move(members));
+        }
+      }
+
+      callStack.pop_back();
+      if (!callStack.empty()) {
+        const uint32_t parent = callStack.back().node;
+        low[parent] = std::min(low[parent], low[v]);
+      }
+    }
+  }
+}
+
+void CheckLinks(const GraphIndex &index, ValidationReport &report) {
+  for (const auto &l : index.links) {
+    const auto &src = index.nodes[l.src_node];
+    const auto &dst = index.nodes[l.dst_node];
+    const auto &from = src.outputs[l.src_pin];
+    const auto &to = dst.inputs[l.dst_pin];
+
+    if (!ArePinTypesCompatible(from, to)) {
+      Report(report, DiagnosticSeverity::Error, DiagnosticKind::TypeMismatch,
+             dst.instance_id, to.key,
+             "Pin '" + to.key + "' expects '" +
+                 PinTypeRegistry::Name(to.type) + "' but '" +
+                 src.instance_id + "." + from.key + "' provides '" +
+                 PinTypeRegistry::Name(from.type) + "'",
+             {src.instance_id});
+    }
+  }
+}
+
+void CheckNodes(const GraphIndex &index, ValidationReport &report) {
+  const uint32_t n = static_cast<uint32_t>(index.nodes.size());
+  std::vector<bool> connected;
+
+  for (uint32_t i = 0; i < n; ++i) {
+    const auto &node = index.nodes[i];
+
+    if (!node.known_schema) {
+      Report(report, DiagnosticSeverity::Error, DiagnosticKind::UnknownSchema,
+             node.instance_id, "",
+             "Unknown schema '" + node.type_id +
+                 "'; only a fallback stub would be generated");
+      continue;
+    }
+
+    // Their port globals and variables would be declared "auto"
+    for (const auto *pins : {&node.inputs, &node.outputs})
+      for (const auto &pin : *pins)
+        if (!pin.exec && pin.storage == kInvalidPinType)
+          Report(report, DiagnosticSeverity::Error, DiagnosticKind::UntypedPin,
+                 node.instance_id, pin.key,
+                 "Pin '" + pin.key + "' is of type '" +
+                     PinTypeRegistry::Name(pin.type) +
+                     "', which has no C++ type to store its value");
+
+    connected.assign(node.inputs.size(), false);
+    index.ForEachInLink(
+        i, [&](const GraphIndex::Link &l) { connected[l.dst_pin] = true; });
+
+    for (size_t p = 0; p < node.inputs.size(); ++p) {
+      const auto &pin = node.inputs[p];
+      if (pin.exec || pin.has_default || connected[p])
+        continue;
+      Report(report, DiagnosticSeverity::Error,
+             DiagnosticKind::UnconnectedInput, node.instance_id, pin.key,
+             "Required input '" + pin.key + "' (" +
+                 PinTypeRegistry::Name(pin.type) +
+                 ") is not connected and has no default value");
+    }
+  }
+}
+
+} // namespace
+
+bool ArePinTypesCompatible(const GraphIndex::PinSlot &from,
+                           const GraphIndex::PinSlot &to) {
+  if (from.exec != to.exec)
+    return false;
+  if (from.exec)
+    return true;
+  if (from.type == to.type)
+    return true;
+  if (from.type == BuiltinPinType::Variant ||
+      to.type == BuiltinPinType::Variant)
+    return true;
+  // Aliases such as "bool_input" share the C++ type of their base.
+  return from.storage != kInvalidPinType && from.storage == to.storage;
+}
+
+const char *DiagnosticKindName(DiagnosticKind kind) {
+  switch (kind) {
+  case DiagnosticKind::ExecCycle:
+    return "Exec cycle";
+  case DiagnosticKind::TypeMismatch:
+    return "Type mismatch";
+  case DiagnosticKind::UnconnectedInput:
+    return "Unconnected input";
+  case DiagnosticKind::UnknownSchema:
+    return "Unknown schema";
+  case DiagnosticKind::SharedAcrossTasks:
+    return "Shared across tasks";
+  case DiagnosticKind::UntypedPin:
+    return "Untyped pin";
+  }
+  return "";
+}
+
+ValidationReport ValidateGraph(const GraphIndex &index) {
+  auto start = std::chrono::steady_clock::now();
+
+  ValidationReport report;
+  CheckNodes(index, report);
+  CheckLinks(index, report);
+  CheckExecCycles(index, report);
+
+  report.elapsed_ms = std::chrono::duration<double, std::milli>(
+                          std::chrono::steady_clock::now() - start)
+                          .count();
+  return report;
+}
+
+void ValidateTasks(const GraphIndex &index, const TaskPartition &tasks,
+                   ValidationReport &report) {
+  auto root = [&](uint32_t task) -> const std::string & {
+    return index.nodes[tasks.tasks[task].root].instance_id;
+  };
+  for (const auto &c : tasks.conflicts) {
+    const auto &node = index.nodes[c.node];
+    const std::string between =
+        "'" + root(c.first) + "' and '" + root(c.second) + "'";
+    Report(report, DiagnosticSeverity::Error,
+           DiagnosticKind::SharedAcrossTasks, node.instance_id, "",
+           c.schema ? "Instances of '" + node.type_id + "' run in tasks " +
+                          between +
+                          " and share its port globals; move them to one "
+                          "task"
+                    : "Runs in tasks " + between +
+                          ", its pins would be written concurrently; use "
+                          "one node per task",
+           {root(c.first), root(c.second)});
+  }
+}
+
+} // namespace ModuleUI
@@ -0,0 +1,71 @@
+#pragma once
+#include "./graph_index.hpp"
+#include "./task_partition.hpp"
+
+#include <cstddef>
+#include <string>
+#include <unordered_map>
+#include <vector>
+
+#ifndef GRAPH_VALIDATION_MAIN_SKETCH_HPP
+#define GRAPH_VALIDATION_MAIN_SKETCH_HPP
+
+namespace ModuleUI {
+
+enum class DiagnosticSeverity { Warning, Error };
+
+enum class DiagnosticKind {
+  ExecCycle,
+  TypeMismatch,
+  UnconnectedInput,
+  UnknownSchema,
+  SharedAcrossTasks,
+  UntypedPin
+};
+
+struct GraphDiagnostic {
+  DiagnosticSeverity severity = DiagnosticSeverity::Error;
+  DiagnosticKind kind = DiagnosticKind::UnknownSchema;
+  std::string instance_id; // node to highlight
+  std::string pin;         // offending pin, empty for node-level issues
+  std::string message;
+  std::vector<std::string> related; // other nodes involved (cycle members...)
+};
+
+struct ValidationReport {
+  std::vector<GraphDiagnostic> diagnostics;
+  std::unordered_map<std::string, DiagnosticSeverity> worst_by_instance;
+  size_t errors = 0;
+  size_t warnings = 0;
+  double elapsed_ms = 0.0;
+
+  bool HasErrors() const { return errors > 0; }
+
+  // Returns nullptr when the node has no diagnostic attached.
+  const DiagnosticSeverity *SeverityFor(const std::string &instance_id) const {
+    auto it = worst_by_instance.find(instance_id);
+    return it == worst_by_instance.end() ? nullptr : &it->second;
+  }
+};
+
+// Runs every check over the index in O(V + E):
+//  - exec cycles (Tarjan SCC over exec links only),
+//  - incompatible pin types on both ends of a link,
+//  - data inputs without a link and without a default value,
+//  - nodes whose schema is unknown (they would be transpiled as stubs),
+//  - data pins of a type without a C++ type (variant, flow or unknown).
+ValidationReport ValidateGraph(const GraphIndex &index);
+
+// Adds an error per node that two tasks would run (or whose schema keeps
+// state shared by its instances in two tasks), see PartitionTasks().
+void ValidateTasks(const GraphIndex &index, const TaskPartition &tasks,
+                   ValidationReport &report);
+
+bool ArePinTypesCompatible(const GraphIndex::PinSlot &from,
+                           const GraphIndex::PinSlot &to);
+
+const char *DiagnosticKindName(DiagnosticKind kind);
+
+} // namespace ModuleUI
+
+#endif // GRAPH_VALIDATION_MAIN_SKETCH_HPP
@@ -0,0 +1,565 @@
+#include "json_stream.hpp"
+#include "../../../../../src/trace.hpp"
+
+#include <algorithm>
+#include <cctype>
+#include <iostream>
+#include <string_view>
+
+#ifndef _WIN32
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+#endif
+
+namespace ModuleUI {
+
+// ---------------------------------------------------------------------------
+// MappedFile
+// ---------------------------------------------------------------------------
+
+MappedFile::MappedFile(const fs::path &path) {
+#ifndef _WIN32
+  int fd = ::open(path.c_str(), O_RDONLY | O_CLOEXEC);
+  if (fd < 0)
+    return;
+  struct stat st;
+  if (::fstat(fd, &st) != 0) {
+    ::close(fd);
+    return;
+  }
+  m_Size = static_cast<size_t>(st.st_size);
+  if (m_Size > 0) {
+    void *p = ::mmap(nullptr, m_Size, PROT_READ, MAP_PRIVATE, fd, 0);
+    if (p == MAP_FAILED) {
+      ::close(fd);
+      return;
+    }
+    ::madvise(p, m_Size, MADV_SEQUENTIAL);
+    m_Data = static_cast<const uint8_t *>(p);
+    m_Mapped = true;
+  }
+  ::close(fd);
+  m_Ok = true;
+  EFUSION_TRACE_COUNT(EmbeddedFusion::TraceCounter::FilesRead);
+#else
+  if (auto bytes = ReadFileBytes(path)) {
+    m_Buffer = std::move(*bytes);
+    m_Data = m_Buffer.data();
+    m_Size = m_Buffer.size();
+    m_Ok = true;
+  }
+#endif
+}
+
+MappedFile::~MappedFile() {
+#ifndef _WIN32
+  if (m_Mapped)
+    ::munmap(const_cast<uint8_t *>(m_Data), m_Size);
+#endif
+}
+
+// ---------------------------------------------------------------------------
+// SaxReader
+// ---------------------------------------------------------------------------
+
+bool SaxReader::string(string_t &v) {
+  if (!m_Build.empty())
+    Insert(json(std::move(v)));
+  else
+    OnString(std::move(v));
+  return true;
+}
+
+bool SaxReader::binary(binary_t &v) {
+  return Scalar(json::binary(std::vector<std::uint8_t>(v.begin(), v.end())));
+}
+
+bool SaxReader::key(string_t &k) {
+  if (!m_Build.empty())
+    m_BuildKey = std::move(k);
+  else
+    m_Key = std::move(k);
+  return true;
+}
+
+bool SaxReader::parse_error(std::size_t position, const std::string &,
+                            const nlohmann::detail::exception &e) {
+  m_Error = "at byte " + std::to_string(position) + ": " + e.what();
+  return false;
+}
+
+bool SaxReader::Scalar(json &&v) {
+  if (!m_Build.empty())
+    Insert(std::move(v));
+  else
+    OnValue(std::move(v));
+  return true;
+}
+
+void SaxReader::Insert(json &&v) {
+  json *top = m_Build.back();
+  if (top->is_array())
+    top->push_back(std::move(v));
+  else
+    (*top)[m_BuildKey] = std::move(v);
+}
+
+bool SaxReader::Start(bool array) {
+  json container = array ? json::array() : json::object();
+  if (!m_Build.empty()) {
+    json *top = m_Build.back();
+    if (top->is_array()) {
+      top->push_back(std::move(container));
+      m_Build.push_back(&top->back());
+    } else {
+      m_Build.push_back(&((*top)[m_BuildKey] = std::move(container)));
+    }
+    return true;
+  }
+  if (WantsSubtree()) {
+    m_Subtree = std::move(container);
+    m_Build.push_back(&m_Subtree);
+    return true;
+  }
+
+  m_Frames.push_back({std::move(m_Key), array});
+  m_Key.clear();
+  OnStart(array);
+  return true;
+}
+
+bool SaxReader::End() {
+  if (!m_Build.empty()) {
+    m_Build.pop_back();
+    if (m_Build.empty())
+      OnValue(std::move(m_Subtree));
+    return true;
+  }
+  if (m_Frames.empty())
+    return false;
+  OnEnd(m_Frames.back().array);
+  m_Frames.pop_back();
+  m_Key.clear();
+  return true;
+}
+
+bool StreamDocument(const MappedFile &file, nlohmann::json_sax<json> &sax) {
+  if (!file.ok() || file.size() == 0)
+    return false;
+
+  const uint8_t *first = file.data();
+  const uint8_t *last = first + file.size();
+  DocumentFormat format = DetectDocumentFormat(first, file.size());
+  first += DocumentHeaderSize(first, file.size(), format);
+
+  using input_format_t = nlohmann::detail::input_format_t;
+  input_format_t input = input_format_t::json;
+  if (format == DocumentFormat::Cbor)
+    input = input_format_t::cbor;
+  else if (format == DocumentFormat::MsgPack)
+    input = input_format_t::msgpack;
+
+  try {
+    return json::sax_parse(first, last, &sax, input);
+  } catch (const std::exception &e) {
+    std::cerr << "StreamDocument: " << e.what() << std::endl;
+    return false;
+  }
+}
+
+// ---------------------------------------------------------------------------
+// Readers
+// ---------------------------------------------------------------------------
+
+namespace {
+
+// Pin type objects, either the root object of type.json (depth 1) or the
+// entries of pin_setup.json's "types" array (depth 3).
+class PinTypeSax : public SaxReader {
+public:
+  PinTypeSax(size_t depth, std::string fallbackId,
+             const std::function<void(PinTypeInfo &&)> &emit)
+      : m_Depth(depth), m_FallbackId(std::move(fallbackId)), m_Emit(emit) {}
+
+protected:
+  bool AtEntry() const {
+    return Depth() == m_Depth && (m_Depth == 1 || KeyOf(m_Depth - 1) == "types");
+  }
+
+  void OnStart(bool array) override {
+    if (array || !AtEntry())
+      return;
+    m_InEntry = true;
+    m_Type = PinTypeInfo{};
+    m_Type.colorHex = "#FFFFFF";
+    m_Type.category = "custom";
+    m_HasId = m_HasName = false;
+  }
+
+  void OnEnd(bool array) override {
+    if (array || !m_InEntry || !AtEntry())
+      return;
+    m_InEntry = false;
+    if (!m_HasId)
+      m_Type.id = m_FallbackId;
+    if (!m_HasName)
+      m_Type.name = m_Type.id;
+    InternPinType(m_Type);
+    m_Emit(std::move(m_Type));
+  }
+
+  void OnString(std::string &&v) override {
+    if (!m_InEntry || Depth() != m_Depth)
+      return;
+    const std::string &k = Key();
+    if (k == "id") {
+      m_Type.id = std::move(v);
+      m_HasId = true;
+    } else if (k == "name") {
+      m_Type.name = std::move(v);
+      m_HasName = true;
+    } else if (k == "description") {
+      m_Type.description = std::move(v);
+    } else if (k == "color") {
+      m_Type.colorHex = std::move(v);
+    } else if (k == "category") {
+      m_Type.category = std::move(v);
+    } else if (k == "cpp_type") {
+      m_Type.cpp_type = std::move(v);
+    } else if (k == "layout") {
+      m_Type.layout = std::move(v);
+    } else if (k == "element") {
+      m_Type.element = std::move(v);
+    }
+  }
+
+  bool WantsSubtree() const override {
+    return m_InEntry && Depth() == m_Depth && Key() == "range";
+  }
+
+  void OnValue(json &&v) override {
+    if (!m_InEntry || Depth() != m_Depth)
+      return;
+    if (Key() == "length" && v.is_number_integer() && v.get<int64_t>() > 0) {
+      m_Type.length = static_cast<uint32_t>(
+          std::min<int64_t>(v.get<int64_t>(), UINT32_MAX));
+    } else if (Key() == "range" && v.is_array() && v.size() == 2 &&
+               v[0].is_number_integer() && v[1].is_number_integer() &&
+               v[0].get<int64_t>() <= v[1].get<int64_t>()) {
+      m_Type.has_range = true;
+      m_Type.range_min = static_cast<int32_t>(
+          std::clamp<int64_t>(v[0].get<int64_t>(), INT32_MIN, INT32_MAX));
+      m_Type.range_max = static_cast<int32_t>(
+          std::clamp<int64_t>(v[1].get<int64_t>(), INT32_MIN, INT32_MAX));
+    }
+  }
+
+private:
+  size_t m_Depth;
+  std::string m_FallbackId;
+  const std::function<void(PinTypeInfo &&)> &m_Emit;
+  PinTypeInfo m_Type;
+  bool m_InEntry = false;
+  bool m_HasId = false;
+  bool m_HasName = false;
+};
+
+// config.json of a primitive or function.
+class SchemaSax : public SaxReader {
+public:
+  SchemaSax(SchemaInfo &out, const std::string &fallbackId) : m_Out(out) {
+    m_Out = SchemaInfo{};
+    m_Out.id = fallbackId;
+    m_Out.kind = "primitive";
+    m_Out.hexcolheader = m_Out.hexcolbg = m_Out.hexcolborder = "#FFFFFF";
+    m_Out.hexcoltext = m_Out.hexcoltextsecondary = "#FFFFFF";
+    m_Out.nodetype = "default";
+  }
+
+protected:
+  bool InPin() const { return m_Pins && Depth() == 3; }
+
+  void OnStart(bool array) override {
+    if (array || Depth() != 3)
+      return;
+    const std::string &list = KeyOf(2);
+    m_Pins = list == "inputs"    ? &m_Out.inputs
+             : list == "outputs" ? &m_Out.outputs
+                                 : nullptr;
+    m_Pin = PinDef{};
+    m_PinHasName = false;
+  }
+
+  void OnEnd(bool array) override {
+    if (array || !InPin())
+      return;
+    if (!m_PinHasName)
+      m_Pin.name = m_Pin.id;
+    m_Pin.type_id = PinTypeRegistry::Intern(m_Pin.type);
+    m_Pin.key = m_Pin.name;
+    m_Pins->push_back(std::move(m_Pin));
+    m_Pins = nullptr;
+  }
+
+  bool WantsSubtree() const override { return InPin() && Key() == "default"; }
+
+  void OnValue(json &&v) override {
+    if (InPin() && Key() == "default")
+      m_Pin.defaultValue = std::move(v);
+  }
+
+  void OnString(std::string &&v) override {
+    const std::string &k = Key();
+    if (InPin()) {
+      if (k == "id") {
+        m_Pin.id = std::move(v);
+      } else if (k == "name") {
+        m_Pin.name = std::move(v);
+        m_PinHasName = true;
+      } else if (k == "type") {
+        m_Pin.type = std::move(v);
+      } else if (k == "default") {
+        m_Pin.defaultValue = std::move(v);
+      }
+      return;
+    }
+    if (Depth() != 1)
+      return;
+    if (std::string *field = Field(k))
+      *field = std::move(v);
+  }
+
+private:
+  std::string *Field(const std::string &k) {
+    if (k == "id")
+      return &m_Out.id;
+    if (k == "name")
+      return &m_Out.name;
+    if (k == "name_secondary")
+      return &m_Out.name_secondary;
+    if (k == "proper_name")
+      return &m_Out.proper_name;
+    if (k == "proper_logo")
+      return &m_Out.proper_logo;
+    if (k == "description")
+      return &m_Out.description;
+    if (k == "kind")
+      return &m_Out.kind;
+    if (k == "hexcolheader")
+      return &m_Out.hexcolheader;
+    if (k == "hexcolbg")
+      return &m_Out.hexcolbg;
+    if (k == "hexcolborder")
+      return &m_Out.hexcolborder;
+    if (k == "hexcoltext")
+      return &m_Out.hexcoltext;
+    if (k == "hexcoltextsecondary")
+      return &m_Out.hexcoltextsecondary;
+    if (k == "nodetype")
+      return &m_Out.nodetype;
+    if (k == "logopath")
+      return &m_Out.logopath;
+    return nullptr;
+  }
+
+  SchemaInfo &m_Out;
+  std::vector<PinDef> *m_Pins = nullptr;
+  PinDef m_Pin;
+  bool m_PinHasName = false;
+};
+
+class TypeIdSax : public SaxReader {
+public:
+  explicit TypeIdSax(std::set<std::string> &ids) : m_Ids(ids) {}
+
+protected:
+  void OnString(std::string &&v) override {
+    if (Key() == "TypeID" && !v.empty())
+      m_Ids.insert(std::move(v));
+  }
+
+private:
+  std::set<std::string> &m_Ids;
+};
+
+// Writes compact json text as events arrive.
+class JsonTextWriter : public nlohmann::json_sax<json> {
+public:
+  std::string out;
+
+  bool null() override { return Raw("null"); }
+  bool boolean(bool v) override { return Raw(v ? "true" : "false"); }
+  bool number_integer(number_integer_t v) override {
+    return Raw(std::to_string(v));
+  }
+  bool number_unsigned(number_unsigned_t v) override {
+    return Raw(std::to_string(v));
+  }
+  bool number_float(number_float_t v, const string_t &) override {
+    return Raw(json(v).dump()); // shortest round-trip, nan/inf as null
+  }
+  bool string(string_t &v) override {
+    Separate();
+    Quote(v);
+    return true;
+  }
+  bool binary(binary_t &v) override {
+    return Raw(json::binary(std::vector<std::uint8_t>(v.begin(), v.end()))
+                   .dump());
+  }
+  bool key(string_t &k) override {
+    Separate();
+    Quote(k);
+    out += ':';
+    m_AfterKey = true;
+    return true;
+  }
+  bool start_object(std::size_t) override { return Open('{'); }
+  bool end_object() override { return Close('}'); }
+  bool start_array(std::size_t) override { return Open('['); }
+  bool end_array() override { return Close(']'); }
+  bool parse_error(std::size_t, const std::string &,
+                   const nlohmann::detail::exception &e) override {
+    std::cerr << "TranscodeToJson: " << e.what() << std::endl;
+    return false;
+  }
+
+private:
+  void Separate() {
+    if (m_AfterKey)
+      m_AfterKey = false;
+    else if (!m_Counts.empty() && m_Counts.back()++ > 0)
+      out += ',';
+  }
+  bool Raw(const std::string &text) {
+    Separate();
+    out += text;
+    return true;
+  }
+  bool Open(char c) {
+    Separate();
+    out += c;
+    m_Counts.push_back(0);
+    return true;
+  }
+  bool Close(char c) {
+    out += c;
+    m_Counts.pop_back();
+    return true;
+  }
+  void Quote(const std::string &s) {
+    static const char hex[] = "0123456789abcdef";
+    out += '"';
+    for (unsigned char c : s) {
+      switch (c) {
+      case '"':
+        out += "\\\"";
+        break;
+      case '\\':
+        out += "\\\\";
+        break;
+      case '\n':
+        out += "\\n";
+        break;
+      case '\r':
+        out += "\\r";
+        break;
+      case '\t':
+        out += "\\t";
+        break;
+      default:
+        if (c < 0x20) {
+          out += "\\u00";
+          out += hex[c >> 4];
+          out += hex[c & 0xf];
+        } else {
+          out += static_cast<char>(c);
+        }
+      }
+    }
+    out += '"';
+  }
+
+  std::vector<size_t> m_Counts; // values written in each open container
+  bool m_AfterKey = false;
+};
+
+} // namespace
+
+bool ReadPinTypeFile(const fs::path &path, const std::string &fallbackId,
+                     PinTypeInfo &out) {
+  MappedFile file(path);
+  bool found = false;
+  std::function<void(PinTypeInfo &&)> emit = [&](PinTypeInfo &&t) {
+    out = std::move(t);
+    found = true;
+  };
+  PinTypeSax sax(1, fallbackId, emit);
+  return StreamDocument(file, sax) && found;
+}
+
+bool ReadSchemaFile(const fs::path &path, const std::string &fallbackId,
+                    SchemaInfo &out) {
+  MappedFile file(path);
+  SchemaSax sax(out, fallbackId);
+  if (!StreamDocument(file, sax))
+    return false;
+  out.kind_id = SchemaKindFromString(out.kind);
+  return true;
+}
+
+bool ReadPinSetupFile(const fs::path &path,
+                      const std::function<void(PinTypeInfo &&)> &fn) {
+  MappedFile file(path);
+  PinTypeSax sax(3, "", fn);
+  return StreamDocument(file, sax);
+}
+
+bool ScanGraphTypeIds(const fs::path &path, std::set<std::string> &ids) {
+  MappedFile file(path);
+  if (!file.ok())
+    return false;
+  if (DetectDocumentFormat(file.data(), file.size()) != DocumentFormat::Json) {
+    TypeIdSax sax(ids);
+    return StreamDocument(file, sax);
+  }
+
+  // Json graphs are scanned as text for "TypeID": "<id>", several times
+  // faster than tokenizing the whole document.
+  std::string_view text(reinterpret_cast<const char *>(file.data()),
+                        file.size());
+  static constexpr std::string_view key = "\"TypeID\"";
+  size_t pos = 0;
+  while ((pos = text.find(key, pos)) != std::string_view::npos) {
+    pos += key.size();
+    while (pos < text.size() && (isspace((unsigned char)text[pos]) ||
+                                 text[pos] == ':'))
+      ++pos;
+    if (pos >= text.size() || text[pos] != '"')
+      continue;
+    std::string id;
+    for (++pos; pos < text.size() && text[pos] != '"'; ++pos) {
+      if (text[pos] == '\\' && pos + 1 < text.size())
+        ++pos;
+      id.push_back(text[pos]);
+    }
+    if (!id.empty())
+      ids.insert(id);
+  }
+  return true;
+}
+
+bool TranscodeToJson(const fs::path &from, const fs::path &to) {
+  MappedFile file(from);
+  JsonTextWriter writer;
+  writer.out.reserve(file.size() * 2);
+  if (!StreamDocument(file, writer))
+    return false;
+  return WriteFileBytes(to,
+                        reinterpret_cast<const uint8_t *>(writer.out.data()),
+                        writer.out.size());
+}
+
+} // namespace ModuleUI
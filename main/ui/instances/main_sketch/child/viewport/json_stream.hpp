@@ -0,0 +1,126 @@
+#pragma once
+#include "../../../../../../lib/vortex/main/include/vortex.h"
+#include "./document_format.hpp"
+#include "./schema_types.hpp"
+
+#include <functional>
+#include <set>
+#include <string>
+#include <vector>
+
+#ifndef JSON_STREAM_MAIN_SKETCH_HPP
+#define JSON_STREAM_MAIN_SKETCH_HPP
+
+namespace ModuleUI {
+
+// Read-only view of a whole file. Mapped with mmap on POSIX, read into a
+// buffer elsewhere. An empty file is valid (ok() with size() == 0).
+class MappedFile {
+public:
+  explicit MappedFile(const fs::path &path);
+  ~MappedFile();
+  MappedFile(const MappedFile &) = delete;
+  MappedFile &operator=(const MappedFile &) = delete;
+
+  bool ok() const { return m_Ok; }
+  const uint8_t *data() const { return m_Data; }
+  size_t size() const { return m_Size; }
+
+private:
+  bool m_Ok = false;
+  const uint8_t *m_Data = nullptr;
+  size_t m_Size = 0;
+  bool m_Mapped = false;
+  std::vector<uint8_t> m_Buffer;
+};
+
+// Base of the streaming readers: a SAX consumer that keeps track of where
+// it is in the document and hands values to the derived reader without
+// building a DOM. A reader can still ask for a small subtree (a pin
+// default, say) to be materialized by returning true from WantsSubtree().
+class SaxReader : public nlohmann::json_sax<json> {
+public:
+  bool null() override { return Scalar(json(nullptr)); }
+  bool boolean(bool v) override { return Scalar(json(v)); }
+  bool number_integer(number_integer_t v) override { return Scalar(json(v)); }
+  bool number_unsigned(number_unsigned_t v) override {
+    return Scalar(json(v));
+  }
+  bool number_float(number_float_t v, const string_t &) override {
+    return Scalar(json(v));
+  }
+  bool string(string_t &v) override;
+  bool binary(binary_t &v) override;
+  bool key(string_t &k) override;
+  bool start_object(std::size_t) override { return Start(false); }
+  bool end_object() override { return End(); }
+  bool start_array(std::size_t) override { return Start(true); }
+  bool end_array() override { return End(); }
+  bool parse_error(std::size_t position, const std::string &,
+                   const nlohmann::detail::exception &e) override;
+
+  const std::string &Error() const { return m_Error; }
+
+protected:
+  // Number of open containers around the current value (1 inside the root
+  // object), the key of the current value ("" in arrays) and the key a
+  // given open container was found under.
+  size_t Depth() const { return m_Frames.size(); }
+  const std::string &Key() const { return m_Key; }
+  const std::string &KeyOf(size_t depth) const {
+    return m_Frames[depth - 1].key;
+  }
+
+  // Scalar at the current position, or a subtree requested by
+  // WantsSubtree() once it is complete. Strings arrive here too.
+  virtual void OnValue(json &&) {}
+  // Faster path for strings, defaults to OnValue().
+  virtual void OnString(std::string &&v) { OnValue(json(std::move(v))); }
+  virtual bool WantsSubtree() const { return false; }
+  virtual void OnStart(bool /*array*/) {}
+  virtual void OnEnd(bool /*array*/) {}
+
+private:
+  struct Frame {
+    std::string key;
+    bool array;
+  };
+
+  bool Scalar(json &&v);
+  bool Start(bool array);
+  bool End();
+  void Insert(json &&v);
+
+  std::vector<Frame> m_Frames;
+  std::string m_Key;
+  // Subtree being materialized, m_Build holds the open containers
+  json m_Subtree;
+  std::vector<json *> m_Build;
+  std::string m_BuildKey;
+  std::string m_Error;
+};
+
+// Feeds a mapped file (json, CBOR or MessagePack) to `sax`.
+bool StreamDocument(const MappedFile &file, nlohmann::json_sax<json> &sax);
+
+// Fill the catalog structures straight from a file. Missing fields get the
+// same defaults as before (ids fall back to `fallbackId`).
+bool ReadPinTypeFile(const fs::path &path, const std::string &fallbackId,
+                     PinTypeInfo &out);
+bool ReadSchemaFile(const fs::path &path, const std::string &fallbackId,
+                    SchemaInfo &out);
+// Calls `fn` for each entry of the "types" array of pin_setup.json.
+bool ReadPinSetupFile(const fs::path &path,
+                      const std::function<void(PinTypeInfo &&)> &fn);
+
+// Collects every "TypeID" value of a graph file, at any depth (collapsed
+// group members are nested in their group's Datas).
+bool ScanGraphTypeIds(const fs::path &path, std::set<std::string> &ids);
+
+// Rewrites a graph file of any format as compact json text without
+// decoding it into a DOM.
+bool TranscodeToJson(const fs::path &from, const fs::path &to);
+
+} // namespace ModuleUI
+
+#endif // JSON_STREAM_MAIN_SKETCH_HPP
@@ -0,0 +1,274 @@
+#include "lookup_table.hpp"
+#include "fixed_point.hpp"
+
+#include <cmath>
+#include <cstdio>
+#include <cstdlib>
+#include <sstream>
+
+namespace ModuleUI {
+
+namespace {
+
+bool HasInLinks(const GraphIndex &index, uint32_t node) {
+  return index.in_offsets[node] != index.in_offsets[node + 1];
+}
+
+// Literal for `value` (as printed by the probe) in an array of `type`, with
+// `bytes` the size of the type on the board.
+bool TableLiteral(const std::string &value, const std::string &type,
+                  size_t bytes, std::string &out) {
+  char *end = nullptr;
+  if (type == "float" || type == "double") {
+    const double v = std::strtod(value.c_str(), &end);
+    if (*end || !std::isfinite(v))
+      return false;
+    char buf[40];
+    std::snprintf(buf, sizeof(buf), type == "float" ? "%.9g" : "%.17g", v);
+    out = buf;
+    if (out.find_first_of(".e") == std::string::npos)
+      out += ".0";
+    if (type == "float")
+      out += "f";
+    return true;
+  }
+  const long long v = std::strtoll(value.c_str(), &end, 10);
+  if (*end)
+    return false;
+  if (type == "bool") {
+    out = v ? "true" : "false";
+    return true;
+  }
+  // Host ints may be wider than the board's
+  if (bytes < 8) {
+    const long long max = (1LL << (8 * bytes - 1)) - 1;
+    if (v > max || v < -max - 1)
+      return false;
+  }
+  out = std::to_string(v);
+  if (type == "char") // signedness differs between boards
+    out = "(char)" + out;
+  return true;
+}
+
+} // namespace
+
+LookupTableProfile LookupTableProfile::ForBoard(const std::string &fqbn) {
+  LookupTableProfile p;
+  if (!IsFpuLessBoard(fqbn))
+    return p;
+  // Software float makes most float nodes worth a table, but flash is
+  // scarce on the small boards.
+  p.soft_float = true;
+  p.min_cost = 4;
+  const size_t a = fqbn.find(':');
+  const std::string arch = fqbn.substr(a + 1, fqbn.find(':', a + 1) - a - 1);
+  if (arch == "avr" || arch == "megaavr") {
+    p.max_bytes = 512;
+    p.int_bytes = 2;
+    p.double_bytes = 4;
+  }
+  return p;
+}
+
+std::vector<LookupTable> PlanLookupTables(const GraphIndex &index,
+                                          const TaskPartition &tasks,
+                                          const LookupTableHooks &hooks,
+                                          uint32_t maxBytes, uint32_t minCost) {
+  constexpr uint32_t npos = GraphIndex::npos;
+  const uint32_t n = static_cast<uint32_t>(index.nodes.size());
+  std::vector<bool> pure(n, false);
+  for (uint32_t i = 0; i < n; ++i)
+    pure[i] = index.nodes[i].IsPure();
+
+  // Pure nodes on or after a data cycle reuse last tick's values: they have
+  // state, no table for them. Kahn's order over the pure nodes leaves them
+  // out.
+  std::vector<bool> acyclic(n, false);
+  std::vector<uint32_t> pending(n, 0), stack;
+  for (const auto &l : index.links)
+    if (pure[l.src_node] && pure[l.dst_node])
+      ++pending[l.dst_node];
+  for (uint32_t i = 0; i < n; ++i)
+    if (pure[i] && pending[i] == 0)
+      stack.push_back(i);
+  while (!stack.empty()) {
+    const uint32_t x = stack.back();
+    stack.pop_back();
+    acyclic[x] = true;
+    index.ForEachOutLink(x, [&](const GraphIndex::Link &l) {
+      if (pure[l.dst_node] && --pending[l.dst_node] == 0)
+        stack.push_back(l.dst_node);
+    });
+  }
+
+  // Subgraph of each pure node, kept when its node would be worth a table
+  std::vector<LookupTable> candidate(n);
+  std::vector<bool> tabulable(n, false);
+  std::vector<uint32_t> seen(n, npos);
+  for (uint32_t p = 0; p < n; ++p) {
+    if (!pure[p])
+      continue;
+    LookupTable t;
+    t.root = p;
+    bool ok = true;
+    stack.assign(1, p);
+    seen[p] = p;
+    while (!stack.empty() && ok) {
+      const uint32_t x = stack.back();
+      stack.pop_back();
+      ok = acyclic[x];
+      t.cost += hooks.cost(x);
+      index.ForEachInLink(x, [&](const GraphIndex::Link &l) {
+        const uint32_t src = l.src_node;
+        if (tasks.MailboxFor(src, l.src_pin, tasks.owner[x]) != npos) {
+          ok = false;
+          return;
+        }
+        const bool external =
+            !pure[src] || (hooks.opaque(src) && !HasInLinks(index, src));
+        if (!external) {
+          if (seen[src] != p) {
+            seen[src] = p;
+            stack.push_back(src);
+          }
+        } else if (t.src_node == npos) {
+          t.src_node = src;
+          t.src_pin = l.src_pin;
+        } else if (t.src_node != src || t.src_pin != l.src_pin) {
+          ok = false; // more than one input
+        }
+      });
+    }
+    if (!ok || t.src_node == npos ||
+        !hooks.range(t.src_node, t.src_pin, t.lo, t.hi) || t.cost < minCost)
+      continue;
+
+    size_t rowBytes = 0;
+    const auto &outs = index.nodes[p].outputs;
+    for (uint32_t o = 0; o < outs.size() && ok; ++o) {
+      const size_t bytes = hooks.size(p, o);
+      ok = bytes != 0;
+      rowBytes += bytes;
+      t.outputs.push_back(o);
+      t.sizes.push_back(bytes);
+    }
+    if (!ok || t.outputs.empty())
+      continue;
+    t.bytes = rowBytes * t.Entries();
+    if (t.bytes > maxBytes)
+      continue;
+    tabulable[p] = true;
+    candidate[p] = std::move(t);
+  }
+
+  std::vector<LookupTable> tables;
+  for (uint32_t p = 0; p < n; ++p) {
+    if (!tabulable[p])
+      continue;
+    bool outermost = false;
+    index.ForEachOutLink(p, [&](const GraphIndex::Link &l) {
+      outermost = outermost || !tabulable[l.dst_node];
+    });
+    if (outermost)
+      tables.push_back(std::move(candidate[p]));
+  }
+  return tables;
+}
+
+bool ParseLookupProbe(const std::string &output,
+                      std::vector<LookupTable> &tables, std::string &error) {
+  std::vector<std::vector<std::vector<std::string>>> rows(tables.size());
+  std::istringstream in(output);
+  std::string line;
+  while (std::getline(in, line)) {
+    if (line.rfind("@lut ", 0) != 0)
+      continue;
+    std::istringstream fields(line.substr(5));
+    size_t t = 0;
+    if (!(fields >> t) || t >= tables.size())
+      continue;
+    std::vector<std::string> row;
+    for (std::string v; fields >> v;)
+      row.push_back(v);
+    rows[t].push_back(std::move(row));
+  }
+
+  for (size_t t = 0; t < tables.size(); ++t) {
+    LookupTable &table = tables[t];
+    if (rows[t].size() != table.Entries()) {
+      error = "table " + std::to_string(t) + ": " +
+              std::to_string(rows[t].size()) + " of " +
+              std::to_string(table.Entries()) + " entries";
+      return false;
+    }
+    const size_t width = table.outputs.size();
+    table.values.assign(width, {});
+    for (size_t e = 0; e < rows[t].size(); ++e) {
+      if (rows[t][e].size() != width) {
+        error = "table " + std::to_string(t) + ": malformed entry";
+        return false;
+      }
+      for (size_t o = 0; o < width; ++o) {
+        std::string literal;
+        if (!TableLiteral(rows[t][e][o], table.types[o], table.sizes[o],
+                          literal)) {
+          error = "table " + std::to_string(t) + ": value " + rows[t][e][o] +
+                  " at input " + std::to_string(table.lo + int64_t(e)) +
+                  " does not fit a " + table.types[o];
+          return false;
+        }
+        table.values[o].push_back(std::move(literal));
+      }
+    }
+  }
+  return true;
+}
+
+std::string LookupTablePrelude() {
+  return R"efx(// ---- Lookup tables of pure subgraphs ----
+#include <string.h>
+#if defined(__AVR__) || defined(ARDUINO_ARCH_ESP8266)
+// Flash is outside the data address space (AVR) or only readable by aligned
+// words (ESP8266): read through the pgm_read_ accessors.
+template <typename T> static inline T efx_lut(const T *p) {
+    T v;
+    if (sizeof(T) == 1) {
+        const uint8_t b = pgm_read_byte(p);
+        memcpy(&v, &b, sizeof(T));
+    } else if (sizeof(T) == 2) {
+        const uint16_t w = pgm_read_word(p);
+        memcpy(&v, &w, sizeof(T));
+    } else if (sizeof(T) == 4) {
+        const uint32_t d = pgm_read_dword(p);
+        memcpy(&v, &d, sizeof(T));
+    } else {
+        memcpy_P(&v, p, sizeof(T));
+    }
+    return v;
+}
+#else
+#ifndef PROGMEM
+#define PROGMEM
+#endif
+template <typename T> static inline T efx_lut(const T *p) { return *p; }
+#endif
+
+)efx";
+}
+
+std::string LookupTableDefinition(const LookupTable &t, size_t o,
+                                  const std::string &name) {
+  constexpr size_t kPerLine = 8;
+  std::ostringstream out;
+  out << "static const " << t.types[o] << " " << name << "[" << t.Entries()
+      << "] PROGMEM = {";
+  for (size_t e = 0; e < t.values[o].size(); ++e) {
+    out << (e % kPerLine == 0 ? "\n    " : " ") << t.values[o][e]
+        << (e + 1 < t.values[o].size() ? "," : "");
+  }
+  out << "\n};\n";
+  return out.str();
+}
+
+} // namespace ModuleUI
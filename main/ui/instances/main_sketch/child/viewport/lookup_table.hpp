@@ -0,0 +1,98 @@
+#pragma once
+#include "./graph_index.hpp"
+#include "./task_partition.hpp"
+
+#include <cstdint>
+#include <functional>
+#include <string>
+#include <vector>
+
+#ifndef LOOKUP_TABLE_MAIN_SKETCH_HPP
+#define LOOKUP_TABLE_MAIN_SKETCH_HPP
+
+namespace ModuleUI {
+
+// A pure node computed from a single input of small declared range (see
+// PinTypeRange()), replaced by a table of its outputs indexed by that
+// input.
+//
+// The subgraph of a table is its root and every pure node the root pulls,
+// transitively. Its only input is the output pin of one node outside it:
+// an impure node, or a pure node with no linked input lowered to a skeleton
+// call (a sensor read, evaluated before the lookup). Constant inputs are
+// part of the table. Skeletons inside the subgraph are assumed to be
+// functions of their inputs, as the reactive mode assumes.
+//
+// The transpiler cannot evaluate skeletons itself: the values come from a
+// host build of the sketch running each subgraph over its whole range (the
+// transpiler's probe pass), so they are what the board would compute,
+// fixed-point lowering included.
+struct LookupTable {
+  uint32_t root = GraphIndex::npos;
+  uint32_t src_node = GraphIndex::npos; // input of the subgraph
+  uint32_t src_pin = GraphIndex::npos;
+  int32_t lo = 0; // range of the input
+  int32_t hi = 0;
+  std::vector<uint32_t> outputs; // data outputs of root
+  std::vector<size_t> sizes;     // bytes of each output on the board
+  std::vector<std::string> types; // C++ type of each output, set by caller
+  std::vector<std::vector<std::string>> values; // per output, literals
+  uint32_t cost = 0;  // of the subgraph per call
+  size_t bytes = 0;   // of the table
+
+  size_t Entries() const { return static_cast<size_t>(int64_t(hi) - lo + 1); }
+};
+
+struct LookupTableHooks {
+  // Range of output `pin` of `node`, false when it has none
+  std::function<bool(uint32_t node, uint32_t pin, int32_t &lo, int32_t &hi)>
+      range;
+  // Bytes of one value of output `pin` of `node` on the board, 0 if it
+  // cannot be tabulated
+  std::function<size_t(uint32_t node, uint32_t pin)> size;
+  // Work of one evaluation of `node`
+  std::function<uint32_t(uint32_t node)> cost;
+  // Nodes lowered to a skeleton call
+  std::function<bool(uint32_t node)> opaque;
+};
+
+// When a pure subgraph is worth a lookup table, by board: a table must fit in max_bytes of flash and replace at least
+// min_cost of work per call. Costs are rough units: 1 per builtin node, 4
+// per skeleton call, 8 more per node doing float math in software.
+struct LookupTableProfile {
+  bool enabled = false;
+  uint32_t max_bytes = 1024;
+  uint32_t min_cost = 8;
+  uint32_t probe_timeout_ms = 5000; // then the sketch keeps plain code
+  bool soft_float = false; // no FPU
+  uint8_t int_bytes = 4;   // sizeof(int) on the board
+  uint8_t double_bytes = 8; // sizeof(double)
+
+  static LookupTableProfile ForBoard(const std::string &fqbn);
+};
+
+// Tables worth emitting under the thresholds of the board, by increasing
+// root. A subgraph is tabulated at its outermost pure node: one with a
+// consumer that is not itself tabulable.
+std::vector<LookupTable> PlanLookupTables(const GraphIndex &index,
+                                          const TaskPartition &tasks,
+                                          const LookupTableHooks &hooks,
+                                          uint32_t maxBytes, uint32_t minCost);
+
+// Lines "@lut <table> <value of each output>" printed by the probe, one per
+// entry in increasing input order. Fills `values`; false (and `error` set)
+// on a missing entry or a value that is not finite.
+bool ParseLookupProbe(const std::string &output,
+                      std::vector<LookupTable> &tables, std::string &error);
+
+// efx_lut(p): reads a table element, from program memory on boards where
+// it is not mapped in the data address space. Emitted once per main.cpp.
+std::string LookupTablePrelude();
+
+// "static const T <name>[N] PROGMEM = {...};" for output `o` of `t`.
+std::string LookupTableDefinition(const LookupTable &t, size_t o,
+                                  const std::string &name);
+
+} // namespace ModuleUI
+
+#endif // LOOKUP_TABLE_MAIN_SKETCH_HPP
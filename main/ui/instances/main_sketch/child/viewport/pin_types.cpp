@@ -0,0 +1,113 @@
+#include "pin_types.hpp"
+
+#include <deque>
+#include <mutex>
+#include <unordered_map>
+
+namespace ModuleUI {
+
+namespace {
+
+struct InternTable {
+  std::mutex mutex;
+  std::unordered_map<std::string, PinTypeId> ids;
+  std::deque<std::string> names; // deque keeps references stable
+
+  InternTable() {
+    for (const auto &b : kBuiltinPinTypes) {
+      ids.emplace(b.name, b.id);
+      names.emplace_back(b.name);
+    }
+  }
+};
+
+InternTable &Table() {
+  static InternTable table;
+  return table;
+}
+
+} // namespace
+
+PinTypeId PinTypeRegistry::Intern(const std::string &name) {
+  InternTable &t = Table();
+  std::lock_guard<std::mutex> lock(t.mutex);
+  auto it = t.ids.find(name);
+  if (it != t.ids.end())
+    return it->second;
+  if (t.names.size() >= kInvalidPinType)
+    return kInvalidPinType;
+  PinTypeId id = static_cast<PinTypeId>(t.names.size());
+  t.names.push_back(name);
+  t.ids.emplace(name, id);
+  return id;
+}
+
+PinTypeId PinTypeRegistry::Find(const std::string &name) {
+  InternTable &t = Table();
+  std::lock_guard<std::mutex> lock(t.mutex);
+  auto it = t.ids.find(name);
+  return it == t.ids.end() ? kInvalidPinType : it->second;
+}
+
+const std::string &PinTypeRegistry::Name(PinTypeId id) {
+  static const std::string empty;
+  InternTable &t = Table();
+  std::lock_guard<std::mutex> lock(t.mutex);
+  return id < t.names.size() ? t.names[id] : empty;
+}
+
+PinCategory PinCategoryFromString(const std::string &category) {
+  if (category == "flow")
+    return PinCategory::Flow;
+  if (category == "primitive")
+    return PinCategory::Primitive;
+  if (category == "event")
+    return PinCategory::Event;
+  return PinCategory::Custom;
+}
+
+const char *PinCategoryName(PinCategory category) {
+  switch (category) {
+  case PinCategory::Flow:
+    return "flow";
+  case PinCategory::Primitive:
+    return "primitive";
+  case PinCategory::Event:
+    return "event";
+  case PinCategory::Custom:
+    return "custom";
+  }
+  return "custom";
+}
+
+SchemaKind SchemaKindFromString(const std::string &kind) {
+  if (kind == "primitive")
+    return SchemaKind::Primitive;
+  if (kind == "function")
+    return SchemaKind::Function;
+  if (kind == "machine")
+    return SchemaKind::Machine;
+  return SchemaKind::Other;
+}
+
+PinLayout PinLayoutFromString(const std::string &layout) {
+  if (layout == "array")
+    return PinLayout::Array;
+  if (layout == "ring")
+    return PinLayout::Ring;
+  return PinLayout::Scalar;
+}
+
+const char *PinLayoutName(PinLayout layout) {
+  switch (layout) {
+  case PinLayout::Scalar:
+    return "scalar";
+  case PinLayout::Array:
+    return "array";
+  case PinLayout::Ring:
+    return "ring";
+  }
+  return "scalar";
+}
+
+} // namespace ModuleUI
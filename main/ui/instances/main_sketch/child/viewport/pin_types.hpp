@@ -0,0 +1,78 @@
+#pragma once
+#include <cstdint>
+#include <string>
+
+#ifndef PIN_TYPES_MAIN_SKETCH_HPP
+#define PIN_TYPES_MAIN_SKETCH_HPP
+
+namespace ModuleUI {
+
+// Pin types are interned to small integers: built-ins have fixed ids from
+// the compile-time table below, custom types get the next free id the first
+// time their name is seen. Strings are only kept for display and
+// serialization, every hot path compares ids.
+using PinTypeId = uint16_t;
+
+constexpr PinTypeId kInvalidPinType = UINT16_MAX;
+
+namespace BuiltinPinType {
+constexpr PinTypeId Exec = 0;
+constexpr PinTypeId Bool = 1;
+constexpr PinTypeId Int = 2;
+constexpr PinTypeId Float = 3;
+constexpr PinTypeId Char = 4;
+constexpr PinTypeId String = 5;
+constexpr PinTypeId Variant = 6;
+constexpr PinTypeId Count = 7;
+} // namespace BuiltinPinType
+
+enum class PinCategory : uint8_t { Flow, Primitive, Event, Custom };
+
+enum class SchemaKind : uint8_t { Primitive, Function, Machine, Other };
+
+// Scalar types hold one value; array and ring types hold a fixed number of
+// elements of a scalar type (see buffer_kernels.hpp).
+enum class PinLayout : uint8_t { Scalar, Array, Ring };
+
+struct BuiltinPinTypeDesc {
+  PinTypeId id;
+  const char *name;
+  const char *cpp_type;
+  PinCategory category;
+};
+
+constexpr BuiltinPinTypeDesc kBuiltinPinTypes[BuiltinPinType::Count] = {
+    {BuiltinPinType::Exec, "exec", "void", PinCategory::Flow},
+    {BuiltinPinType::Bool, "bool", "bool", PinCategory::Primitive},
+    {BuiltinPinType::Int, "int", "int", PinCategory::Primitive},
+    {BuiltinPinType::Float, "float", "float", PinCategory::Primitive},
+    {BuiltinPinType::Char, "char", "char", PinCategory::Primitive},
+    {BuiltinPinType::String, "string", "std::string", PinCategory::Primitive},
+    {BuiltinPinType::Variant, "variant", "auto", PinCategory::Flow},
+};
+
+constexpr bool IsBuiltinPinType(PinTypeId id) {
+  return id < BuiltinPinType::Count;
+}
+
+// Process-wide interner shared by every open sketch. Thread-safe, ids are
+// stable for the lifetime of the module.
+class PinTypeRegistry {
+public:
+  static PinTypeId Intern(const std::string &name);
+  // Returns kInvalidPinType if the name was never interned.
+  static PinTypeId Find(const std::string &name);
+  static const std::string &Name(PinTypeId id);
+};
+
+PinCategory PinCategoryFromString(const std::string &category);
+const char *PinCategoryName(PinCategory category);
+
+SchemaKind SchemaKindFromString(const std::string &kind);
+
+PinLayout PinLayoutFromString(const std::string &layout);
+const char *PinLayoutName(PinLayout layout);
+
+} // namespace ModuleUI
+
+#endif // PIN_TYPES_MAIN_SKETCH_HPP
@@ -0,0 +1,278 @@
+#include "reactive_plan.hpp"
+
+#include <algorithm>
+#include <cstdio>
+#include <functional>
+#include <queue>
+#include <sstream>
+
+namespace ModuleUI {
+
+ReactivePlan
+PlanReactive(const GraphIndex &index, const TaskPartition &tasks,
+             const std::function<bool(uint32_t)> &opaque,
+             const std::function<bool(uint32_t, uint32_t)> &direct) {
+  constexpr uint32_t npos = GraphIndex::npos;
+  ReactivePlan plan;
+  const uint32_t n = static_cast<uint32_t>(index.nodes.size());
+  plan.bit.assign(n, npos);
+
+  uint32_t loopTask = npos;
+  for (uint32_t t = 0; t < tasks.tasks.size(); ++t)
+    if (tasks.tasks[t].loop)
+      loopTask = t;
+  if (loopTask == npos)
+    return plan;
+  auto inChain = [&](uint32_t node) {
+    return tasks.owner[node] == loopTask;
+  };
+
+  // Chains behind direct outputs run when called
+  std::vector<bool> called(n, false), gated(n, false);
+  std::vector<uint32_t> stack;
+  for (uint32_t i = 0; direct && i < n; ++i) {
+    if (!inChain(i))
+      continue;
+    index.ForEachOutLink(i, [&](const GraphIndex::Link &l) {
+      if (!index.nodes[i].outputs[l.src_pin].exec || !direct(i, l.src_pin))
+        return;
+      gated[i] = true;
+      if (!called[l.dst_node]) {
+        called[l.dst_node] = true;
+        stack.push_back(l.dst_node);
+      }
+    });
+  }
+  while (!stack.empty()) {
+    const uint32_t x = stack.back();
+    stack.pop_back();
+    index.ForEachOutLink(x, [&](const GraphIndex::Link &l) {
+      if (index.nodes[x].outputs[l.src_pin].exec &&
+          index.nodes[l.dst_node].inputs[l.dst_pin].exec &&
+          !called[l.dst_node]) {
+        called[l.dst_node] = true;
+        stack.push_back(l.dst_node);
+      }
+    });
+  }
+
+  std::vector<uint32_t> members;
+  std::vector<bool> scheduled(n, false);
+  for (uint32_t i = 0; i < n; ++i) {
+    if (inChain(i) && i != tasks.tasks[loopTask].root &&
+        !index.nodes[i].IsPure() && !called[i]) {
+      members.push_back(i);
+      scheduled[i] = true;
+    }
+  }
+
+  // Dependents of each member: data consumers (seen through pure nodes) and
+  // exec successors. Successors of branches and of nodes with direct
+  // outputs only order the schedule, these nodes set them themselves.
+  std::vector<std::vector<uint32_t>> down(n), after(n);
+  std::vector<bool> fed(n, false), sampled(n, false);
+  std::vector<uint32_t> seen(n, npos);
+  for (uint32_t r : members) {
+    const bool selects = index.nodes[r].type_id == "branch" || gated[r];
+    stack.assign(1, r);
+    while (!stack.empty()) {
+      const uint32_t x = stack.back();
+      stack.pop_back();
+      index.ForEachOutLink(x, [&](const GraphIndex::Link &l) {
+        const uint32_t dst = l.dst_node;
+        const bool exec = index.nodes[x].outputs[l.src_pin].exec;
+        if (exec && (x != r || !index.nodes[dst].inputs[l.dst_pin].exec))
+          return;
+        if (exec && selects) {
+          if (scheduled[dst])
+            after[r].push_back(dst);
+          return;
+        }
+        if (scheduled[dst])
+          fed[dst] = fed[dst] || !exec;
+        if (seen[dst] == r)
+          return;
+        seen[dst] = r;
+        if (scheduled[dst]) {
+          down[r].push_back(dst);
+        } else if (index.nodes[dst].IsPure() && inChain(dst)) {
+          stack.push_back(dst);
+        }
+      });
+    }
+  }
+
+  // Inputs only visible through a mailbox, a called node or a skeleton pure
+  // leaf
+  std::fill(seen.begin(), seen.end(), npos);
+  for (uint32_t r : members) {
+    stack.assign(1, r);
+    seen[r] = r;
+    while (!stack.empty() && !sampled[r]) {
+      const uint32_t x = stack.back();
+      stack.pop_back();
+      index.ForEachInLink(x, [&](const GraphIndex::Link &l) {
+        if (index.nodes[x].inputs[l.dst_pin].exec)
+          return;
+        const uint32_t src = l.src_node;
+        if (called[src] ||
+            tasks.MailboxFor(src, l.src_pin, loopTask) != npos) {
+          sampled[r] = true;
+          return;
+        }
+        if (!index.nodes[src].IsPure() || seen[src] == r)
+          return;
+        seen[src] = r;
+        bool linked = false;
+        index.ForEachInLink(src, [&](const GraphIndex::Link &) {
+          linked = true;
+        });
+        if (!linked && opaque && opaque(src))
+          sampled[r] = true;
+        stack.push_back(src);
+      });
+    }
+    if (!fed[r])
+      for (const auto &p : index.nodes[r].outputs)
+        if (!p.exec)
+          sampled[r] = true;
+  }
+
+  // Kahn's order, lowest node index first among ready nodes. A cycle is
+  // broken at its lowest node; its back edges take effect on the next
+  // loop().
+  std::vector<uint32_t> pending(n, 0);
+  for (uint32_t r : members) {
+    for (uint32_t d : down[r])
+      if (d != r)
+        ++pending[d];
+    for (uint32_t d : after[r])
+      if (d != r)
+        ++pending[d];
+  }
+  std::priority_queue<uint32_t, std::vector<uint32_t>, std::greater<uint32_t>>
+      ready;
+  for (uint32_t r : members)
+    if (pending[r] == 0)
+      ready.push(r);
+  size_t next = 0; // scan position for cycle breaking
+  while (plan.order.size() < members.size()) {
+    if (ready.empty()) {
+      while (plan.bit[members[next]] != npos)
+        ++next;
+      pending[members[next]] = 0;
+      ready.push(members[next]);
+    }
+    const uint32_t r = ready.top();
+    ready.pop();
+    if (plan.bit[r] != npos)
+      continue;
+    plan.bit[r] = static_cast<uint32_t>(plan.order.size());
+    plan.order.push_back(r);
+    for (const auto *edges : {&down[r], &after[r]})
+      for (uint32_t d : *edges)
+        if (d != r && plan.bit[d] == npos && pending[d] && --pending[d] == 0)
+          ready.push(d);
+  }
+
+  plan.down.resize(plan.order.size());
+  for (uint32_t b = 0; b < plan.order.size(); ++b) {
+    const uint32_t r = plan.order[b];
+    for (uint32_t d : down[r])
+      plan.down[b].push_back(plan.bit[d]);
+    std::sort(plan.down[b].begin(), plan.down[b].end());
+    if (sampled[r])
+      plan.sampled.push_back(b);
+  }
+  return plan;
+}
+
+std::vector<uint32_t> ExecSuccessorBits(const GraphIndex &index,
+                                        const ReactivePlan &plan,
+                                        uint32_t node, uint32_t pin,
+                                        bool transitive) {
+  std::vector<uint32_t> bits;
+  std::vector<bool> seen(index.nodes.size(), false);
+  std::vector<std::pair<uint32_t, uint32_t>> stack = {{node, pin}};
+  while (!stack.empty()) {
+    const auto [x, out] = stack.back();
+    stack.pop_back();
+    index.ForEachOutLink(x, [&](const GraphIndex::Link &l) {
+      if ((out != GraphIndex::npos && l.src_pin != out) ||
+          !index.nodes[x].outputs[l.src_pin].exec ||
+          !index.nodes[l.dst_node].inputs[l.dst_pin].exec ||
+          seen[l.dst_node])
+        return;
+      seen[l.dst_node] = true;
+      if (plan.Scheduled(l.dst_node))
+        bits.push_back(plan.bit[l.dst_node]);
+      if (transitive)
+        stack.push_back({l.dst_node, GraphIndex::npos});
+    });
+  }
+  std::sort(bits.begin(), bits.end());
+  return bits;
+}
+
+std::string BitMaskStatements(const std::string &array,
+                              const std::vector<uint32_t> &bits, bool set,
+                              const std::string &indent) {
+  std::ostringstream out;
+  for (size_t i = 0; i < bits.size();) {
+    const uint32_t word = bits[i] / 32;
+    uint32_t mask = 0;
+    for (; i < bits.size() && bits[i] / 32 == word; ++i)
+      mask |= uint32_t(1) << (bits[i] % 32);
+    char hex[16];
+    std::snprintf(hex, sizeof(hex), "0x%08x", mask);
+    out << indent << array << "[" << word << "] "
+        << (set ? "|= UINT32_C(" : "&= ~UINT32_C(") << hex << ");\n";
+  }
+  return out.str();
+}
+
+std::string ReactiveRuntimePrelude(const ReactivePlan &plan) {
+  const size_t words = std::max<size_t>(1, plan.Words());
+  std::ostringstream out;
+  out << "// ---- Reactive loop chain: " << plan.order.size()
+      << " scheduled node(s) ----\n";
+  out << "#include <string.h>\n";
+  out << "static uint32_t g_efusion_dirty[" << words << "] = {";
+  for (size_t w = 0; w < words; ++w) {
+    const size_t used = std::min<size_t>(32, plan.order.size() - 32 * w);
+    char hex[16];
+    std::snprintf(hex, sizeof(hex), "0x%08x",
+                  used >= 32 ? 0xffffffffu : (uint32_t(1) << used) - 1);
+    out << (w ? ", " : "") << "UINT32_C(" << hex << ")";
+  }
+  out << "};\n";
+  out << "static uint32_t g_efusion_blocked[" << words << "];\n";
+  out << R"efx(// True when node bit `i` is dirty and not blocked by a branch; clears it.
+static inline bool efx_take(uint16_t i) {
+    const uint32_t m = UINT32_C(1) << (i & 31);
+    uint32_t &dirty = g_efusion_dirty[i >> 5];
+    if (!(dirty & m) || (g_efusion_blocked[i >> 5] & m))
+        return false;
+    dirty &= ~m;
+    return true;
+}
+// True when `now` differs from `prev`, the value of the previous run, which
+// is then updated. Bytewise: padding may report a change, never hide one.
+template <typename T> static inline bool efx_changed(T &prev, const T &now) {
+    if (memcmp(&prev, &now, sizeof(T)) == 0)
+        return false;
+    prev = now;
+    return true;
+}
+static inline bool efx_changed(std::string &prev, const std::string &now) {
+    if (prev == now)
+        return false;
+    prev = now;
+    return true;
+}
+
+)efx";
+  return out.str();
+}
+
+} // namespace ModuleUI
@@ -0,0 +1,83 @@
+#pragma once
+#include "./graph_index.hpp"
+#include "./task_partition.hpp"
+
+#include <cstdint>
+#include <functional>
+#include <string>
+#include <vector>
+
+#ifndef REACTIVE_PLAN_MAIN_SKETCH_HPP
+#define REACTIVE_PLAN_MAIN_SKETCH_HPP
+
+namespace ModuleUI {
+
+// Schedule of the loop chain in the reactive execution mode ("execution":
+// "reactive" in the sketch's "transpile" settings).
+//
+// Instead of calling the whole chain from loop(), each node of the chain
+// owns a bit of the g_efusion_dirty bitset and loop() runs, in topological
+// order, only the nodes whose bit is set. A node that ran sets the bits of
+// its dependents when one of its data outputs changed (compared with the
+// value of its previous run), or unconditionally when it has no data
+// output. A branch only sets the bits of the side it takes and blocks the
+// other side, whose pending nodes wait until the branch takes it again.
+//
+// Sampled nodes are set dirty on every loop(): the nodes whose value can
+// change with no input change. These are the nodes with data outputs and no
+// input from another scheduled node (sensors, inputs), the readers of a
+// task's mailbox, and the consumers of a skeleton pure node with no linked
+// input. Every other skeleton is assumed to be a function of its inputs;
+// sinks with neither linked inputs nor outputs run once and then only when
+// their exec predecessor does. Nodes feeding themselves (through pure nodes)
+// run again on the next loop() while their value changes.
+//
+// Pure nodes are not scheduled: they stay pulled by their consumers, their
+// inputs count as inputs of the consumer. Neither are the nodes behind a
+// "direct" exec output (state machine entry actions): they are called by
+// the node firing them, when it fires them, and their consumers sample
+// them.
+struct ReactivePlan {
+  std::vector<uint32_t> order; // node of each bit, in topological order
+  std::vector<uint32_t> bit;   // bit of each node, npos when not scheduled
+  // Per bit: bits to set when the node's outputs change (data dependents
+  // and, except for branches and state machines, exec successors).
+  std::vector<std::vector<uint32_t>> down;
+  std::vector<uint32_t> sampled; // bits set on every loop()
+
+  bool Scheduled(uint32_t node) const {
+    return node < bit.size() && bit[node] != GraphIndex::npos;
+  }
+  size_t Words() const { return (order.size() + 31) / 32; }
+};
+
+// Plans the chain of the loop task of `tasks`. `opaque(node)` is true for
+// nodes lowered to a skeleton call, whose result the transpiler cannot see
+// through; `direct(node, pin)` for the exec outputs whose successors are
+// called directly.
+ReactivePlan
+PlanReactive(const GraphIndex &index, const TaskPartition &tasks,
+             const std::function<bool(uint32_t)> &opaque,
+             const std::function<bool(uint32_t, uint32_t)> &direct);
+
+// Bits of the scheduled exec successors of output `pin` of `node`, directly
+// or (with `transitive`) through any number of exec links.
+std::vector<uint32_t> ExecSuccessorBits(const GraphIndex &index,
+                                        const ReactivePlan &plan,
+                                        uint32_t node, uint32_t pin,
+                                        bool transitive);
+
+// Statements applying `bits` to the bitset `array`: `|=` when `set`,
+// `&= ~` otherwise, one per non-empty 32-bit word.
+std::string BitMaskStatements(const std::string &array,
+                              const std::vector<uint32_t> &bits, bool set,
+                              const std::string &indent);
+
+// Dirty and blocked bitsets, efx_take() and efx_changed(), emitted once in
+// a reactive main.cpp. Every bit starts dirty so the first loop() runs the
+// whole chain.
+std::string ReactiveRuntimePrelude(const ReactivePlan &plan);
+
+} // namespace ModuleUI
+
+#endif // REACTIVE_PLAN_MAIN_SKETCH_HPP
@@ -0,0 +1,425 @@
+#include "schema_library.hpp"
+#include "./buffer_kernels.hpp"
+#include "./json_stream.hpp"
+#include "./state_machine.hpp"
+#include "../../../../../src/trace.hpp"
+
+#include <chrono>
+#include <fstream>
+#include <iostream>
+#include <sstream>
+
+namespace ModuleUI {
+
+SchemaLibrary::SchemaLibrary(const fs::path &root)
+    : m_Root(root), m_Snapshot(std::make_shared<SchemaCatalog>()) {}
+
+std::shared_ptr<const SchemaCatalog> SchemaLibrary::Snapshot() const {
+  std::lock_guard<std::mutex> lock(m_Mutex);
+  return m_Snapshot;
+}
+
+uint64_t SchemaLibrary::Generation() const {
+  std::lock_guard<std::mutex> lock(m_Mutex);
+  return m_Snapshot->generation;
+}
+
+void SchemaLibrary::Edit(const std::function<void(SchemaCatalog &)> &fn) {
+  std::lock_guard<std::mutex> lock(m_Mutex);
+  auto copy = std::make_shared<SchemaCatalog>(*m_Snapshot);
+  fn(*copy);
+  copy->generation = m_Snapshot->generation + 1;
+  m_Snapshot = std::move(copy);
+}
+
+void SchemaLibrary::Merge(CatalogChunk chunk, bool replace) {
+  if (chunk.types.empty() && chunk.schemas.empty())
+    return;
+  // Written from the published entries, the chunk's are moved below
+  const auto skeletons = std::move(chunk.skeletons);
+  Edit([&](SchemaCatalog &c) {
+    for (auto &t : chunk.types) {
+      if (replace)
+        c.UpsertType(std::move(t));
+      else
+        c.AddType(std::move(t));
+    }
+    for (auto &s : chunk.schemas) {
+      if (replace)
+        c.UpsertSchema(std::move(s));
+      else
+        c.AddSchema(std::move(s));
+    }
+  });
+
+  if (skeletons.empty())
+    return;
+  auto snapshot = Snapshot();
+  for (const auto &[folder, id] : skeletons)
+    if (const SchemaInfo *s = snapshot->FindSchema(id))
+      EnsureSkeleton(folder, *s);
+}
+
+void SchemaLibrary::EnsureSchemas(const std::set<std::string> &ids) {
+  auto snapshot = Snapshot();
+  std::set<std::string> missing;
+  for (const auto &id : ids)
+    if (!snapshot->FindSchema(id))
+      missing.insert(id);
+  if (missing.empty())
+    return;
+
+  std::set<std::string> skipTypes;
+  for (const auto &t : snapshot->types)
+    skipTypes.insert(t.id);
+  Merge(LoadCatalog(m_Root, &missing, {}, skipTypes));
+}
+
+void SchemaLibrary::LoadRemainingAsync() {
+  if (m_Complete || m_Pending.valid())
+    return;
+
+  auto snapshot = Snapshot();
+  std::set<std::string> skipSchemas, skipTypes;
+  for (const auto &s : snapshot->schemas)
+    skipSchemas.insert(s.id);
+  for (const auto &t : snapshot->types)
+    skipTypes.insert(t.id);
+
+  m_Pending = std::async(std::launch::async, &LoadCatalog, m_Root, nullptr,
+                         std::move(skipSchemas), std::move(skipTypes),
+                         nullptr);
+}
+
+void SchemaLibrary::Poll() {
+  if (m_Pending.valid() && m_Pending.wait_for(std::chrono::seconds(0)) ==
+                               std::future_status::ready) {
+    Merge(m_Pending.get());
+    m_Complete = true;
+  }
+}
+
+void SchemaLibrary::WaitForComplete() {
+  if (m_Pending.valid()) {
+    Merge(m_Pending.get());
+    m_Complete = true;
+  }
+}
+
+bool SchemaLibrary::IsComplete() const { return m_Complete; }
+
+void SchemaLibrary::Reload() {
+  EFUSION_TRACE_SCOPE("SchemaLibrary::Reload");
+  WaitForComplete();
+  Merge(LoadCatalog(m_Root, nullptr, {}, {}), true);
+  m_Complete = true;
+}
+
+namespace {
+
+json PinDefToJson(const PinDef &p) {
+  return {{"id", p.id},
+          {"name", p.name},
+          {"type", p.type},
+          {"default", p.defaultValue},
+          {"key", p.key}};
+}
+
+PinDef PinDefFromJson(const json &j) {
+  PinDef p;
+  p.id = j.value("id", "");
+  p.name = j.value("name", "");
+  p.type = j.value("type", "");
+  p.defaultValue = j.contains("default") ? j["default"] : json();
+  p.key = j.value("key", "");
+  p.type_id = PinTypeRegistry::Intern(p.type);
+  return p;
+}
+
+} // namespace
+
+json SchemaLibrary::Export() const {
+  auto snapshot = Snapshot();
+  json j;
+  j["root"] = m_Root.string();
+  j["complete"] = m_Complete;
+
+  j["types"] = json::array();
+  for (const auto &t : snapshot->types) {
+    json e = {{"id", t.id},
+              {"name", t.name},
+              {"description", t.description},
+              {"color", t.colorHex},
+              {"category", t.category},
+              {"cpp_type", t.cpp_type},
+              {"layout", t.layout},
+              {"element", t.element},
+              {"length", t.length}};
+    if (t.has_range)
+      e["range"] = {t.range_min, t.range_max};
+    j["types"].push_back(std::move(e));
+  }
+
+  j["schemas"] = json::array();
+  for (const auto &s : snapshot->schemas) {
+    json e = {{"id", s.id},
+              {"proper_name", s.proper_name},
+              {"proper_logo", s.proper_logo},
+              {"name", s.name},
+              {"name_secondary", s.name_secondary},
+              {"description", s.description},
+              {"kind", s.kind},
+              {"hexcolheader", s.hexcolheader},
+              {"hexcolbg", s.hexcolbg},
+              {"hexcolborder", s.hexcolborder},
+              {"hexcoltext", s.hexcoltext},
+              {"hexcoltextsecondary", s.hexcoltextsecondary},
+              {"nodetype", s.nodetype},
+              {"logopath", s.logopath}};
+    e["inputs"] = json::array();
+    for (const auto &p : s.inputs)
+      e["inputs"].push_back(PinDefToJson(p));
+    e["outputs"] = json::array();
+    for (const auto &p : s.outputs)
+      e["outputs"].push_back(PinDefToJson(p));
+    j["schemas"].push_back(std::move(e));
+  }
+  return j;
+}
+
+void SchemaLibrary::Restore(const json &j) {
+  CatalogChunk chunk;
+  for (const auto &e : j.value("types", json::array())) {
+    PinTypeInfo t;
+    t.id = e.value("id", "");
+    t.name = e.value("name", "");
+    t.description = e.value("description", "");
+    t.colorHex = e.value("color", "");
+    t.category = e.value("category", "");
+    t.cpp_type = e.value("cpp_type", "");
+    t.layout = e.value("layout", "");
+    t.element = e.value("element", "");
+    t.length = e.value("length", 0u);
+    if (e.contains("range") && e["range"].size() == 2) {
+      t.has_range = true;
+      t.range_min = e["range"][0].get<int32_t>();
+      t.range_max = e["range"][1].get<int32_t>();
+    }
+    InternPinType(t);
+    chunk.types.push_back(std::move(t));
+  }
+  for (const auto &e : j.value("schemas", json::array())) {
+    SchemaInfo s;
+    s.id = e.value("id", "");
+    s.proper_name = e.value("proper_name", "");
+    s.proper_logo = e.value("proper_logo", "");
+    s.name = e.value("name", "");
+    s.name_secondary = e.value("name_secondary", "");
+    s.description = e.value("description", "");
+    s.kind = e.value("kind", "");
+    s.hexcolheader = e.value("hexcolheader", "");
+    s.hexcolbg = e.value("hexcolbg", "");
+    s.hexcolborder = e.value("hexcolborder", "");
+    s.hexcoltext = e.value("hexcoltext", "");
+    s.hexcoltextsecondary = e.value("hexcoltextsecondary", "");
+    s.nodetype = e.value("nodetype", "");
+    s.logopath = e.value("logopath", "");
+    for (const auto &p : e.value("inputs", json::array()))
+      s.inputs.push_back(PinDefFromJson(p));
+    for (const auto &p : e.value("outputs", json::array()))
+      s.outputs.push_back(PinDefFromJson(p));
+    s.kind_id = SchemaKindFromString(s.kind);
+    chunk.schemas.push_back(std::move(s));
+  }
+  Merge(std::move(chunk), true);
+  // An incomplete library streams the rest when its window asks
+  m_Complete = j.value("complete", false);
+}
+
+// Both readers stream the file (mapped, see json_stream.hpp) straight into
+// the catalog structures, no json DOM is built.
+std::optional<PinTypeInfo>
+SchemaLibrary::readTypeFromFolder(const fs::path &folder) {
+  try {
+    PinTypeInfo t;
+    if (!ReadPinTypeFile(folder / "type.json", folder.filename().string(), t))
+      return std::nullopt;
+    return t;
+  } catch (...) {
+    return std::nullopt;
+  }
+}
+
+std::optional<SchemaInfo>
+SchemaLibrary::readSchemaFromFolder(const fs::path &folder) {
+  try {
+    SchemaInfo s;
+    if (!ReadSchemaFile(folder / "config.json", folder.filename().string(), s))
+      return std::nullopt;
+    return s;
+  } catch (...) {
+    return std::nullopt;
+  }
+}
+
+void SchemaLibrary::EnsureSkeleton(const fs::path &folder,
+                                   const SchemaInfo &info) {
+  fs::path skeleton = folder / (info.id + ".cpp");
+  if (fs::exists(skeleton))
+    return;
+  std::ofstream sk(skeleton);
+  if (sk.is_open())
+    sk << SkeletonSource(info);
+}
+
+std::string SchemaLibrary::SkeletonSource(const SchemaInfo &info) {
+  std::ostringstream sk;
+  sk << "// "
+     << (info.kind_id == SchemaKind::Function ? "Function" : "Primitive")
+     << " skeleton for: " << info.id << "\n";
+  if (!info.description.empty())
+    sk << "// Description: " << info.description << "\n";
+  sk << "\n// TODO: implement\n";
+  sk << "// Pin values are exchanged through the "
+     << SanitizeIdentifier("port_" + info.id) << "_<pin> globals\n";
+  sk << "void " << SkeletonFunctionName(info) << "() {\n}\n";
+  return sk.str();
+}
+
+CatalogChunk SchemaLibrary::LoadCatalog(
+    const fs::path &root, const std::set<std::string> *only,
+    const std::set<std::string> &skipSchemas,
+    const std::set<std::string> &skipTypes, const std::atomic<bool> *cancel) {
+  EFUSION_TRACE_SCOPE("SchemaLibrary::LoadCatalog", root.string());
+  CatalogChunk chunk;
+  std::set<std::string> wantedTypes;
+  auto cancelled = [cancel]() { return cancel && cancel->load(); };
+
+  const std::pair<fs::path, const char *> schemaDirs[] = {
+      {root / "primitives", "primitive"}, {root / "functions", "function"}};
+
+  auto loadSchema = [&](const fs::path &folder, const char *defaultKind) {
+    auto maybe = readSchemaFromFolder(folder);
+    if (!maybe || skipSchemas.count(maybe->id))
+      return;
+    maybe->kind = maybe->kind.empty() ? defaultKind : maybe->kind;
+    maybe->kind_id = SchemaKindFromString(maybe->kind);
+    for (const auto &p : maybe->inputs)
+      wantedTypes.insert(p.type);
+    for (const auto &p : maybe->outputs)
+      wantedTypes.insert(p.type);
+    std::error_code ec;
+    if (!fs::exists(folder / (maybe->id + ".cpp"), ec))
+      chunk.skeletons.emplace_back(folder, maybe->id);
+    chunk.schemas.push_back(std::move(*maybe));
+  };
+  // State machines are node types too, generated from their definition
+  const fs::path machinesDir = root / "machines";
+  auto loadMachine = [&](const fs::path &folder) {
+    StateMachineInfo m;
+    std::string error;
+    if (!ReadStateMachineFile(folder / "machine.json",
+                              folder.filename().string(), m, error)) {
+      std::cerr << "LoadCatalog: " << error << std::endl;
+      return;
+    }
+    if (!skipSchemas.count(m.id))
+      chunk.schemas.push_back(StateMachineSchema(m));
+  };
+
+  try {
+    if (only) {
+      // Schema folders are named after their id (see SavePrimitives), so a
+      // referenced id costs one stat instead of a directory listing.
+      for (const auto &id : *only) {
+        if (cancelled())
+          return chunk;
+        if (skipSchemas.count(id))
+          continue;
+        bool found = false;
+        for (const auto &d : schemaDirs) {
+          fs::path folder = d.first / id;
+          if (fs::is_directory(folder)) {
+            loadSchema(folder, d.second);
+            found = true;
+            break;
+          }
+        }
+        if (!found && fs::is_directory(machinesDir / id)) {
+          loadMachine(machinesDir / id);
+          found = true;
+        }
+        // Batch primitives of a buffer type come with the type
+        std::string typeId;
+        BufferOp op;
+        if (!found && SplitBufferPrimitiveId(id, typeId, op))
+          wantedTypes.insert(typeId);
+      }
+    } else {
+      for (const auto &d : schemaDirs) {
+        if (!fs::exists(d.first))
+          continue;
+        for (auto &p : fs::directory_iterator(d.first)) {
+          if (cancelled())
+            return chunk;
+          if (p.is_directory())
+            loadSchema(p.path(), d.second);
+        }
+      }
+      if (fs::exists(machinesDir))
+        for (auto &p : fs::directory_iterator(machinesDir))
+          if (p.is_directory())
+            loadMachine(p.path());
+    }
+
+    auto wantType = [&](const std::string &id) {
+      return !skipTypes.count(id) && (!only || wantedTypes.count(id));
+    };
+    std::set<std::string> seen;
+    auto addType = [&](PinTypeInfo t) {
+      if (wantType(t.id) && seen.insert(t.id).second)
+        chunk.types.push_back(std::move(t));
+    };
+
+    fs::path typesRoot = root / "types";
+    if (only) {
+      for (const auto &id : wantedTypes) {
+        if (cancelled())
+          return chunk;
+        if (!wantType(id))
+          continue;
+        if (auto t = readTypeFromFolder(typesRoot / id))
+          addType(std::move(*t));
+      }
+    } else if (fs::exists(typesRoot)) {
+      for (auto &p : fs::directory_iterator(typesRoot)) {
+        if (cancelled())
+          return chunk;
+        if (p.is_directory())
+          if (auto t = readTypeFromFolder(p.path()))
+            addType(std::move(*t));
+      }
+    }
+
+    fs::path pinSetup = root / "src" / "setup" / "pin_setup.json";
+    if (fs::exists(pinSetup)) {
+      // json, CBOR or MessagePack depending on the sketch's format
+      ReadPinSetupFile(pinSetup, [&](PinTypeInfo &&t) {
+        if (!t.id.empty())
+          addType(std::move(t));
+      });
+    }
+
+    // Batch primitives are generated from their buffer type, never read
+    // from disk
+    for (const auto &t : chunk.types)
+      for (auto &s : BufferPrimitives(t))
+        if (!skipSchemas.count(s.id))
+          chunk.schemas.push_back(std::move(s));
+  } catch (const std::exception &e) {
+    std::cerr << "LoadCatalog exception: " << e.what() << std::endl;
+  }
+  return chunk;
+}
+
+} // namespace ModuleUI
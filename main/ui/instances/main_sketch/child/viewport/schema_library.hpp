@@ -0,0 +1,86 @@
+#pragma once
+#include "./schema_types.hpp"
+
+#include <atomic>
+#include <functional>
+#include <future>
+#include <memory>
+#include <mutex>
+#include <optional>
+#include <set>
+
+#ifndef SCHEMA_LIBRARY_MAIN_SKETCH_HPP
+#define SCHEMA_LIBRARY_MAIN_SKETCH_HPP
+
+namespace ModuleUI {
+
+// Types, primitives and functions of one schema root, parsed once and
+// shared read-only by every window showing a sketch of that project.
+// Instances are handed out by EmbeddedFusion::AcquireSchemaLibrary(), keyed
+// by EmbeddedFusion::SchemaRoot(), and die with the last window holding them.
+//
+// Readers take an immutable snapshot; writers go through Edit(), which copies
+// the current snapshot, applies the change and publishes a new generation.
+// Windows notice the generation change and register what is new.
+class SchemaLibrary {
+public:
+  explicit SchemaLibrary(const fs::path &root);
+
+  const fs::path &Root() const { return m_Root; }
+
+  std::shared_ptr<const SchemaCatalog> Snapshot() const;
+  uint64_t Generation() const;
+
+  // Synchronously loads the given schema ids (and the pin types their pins
+  // use) if they are not in the catalog yet.
+  void EnsureSchemas(const std::set<std::string> &ids);
+  // Parses the rest of the library on a background thread. Idempotent.
+  void LoadRemainingAsync();
+  // Merges a finished background load, never blocks.
+  void Poll();
+  // Blocks until the background load (if any) is merged.
+  void WaitForComplete();
+  bool IsComplete() const;
+  // Re-reads everything from disk; entries found on disk replace the
+  // current ones, entries only known in memory (built-ins) are kept.
+  void Reload();
+
+  // Hot reload of the module: the catalog without its interned ids (the
+  // pin type registry does not survive the module), and its restoration
+  // into a fresh library in place of a parse from disk.
+  json Export() const;
+  void Restore(const json &j);
+
+  void Edit(const std::function<void(SchemaCatalog &)> &fn);
+  // Publishes `chunk`, then writes the skeletons it lists. Windows merge on
+  // the UI thread only, so no two skeleton writes race.
+  void Merge(CatalogChunk chunk, bool replace = false);
+
+  // File readers. Thread-safe: they only read the filesystem and touch the
+  // pin type interner, skeletons to create are returned, not written.
+  static std::optional<PinTypeInfo> readTypeFromFolder(const fs::path &folder);
+  static std::optional<SchemaInfo> readSchemaFromFolder(const fs::path &folder);
+  static void EnsureSkeleton(const fs::path &folder, const SchemaInfo &info);
+  // Fresh <id>.cpp of a primitive or function: an empty definition of
+  // SkeletonFunctionName(), so the transpiled sketch links before it is
+  // filled in.
+  static std::string SkeletonSource(const SchemaInfo &info);
+  // When `only` is null every schema folder is read, otherwise only the
+  // listed ids. Setting `*cancel` stops the read between two folders.
+  static CatalogChunk LoadCatalog(const fs::path &root,
+                                  const std::set<std::string> *only,
+                                  const std::set<std::string> &skipSchemas,
+                                  const std::set<std::string> &skipTypes,
+                                  const std::atomic<bool> *cancel = nullptr);
+
+private:
+  fs::path m_Root;
+  mutable std::mutex m_Mutex;
+  std::shared_ptr<const SchemaCatalog> m_Snapshot;
+  std::future<CatalogChunk> m_Pending;
+  bool m_Complete = false;
+};
+
+} // namespace ModuleUI
+
+#endif // SCHEMA_LIBRARY_MAIN_SKETCH_HPP
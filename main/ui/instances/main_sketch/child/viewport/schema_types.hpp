@@ -0,0 +1,207 @@
+#pragma once
+#include "../../../../../../lib/vortex/main/include/vortex.h"
+#include "./pin_types.hpp"
+
+#include <cctype>
+#include <string>
+#include <unordered_map>
+#include <vector>
+
+#ifndef SCHEMA_TYPES_MAIN_SKETCH_HPP
+#define SCHEMA_TYPES_MAIN_SKETCH_HPP
+
+namespace ModuleUI {
+
+struct PinTypeInfo {
+  std::string id;
+  std::string name;
+  std::string description;
+  std::string colorHex;
+  std::string category; // "primitive" or "custom"
+  std::string cpp_type;
+  // Buffer types: layout "array" or "ring" of `length` elements of pin type
+  // `element` (int or float). Scalar types leave these empty.
+  std::string layout = {};
+  std::string element = {};
+  uint32_t length = 0;
+  // Declared values of an integral type ("range": [lo, hi]), see
+  // PinTypeRange()
+  bool has_range = false;
+  int32_t range_min = 0;
+  int32_t range_max = 0;
+
+  // Interned forms of the strings above, see InternPinType()
+  PinTypeId type_id = kInvalidPinType;
+  PinCategory category_id = PinCategory::Custom;
+  PinTypeId storage_id = kInvalidPinType;
+  PinLayout layout_id = PinLayout::Scalar;
+  PinTypeId element_id = kInvalidPinType;
+};
+
+struct PinDef {
+  std::string id;
+  std::string name;
+  std::string type; // pin type id (refers to PinTypeInfo.id)
+  json defaultValue;
+  std::string key = {}; // name the pin was registered with in m_NodeCtx
+  PinTypeId type_id = kInvalidPinType;
+
+  // Pin name in the node graph
+  const std::string &GraphKey() const {
+    return !key.empty() ? key : !id.empty() ? id : name;
+  }
+};
+
+// Pin of a schema generated in code (buffer kernels, state machines),
+// registered under its id.
+inline PinDef MakePinDef(const std::string &id, const std::string &name,
+                         const std::string &type, json defaultValue = nullptr) {
+  PinDef p{id, name, type, std::move(defaultValue)};
+  p.key = p.id;
+  p.type_id = PinTypeRegistry::Intern(p.type);
+  return p;
+}
+
+struct SchemaInfo {
+  std::string id;
+  std::string proper_name;
+  std::string proper_logo;
+  std::string name;
+  std::string name_secondary;
+  std::string description;
+  std::vector<PinDef> inputs;
+  std::vector<PinDef> outputs;
+  std::string kind; // "primitive" or "function" or other
+  std::string hexcolheader;
+  std::string hexcolbg;
+  std::string hexcolborder;
+  std::string hexcoltext;
+  std::string hexcoltextsecondary;
+  std::string nodetype;
+  std::string logopath;
+  SchemaKind kind_id = SchemaKind::Other;
+};
+
+// C identifier for generated code: anything but [A-Za-z0-9_] becomes '_',
+// and a leading digit gets a '_' prefix.
+inline std::string SanitizeIdentifier(const std::string &s) {
+  std::string out;
+  for (char c : s) {
+    if (isalnum((unsigned char)c) || c == '_')
+      out.push_back(c);
+    else
+      out.push_back('_');
+  }
+  // avoid starting with digit
+  if (!out.empty() && isdigit((unsigned char)out.front()))
+    out = std::string("_") + out;
+  return out;
+}
+
+// Function a primitive or function skeleton defines and the transpiled
+// code calls for every instance of the schema.
+inline std::string SkeletonFunctionName(const SchemaInfo &s) {
+  return SanitizeIdentifier("primitive_" + s.id);
+}
+
+inline void InternPinType(PinTypeInfo &t) {
+  t.type_id = PinTypeRegistry::Intern(t.id);
+  t.category_id = PinCategoryFromString(t.category);
+  t.layout_id = PinLayoutFromString(t.layout);
+  t.element_id = t.element.empty() ? kInvalidPinType
+                                   : PinTypeRegistry::Intern(t.element);
+  // Buffers are emitted as a struct named after the type
+  if (t.layout_id != PinLayout::Scalar && t.cpp_type.empty())
+    t.cpp_type = t.id;
+  t.storage_id = t.cpp_type.empty() ? kInvalidPinType
+                                    : PinTypeRegistry::Intern(t.cpp_type);
+}
+
+// Values a pin of type `t` can hold: its declared range, or the one implied
+// by a bool or 8-bit cpp_type. False for other types.
+inline bool PinTypeRange(const PinTypeInfo &t, int32_t &lo, int32_t &hi) {
+  if (t.has_range) {
+    lo = t.range_min;
+    hi = t.range_max;
+  } else if (t.cpp_type == "bool") {
+    lo = 0;
+    hi = 1;
+  } else if (t.cpp_type == "uint8_t" || t.cpp_type == "byte") {
+    lo = 0;
+    hi = 255;
+  } else if (t.cpp_type == "int8_t") {
+    lo = -128;
+    hi = 127;
+  } else {
+    return false;
+  }
+  return lo <= hi;
+}
+
+// Parsed types and schemas of a sketch library. Published snapshots are
+// immutable and shared between windows; edits go through
+// SchemaLibrary::Edit() which works on a copy.
+struct SchemaCatalog {
+  std::vector<PinTypeInfo> types;
+  std::vector<SchemaInfo> schemas; // primitives + functions
+  std::unordered_map<std::string, size_t> schema_index;
+  std::unordered_map<PinTypeId, size_t> type_index;
+  uint64_t generation = 0;
+
+  const SchemaInfo *FindSchema(const std::string &id) const {
+    auto it = schema_index.find(id);
+    return it == schema_index.end() ? nullptr : &schemas[it->second];
+  }
+
+  const PinTypeInfo *FindType(PinTypeId id) const {
+    auto it = type_index.find(id);
+    return it == type_index.end() ? nullptr : &types[it->second];
+  }
+
+  // Adds the entry unless one with the same id exists; returns true if added.
+  bool AddType(PinTypeInfo t) {
+    if (type_index.count(t.type_id))
+      return false;
+    type_index.emplace(t.type_id, types.size());
+    types.push_back(std::move(t));
+    return true;
+  }
+
+  bool AddSchema(SchemaInfo s) {
+    if (schema_index.count(s.id))
+      return false;
+    schema_index.emplace(s.id, schemas.size());
+    schemas.push_back(std::move(s));
+    return true;
+  }
+
+  // Replaces the entry with the same id, or adds it.
+  void UpsertType(PinTypeInfo t) {
+    auto it = type_index.find(t.type_id);
+    if (it == type_index.end())
+      AddType(std::move(t));
+    else
+      types[it->second] = std::move(t);
+  }
+
+  void UpsertSchema(SchemaInfo s) {
+    auto it = schema_index.find(s.id);
+    if (it == schema_index.end())
+      AddSchema(std::move(s));
+    else
+      schemas[it->second] = std::move(s);
+  }
+};
+
+// Result of a (possibly partial) library read, merged into a catalog.
+struct CatalogChunk {
+  std::vector<PinTypeInfo> types;
+  std::vector<SchemaInfo> schemas;
+  // Folder and schema id of read schemas without a <id>.cpp skeleton; the
+  // readers only note them, SchemaLibrary::Merge() writes the files.
+  std::vector<std::pair<fs::path, std::string>> skeletons = {};
+};
+
+} // namespace ModuleUI
+
+#endif // SCHEMA_TYPES_MAIN_SKETCH_HPP
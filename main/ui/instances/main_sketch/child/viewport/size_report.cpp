@@ -0,0 +1,109 @@
+#include "size_report.hpp"
+
+#include <algorithm>
+#include <sstream>
+
+namespace ModuleUI {
+
+std::vector<SymbolSize> ParseNmSizes(const std::string &output) {
+  std::vector<SymbolSize> symbols;
+  std::istringstream in(output);
+  std::string line;
+  while (std::getline(in, line)) {
+    // <address> <size> <type> <name...>
+    std::istringstream fields(line);
+    std::string address, size, type;
+    if (!(fields >> address >> size >> type) || type.size() != 1)
+      continue;
+    std::string name;
+    std::getline(fields >> std::ws, name);
+    const size_t paren = name.find('(');
+    if (paren != std::string::npos)
+      name.resize(paren);
+    if (name.empty())
+      continue;
+
+    SymbolSize s;
+    s.name = std::move(name);
+    s.kind = type[0];
+    try {
+      s.size = std::stoull(size, nullptr, 16);
+    } catch (...) {
+      continue;
+    }
+    symbols.push_back(std::move(s));
+  }
+  return symbols;
+}
+
+Footprint FootprintOf(const SymbolSize &symbol) {
+  Footprint f;
+  switch (symbol.kind) {
+  case 'T':
+  case 't':
+  case 'W':
+  case 'w':
+  case 'R':
+  case 'r':
+    f.flash = symbol.size;
+    break;
+  case 'D':
+  case 'd':
+  case 'G':
+  case 'g':
+  case 'V':
+  case 'v':
+    f.flash = symbol.size;
+    f.ram = symbol.size;
+    break;
+  case 'B':
+  case 'b':
+  case 'S':
+  case 's':
+    f.ram = symbol.size;
+    break;
+  default:
+    break;
+  }
+  return f;
+}
+
+std::vector<std::pair<std::string, Footprint>> SizeReport::Ranked() const {
+  std::vector<std::pair<std::string, Footprint>> ranked(nodes.begin(),
+                                                        nodes.end());
+  std::sort(ranked.begin(), ranked.end(), [](const auto &a, const auto &b) {
+    const uint64_t sa = a.second.flash + a.second.ram;
+    const uint64_t sb = b.second.flash + b.second.ram;
+    return sa != sb ? sa > sb : a.first < b.first;
+  });
+  return ranked;
+}
+
+SizeReport
+AttributeSizes(const std::vector<SymbolSize> &symbols,
+               const std::unordered_map<std::string, std::vector<std::string>>
+                   &owners) {
+  SizeReport report;
+  for (const auto &s : symbols) {
+    const Footprint f = FootprintOf(s);
+    report.total += f;
+
+    auto it = owners.find(s.name);
+    if (it == owners.end() || it->second.empty())
+      continue;
+    report.attributed += f;
+
+    // Even split, the remainder goes to the first owners
+    const auto &ids = it->second;
+    const uint64_t n = ids.size();
+    for (uint64_t k = 0; k < n; ++k) {
+      Footprint share;
+      share.flash = f.flash / n + (k < f.flash % n ? 1 : 0);
+      share.ram = f.ram / n + (k < f.ram % n ? 1 : 0);
+      report.nodes[ids[k]] += share;
+    }
+  }
+  return report;
+}
+
+} // namespace ModuleUI
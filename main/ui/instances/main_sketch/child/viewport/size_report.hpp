@@ -0,0 +1,60 @@
+#pragma once
+#include "../../../../../../lib/vortex/main/include/vortex.h"
+
+#include <cstdint>
+#include <string>
+#include <unordered_map>
+#include <utility>
+#include <vector>
+
+#ifndef SIZE_REPORT_MAIN_SKETCH_HPP
+#define SIZE_REPORT_MAIN_SKETCH_HPP
+
+namespace ModuleUI {
+
+// One line of `nm -S --size-sort -C`. `name` is cut before the parameter
+// list, so node_x() reads as node_x.
+struct SymbolSize {
+  std::string name;
+  uint64_t size = 0;
+  char kind = '?'; // nm symbol type letter
+};
+
+std::vector<SymbolSize> ParseNmSizes(const std::string &output);
+
+struct Footprint {
+  uint64_t flash = 0;
+  uint64_t ram = 0;
+
+  Footprint &operator+=(const Footprint &o) {
+    flash += o.flash;
+    ram += o.ram;
+    return *this;
+  }
+};
+
+// Code and read-only data cost flash, zero-initialized data costs RAM,
+// initialized data costs both (its initial image lives in flash).
+Footprint FootprintOf(const SymbolSize &symbol);
+
+struct SizeReport {
+  std::unordered_map<std::string, Footprint> nodes; // by instance id
+  Footprint total;      // every sized symbol of the binary
+  Footprint attributed; // the part that went to nodes
+
+  bool empty() const { return total.flash == 0 && total.ram == 0; }
+  // Nodes by decreasing flash + RAM
+  std::vector<std::pair<std::string, Footprint>> Ranked() const;
+};
+
+// Attributes symbol sizes to node instances. `owners` maps a generated
+// symbol name to the instances it belongs to; a symbol shared by several
+// instances (a primitive body, its port globals) is split evenly.
+SizeReport
+AttributeSizes(const std::vector<SymbolSize> &symbols,
+               const std::unordered_map<std::string, std::vector<std::string>>
+                   &owners);
+
+} // namespace ModuleUI
+
+#endif // SIZE_REPORT_MAIN_SKETCH_HPP
@@ -0,0 +1,71 @@
+#include "sketch_loader.hpp"
+#include "./json_stream.hpp"
+#include "./schema_library.hpp"
+#include "../../../../../src/trace.hpp"
+
+#include <iostream>
+
+namespace ModuleUI {
+
+std::string StageGraphForEngine(const fs::path &graphFile,
+                                const fs::path &staged) {
+  std::error_code ec;
+  fs::remove(staged, ec);
+
+  MappedFile file(graphFile);
+  if (!file.ok() ||
+      DetectDocumentFormat(file.data(), file.size()) == DocumentFormat::Json)
+    return graphFile.string();
+
+  // The engine only populates from json files
+  if (!TranscodeToJson(graphFile, staged)) {
+    std::cerr << "StageGraphForEngine: unable to decode " << graphFile
+              << std::endl;
+    return graphFile.string();
+  }
+  return staged.string();
+}
+
+SketchLoader::SketchLoader(const fs::path &root, const fs::path &graphFile,
+                           const fs::path &staged,
+                           std::set<std::string> skipSchemas,
+                           std::set<std::string> skipTypes)
+    : m_Root(root), m_GraphFile(graphFile), m_Staged(staged),
+      m_SkipSchemas(std::move(skipSchemas)), m_SkipTypes(std::move(skipTypes)),
+      m_Thread(&SketchLoader::Run, this) {}
+
+SketchLoader::~SketchLoader() {
+  Cancel();
+  if (m_Thread.joinable())
+    m_Thread.join();
+}
+
+void SketchLoader::Run() {
+  EFUSION_TRACE_SCOPE("SketchLoader::Run", m_Root.string());
+  try {
+    std::set<std::string> ids;
+    ScanGraphTypeIds(m_GraphFile, ids);
+    if (m_Cancel)
+      return;
+    m_Reached.store(Step::Catalog, std::memory_order_release);
+
+    catalog = SchemaLibrary::LoadCatalog(m_Root, &ids, m_SkipSchemas,
+                                         m_SkipTypes, &m_Cancel);
+    if (m_Cancel)
+      return;
+    m_Reached.store(Step::Graph, std::memory_order_release);
+
+    graph.file = StageGraphForEngine(m_GraphFile, m_Staged);
+    graph.type_ids = std::move(ids);
+    if (m_Cancel)
+      return;
+    m_Reached.store(Step::Done, std::memory_order_release);
+  } catch (const std::exception &e) {
+    // Not reported as done: the window would open on a missing graph
+    std::cerr << "SketchLoader exception: " << e.what() << std::endl;
+    m_Error = e.what();
+    m_Failed.store(true, std::memory_order_release);
+  }
+}
+
+} // namespace ModuleUI
@@ -0,0 +1,77 @@
+#pragma once
+#include "./schema_types.hpp"
+
+#include <atomic>
+#include <cstdint>
+#include <set>
+#include <string>
+#include <thread>
+
+#ifndef SKETCH_LOADER_MAIN_SKETCH_HPP
+#define SKETCH_LOADER_MAIN_SKETCH_HPP
+
+namespace ModuleUI {
+
+// Graph file as the engine populates it: `file` is json (the graph itself
+// or a decoded copy), `type_ids` every TypeID it references.
+struct StagedGraph {
+  std::string file;
+  std::set<std::string> type_ids;
+};
+
+// Path the engine should populate from: `graphFile` when it is json,
+// otherwise `staged`, a json copy decoded from it.
+std::string StageGraphForEngine(const fs::path &graphFile,
+                                const fs::path &staged);
+
+// File work of opening a sketch window, run on its own thread so the
+// window shows up at once: scans the graph for the schemas it references,
+// reads them and their pin types (skipping what the shared library
+// already holds), then stages the graph document. The window applies each
+// result on its own thread as soon as it is reached (Reached()), types
+// before schemas before the graph, since the engine can only place nodes
+// whose schema is registered.
+//
+// Results are written by the worker before Reached() moves past their
+// step and never touched by it again: past that point the window may read
+// and move them without locking.
+class SketchLoader {
+public:
+  enum class Step : uint8_t { Scan, Catalog, Graph, Done };
+
+  SketchLoader(const fs::path &root, const fs::path &graphFile,
+               const fs::path &staged, std::set<std::string> skipSchemas,
+               std::set<std::string> skipTypes);
+  // Cancels and waits for the worker
+  ~SketchLoader();
+  SketchLoader(const SketchLoader &) = delete;
+  SketchLoader &operator=(const SketchLoader &) = delete;
+
+  // The worker stops at its next check, Reached() stays where it was.
+  void Cancel() { m_Cancel = true; }
+  bool IsCancelled() const { return m_Cancel; }
+  // Step the worker is on; every earlier step has its result ready.
+  Step Reached() const { return m_Reached.load(std::memory_order_acquire); }
+  // The worker stopped on an exception, Reached() stays where it was.
+  // Error() is set before Failed() turns true.
+  bool Failed() const { return m_Failed.load(std::memory_order_acquire); }
+  const std::string &Error() const { return m_Error; }
+
+  CatalogChunk catalog; // ready past Step::Catalog
+  StagedGraph graph;    // ready past Step::Graph
+
+private:
+  void Run();
+
+  fs::path m_Root, m_GraphFile, m_Staged;
+  std::set<std::string> m_SkipSchemas, m_SkipTypes;
+  std::atomic<bool> m_Cancel{false};
+  std::atomic<Step> m_Reached{Step::Scan};
+  std::atomic<bool> m_Failed{false};
+  std::string m_Error;
+  std::thread m_Thread;
+};
+
+} // namespace ModuleUI
+
+#endif // SKETCH_LOADER_MAIN_SKETCH_HPP
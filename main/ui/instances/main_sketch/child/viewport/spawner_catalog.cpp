@@ -0,0 +1,217 @@
+#include "spawner_catalog.hpp"
+
+#include <algorithm>
+#include <cctype>
+
+namespace ModuleUI {
+
+namespace {
+
+constexpr uint32_t Gram(unsigned char a, unsigned char b, unsigned char c) {
+  return (uint32_t(a) << 16) | (uint32_t(b) << 8) | uint32_t(c);
+}
+
+template <typename F> void ForEachWord(const std::string &folded, F &&fn) {
+  size_t start = 0;
+  while (start < folded.size()) {
+    size_t end = folded.find(' ', start);
+    if (end == std::string::npos)
+      end = folded.size();
+    if (end > start)
+      fn(folded.data() + start, end - start);
+    start = end + 1;
+  }
+}
+
+bool StartsWith(const std::string &s, const std::string &prefix) {
+  return s.size() >= prefix.size() && s.compare(0, prefix.size(), prefix) == 0;
+}
+
+} // namespace
+
+std::string SpawnerCatalog::Fold(const std::string &text) {
+  std::string out;
+  out.reserve(text.size());
+  for (unsigned char c : text) {
+    if (std::isalnum(c) || c >= 0x80) {
+      out.push_back(static_cast<char>(std::tolower(c)));
+    } else if (!out.empty() && out.back() != ' ') {
+      out.push_back(' ');
+    }
+  }
+  if (!out.empty() && out.back() == ' ')
+    out.pop_back();
+  return out;
+}
+
+// Per word: the one and two letter prefix keys (' ', c, 0) and (' ', c, d)
+// for short queries, then every trigram inside the word.
+void SpawnerCatalog::EntryGrams(const std::string &folded,
+                                std::vector<uint32_t> &out) {
+  out.clear();
+  ForEachWord(folded, [&](const char *w, size_t n) {
+    out.push_back(Gram(' ', w[0], 0));
+    out.push_back(Gram(' ', w[0], n > 1 ? w[1] : 0));
+    for (size_t i = 0; i + 2 < n; ++i)
+      out.push_back(Gram(w[i], w[i + 1], w[i + 2]));
+  });
+  std::sort(out.begin(), out.end());
+  out.erase(std::unique(out.begin(), out.end()), out.end());
+}
+
+// Query words of one or two characters can only be word prefixes, longer
+// ones match anywhere.
+void SpawnerCatalog::QueryGrams(const std::string &folded,
+                                std::vector<uint32_t> &out) {
+  out.clear();
+  ForEachWord(folded, [&](const char *w, size_t n) {
+    if (n == 1) {
+      out.push_back(Gram(' ', w[0], 0));
+    } else if (n == 2) {
+      out.push_back(Gram(' ', w[0], w[1]));
+    } else {
+      for (size_t i = 0; i + 2 < n; ++i)
+        out.push_back(Gram(w[i], w[i + 1], w[i + 2]));
+    }
+  });
+  std::sort(out.begin(), out.end());
+  out.erase(std::unique(out.begin(), out.end()), out.end());
+}
+
+void SpawnerCatalog::Index(uint32_t entry) {
+  std::vector<uint32_t> grams;
+  EntryGrams(m_Entries[entry].text, grams);
+  for (uint32_t g : grams)
+    m_Postings[g].push_back(entry);
+}
+
+void SpawnerCatalog::Unindex(uint32_t entry) {
+  std::vector<uint32_t> grams;
+  EntryGrams(m_Entries[entry].text, grams);
+  for (uint32_t g : grams) {
+    auto it = m_Postings.find(g);
+    if (it == m_Postings.end())
+      continue;
+    auto &list = it->second;
+    auto pos = std::find(list.begin(), list.end(), entry);
+    if (pos != list.end()) {
+      *pos = list.back();
+      list.pop_back();
+    }
+    if (list.empty())
+      m_Postings.erase(it);
+  }
+}
+
+bool SpawnerCatalog::Upsert(const SchemaInfo &schema) {
+  Entry e;
+  e.schema_id = schema.id;
+  e.name = schema.name;
+  e.proper_name = schema.proper_name;
+  e.description = schema.description;
+  e.category = schema.kind;
+  e.text = Fold(schema.name + " " + schema.proper_name + " " +
+                schema.description + " " + schema.kind + " " + schema.id);
+  e.name_key = Fold(schema.name);
+  e.proper_key = Fold(schema.proper_name);
+
+  auto it = m_ById.find(schema.id);
+  if (it != m_ById.end()) {
+    Entry &current = m_Entries[it->second];
+    if (current.text == e.text && current.name == e.name &&
+        current.proper_name == e.proper_name &&
+        current.description == e.description)
+      return false;
+    Unindex(it->second);
+    current = std::move(e);
+    Index(it->second);
+    return false;
+  }
+
+  uint32_t idx = static_cast<uint32_t>(m_Entries.size());
+  m_Entries.push_back(std::move(e));
+  m_ById.emplace(schema.id, idx);
+  Index(idx);
+  return true;
+}
+
+const SpawnerCatalog::Entry *
+SpawnerCatalog::Find(const std::string &schema_id) const {
+  auto it = m_ById.find(schema_id);
+  return it == m_ById.end() ? nullptr : &m_Entries[it->second];
+}
+
+int SpawnerCatalog::Score(const Entry &e, const std::string &query) {
+  int score = 0;
+  if (e.name_key == query || e.proper_key == query) {
+    score = 1000;
+  } else if (StartsWith(e.name_key, query) ||
+             StartsWith(e.proper_key, query)) {
+    score = 600;
+  } else {
+    size_t inName = e.name_key.find(query);
+    size_t inProper = e.proper_key.find(query);
+    if (inName != std::string::npos || inProper != std::string::npos) {
+      score = 300;
+      if ((inName != std::string::npos && e.name_key[inName - 1] == ' ') ||
+          (inProper != std::string::npos && e.proper_key[inProper - 1] == ' '))
+        score += 100;
+    } else if (e.text.find(query) != std::string::npos) {
+      score = 100;
+    }
+  }
+  // Shorter titles first among equals
+  return score - static_cast<int>(std::min<size_t>(e.name_key.size(), 64)) / 4;
+}
+
+std::vector<SpawnerCatalog::Hit>
+SpawnerCatalog::Search(const std::string &query, size_t limit) const {
+  std::vector<Hit> hits;
+  const std::string q = Fold(query);
+
+  auto byScore = [this](const Hit &a, const Hit &b) {
+    if (a.score != b.score)
+      return a.score > b.score;
+    return m_Entries[a.entry].name < m_Entries[b.entry].name;
+  };
+
+  if (q.empty()) {
+    for (const auto &kv : m_ById)
+      hits.push_back({kv.second, 0});
+  } else {
+    std::vector<uint32_t> grams;
+    QueryGrams(q, grams);
+    if (grams.empty())
+      return hits;
+
+    m_Counts.resize(m_Entries.size(), 0);
+    std::vector<uint32_t> touched;
+    for (uint32_t g : grams) {
+      auto it = m_Postings.find(g);
+      if (it == m_Postings.end())
+        continue;
+      for (uint32_t e : it->second)
+        if (m_Counts[e]++ == 0)
+          touched.push_back(e);
+    }
+
+    // About a quarter of the query keys may miss, so a typo still finds its
+    // entry; exact matches rank above through Score().
+    const size_t need = grams.size() - (grams.size() + 2) / 4;
+    for (uint32_t e : touched) {
+      if (m_Counts[e] >= need)
+        hits.push_back({e, Score(m_Entries[e], q) + 4 * m_Counts[e]});
+      m_Counts[e] = 0;
+    }
+  }
+
+  if (hits.size() > limit) {
+    std::partial_sort(hits.begin(), hits.begin() + limit, hits.end(), byScore);
+    hits.resize(limit);
+  } else {
+    std::sort(hits.begin(), hits.end(), byScore);
+  }
+  return hits;
+}
+
+} // namespace ModuleUI
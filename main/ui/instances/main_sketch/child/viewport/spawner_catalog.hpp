@@ -0,0 +1,68 @@
+#pragma once
+#include "./schema_types.hpp"
+
+#include <cstdint>
+#include <string>
+#include <unordered_map>
+#include <vector>
+
+#ifndef SPAWNER_CATALOG_MAIN_SKETCH_HPP
+#define SPAWNER_CATALOG_MAIN_SKETCH_HPP
+
+namespace ModuleUI {
+
+// Searchable list of spawnable schemas, one entry per schema id. Name,
+// proper name, description and category are folded into a lowercase text
+// indexed by trigrams (words are padded with a leading space so short
+// queries match word prefixes). A search only scores the entries sharing
+// enough trigrams with the query instead of scanning the whole library.
+class SpawnerCatalog {
+public:
+  struct Entry {
+    std::string schema_id;
+    std::string name;
+    std::string proper_name;
+    std::string description;
+    std::string category;
+    std::string text;       // folded search text, all fields
+    std::string name_key;   // folded name
+    std::string proper_key; // folded proper name
+  };
+
+  struct Hit {
+    uint32_t entry;
+    int score;
+  };
+
+  // Adds or updates the entry of `schema`. Returns true if the id was not
+  // in the catalog before.
+  bool Upsert(const SchemaInfo &schema);
+
+  const Entry *Find(const std::string &schema_id) const;
+  const Entry &At(uint32_t entry) const { return m_Entries[entry]; }
+  size_t Size() const { return m_ById.size(); }
+
+  // Best `limit` entries for `query`, highest score first. An empty query
+  // lists entries by name.
+  std::vector<Hit> Search(const std::string &query, size_t limit) const;
+
+private:
+  static std::string Fold(const std::string &text);
+  static void EntryGrams(const std::string &folded, std::vector<uint32_t> &out);
+  static void QueryGrams(const std::string &folded, std::vector<uint32_t> &out);
+  static int Score(const Entry &e, const std::string &query);
+
+  void Index(uint32_t entry);
+  void Unindex(uint32_t entry);
+
+  std::vector<Entry> m_Entries;
+  std::unordered_map<std::string, uint32_t> m_ById;
+  std::unordered_map<uint32_t, std::vector<uint32_t>> m_Postings;
+
+  // Scratch for Search(), sized with m_Entries
+  mutable std::vector<uint16_t> m_Counts;
+};
+
+} // namespace ModuleUI
+
+#endif // SPAWNER_CATALOG_MAIN_SKETCH_HPP
@@ -0,0 +1,205 @@
+#include "state_machine.hpp"
+
+#include <algorithm>
+#include <sstream>
+#include <unordered_map>
+
+namespace ModuleUI {
+
+std::vector<std::string> StateMachineInfo::Events() const {
+  std::vector<std::string> events;
+  for (const auto &t : transitions)
+    if (!t.when.empty() &&
+        std::find(events.begin(), events.end(), t.when) == events.end())
+      events.push_back(t.when);
+  return events;
+}
+
+bool ReadStateMachineFile(const fs::path &file, const std::string &fallbackId,
+                          StateMachineInfo &out, std::string &error) {
+  auto doc = ReadDocument(file);
+  if (!doc || !doc->is_object()) {
+    error = "cannot read " + file.string();
+    return false;
+  }
+  try {
+    StateMachineInfo m;
+    m.id = doc->value("id", fallbackId);
+    m.name = doc->value("name", m.id);
+    m.description = doc->value("description", "");
+
+    std::unordered_map<std::string, uint8_t> index;
+    // States by enumerator, two of them would not compile
+    std::unordered_map<std::string, std::string> enumerators;
+    if (doc->contains("states") && (*doc)["states"].is_array()) {
+      for (const auto &s : (*doc)["states"]) {
+        const std::string name = s.get<std::string>();
+        if (m.states.size() == kMaxMachineStates) {
+          error = m.id + ": more than " + std::to_string(kMaxMachineStates) +
+                  " states";
+          return false;
+        }
+        if (!index.emplace(name, static_cast<uint8_t>(m.states.size()))
+                 .second) {
+          error = m.id + ": duplicate state \"" + name + "\"";
+          return false;
+        }
+        auto e = enumerators.emplace(SanitizeIdentifier(name), name);
+        if (!e.second) {
+          error = m.id + ": states \"" + e.first->second + "\" and \"" +
+                  name + "\" both become " + e.first->first;
+          return false;
+        }
+        m.states.push_back(name);
+      }
+    }
+    if (m.states.empty()) {
+      error = m.id + ": no state";
+      return false;
+    }
+
+    if (doc->contains("transitions") && (*doc)["transitions"].is_array()) {
+      for (const auto &t : (*doc)["transitions"]) {
+        StateMachineInfo::Transition tr;
+        const std::string from = t.value("from", "");
+        const std::string to = t.value("to", "");
+        auto f = index.find(from);
+        auto d = index.find(to);
+        if (f == index.end() || d == index.end()) {
+          error = m.id + ": transition " + from + " -> " + to +
+                  " names an unknown state";
+          return false;
+        }
+        tr.from = f->second;
+        tr.to = d->second;
+        tr.when = t.value("when", "");
+        if (tr.when == "step") {
+          error = m.id + ": \"step\" is the exec input, not an event";
+          return false;
+        }
+        m.transitions.push_back(std::move(tr));
+      }
+    }
+    out = std::move(m);
+    return true;
+  } catch (const std::exception &e) {
+    error = file.string() + ": " + e.what();
+    return false;
+  }
+}
+
+bool WriteStateMachineFile(const fs::path &file, const StateMachineInfo &m,
+                           DocumentFormat format) {
+  json j;
+  j["id"] = m.id;
+  j["name"] = m.name;
+  j["description"] = m.description;
+  j["states"] = m.states;
+  j["transitions"] = json::array();
+  for (const auto &t : m.transitions) {
+    json tj = {{"from", m.states[t.from]}, {"to", m.states[t.to]}};
+    if (!t.when.empty())
+      tj["when"] = t.when;
+    j["transitions"].push_back(std::move(tj));
+  }
+  std::error_code ec;
+  fs::create_directories(file.parent_path(), ec);
+  return WriteDocument(file, j, format, true);
+}
+
+std::string MachineEntryPin(const std::string &state) {
+  return "entered_" + state;
+}
+
+SchemaInfo StateMachineSchema(const StateMachineInfo &m) {
+  SchemaInfo s;
+  s.id = m.id;
+  s.kind = kMachineKind;
+  s.kind_id = SchemaKindFromString(s.kind);
+  s.name = m.name;
+  s.proper_name = m.name;
+  s.name_secondary = std::to_string(m.states.size()) + " states";
+  s.description =
+      m.description.empty() ? "State machine " + m.id : m.description;
+  s.hexcolheader = "#5a3a7a";
+  s.hexcolbg = "def";
+  s.hexcolborder = "def";
+  s.hexcoltext = "#CCCCCC";
+  s.hexcoltextsecondary = "#CCCCCC";
+
+  s.inputs.push_back(MakePinDef("step", "", "exec"));
+  for (const auto &e : m.Events())
+    s.inputs.push_back(MakePinDef(e, e, "bool", false));
+  s.outputs.push_back(MakePinDef("then", "", "exec"));
+  for (const auto &state : m.states)
+    s.outputs.push_back(MakePinDef(MachineEntryPin(state), state, "exec"));
+  s.outputs.push_back(MakePinDef("state", "State", "int"));
+  return s;
+}
+
+std::string MachineStateName(const StateMachineInfo &m, size_t state) {
+  return SanitizeIdentifier("sm_" + m.id + "_" + m.states[state]);
+}
+
+size_t FindStateClash(const StateMachineInfo &m, const std::string &name) {
+  const std::string enumerator = SanitizeIdentifier(name);
+  for (size_t s = 0; s < m.states.size(); ++s)
+    if (SanitizeIdentifier(m.states[s]) == enumerator)
+      return s;
+  return m.states.size();
+}
+
+std::string StateMachineDefinition(const StateMachineInfo &m) {
+  const std::vector<std::string> events = m.Events();
+  auto eventIndex = [&](const std::string &e) {
+    return std::find(events.begin(), events.end(), e) - events.begin();
+  };
+
+  std::ostringstream out;
+  out << "// ---- State machine " << m.id << ": " << m.states.size()
+      << " states, " << m.transitions.size() << " transitions ----\n";
+  out << "enum : uint8_t {\n";
+  for (size_t s = 0; s < m.states.size(); ++s)
+    out << "    " << MachineStateName(m, s) << " = " << s << ",\n";
+  out << "};\n";
+  out << "static uint8_t " << SanitizeIdentifier("sm_" + m.id + "_step")
+      << "(uint8_t s";
+  for (size_t e = 0; e < events.size(); ++e)
+    out << ", bool e" << e;
+  out << ") {\n";
+  out << "    switch (s) {\n";
+  for (size_t s = 0; s < m.states.size(); ++s) {
+    bool any = false, always = false;
+    for (const auto &t : m.transitions) {
+      if (t.from != s)
+        continue;
+      if (!any)
+        out << "    case " << MachineStateName(m, s) << ":\n";
+      any = true;
+      if (t.when.empty()) {
+        out << "        return " << MachineStateName(m, t.to) << ";\n";
+        always = true; // later transitions of this state are unreachable
+        break;
+      }
+      out << "        if (e" << eventIndex(t.when) << ")\n";
+      out << "            return " << MachineStateName(m, t.to) << ";\n";
+    }
+    if (any && !always)
+      out << "        break;\n";
+  }
+  out << "    }\n";
+  out << "    return s;\n";
+  out << "}\n\n";
+  return out.str();
+}
+
+std::string
+MachineStepCall(const StateMachineInfo &m, const std::string &state,
+                const std::function<std::string(const std::string &)> &event) {
+  std::string call = SanitizeIdentifier("sm_" + m.id + "_step") + "(" + state;
+  for (const auto &e : m.Events())
+    call += ", " + event(e);
+  return call + ")";
+}
+
+} // namespace ModuleUI
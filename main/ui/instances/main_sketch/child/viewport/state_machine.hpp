@@ -0,0 +1,81 @@
+#pragma once
+#include "../../../../../../lib/vortex/main/include/vortex.h"
+#include "./document_format.hpp"
+#include "./schema_types.hpp"
+
+#include <cstdint>
+#include <functional>
+#include <string>
+#include <vector>
+
+#ifndef STATE_MACHINE_MAIN_SKETCH_HPP
+#define STATE_MACHINE_MAIN_SKETCH_HPP
+
+namespace ModuleUI {
+
+// State machines are stored in machines/<id>/machine.json:
+//   { "id": "door", "name": "Door",
+//     "states": ["closed", "opening", "open"],
+//     "transitions": [ { "from": "closed", "to": "opening", "when": "button" },
+//                      { "from": "opening", "to": "open", "when": "done" } ] }
+// The first state is the initial one. Each machine is a node type of kind
+// "machine" named after its id:
+//   inputs  step (exec), one bool per distinct "when" event
+//   outputs then (exec, after every step), entered_<state> (exec, once per
+//           entry into that state), state (int, index in "states")
+// A step tries the transitions leaving the current state in file order and
+// takes the first whose event is true (a transition without "when" always
+// fires); at most one transition per step. The transpiler lowers the
+// machine to a uint8_t state per instance and a switch over the states,
+// which compilers turn into a jump table: a step costs the same whatever
+// the number of states, and the code grows linearly with the transitions.
+struct StateMachineInfo {
+  struct Transition {
+    uint8_t from = 0;
+    uint8_t to = 0;
+    std::string when; // event, empty for an unconditional transition
+  };
+
+  std::string id;
+  std::string name;
+  std::string description;
+  std::vector<std::string> states;
+  std::vector<Transition> transitions;
+
+  // Distinct events, in order of first use.
+  std::vector<std::string> Events() const;
+};
+
+constexpr size_t kMaxMachineStates = 255;
+constexpr const char *kMachineKind = "machine";
+
+// False with `error` set on unreadable or inconsistent files (unknown
+// state in a transition, duplicate state or enumerator, too many states).
+bool ReadStateMachineFile(const fs::path &file, const std::string &fallbackId,
+                          StateMachineInfo &out, std::string &error);
+bool WriteStateMachineFile(const fs::path &file, const StateMachineInfo &m,
+                           DocumentFormat format);
+
+// Node type of the machine.
+SchemaInfo StateMachineSchema(const StateMachineInfo &m);
+// Output pin fired on entry into `state`.
+std::string MachineEntryPin(const std::string &state);
+
+// Enumerated states and the sm_<id>_step() dispatcher, emitted once per
+// main.cpp for each machine used by the graph.
+std::string StateMachineDefinition(const StateMachineInfo &m);
+// Name of the enumerator of `state` (an index in m.states).
+std::string MachineStateName(const StateMachineInfo &m, size_t state);
+// State of `m` whose enumerator a state called `name` would also get (names
+// differing only in characters an identifier cannot hold), m.states.size()
+// if there is none.
+size_t FindStateClash(const StateMachineInfo &m, const std::string &name);
+// "sm_<id>_step(<state>, <events...>)", `event` maps an event to the
+// variable holding it.
+std::string
+MachineStepCall(const StateMachineInfo &m, const std::string &state,
+                const std::function<std::string(const std::string &)> &event);
+
+} // namespace ModuleUI
+
+#endif // STATE_MACHINE_MAIN_SKETCH_HPP
@@ -0,0 +1,189 @@
+#include "subgraph.hpp"
+
+#include <iostream>
+#include <unordered_set>
+
+namespace ModuleUI {
+
+namespace {
+
+json PinToJson(const SubgraphPin &p) {
+  return {{"key", p.key},
+          {"type", p.type},
+          {"instance", p.instance_id},
+          {"pin", p.pin}};
+}
+
+SubgraphPin PinFromJson(const json &j) {
+  SubgraphPin p;
+  p.key = j.value("key", "");
+  p.type = j.value("type", "");
+  p.instance_id = j.value("instance", "");
+  p.pin = j.value("pin", "");
+  return p;
+}
+
+GraphEndpoint::Pin Forward(const GraphIndex &index, const SubgraphPin &sp,
+                           bool input) {
+  GraphEndpoint::Pin pin{sp.key};
+  const uint32_t member = index.Find(sp.instance_id);
+  if (member == GraphIndex::npos)
+    return pin;
+  const auto &entry = index.nodes[member];
+  pin.pin = entry.FindPin(sp.pin, input);
+  if (pin.pin != GraphIndex::npos)
+    pin.node = member;
+  return pin;
+}
+
+} // namespace
+
+json NodeInstanceToJson(const Cherry::NodeSystem::NodeInstance &ni) {
+  return {{"TypeID", ni.TypeID},
+          {"InstanceID", ni.InstanceID},
+          {"Position", {ni.Position.x, ni.Position.y}},
+          {"Size", {ni.Size.x, ni.Size.y}},
+          {"Datas", ni.Datas}};
+}
+
+Cherry::NodeSystem::NodeInstance NodeInstanceFromJson(const json &j) {
+  Cherry::NodeSystem::NodeInstance ni;
+  ni.TypeID = j.value("TypeID", "");
+  ni.InstanceID = j.value("InstanceID", "");
+  if (j.contains("Position") && j["Position"].size() == 2)
+    ni.Position = {j["Position"][0].get<float>(),
+                   j["Position"][1].get<float>()};
+  if (j.contains("Size") && j["Size"].size() == 2)
+    ni.Size = {j["Size"][0].get<float>(), j["Size"][1].get<float>()};
+  ni.Datas = j.contains("Datas") ? j["Datas"] : json::object();
+  return ni;
+}
+
+json Subgraph::ToJson() const {
+  json j;
+  j["label"] = label;
+
+  j["nodes"] = json::array();
+  for (const auto &ni : nodes)
+    j["nodes"].push_back(NodeInstanceToJson(ni));
+
+  j["inputs"] = json::array();
+  for (const auto &p : inputs)
+    j["inputs"].push_back(PinToJson(p));
+  j["outputs"] = json::array();
+  for (const auto &p : outputs)
+    j["outputs"].push_back(PinToJson(p));
+
+  j["links"] = json::array();
+  for (const auto &l : links)
+    j["links"].push_back({l.src_instance, l.src_pin, l.dst_instance,
+                          l.dst_pin});
+  return j;
+}
+
+std::optional<Subgraph> Subgraph::FromJson(const json &j) {
+  if (!j.is_object() || !j.contains("nodes") || !j["nodes"].is_array())
+    return std::nullopt;
+
+  try {
+    Subgraph g;
+    g.label = j.value("label", "");
+
+    for (const auto &n : j["nodes"]) {
+      Cherry::NodeSystem::NodeInstance ni = NodeInstanceFromJson(n);
+      if (!ni.TypeID.empty() && !ni.InstanceID.empty())
+        g.nodes.push_back(std::move(ni));
+    }
+
+    if (j.contains("inputs"))
+      for (const auto &p : j["inputs"])
+        g.inputs.push_back(PinFromJson(p));
+    if (j.contains("outputs"))
+      for (const auto &p : j["outputs"])
+        g.outputs.push_back(PinFromJson(p));
+
+    // Links crossing the boundary are drawn on the group pins, a record
+    // still holding one would replay it a second time.
+    std::unordered_set<std::string> members;
+    for (const auto &ni : g.nodes)
+      members.insert(ni.InstanceID);
+    if (j.contains("links"))
+      for (const auto &l : j["links"])
+        if (l.is_array() && l.size() == 4 &&
+            members.count(l[0].get<std::string>()) &&
+            members.count(l[2].get<std::string>()))
+          g.links.push_back({l[0].get<std::string>(), l[1].get<std::string>(),
+                             l[2].get<std::string>(),
+                             l[3].get<std::string>()});
+    return g;
+  } catch (const std::exception &e) {
+    std::cerr << "Subgraph::FromJson: " << e.what() << std::endl;
+    return std::nullopt;
+  }
+}
+
+const SubgraphPin *Subgraph::FindPin(const std::string &key,
+                                     bool input) const {
+  for (const auto &p : input ? inputs : outputs)
+    if (p.key == key)
+      return &p;
+  return nullptr;
+}
+
+GraphEndpoint GraphEndpoint::ForNode(const GraphIndex &index, uint32_t node) {
+  const auto &entry = index.nodes[node];
+  GraphEndpoint e;
+  e.instance_id = entry.instance_id;
+  for (uint32_t p = 0; p < entry.inputs.size(); ++p)
+    e.inputs.push_back({entry.inputs[p].key, node, p});
+  for (uint32_t p = 0; p < entry.outputs.size(); ++p)
+    e.outputs.push_back({entry.outputs[p].key, node, p});
+  return e;
+}
+
+GraphEndpoint GraphEndpoint::ForGroup(const GraphIndex &index,
+                                      const std::string &instance_id,
+                                      const Subgraph &group) {
+  GraphEndpoint e;
+  e.instance_id = instance_id;
+  for (const auto &p : group.inputs)
+    e.inputs.push_back(Forward(index, p, true));
+  for (const auto &p : group.outputs)
+    e.outputs.push_back(Forward(index, p, false));
+  return e;
+}
+
+LinkResolver::LinkResolver(GraphIndex &index,
+                           std::vector<GraphEndpoint> endpoints)
+    : m_Index(index), m_Endpoints(std::move(endpoints)) {
+  m_ByInstance.reserve(m_Endpoints.size());
+  for (uint32_t i = 0; i < m_Endpoints.size(); ++i)
+    m_ByInstance.emplace(m_Endpoints[i].instance_id, i);
+}
+
+const GraphEndpoint::Pin *LinkResolver::Find(const std::string &instance,
+                                             const std::string &key,
+                                             bool input) const {
+  auto it = m_ByInstance.find(instance);
+  if (it == m_ByInstance.end())
+    return nullptr;
+  const auto &e = m_Endpoints[it->second];
+  for (const auto &pin : input ? e.inputs : e.outputs)
+    if (pin.key == key)
+      return pin.node == GraphIndex::npos ? nullptr : &pin;
+  return nullptr;
+}
+
+bool LinkResolver::Add(const std::string &srcInstance,
+                       const std::string &srcPin,
+                       const std::string &dstInstance,
+                       const std::string &dstPin) {
+  const GraphEndpoint::Pin *out = Find(srcInstance, srcPin, false);
+  const GraphEndpoint::Pin *in = Find(dstInstance, dstPin, true);
+  if (!out || !in)
+    return false;
+  m_Index.links.push_back({out->node, out->pin, in->node, in->pin});
+  return true;
+}
+
+} // namespace ModuleUI
@@ -0,0 +1,105 @@
+#pragma once
+#include "../../../../../../lib/vortex/main/include/vortex.h"
+#include "../../../../../../lib/vortex/main/include/vortex_internals.h"
+#include "./graph_index.hpp"
+
+#include <optional>
+#include <string>
+#include <unordered_map>
+#include <vector>
+
+#ifndef SUBGRAPH_MAIN_SKETCH_HPP
+#define SUBGRAPH_MAIN_SKETCH_HPP
+
+namespace ModuleUI {
+
+// Group nodes get a schema of their own (their pins depend on what was
+// collapsed), all under this prefix.
+constexpr const char *kGroupSchemaPrefix = "efusion_group_";
+
+inline bool IsGroupTypeId(const std::string &type_id) {
+  return type_id.rfind(kGroupSchemaPrefix, 0) == 0;
+}
+
+// Plain json form of a node instance, as stored in subgraphs and journals.
+json NodeInstanceToJson(const Cherry::NodeSystem::NodeInstance &ni);
+Cherry::NodeSystem::NodeInstance NodeInstanceFromJson(const json &j);
+
+// Pin of a group node, forwarding to a pin of one of its members.
+struct SubgraphPin {
+  std::string key; // pin name on the group node
+  std::string type;
+  std::string instance_id;
+  std::string pin; // pin key on the member
+};
+
+// Link between two members, recorded when the group was collapsed.
+struct SubgraphLink {
+  std::string src_instance;
+  std::string src_pin;
+  std::string dst_instance;
+  std::string dst_pin;
+};
+
+// Nodes collapsed into a group node. It is stored in the Datas of the group
+// node instance under "subgraph", so it is saved with the sketch graph.
+// Members are not instantiated in the node engine until the group is
+// expanded again.
+struct Subgraph {
+  std::string label;
+  std::vector<Cherry::NodeSystem::NodeInstance> nodes;
+  std::vector<SubgraphPin> inputs;
+  std::vector<SubgraphPin> outputs;
+  // Links between members. Links crossing the boundary are drawn on the
+  // group's pins while it is collapsed.
+  std::vector<SubgraphLink> links;
+
+  // Group pin named `key`, nullptr if there is none.
+  const SubgraphPin *FindPin(const std::string &key, bool input) const;
+
+  json ToJson() const;
+  static std::optional<Subgraph> FromJson(const json &j);
+};
+
+// A node as the node graph sees it: its pin keys, each resolved to the
+// index slot it stands for. Group pins forward to their member pin, npos
+// when that member or pin is not in the index.
+struct GraphEndpoint {
+  struct Pin {
+    std::string key;
+    uint32_t node = GraphIndex::npos;
+    uint32_t pin = GraphIndex::npos;
+  };
+  std::string instance_id;
+  std::vector<Pin> inputs;
+  std::vector<Pin> outputs;
+
+  static GraphEndpoint ForNode(const GraphIndex &index, uint32_t node);
+  // `group`'s members must already be in `index`.
+  static GraphEndpoint ForGroup(const GraphIndex &index,
+                                const std::string &instance_id,
+                                const Subgraph &group);
+};
+
+// Turns links given as the node graph draws them (instance id and pin key
+// on each end) into index.links. A link on a group pin lands on the member
+// pin it forwards to; a link with an end outside the endpoints is dropped.
+class LinkResolver {
+public:
+  LinkResolver(GraphIndex &index, std::vector<GraphEndpoint> endpoints);
+
+  bool Add(const std::string &srcInstance, const std::string &srcPin,
+           const std::string &dstInstance, const std::string &dstPin);
+
+private:
+  const GraphEndpoint::Pin *Find(const std::string &instance,
+                                 const std::string &key, bool input) const;
+
+  GraphIndex &m_Index;
+  std::vector<GraphEndpoint> m_Endpoints;
+  std::unordered_map<std::string, uint32_t> m_ByInstance;
+};
+
+} // namespace ModuleUI
+
+#endif // SUBGRAPH_MAIN_SKETCH_HPP
@@ -0,0 +1,145 @@
+#include "task_partition.hpp"
+
+#include <unordered_map>
+
+namespace ModuleUI {
+
+std::string TaskRuntimePrelude() {
+  return R"efx(// ---- Tasks: FreeRTOS on ESP32, threads in the simulator, otherwise
+// cooperative from loop() ----
+#if defined(EFUSION_SIM)
+#define EFX_TASKS_THREAD 1
+#include <atomic>
+#include <chrono>
+#include <thread>
+#elif defined(ESP32)
+#define EFX_TASKS_FREERTOS 1
+#include <atomic>
+#ifndef EFX_TASK_STACK
+#define EFX_TASK_STACK 4096
+#endif
+#else
+#define EFX_TASKS_COOPERATIVE 1
+#endif
+
+#ifdef EFX_TASKS_COOPERATIVE
+template <typename T> struct efx_mailbox {
+    T value;
+    void write(const T &v) { value = v; }
+    const T &read() { return value; }
+};
+#else
+// Latest-value triple buffer between one writer task and one reader task.
+// Neither side ever blocks; the reader sees the last complete write.
+template <typename T> struct efx_mailbox {
+    T slot[3];
+    std::atomic<uint8_t> middle{1}; // slot index, bit 2 set when fresh
+    uint8_t back = 0;               // writer's slot
+    uint8_t front = 2;              // reader's slot
+    void write(const T &v) {
+        slot[back] = v;
+        back = middle.exchange(back | 4, std::memory_order_acq_rel) & 3;
+    }
+    const T &read() {
+        if (middle.load(std::memory_order_relaxed) & 4)
+            front = middle.exchange(front, std::memory_order_acq_rel) & 3;
+        return slot[front];
+    }
+};
+#endif
+
+)efx";
+}
+
+uint32_t TaskPartition::MailboxFor(uint32_t srcNode, uint32_t srcPin,
+                                   uint32_t reader) const {
+  for (uint32_t i = 0; i < mailboxes.size(); ++i) {
+    const auto &m = mailboxes[i];
+    if (m.src_node == srcNode && m.src_pin == srcPin && m.reader == reader)
+      return i;
+  }
+  return GraphIndex::npos;
+}
+
+TaskPartition
+PartitionTasks(const GraphIndex &index,
+               const std::function<bool(uint32_t)> &sharesState) {
+  TaskPartition part;
+  const uint32_t n = static_cast<uint32_t>(index.nodes.size());
+  part.owner.assign(n, TaskPartition::kNone);
+
+  for (uint32_t i = 0; i < n; ++i) {
+    const std::string &type = index.nodes[i].type_id;
+    if (type == "loop")
+      part.tasks.insert(part.tasks.begin(), {i, true});
+    else if (type == "task")
+      part.tasks.push_back({i, false});
+  }
+
+  // Walk each chain: exec successors, then the pure nodes they pull.
+  std::vector<uint32_t> visited(n, TaskPartition::kNone);
+  std::vector<uint32_t> stack;
+  for (uint32_t t = 0; t < part.tasks.size(); ++t) {
+    stack.assign(1, part.tasks[t].root);
+    visited[part.tasks[t].root] = t;
+    while (!stack.empty()) {
+      const uint32_t node = stack.back();
+      stack.pop_back();
+
+      uint32_t &owner = part.owner[node];
+      if (owner == TaskPartition::kNone) {
+        owner = t;
+      } else if (owner != t) {
+        if (owner != TaskPartition::kShared)
+          part.conflicts.push_back({node, owner, t, false});
+        owner = TaskPartition::kShared;
+      }
+
+      auto visit = [&](uint32_t next) {
+        if (visited[next] != t) {
+          visited[next] = t;
+          stack.push_back(next);
+        }
+      };
+      index.ForEachOutLink(node, [&](const GraphIndex::Link &l) {
+        if (index.nodes[node].outputs[l.src_pin].exec &&
+            index.nodes[l.dst_node].inputs[l.dst_pin].exec)
+          visit(l.dst_node);
+      });
+      index.ForEachInLink(node, [&](const GraphIndex::Link &l) {
+        if (!index.nodes[node].inputs[l.dst_pin].exec &&
+            index.nodes[l.src_node].IsPure())
+          visit(l.src_node);
+      });
+    }
+  }
+
+  // Instances of one schema in different tasks share its port globals
+  if (sharesState) {
+    std::unordered_map<std::string, uint32_t> firstTask; // by schema
+    for (uint32_t i = 0; i < n; ++i) {
+      const uint32_t owner = part.owner[i];
+      if (owner >= part.tasks.size() || !sharesState(i))
+        continue;
+      auto [it, added] = firstTask.emplace(index.nodes[i].type_id, owner);
+      if (!added && it->second != owner)
+        part.conflicts.push_back({i, it->second, owner, true});
+    }
+  }
+
+  // Data read by a task from a node another task runs
+  for (const auto &l : index.links) {
+    if (index.nodes[l.dst_node].inputs[l.dst_pin].exec)
+      continue;
+    const uint32_t writer = part.owner[l.src_node];
+    const uint32_t reader = part.owner[l.dst_node];
+    if (writer >= part.tasks.size() || reader >= part.tasks.size() ||
+        writer == reader || index.nodes[l.src_node].IsPure())
+      continue;
+    if (part.MailboxFor(l.src_node, l.src_pin, reader) == GraphIndex::npos)
+      part.mailboxes.push_back({l.src_node, l.src_pin, reader});
+  }
+  return part;
+}
+
+} // namespace ModuleUI
@@ -0,0 +1,78 @@
+#pragma once
+#include "./graph_index.hpp"
+
+#include <cstdint>
+#include <functional>
+#include <string>
+#include <vector>
+
+#ifndef TASK_PARTITION_MAIN_SKETCH_HPP
+#define TASK_PARTITION_MAIN_SKETCH_HPP
+
+namespace ModuleUI {
+
+// Split of the graph into the event chains that run concurrently: the
+// "loop" chain and one chain per "task" node. A node belongs to the chain
+// whose exec links reach it; pure nodes belong to the chain that pulls
+// them. "setup" is not a task, it completes before any task starts.
+//
+// Data crossing from a node of one task to a node of another goes through
+// a mailbox (one per source pin and reading task, single writer, single
+// reader). A node reached by two tasks would have its pin globals written
+// concurrently: such nodes are reported as conflicts and the graph is
+// rejected by validation.
+struct TaskPartition {
+  static constexpr uint32_t kNone = UINT32_MAX;       // runs in no task
+  static constexpr uint32_t kShared = UINT32_MAX - 1; // runs in several
+
+  struct Task {
+    uint32_t root;     // "loop" or "task" node
+    bool loop = false; // runs in Arduino's loop()
+  };
+
+  struct Mailbox {
+    uint32_t src_node;
+    uint32_t src_pin;
+    uint32_t reader; // task index
+  };
+
+  struct Conflict {
+    uint32_t node;
+    uint32_t first;  // task indices
+    uint32_t second;
+    bool schema = false; // shared primitive state rather than the node
+  };
+
+  std::vector<Task> tasks;     // the loop chain first, if any
+  std::vector<uint32_t> owner; // task index per node, or kNone / kShared
+  std::vector<Mailbox> mailboxes;
+  std::vector<Conflict> conflicts;
+
+  // True when at least one "task" node exists; otherwise the sketch is
+  // transpiled as a plain setup()/loop() program.
+  bool HasTasks() const {
+    for (const auto &t : tasks)
+      if (!t.loop)
+        return true;
+    return false;
+  }
+  // Index in `mailboxes`, npos when the link needs none.
+  uint32_t MailboxFor(uint32_t srcNode, uint32_t srcPin,
+                      uint32_t reader) const;
+};
+
+// `sharesState(node)` is true for nodes whose generated code uses globals
+// common to every instance of the schema (skeleton ports); instances of such
+// a schema in two tasks are conflicts too.
+TaskPartition
+PartitionTasks(const GraphIndex &index,
+               const std::function<bool(uint32_t)> &sharesState);
+
+// Backend selection (FreeRTOS on ESP32, std::thread in the host simulator,
+// cooperative scheduling from loop() elsewhere) and the efx_mailbox
+// template, emitted once in a main.cpp with tasks.
+std::string TaskRuntimePrelude();
+
+} // namespace ModuleUI
+
+#endif // TASK_PARTITION_MAIN_SKETCH_HPP
@@ -0,0 +1,534 @@
+#include "telemetry.hpp"
+#include "document_format.hpp"
+
+#include <algorithm>
+#include <cstdio>
+#include <cstring>
+#include <sstream>
+
+#ifndef _WIN32
+#include <cerrno>
+#include <csignal>
+#include <fcntl.h>
+#include <sys/wait.h>
+#include <termios.h>
+#include <unistd.h>
+#endif
+
+namespace ModuleUI {
+
+namespace {
+
+uint8_t Crc8(const uint8_t *p, size_t n) {
+  uint8_t crc = 0;
+  for (size_t i = 0; i < n; ++i) {
+    crc ^= p[i];
+    for (int b = 0; b < 8; ++b)
+      crc = (crc & 0x80) ? static_cast<uint8_t>((crc << 1) ^ 0x07)
+                         : static_cast<uint8_t>(crc << 1);
+  }
+  return crc;
+}
+
+bool ReadVarint(const uint8_t *&p, const uint8_t *end, uint32_t &v) {
+  v = 0;
+  for (int shift = 0; p < end && shift < 35; shift += 7) {
+    const uint8_t b = *p++;
+    v |= static_cast<uint32_t>(b & 0x7f) << shift;
+    if (!(b & 0x80))
+      return true;
+  }
+  return false;
+}
+
+uint32_t Unzigzag(uint32_t v) { return (v >> 1) ^ (0u - (v & 1)); }
+
+const char *KindName(TelemetryKind k) {
+  switch (k) {
+  case TelemetryKind::Bool:
+    return "bool";
+  case TelemetryKind::Char:
+    return "char";
+  case TelemetryKind::Float:
+    return "float";
+  case TelemetryKind::Double:
+    return "double";
+  case TelemetryKind::Fixed:
+    return "fixed";
+  default:
+    return "int";
+  }
+}
+
+TelemetryKind KindFromName(const std::string &s) {
+  for (auto k : {TelemetryKind::Bool, TelemetryKind::Char, TelemetryKind::Float,
+                 TelemetryKind::Double, TelemetryKind::Fixed})
+    if (s == KindName(k))
+      return k;
+  return TelemetryKind::Int;
+}
+
+} // namespace
+
+// ---------------------------------------------------------------------------
+// Settings and manifest
+// ---------------------------------------------------------------------------
+
+TelemetrySettings TelemetrySettings::FromJson(const json &j) {
+  TelemetrySettings s;
+  if (!j.is_object())
+    return s;
+  auto number = [&](const char *key, uint32_t fallback, uint32_t lo,
+                    uint32_t hi) {
+    if (!j.contains(key) || !j[key].is_number_unsigned())
+      return fallback;
+    return std::clamp(j[key].get<uint32_t>(), lo, hi);
+  };
+  s.baud = number("baud", s.baud, 300, 4000000);
+  s.period_ms = number("period_ms", s.period_ms, 1, 60000);
+  s.keyframe = number("keyframe", s.keyframe, 1, UINT16_MAX);
+  s.buffer = number("buffer", s.buffer, 32, UINT16_MAX);
+  s.device = j.value("device", "");
+  if (j.contains("watch") && j["watch"].is_array())
+    for (const auto &w : j["watch"])
+      if (w.is_string())
+        s.watch.push_back(w.get<std::string>());
+  return s;
+}
+
+json TelemetrySettings::ToJson() const {
+  return {{"baud", baud},         {"watch", watch},   {"period_ms", period_ms},
+          {"keyframe", keyframe}, {"buffer", buffer}, {"device", device}};
+}
+
+bool TelemetryManifest::Write(const fs::path &file) const {
+  json j;
+  j["baud"] = baud;
+  j["frac_bits"] = frac_bits;
+  j["vars"] = json::array();
+  for (const auto &v : vars)
+    j["vars"].push_back({{"instance", v.instance},
+                         {"pin", v.pin},
+                         {"var", v.var},
+                         {"kind", KindName(v.kind)}});
+  return WriteDocument(file, j, DocumentFormat::Json, true);
+}
+
+bool TelemetryManifest::Read(const fs::path &file, TelemetryManifest &out) {
+  auto doc = ReadDocument(file);
+  if (!doc || !doc->is_object())
+    return false;
+  try {
+    TelemetryManifest m;
+    m.baud = doc->value("baud", m.baud);
+    m.frac_bits = doc->value("frac_bits", m.frac_bits);
+    if (doc->contains("vars") && (*doc)["vars"].is_array())
+      for (const auto &v : (*doc)["vars"])
+        m.vars.push_back({v.value("instance", ""), v.value("pin", ""),
+                          v.value("var", ""),
+                          KindFromName(v.value("kind", "int"))});
+    out = std::move(m);
+    return true;
+  } catch (const std::exception &) {
+    return false;
+  }
+}
+
+// ---------------------------------------------------------------------------
+// Generated runtime
+// ---------------------------------------------------------------------------
+
+std::string TelemetryRuntime(const TelemetrySettings &settings,
+                             const TelemetryManifest &manifest) {
+  const size_t n = manifest.vars.size();
+  const size_t maxFrame = 4 + 6 * n + 1;
+  const size_t ring = std::max<size_t>(settings.buffer, maxFrame);
+
+  std::ostringstream out;
+  out << "// ---- Telemetry: " << n
+      << " watched pin(s), frame format in telemetry.hpp ----\n";
+  out << "#include <string.h>\n";
+  out << "#define EFX_TM_N " << n << "\n";
+  out << "#define EFX_TM_RING " << ring << "\n";
+  out << "#define EFX_TM_PERIOD_MS " << settings.period_ms << "UL\n";
+  out << "#define EFX_TM_KEYFRAME " << settings.keyframe << "\n";
+  out << R"efx(static uint8_t efx_tm_ring[EFX_TM_RING];
+static uint16_t efx_tm_head, efx_tm_used; // read position, bytes queued
+static uint32_t efx_tm_prev[EFX_TM_N];    // values of the last frame queued
+static uint8_t efx_tm_seq;
+static uint16_t efx_tm_samples; // since the last key frame
+static uint16_t efx_tm_dropped; // frames that did not fit in the ring
+static unsigned long efx_tm_due;
+static inline uint32_t efx_tm_raw(bool v) { return v; }
+static inline uint32_t efx_tm_raw(char v) { return (uint32_t)(int32_t)v; }
+static inline uint32_t efx_tm_raw(int v) { return (uint32_t)(int32_t)v; }
+static inline uint32_t efx_tm_raw(long v) { return (uint32_t)(int32_t)v; }
+static inline uint32_t efx_tm_raw(float v) {
+    uint32_t r;
+    memcpy(&r, &v, sizeof(r));
+    return r;
+}
+static inline uint32_t efx_tm_raw(double v) { return efx_tm_raw((float)v); }
+static inline uint32_t efx_tm_zigzag(uint32_t v) {
+    return (v << 1) ^ (0u - (v >> 31));
+}
+static uint8_t efx_tm_varint(uint8_t *p, uint32_t v) {
+    uint8_t n = 0;
+    while (v >= 0x80) {
+        p[n++] = (uint8_t)(v | 0x80);
+        v >>= 7;
+    }
+    p[n++] = (uint8_t)v;
+    return n;
+}
+static uint8_t efx_tm_crc8(const uint8_t *p, uint8_t n) {
+    uint8_t crc = 0;
+    while (n--) {
+        crc ^= *p++;
+        for (uint8_t b = 0; b < 8; ++b)
+            crc = (crc & 0x80) ? (uint8_t)((crc << 1) ^ 0x07) : (uint8_t)(crc << 1);
+    }
+    return crc;
+}
+)efx";
+  out << "static void efx_telemetry_sample() {\n";
+  out << "    const uint32_t now[EFX_TM_N] = {";
+  for (size_t i = 0; i < n; ++i)
+    out << (i ? ", " : "") << "efx_tm_raw(" << manifest.vars[i].var << ")";
+  out << "};\n";
+  out << R"efx(    uint8_t f[4 + 6 * EFX_TM_N + 1];
+    uint8_t n = 4;
+    const bool key = efx_tm_samples == 0;
+    if (++efx_tm_samples >= EFX_TM_KEYFRAME)
+        efx_tm_samples = 0;
+    for (uint8_t i = 0; i < EFX_TM_N; ++i) {
+        if (key) {
+            n += efx_tm_varint(f + n, efx_tm_zigzag(now[i]));
+        } else if (now[i] != efx_tm_prev[i]) {
+            n += efx_tm_varint(f + n, i);
+            n += efx_tm_varint(f + n, efx_tm_zigzag(now[i] - efx_tm_prev[i]));
+        }
+    }
+    if (n == 4)
+        return; // nothing changed
+    f[0] = 0xE7;
+    f[1] = efx_tm_seq;
+    f[2] = key ? 'K' : 'D';
+    f[3] = n - 4;
+    f[n] = efx_tm_crc8(f + 1, n - 1);
+    ++n;
+    if (EFX_TM_RING - efx_tm_used < n) {
+        ++efx_tm_dropped;
+        return;
+    }
+    for (uint8_t i = 0; i < n; ++i)
+        efx_tm_ring[(efx_tm_head + efx_tm_used + i) % EFX_TM_RING] = f[i];
+    efx_tm_used += n;
+    memcpy(efx_tm_prev, now, sizeof(now));
+    ++efx_tm_seq;
+}
+// Samples when due, then hands the UART what it takes without blocking.
+static void efx_telemetry_step() {
+    if ((long)(millis() - efx_tm_due) >= 0) {
+        efx_tm_due = millis() + EFX_TM_PERIOD_MS;
+        efx_telemetry_sample();
+    }
+    int room = Serial.availableForWrite();
+    while (room > 0 && efx_tm_used > 0) {
+        uint16_t chunk = EFX_TM_RING - efx_tm_head;
+        if (chunk > efx_tm_used)
+            chunk = efx_tm_used;
+        if (chunk > (uint16_t)room)
+            chunk = (uint16_t)room;
+        Serial.write(efx_tm_ring + efx_tm_head, chunk);
+        efx_tm_head = (efx_tm_head + chunk) % EFX_TM_RING;
+        efx_tm_used -= chunk;
+        room -= chunk;
+    }
+}
+
+)efx";
+  return out.str();
+}
+
+// ---------------------------------------------------------------------------
+// TelemetryDecoder
+// ---------------------------------------------------------------------------
+
+TelemetryDecoder::TelemetryDecoder(TelemetryManifest manifest)
+    : m_Manifest(std::move(manifest)), m_Raw(m_Manifest.vars.size(), 0) {}
+
+size_t TelemetryDecoder::Feed(const uint8_t *data, size_t size) {
+  m_Pending.insert(m_Pending.end(), data, data + size);
+  size_t applied = 0, i = 0;
+  for (;;) {
+    while (i < m_Pending.size() && m_Pending[i] != kTelemetrySync)
+      ++i;
+    if (m_Pending.size() - i < 5)
+      break;
+    const size_t length = m_Pending[i + 3];
+    if (m_Pending.size() - i < 5 + length)
+      break;
+    const uint8_t *f = m_Pending.data() + i;
+    if (Crc8(f + 1, 3 + length) != f[4 + length] ||
+        !Apply(f[1], f[2], f + 4, length)) {
+      // A sync byte inside a payload, or a corrupted frame
+      ++bad_frames;
+      ++i;
+      continue;
+    }
+    ++applied;
+    i += 5 + length;
+  }
+  m_Pending.erase(m_Pending.begin(), m_Pending.begin() + i);
+  return applied;
+}
+
+bool TelemetryDecoder::Apply(uint8_t seq, uint8_t kind, const uint8_t *p,
+                             size_t n) {
+  const uint8_t *end = p + n;
+  std::vector<uint32_t> raw = m_Raw;
+  uint32_t v = 0;
+  if (kind == 'K') {
+    for (auto &r : raw) {
+      if (!ReadVarint(p, end, v))
+        return false;
+      r = Unzigzag(v);
+    }
+  } else if (kind == 'D') {
+    while (p < end) {
+      uint32_t index = 0;
+      if (!ReadVarint(p, end, index) || index >= raw.size() ||
+          !ReadVarint(p, end, v))
+        return false;
+      raw[index] += Unzigzag(v);
+    }
+  } else {
+    return false;
+  }
+  if (p != end)
+    return false;
+
+  if (frames > 0 && seq != static_cast<uint8_t>(m_Seq + 1)) {
+    lost += static_cast<uint8_t>(seq - m_Seq - 1);
+    m_Synced = false;
+  }
+  m_Seq = seq;
+  ++frames;
+  if (kind == 'K')
+    m_Synced = true;
+  if (m_Synced)
+    m_Raw = std::move(raw);
+  return true;
+}
+
+double TelemetryDecoder::Value(size_t var) const {
+  const uint32_t raw = m_Raw[var];
+  switch (m_Manifest.vars[var].kind) {
+  case TelemetryKind::Float:
+  case TelemetryKind::Double: {
+    float f;
+    std::memcpy(&f, &raw, sizeof(f));
+    return f;
+  }
+  case TelemetryKind::Fixed:
+    return static_cast<int32_t>(raw) /
+           static_cast<double>(int64_t(1) << m_Manifest.frac_bits);
+  case TelemetryKind::Bool:
+    return raw ? 1.0 : 0.0;
+  default:
+    return static_cast<int32_t>(raw);
+  }
+}
+
+std::string TelemetryDecoder::Format(size_t var) const {
+  char buf[32];
+  switch (m_Manifest.vars[var].kind) {
+  case TelemetryKind::Bool:
+    return m_Raw[var] ? "true" : "false";
+  case TelemetryKind::Int:
+  case TelemetryKind::Char:
+    std::snprintf(buf, sizeof(buf), "%d", static_cast<int32_t>(m_Raw[var]));
+    return buf;
+  default:
+    std::snprintf(buf, sizeof(buf), "%.4g", Value(var));
+    return buf;
+  }
+}
+
+// ---------------------------------------------------------------------------
+// TelemetryLink
+// ---------------------------------------------------------------------------
+
+#ifndef _WIN32
+
+namespace {
+
+speed_t BaudConstant(uint32_t baud) {
+  switch (baud) {
+  case 9600:
+    return B9600;
+  case 19200:
+    return B19200;
+  case 38400:
+    return B38400;
+  case 57600:
+    return B57600;
+  case 115200:
+    return B115200;
+  case 230400:
+    return B230400;
+#ifdef B460800
+  case 460800:
+    return B460800;
+#endif
+#ifdef B921600
+  case 921600:
+    return B921600;
+#endif
+  default:
+    return B0;
+  }
+}
+
+bool MakeRaw(int fd, speed_t speed, std::string &error) {
+  termios tio;
+  if (::tcgetattr(fd, &tio) != 0) {
+    error = std::strerror(errno);
+    return false;
+  }
+  ::cfmakeraw(&tio);
+  if (speed != B0) {
+    ::cfsetispeed(&tio, speed);
+    ::cfsetospeed(&tio, speed);
+  }
+  if (::tcsetattr(fd, TCSANOW, &tio) != 0) {
+    error = std::strerror(errno);
+    return false;
+  }
+  return true;
+}
+
+} // namespace
+
+bool TelemetryLink::OpenDevice(const std::string &path, uint32_t baud,
+                               std::string &error) {
+  Close();
+  const speed_t speed = BaudConstant(baud);
+  if (speed == B0) {
+    error = "unsupported baud rate " + std::to_string(baud);
+    return false;
+  }
+  m_Fd = ::open(path.c_str(), O_RDONLY | O_NOCTTY | O_NONBLOCK | O_CLOEXEC);
+  if (m_Fd < 0) {
+    error = path + ": " + std::strerror(errno);
+    return false;
+  }
+  if (!MakeRaw(m_Fd, speed, error)) {
+    error = path + ": " + error;
+    Close();
+    return false;
+  }
+  return true;
+}
+
+bool TelemetryLink::OpenPty(std::string &peer, std::string &error) {
+  Close();
+  m_Fd = ::posix_openpt(O_RDWR | O_NOCTTY);
+  if (m_Fd < 0 || ::grantpt(m_Fd) != 0 || ::unlockpt(m_Fd) != 0) {
+    error = std::string("pseudo-terminal: ") + std::strerror(errno);
+    Close();
+    return false;
+  }
+  ::fcntl(m_Fd, F_SETFD, FD_CLOEXEC);
+  ::fcntl(m_Fd, F_SETFL, ::fcntl(m_Fd, F_GETFL) | O_NONBLOCK);
+  const char *name = ::ptsname(m_Fd);
+  m_Peer = name ? ::open(name, O_RDWR | O_NOCTTY | O_CLOEXEC) : -1;
+  // Raw on the terminal side too: no newline translation of the frames
+  if (m_Peer < 0 || !MakeRaw(m_Peer, B0, error)) {
+    error = std::string("pseudo-terminal: ") +
+            (error.empty() ? std::strerror(errno) : error);
+    Close();
+    return false;
+  }
+  peer = name;
+  return true;
+}
+
+bool TelemetryLink::Spawn(const std::vector<std::string> &argv,
+                          std::string &error) {
+  std::vector<char *> args;
+  for (const auto &a : argv)
+    args.push_back(const_cast<char *>(a.c_str()));
+  args.push_back(nullptr);
+  const pid_t pid = ::fork();
+  if (pid < 0) {
+    error = std::string("fork: ") + std::strerror(errno);
+    return false;
+  }
+  if (pid == 0) {
+    ::execv(args[0], args.data());
+    ::_exit(127);
+  }
+  m_Child = pid;
+  return true;
+}
+
+bool TelemetryLink::Read(std::vector<uint8_t> &out) {
+  if (m_Fd < 0)
+    return false;
+  uint8_t buf[4096];
+  for (;;) {
+    const ssize_t n = ::read(m_Fd, buf, sizeof(buf));
+    if (n > 0) {
+      out.insert(out.end(), buf, buf + n);
+      continue;
+    }
+    if (n < 0 && errno == EINTR)
+      continue;
+    if (n < 0 && errno != EAGAIN && errno != EWOULDBLOCK)
+      return false;
+    break;
+  }
+  if (m_Child > 0 && ::waitpid(m_Child, nullptr, WNOHANG) == m_Child) {
+    m_Child = -1;
+    return false;
+  }
+  return true;
+}
+
+void TelemetryLink::Close() {
+  if (m_Child > 0) {
+    ::kill(m_Child, SIGTERM);
+    ::waitpid(m_Child, nullptr, 0);
+    m_Child = -1;
+  }
+  for (int *fd : {&m_Fd, &m_Peer}) {
+    if (*fd >= 0)
+      ::close(*fd);
+    *fd = -1;
+  }
+}
+
+#else
+
+bool TelemetryLink::OpenDevice(const std::string &, uint32_t,
+                               std::string &error) {
+  error = "serial telemetry needs a POSIX host";
+  return false;
+}
+bool TelemetryLink::OpenPty(std::string &, std::string &error) {
+  error = "pseudo-terminals need a POSIX host";
+  return false;
+}
+bool TelemetryLink::Spawn(const std::vector<std::string> &,
+                          std::string &error) {
+  error = "not supported on this host";
+  return false;
+}
+bool TelemetryLink::Read(std::vector<uint8_t> &) { return false; }
+void TelemetryLink::Close() {}
+
+#endif
+
+} // namespace ModuleUI
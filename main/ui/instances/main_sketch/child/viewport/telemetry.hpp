@@ -0,0 +1,142 @@
+#pragma once
+#include "../../../../../../lib/vortex/main/include/vortex.h"
+
+#include <cstdint>
+#include <string>
+#include <vector>
+
+#ifndef TELEMETRY_MAIN_SKETCH_HPP
+#define TELEMETRY_MAIN_SKETCH_HPP
+
+namespace ModuleUI {
+
+// Live values of watched pins, streamed by the sketch over its serial port.
+//
+// Settings, "telemetry" object of the sketch's main_sketch.json:
+//   "baud":      serial speed, also the generated Serial.begin()'s
+//                (default 115200)
+//   "watch":     ["<instance>.<pin>", ...] data outputs to stream; no
+//                telemetry code is generated when empty
+//   "period_ms": sampling period (default 20)
+//   "keyframe":  samples between two key frames (default 16)
+//   "buffer":    bytes of the on-board frame ring buffer (default 128)
+//   "device":    serial device the editor reads; empty to run the host
+//                simulator on a pseudo-terminal instead
+//
+// Wire format, one frame per sample:
+//   0xE7 | seq | kind | length | payload[length] | crc8(seq .. payload)
+// Every value travels as its 32 raw bits (two's complement for integers
+// and efx_q, IEEE bits for float; double is narrowed to float). A key
+// frame (kind 'K') holds every value in watch order as a zigzag LEB128
+// varint; a delta frame ('D') holds (varint index, zigzag varint of the
+// difference with the previous frame) for the values that changed, and is
+// not sent when none did. seq counts frames, so a decoder that misses one
+// (line noise, a late start) waits for the next key frame.
+//
+// loop() samples into a ring buffer and writes out only what
+// Serial.availableForWrite() accepts: telemetry never blocks the sketch.
+// A frame that does not fit in the ring is dropped whole; the next delta
+// is taken against the last frame sent, so dropping is invisible to the
+// decoder.
+struct TelemetrySettings {
+  uint32_t baud = 115200;
+  std::vector<std::string> watch;
+  uint32_t period_ms = 20;
+  uint32_t keyframe = 16;
+  uint32_t buffer = 128;
+  std::string device;
+
+  bool Enabled() const { return !watch.empty(); }
+  static TelemetrySettings FromJson(const json &j);
+  json ToJson() const;
+};
+
+constexpr uint8_t kTelemetrySync = 0xE7;
+// Key frames hold at most 5 bytes per value, delta frames 6: the payload
+// of either fits its one-byte length.
+constexpr size_t kMaxWatched = 40;
+
+enum class TelemetryKind : uint8_t { Int, Bool, Char, Float, Double, Fixed };
+
+struct TelemetryVar {
+  std::string instance;
+  std::string pin;
+  std::string var; // generated global
+  TelemetryKind kind = TelemetryKind::Int;
+};
+
+// What the editor needs to decode a stream, written next to main.cpp as
+// telemetry.json by the transpiler.
+struct TelemetryManifest {
+  std::vector<TelemetryVar> vars;
+  int frac_bits = 16; // of Fixed values
+  uint32_t baud = 115200;
+
+  bool Write(const fs::path &file) const;
+  static bool Read(const fs::path &file, TelemetryManifest &out);
+};
+
+// Ring buffer, efx_telemetry_sample() and efx_telemetry_step() (called at
+// the end of loop()), emitted once in a main.cpp with watched pins.
+std::string TelemetryRuntime(const TelemetrySettings &settings,
+                             const TelemetryManifest &manifest);
+
+// Editor side: frames to values.
+class TelemetryDecoder {
+public:
+  explicit TelemetryDecoder(TelemetryManifest manifest = {});
+
+  // Consumes raw bytes, keeps a partial frame for the next call. Returns
+  // the number of frames applied.
+  size_t Feed(const uint8_t *data, size_t size);
+
+  const TelemetryManifest &Manifest() const { return m_Manifest; }
+  // A key frame was seen and no frame was lost since
+  bool Synced() const { return m_Synced; }
+  double Value(size_t var) const;
+  std::string Format(size_t var) const;
+
+  size_t frames = 0;     // applied
+  size_t lost = 0;       // seq gaps
+  size_t bad_frames = 0; // crc or payload errors
+
+private:
+  bool Apply(uint8_t seq, uint8_t kind, const uint8_t *p, size_t n);
+
+  TelemetryManifest m_Manifest;
+  std::vector<uint32_t> m_Raw;
+  std::vector<uint8_t> m_Pending;
+  bool m_Synced = false;
+  uint8_t m_Seq = 0;
+};
+
+// Byte source of a decoder: a serial device, or the master side of a
+// pseudo-terminal whose other side is handed to the host simulator
+// (--serial). POSIX only.
+class TelemetryLink {
+public:
+  TelemetryLink() = default;
+  TelemetryLink(const TelemetryLink &) = delete;
+  TelemetryLink &operator=(const TelemetryLink &) = delete;
+  ~TelemetryLink() { Close(); }
+
+  bool OpenDevice(const std::string &path, uint32_t baud, std::string &error);
+  // `peer` receives the path of the terminal side.
+  bool OpenPty(std::string &peer, std::string &error);
+  // Runs `argv` in the background until Close().
+  bool Spawn(const std::vector<std::string> &argv, std::string &error);
+  // Appends what is available without blocking; false once the link is
+  // gone (device unplugged, simulator exited).
+  bool Read(std::vector<uint8_t> &out);
+  void Close();
+  bool IsOpen() const { return m_Fd >= 0; }
+
+private:
+  int m_Fd = -1;
+  int m_Peer = -1; // pty terminal side, held open to keep its raw mode
+  int m_Child = -1;
+};
+
+} // namespace ModuleUI
+
+#endif // TELEMETRY_MAIN_SKETCH_HPP
@@ -1,21 +1,17 @@
 #include "viewport.hpp"
 #include "../../../../../src/module.hpp"
 
+#include <algorithm>
+#include <cctype>
+#include <chrono>
+#include <cmath>
+#include <cstdio>
 #include <filesystem>
 #include <iostream>
+#include <map>
 #include <string>
 
 namespace ModuleUI {
-enum class ExplorerState { MainMenu, ExploringNode, Exit };
-
-struct Explorer {
-  ExplorerState state = ExplorerState::MainMenu;
-  Node *currentNode = nullptr;
-  std::vector<std::string> linkedIDs;
-  int selectedPin = -1;
-};
-
-Explorer m_Explorer;
 
 ViewportMainSketchAppWindow::ViewportMainSketchAppWindow(
     const std::string &path, const std::string &name) {
@@ -27,20 +23,21 @@ ViewportMainSketchAppWindow::ViewportMainSketchAppWindow(
   std::shared_ptr<Cherry::AppWindow> win = m_AppWindow;
 
   m_Path = path;
+  LoadDocumentFormat();
+  m_Build = std::make_unique<BuildPipeline>(path);
 
   // -------------------------
   // Init node system context
   // -------------------------
-  FetchTypes();
-  FetchPrimitives();
-  FetchFunctions();
+  // The library is shared with every window of the project. What the
+  // graph references is read by the loader while the window already shows,
+  // the rest of the library streams in once the graph is placed.
+  m_Library = EmbeddedFusion::AcquireSchemaLibrary(path);
+  m_Catalog = std::make_shared<SchemaCatalog>();
 
   RegisterBoolVarNode();
 
-  FetchMainNodeGraph();
-
-  PopulateMinimum(); // inject built-ins (types + primitives)
-  AddSchemasToNodeGraphSpawner();
+  StartOpen();
 
   m_Graph.m_NodeSpawnCallback = [this](const std::string &schema_id, float x,
                                        float y, const std::string &link) {
@@ -50,31 +47,29 @@ ViewportMainSketchAppWindow::ViewportMainSketchAppWindow(
   this->ctx = VortexMaker::GetCurrentContext();
 }
 
+ViewportMainSketchAppWindow::~ViewportMainSketchAppWindow() {
+  // The job futures join in their destructors, do not let them wait for
+  // a whole toolchain run.
+  CancelJobs();
+}
+
 void ViewportMainSketchAppWindow::PopulateMinimum() {
+  // Built-ins are only added to the shared library by the first window that
+  // misses them; later windows find them in the snapshot and skip the copy.
+  auto snapshot = m_Library->Snapshot();
+  CatalogChunk pending;
+
   // --- Built-in pin types ---
   auto ensureType = [&](const std::string &id, const std::string &name,
                         const std::string &desc, const std::string &color,
                         const std::string &category,
                         const std::string &cpp_type) {
-    auto it = std::find_if(g_TypesCache.begin(), g_TypesCache.end(),
-                           [&](const PinTypeInfo &t) { return t.id == id; });
-    if (it == g_TypesCache.end()) {
-      PinTypeInfo t{id, name, desc, color, category, cpp_type};
-      g_TypesCache.push_back(t);
-
-      Cherry::NodeSystem::PinShape shape = Cherry::NodeSystem::PinShape::Circle;
-
-      if (category == "flow") {
-        shape = Cherry::NodeSystem::PinShape::Flow;
-      } else if (category == "primitive") {
-        shape = Cherry::NodeSystem::PinShape::Circle;
-      } else if (category == "event") {
-        shape = Cherry::NodeSystem::PinShape::Square;
-      }
-
-      m_NodeCtx.SetupPinFormat(
-          Cherry::NodeSystem::PinFormat(t.id, t.name, t.colorHex, shape, desc));
-    }
+    const PinTypeId typeId = PinTypeRegistry::Intern(id);
+    if (snapshot->FindType(typeId))
+      return;
+    PinTypeInfo t{id, name, desc, color, category, cpp_type};
+    InternPinType(t);
+    pending.types.push_back(std::move(t));
   };
 
   ensureType("exec", "Execution", "Flow execution pin", "#FFFFFF", "flow",
@@ -115,82 +110,35 @@ void ViewportMainSketchAppWindow::PopulateMinimum() {
           const std::string &name_secondary = "",
           const std::string &proper_name = "",
           const std::string &proper_logo = "") {
-        auto it = std::find_if(g_SchemasCache.begin(), g_SchemasCache.end(),
-                               [&](const SchemaInfo &s) { return s.id == id; });
-        if (it == g_SchemasCache.end()) {
-          SchemaInfo s;
-          s.id = id;
-          s.name = name;
-          s.name_secondary = name_secondary;
-          s.proper_name = proper_name;
-          s.proper_logo = proper_logo;
-          s.description = desc;
-          s.kind = "primitive";
-          s.hexcolheader = hexcolheader;
-          s.hexcolbg = hexcolbg;
-          s.hexcolborder = hexcolborder;
-          s.hexcoltext = hexcoltext;
-          s.hexcoltextsecondary = hexcoltextsecondary;
-          s.logopath = logopath;
-          s.nodetype = nodetype;
-          s.inputs = std::move(inputs);
-          s.outputs = std::move(outputs);
-          g_SchemasCache.push_back(s);
-
-          // Register in NodeCtx
-          m_NodeCtx.CreateSchema(id);
-          auto schema = m_NodeCtx.GetSchema(id);
-          if (schema) {
-            if (nodetype == "blueprint") {
-              schema->SetType(Cherry::NodeSystem::NodeType::Blueprint);
-            }
-
-            for (auto &p : s.inputs) {
-              schema->AddInputPin(p.id, p.type);
-            }
-
-            for (auto &p : s.outputs) {
-              schema->AddOutputPin(p.id, p.type);
-            }
-
-            if (!name.empty()) {
-              schema->SetLabel(name);
-            }
-
-            if (!name_secondary.empty()) {
-              schema->SetSecondLabel(name_secondary);
-            }
-
-            if (!hexcolheader.empty()) {
-              schema->SetHexHeaderColor(hexcolheader);
-            }
-
-            if (!hexcoltext.empty()) {
-              schema->SetLabelHexColor(hexcoltext);
-            }
-
-            if (!hexcoltextsecondary.empty()) {
-              schema->SetSecondLabelHexColor(hexcoltextsecondary);
-            }
-
-            if (!hexcolbg.empty()) {
-              if (hexcolbg == "def") {
-              } else {
-                schema->SetHexBackgroundColor(hexcolbg);
-              }
-            }
-
-            if (!hexcolborder.empty()) {
-              if (hexcolborder == "def") {
-              } else {
-                schema->SetHexBorderColor(hexcolborder);
-              }
-            }
-            if (!logopath.empty()) {
-              schema->SetLogoPath(logopath);
-            }
-          }
+        if (snapshot->FindSchema(id))
+          return;
+        SchemaInfo s;
+        s.id = id;
+        s.name = name;
+        s.name_secondary = name_secondary;
+        s.proper_name = proper_name;
+        s.proper_logo = proper_logo;
+        s.description = desc;
+        s.kind = "primitive";
+        s.kind_id = SchemaKind::Primitive;
+        s.hexcolheader = hexcolheader;
+        s.hexcolbg = hexcolbg;
+        s.hexcolborder = hexcolborder;
+        s.hexcoltext = hexcoltext;
+        s.hexcoltextsecondary = hexcoltextsecondary;
+        s.logopath = logopath;
+        s.nodetype = nodetype;
+        s.inputs = std::move(inputs);
+        s.outputs = std::move(outputs);
+        for (auto &p : s.inputs) {
+          p.key = p.id;
+          p.type_id = PinTypeRegistry::Intern(p.type);
         }
+        for (auto &p : s.outputs) {
+          p.key = p.id;
+          p.type_id = PinTypeRegistry::Intern(p.type);
+        }
+        pending.schemas.push_back(std::move(s));
       };
 
   // Events
@@ -206,6 +154,16 @@ void ViewportMainSketchAppWindow::PopulateMinimum() {
                   EmbeddedFusion::GetPath("resources/icons/event.png"),
                   "Main program loop");
 
+  // Runs concurrently with loop(), pinned to `core` where the board has
+  // several (see TaskPartition)
+  ensurePrimitive("task", "Task", "Concurrent task",
+                  {{"core", "Core", "int", 0},
+                   {"period_ms", "Period (ms)", "int", 10}},
+                  {{"on_tick", "On tick", "exec", nullptr}}, "#db2c2c", "def",
+                  "def", "#CCCCCC", "#e07070", "blueprint",
+                  EmbeddedFusion::GetPath("resources/icons/event.png"),
+                  "Periodic task on its own core");
+
   // Flow control
   ensurePrimitive(
       "branch", "Branch", "Conditional branch",
@@ -217,7 +175,7 @@ void ViewportMainSketchAppWindow::PopulateMinimum() {
 
   ensurePrimitive(
       "is_float_bigger_than_float", ">", "",
-      {{"float1", "", "float", nullptr}, {"float1", "", "float", false}},
+      {{"float1", "", "float", nullptr}, {"float2", "", "float", nullptr}},
       {{"bool_result", "", "bool", nullptr}}, "#616363", "def", "def",
       "#CCCCCC", "#CCCCCC", "", "", "", "Float size comparaison",
       EmbeddedFusion::GetPath("resources/icons/if.png"));
@@ -231,6 +189,9 @@ void ViewportMainSketchAppWindow::PopulateMinimum() {
                   {{"bool_input1", "bool_input1", "bool_input", nullptr}},
                   {{"bool1", "", "bool", nullptr}}, "#616363", "def", "def",
                   "#CCCCCC", "#CCCCCC", "", "", "", "Simple bool var");
+
+  m_Library->Merge(std::move(pending));
+  SyncCatalog();
 }
 
 void ViewportMainSketchAppWindow::SpawnMinimal() {
@@ -253,13 +214,10 @@ void ViewportMainSketchAppWindow::SpawnMinimal() {
   }
 }
 
-void ViewportMainSketchAppWindow::AddSchemasToNodeGraphSpawner() {
-  auto schemas = m_NodeCtx.GetSchemas();
-
-  for (auto schema : g_SchemasCache) {
-    if (schema.description == "Main event")
-      continue;
-
+void ViewportMainSketchAppWindow::AddSchemasToNodeGraphSpawner(
+    const std::vector<const SchemaInfo *> &schemas) {
+  for (const SchemaInfo *s : schemas) {
+    const SchemaInfo &schema = *s;
     Cherry::NodeSystem::NodeSpawnPossibility poss;
     poss.proper_name = schema.proper_name;
     poss.proper_description = schema.description;
@@ -272,29 +230,91 @@ void ViewportMainSketchAppWindow::AddSchemasToNodeGraphSpawner() {
 }
 
 void ViewportMainSketchAppWindow::Refresh() {
-  FetchTypes();
-
-  // Primitives
-  FetchPrimitives();
-
-  // Functions
-  FetchFunctions();
+  EFUSION_TRACE_SCOPE("Viewport::Refresh", m_Path);
+  if (IsLoading())
+    return;
+  // Types, primitives and functions
+  m_Library->Reload();
+  SyncCatalog();
 
   FetchMainNodeGraph();
   PopulateMinimum();
-  AddSchemasToNodeGraphSpawner();
 
   m_NodeEngine.RefreshNodeGraph();
   m_NodeEngine.RefreshNodeGraphLinks();
 }
 
 void ViewportMainSketchAppWindow::Save() {
+  EFUSION_TRACE_SCOPE("Viewport::Save", m_Path);
+  // The graph is not in yet: saving would overwrite it with nothing
+  if (IsLoading())
+    return;
+  // SaveTypes rewrites the pin_setup.json mirror from the catalog, it must
+  // see the whole library.
+  m_Library->WaitForComplete();
+  SyncCatalog();
 
   m_NodeEngine.SaveNodeGraph();
   SaveTypes();
   SavePrimitives();
   SaveFunctions();
-  SaveMainNodeGraph();
+  // The graph file now holds every journaled edit
+  if (SaveMainNodeGraph())
+    m_Journal.Compact(srcMainSketchFile());
+}
+
+std::set<std::string>
+ViewportMainSketchAppWindow::ScanReferencedTypeIds(const fs::path &graphFile) {
+  // Streamed from the mapped file, no DOM is built.
+  std::set<std::string> ids;
+  ScanGraphTypeIds(graphFile, ids);
+  return ids;
+}
+
+void ViewportMainSketchAppWindow::SyncCatalog() {
+  auto snapshot = m_Library->Snapshot();
+  if (m_Catalog == snapshot)
+    return;
+
+  for (const auto &t : snapshot->types) {
+    if (!m_RegisteredTypes.insert(t.type_id).second)
+      continue;
+    try {
+      m_NodeCtx.SetupPinFormat(Cherry::NodeSystem::PinFormat(
+          t.id, t.name, t.colorHex, PinShapeFor(t.category_id),
+          t.description));
+    } catch (...) {
+      std::cerr << "SyncCatalog: failed to SetupPinFormat for " << t.id
+                << std::endl;
+    }
+  }
+
+  bool registered = false;
+  std::vector<const SchemaInfo *> added;
+  for (const auto &s : snapshot->schemas) {
+    bool stale = m_RegisteredSchemas.insert(s.id).second;
+    if (!stale && m_Catalog) {
+      // An edit (pins added or retyped) publishes the entry anew
+      const SchemaInfo *previous = m_Catalog->FindSchema(s.id);
+      stale = previous && !SameRegistration(*previous, s);
+    }
+    if (stale) {
+      if (!RegisterSchema(s))
+        std::cerr << "SyncCatalog: failed to register schema " << s.id
+                  << std::endl;
+      registered = true;
+    }
+    // Upsert re-indexes changed schemas, only new ids reach the spawner
+    if (s.description != "Main event" && m_Spawner.Upsert(s))
+      added.push_back(&s);
+  }
+
+  m_Catalog = std::move(snapshot);
+  m_SpawnResultsDirty = true;
+  if (!added.empty())
+    AddSchemasToNodeGraphSpawner(added);
+  if (registered)
+    MarkGraphDirty();
 }
 
 std::shared_ptr<Cherry::AppWindow> &
@@ -323,42 +343,67 @@ void ViewportMainSketchAppWindow::SetupRenderCallback() {
 void ViewportMainSketchAppWindow::SpawnNode(const std::string &schema_id,
                                             float x, float y,
                                             const std::string &link) {
-  std::cout << "2a" << std::endl;
+  EFUSION_TRACE_SCOPE("Viewport::SpawnNode", schema_id);
   Cherry::NodeSystem::NodeInstance ni;
   ni.TypeID = schema_id;
-  ni.InstanceID =
-      schema_id + "_" + std::to_string(m_Graph.m_InstanciatedNodes.size() + 1);
+  // Collapsed group members still own their ids
+  std::unordered_set<std::string> taken;
+  for (const auto &n : m_Graph.m_InstanciatedNodes)
+    taken.insert(n.InstanceID);
+  for (const auto &kv : m_Subgraphs)
+    for (const auto &member : kv.second.nodes)
+      taken.insert(member.InstanceID);
+  for (size_t n = m_Graph.m_InstanciatedNodes.size() + 1;; ++n) {
+    ni.InstanceID = schema_id + "_" + std::to_string(n);
+    if (!taken.count(ni.InstanceID))
+      break;
+  }
   ni.Position = {x, y};
   ni.Size = {120.f, 40.f};
 
   ni.Datas = "{}";
-  std::cout << "2112" << std::endl;
 
   // ⚡ Ajoute le node à la graph
   m_Graph.AddNodeInstance(ni);
+  MarkGraphDirty();
 
   // Reconstruire et rafraîchir
-  std::cout << "2b1" << std::endl;
-  m_NodeEngine.BuildNodes();
-  std::cout << "2b2" << std::endl;
-  m_NodeEngine.RefreshNodeGraph();
-  std::cout << "2b3" << std::endl;
-  m_NodeEngine.RefreshNodeGraphLinks();
-  std::cout << "2b4" << std::endl;
+  {
+    EFUSION_TRACE_SCOPE("NodeEngine::BuildNodes");
+    m_NodeEngine.BuildNodes();
+  }
+  {
+    EFUSION_TRACE_SCOPE("NodeEngine::RefreshNodeGraph");
+    m_NodeEngine.RefreshNodeGraph();
+    m_NodeEngine.RefreshNodeGraphLinks();
+  }
+  CaptureEdits();
 
   // Positionner le node
   Node *nodePtr = m_NodeEngine.FindNodeByInstanceID(ni.InstanceID);
   if (nodePtr) {
     ed::SetNodePosition(nodePtr->ID, ImVec2(x, y));
   }
-  std::cout << "2b" << std::endl;
 }
 
 void ViewportMainSketchAppWindow::Render() {
+  EFUSION_TRACE_SCOPE("Viewport::Render", m_Path);
   int width = CherryGUI::GetContentRegionAvail().x;
   int height = CherryGUI::GetContentRegionAvail().y;
   CherryStyle::AddMarginY(5.0f);
 
+  if (!PollOpen()) {
+    DrawLoading();
+    return;
+  }
+
+  m_Library->Poll();
+  SyncCatalog();
+
+  // The explorer reads the graph index, rebuilt only after a mutation
+  if (m_GraphDirty)
+    Validate();
+
   switch (m_Explorer.state) {
   case ExplorerState::MainMenu:
     DrawMainMenu();
@@ -370,167 +415,785 @@ void ViewportMainSketchAppWindow::Render() {
     break;
   }
 
+  // Links and moves are edited inside the node area, the end of a mouse
+  // interaction is when they are diffed. Only an added or removed node or
+  // link rebuilds the index, a data edit only re-validates, a move neither.
+  if (ImGui::IsMouseClicked(0))
+    TouchHoveredNode();
+  if (ImGui::IsMouseReleased(0)) {
+    TouchHoveredNode();
+    CaptureEdits();
+    m_History.EndInteraction();
+  }
+  if (m_GraphDirty || m_ValidationDirty)
+    Validate();
+  DrawDiagnostics();
+  DrawSpawnSearch();
+  DrawGroupControls();
+  DrawFormatControls();
+  DrawStateMachines();
+  DrawBuildStatus();
+  DrawSizeReport();
+  DrawFixedPointCompare();
+  PollTelemetry();
+  DrawTelemetry();
+  DrawTracing();
+
   auto node_area =
       CherryKit::NodeAreaOpen(CherryID("viewport"), "", width, height,
                               &m_NodeCtx, &m_Graph, &m_NodeEngine);
+  DrawTelemetryOverlay();
 
   static bool first = true;
   if (first) {
     SpawnMinimal();
+    ResetHistory();
     first = false;
   }
 }
 
-void ViewportMainSketchAppWindow::Transpilation() {
+std::string ViewportMainSketchAppWindow::CppLiteral(const json &value,
+                                                    const std::string &cppType) {
+  if (value.is_null())
+    return "";
+  if (value.is_boolean())
+    return value.get<bool>() ? "true" : "false";
+  if (value.is_number())
+    return cppType == "efx_q"
+               ? FixedLiteral(value.get<double>(), m_Transpile.frac_bits)
+               : value.dump();
+  if (value.is_string()) {
+    std::string str = value.get<std::string>();
+    if (cppType == "char" && str.size() == 1)
+      return str == "'" || str == "\\" ? "'\\" + str + "'" : "'" + str + "'";
+    if (cppType == "bool")
+      return (str == "true" || str == "1") ? "true" : "false";
+    return value.dump();
+  }
+  return "";
+}
+
+std::string ViewportMainSketchAppWindow::InitialValueForInput(
+    const Cherry::NodeSystem::NodeInstance &ni,
+    const GraphIndex::PinSlot &pin) {
+  static const PinTypeId boolInput = PinTypeRegistry::Intern("bool_input");
+  const std::string cppType = PinCppType(pin);
+
+  // Per-instance values edited in the node body take precedence over the
+  // schema default.
+  if (ni.Datas.is_object()) {
+    if (ni.Datas.contains(pin.id))
+      return CppLiteral(ni.Datas[pin.id], cppType);
+    if (pin.type == boolInput && ni.Datas.contains("value"))
+      return CppLiteral(ni.Datas["value"], cppType);
+  }
+  if (const SchemaInfo *schema = FindSchema(ni.TypeID)) {
+    for (const auto &p : schema->inputs)
+      if ((p.id.empty() ? p.name : p.id) == pin.id)
+        return CppLiteral(p.defaultValue, cppType);
+  }
+  return "";
+}
+
+void ViewportMainSketchAppWindow::EmitInputPulls(uint32_t node,
+                                                 std::ostringstream &out) {
+  const auto &entry = m_GraphIndex.nodes[node];
+  std::vector<uint32_t> evaluated;
+  m_GraphIndex.ForEachInLink(node, [&](const GraphIndex::Link &l) {
+    const auto &to = entry.inputs[l.dst_pin];
+    if (to.exec)
+      return;
+    const auto &src = m_GraphIndex.nodes[l.src_node];
+    const uint32_t mailbox =
+        m_Tasks.MailboxFor(l.src_node, l.src_pin, m_Tasks.owner[node]);
+    if (mailbox != GraphIndex::npos) {
+      out << "    " << VarNameForSlot(entry, to) << " = "
+          << MailboxName(m_Tasks.mailboxes[mailbox]) << ".read();\n";
+      return;
+    }
+    if (src.IsPure() && std::find(evaluated.begin(), evaluated.end(),
+                                  l.src_node) == evaluated.end()) {
+      evaluated.push_back(l.src_node);
+      out << "    eval_" << SanitizeIdentifier(src.instance_id) << "();\n";
+    }
+    out << "    " << VarNameForSlot(entry, to) << " = "
+        << VarNameForSlot(src, src.outputs[l.src_pin]) << ";\n";
+  });
+}
+
+bool ViewportMainSketchAppWindow::EmitBuiltinPrimitive(
+    uint32_t node, std::ostringstream &out) {
+  const auto &entry = m_GraphIndex.nodes[node];
+  auto in = [&](const std::string &id) {
+    for (const auto &p : entry.inputs)
+      if (p.id == id)
+        return VarNameForSlot(entry, p);
+    return std::string("0");
+  };
+  auto outVar = [&](const std::string &id) {
+    for (const auto &p : entry.outputs)
+      if (p.id == id)
+        return VarNameForSlot(entry, p);
+    return std::string();
+  };
+
+  const std::string &id = entry.type_id;
+  if (id == "setup" || id == "loop" || id == "task") {
+    return true;
+  } else if (id == "is_float_bigger_than_float") {
+    out << "    " << outVar("bool_result") << " = " << in("float1") << " > "
+        << in("float2") << ";\n";
+    return true;
+  } else if (id == "float_to_int") {
+    const bool fixed = m_Transpile.floats == FloatLowering::Fixed;
+    out << "    " << outVar("int1") << " = "
+        << (fixed ? "efx_to_int(" : "static_cast<int>(") << in("float1")
+        << ");\n";
+    return true;
+  } else if (id == "test") {
+    out << "    " << outVar("bool1") << " = " << in("bool_input1") << ";\n";
+    return true;
+  }
+
+  BufferOp op;
+  if (const PinTypeInfo *type = FindBufferPrimitive(*m_Catalog, id, op)) {
+    out << "    "
+        << BufferKernelCall(*type, op,
+                            [&](const std::string &pin) {
+                              const std::string var = outVar(pin);
+                              return var.empty() ? in(pin) : var;
+                            })
+        << "\n";
+    return true;
+  }
+  return false;
+}
+
+void ViewportMainSketchAppWindow::EmitExecSuccessors(
+    uint32_t node, uint32_t outputPin, std::ostringstream &out,
+    const std::string &indent) {
+  bool any = false;
+  std::vector<uint32_t> marks; // reactive successors run from loop()
+  m_GraphIndex.ForEachOutLink(node, [&](const GraphIndex::Link &l) {
+    if (l.src_pin != outputPin ||
+        !m_GraphIndex.nodes[l.dst_node].inputs[l.dst_pin].exec)
+      return;
+    any = true;
+    if (IsScheduled(node) && IsScheduled(l.dst_node)) {
+      marks.push_back(m_Reactive.bit[l.dst_node]);
+      return;
+    }
+    out << indent << "node_"
+        << SanitizeIdentifier(m_GraphIndex.nodes[l.dst_node].instance_id)
+        << "();\n";
+  });
+  std::sort(marks.begin(), marks.end());
+  out << BitMaskStatements("g_efusion_dirty", marks, true, indent);
+  if (!any)
+    out << indent << "// no target on "
+        << m_GraphIndex.nodes[node].outputs[outputPin].id << "\n";
+}
+
+void ViewportMainSketchAppWindow::EmitReactivePropagation(
+    uint32_t node, std::ostringstream &out) {
+  const auto &entry = m_GraphIndex.nodes[node];
+  const auto &down = m_Reactive.down[m_Reactive.bit[node]];
+  if (down.empty())
+    return;
+  // `|` rather than `||`: every previous value must be updated
+  std::string changed;
+  for (const auto &p : entry.outputs) {
+    if (p.exec)
+      continue;
+    changed += std::string(changed.empty() ? "" : " |\n        ") +
+               "efx_changed(" + PrevVarForSlot(entry, p) + ", " +
+               VarNameForSlot(entry, p) + ")";
+  }
+  if (changed.empty()) {
+    out << BitMaskStatements("g_efusion_dirty", down, true, "    ");
+    return;
+  }
+  out << "    if (" << changed << ") {\n";
+  out << BitMaskStatements("g_efusion_dirty", down, true, "        ");
+  out << "    }\n";
+}
+
+void ViewportMainSketchAppWindow::PopulateStateMachine(
+    const StateMachineInfo &m, uint32_t node, std::ostringstream &out) {
+  const auto &entry = m_GraphIndex.nodes[node];
+  const std::string inst = SanitizeIdentifier(entry.instance_id);
+  const std::string state = "sm_state_" + inst;
+  auto hasTargets = [&](uint32_t pin) {
+    bool any = false;
+    m_GraphIndex.ForEachOutLink(node, [&](const GraphIndex::Link &l) {
+      any = any || l.src_pin == pin;
+    });
+    return any;
+  };
+
+  out << "// --- state machine node: " << entry.instance_id
+      << " (machine: " << m.id << ") ---\n";
+  out << "static uint8_t " << state << " = " << MachineStateName(m, 0)
+      << ";\n";
+  out << "void node_" << inst << "() {\n";
+  EmitInputPulls(node, out);
+  out << "    const uint8_t from = " << state << ";\n";
+  // Events added to the machine after the node was placed have no pin
+  // until the sketch is reloaded, they read as false.
+  out << "    " << state << " = "
+      << MachineStepCall(m, "from",
+                         [&](const std::string &event) {
+                           for (const auto &p : entry.inputs)
+                             if (p.id == event)
+                               return VarNameForSlot(entry, p);
+                           return std::string("false");
+                         })
+      << ";\n";
+
+  uint32_t thenPin = GraphIndex::npos;
+  std::vector<std::pair<size_t, uint32_t>> entries; // state, pin
+  for (uint32_t o = 0; o < entry.outputs.size(); ++o) {
+    const auto &p = entry.outputs[o];
+    if (!p.exec) {
+      if (p.id == "state")
+        out << "    " << VarNameForSlot(entry, p) << " = " << state << ";\n";
+      continue;
+    }
+    if (p.id == "then") {
+      thenPin = o;
+      continue;
+    }
+    for (size_t s = 0; s < m.states.size(); ++s)
+      if (p.id == MachineEntryPin(m.states[s]) && hasTargets(o))
+        entries.push_back({s, o});
+  }
+
+  // A reactive machine steps again on the next loop() after a transition,
+  // the events that are still true may take the next one.
+  const bool reactive = IsScheduled(node);
+  if (!entries.empty() || reactive) {
+    out << "    if (" << state << " != from) {\n";
+    if (reactive)
+      out << BitMaskStatements("g_efusion_dirty", {m_Reactive.bit[node]}, true,
+                               "        ");
+    if (!entries.empty()) {
+      out << "        switch (" << state << ") {\n";
+      for (const auto &[s, o] : entries) {
+        out << "        case " << MachineStateName(m, s) << ":\n";
+        EmitExecSuccessors(node, o, out, "            ");
+        out << "            break;\n";
+      }
+      out << "        }\n";
+    }
+    out << "    }\n";
+  }
+  if (thenPin != GraphIndex::npos)
+    EmitExecSuccessors(node, thenPin, out, "    ");
+  if (reactive)
+    EmitReactivePropagation(node, out);
+  out << "}\n\n";
+}
+
+TranspileOptions ViewportMainSketchAppWindow::TranspileOptionsForSketch() {
+  json settings = json::object();
+  if (auto doc = ReadDocument(sketchSettingsFile()))
+    if (doc->is_object())
+      settings = std::move(*doc);
+  BuildSettings build;
+  if (settings.contains("build"))
+    build = BuildSettings::FromJson(settings["build"]);
+  TranspileOptions options = TranspileOptions::FromJson(
+      settings.value("transpile", json::object()), build.fqbn);
+  if (settings.contains("telemetry"))
+    options.telemetry = TelemetrySettings::FromJson(settings["telemetry"]);
+  return options;
+}
+
+BuildSettings ViewportMainSketchAppWindow::BuildSettingsForSketch() {
+  BuildSettings settings;
+  if (auto doc = ReadDocument(sketchSettingsFile()))
+    if (doc->is_object() && doc->contains("build"))
+      settings = BuildSettings::FromJson((*doc)["build"]);
+  return settings;
+}
+
+void ViewportMainSketchAppWindow::TabulatePureSubgraphs(
+    const TranspileOptions &options) {
+  m_Transpile = options; // pin types of the hooks
+  m_Tables.clear();
+  const LookupTableProfile &board = options.lut;
+  auto floatMath = [&](uint32_t node) {
+    const auto &entry = m_GraphIndex.nodes[node];
+    for (const auto *pins : {&entry.inputs, &entry.outputs})
+      for (const auto &p : *pins)
+        if (p.type == BuiltinPinType::Float ||
+            p.storage == BuiltinPinType::Float)
+          return true;
+    return false;
+  };
+
+  LookupTableHooks hooks;
+  hooks.range = [this](uint32_t node, uint32_t pin, int32_t &lo, int32_t &hi) {
+    const PinTypeInfo *t =
+        m_Catalog->FindType(m_GraphIndex.nodes[node].outputs[pin].type);
+    return t && PinTypeRange(*t, lo, hi);
+  };
+  hooks.size = [&](uint32_t node, uint32_t pin) -> size_t {
+    const std::string type = PinCppType(m_GraphIndex.nodes[node].outputs[pin]);
+    if (type == "bool" || type == "char")
+      return 1;
+    if (type == "int")
+      return board.int_bytes;
+    if (type == "float" || type == "efx_q")
+      return 4;
+    if (type == "double")
+      return board.double_bytes;
+    return 0;
+  };
+  hooks.cost = [&](uint32_t node) -> uint32_t {
+    uint32_t cost = UsesSkeleton(node) ? 4 : 1;
+    if (board.soft_float && options.floats == FloatLowering::Float &&
+        floatMath(node))
+      cost += 8;
+    return cost;
+  };
+  hooks.opaque = [this](uint32_t node) { return UsesSkeleton(node); };
+
+  std::vector<LookupTable> tables = PlanLookupTables(
+      m_GraphIndex, m_Tasks, hooks, board.max_bytes, board.min_cost);
+  if (tables.empty())
+    return;
+  for (auto &t : tables)
+    for (uint32_t o : t.outputs)
+      t.types.push_back(PinCppType(m_GraphIndex.nodes[t.root].outputs[o]));
+
+  // Probe pass: same graph, polled, setup() prints the tables and exits.
+  // Only generated here, it is built and run by the next build job.
+  m_Tables = tables;
+  TranspileOptions probe = options;
+  probe.lut_probe = true;
+  probe.execution = ExecutionMode::Polled;
+  probe.telemetry.watch.clear();
+  const fs::path scratch =
+      fs::path(m_Path) / "transpilation" / "lut" / "probe.cpp";
+  const bool generated = TranspileTo(scratch, probe);
+  m_Transpile = options;
+  m_Tables.clear();
+  auto source = generated ? ReadFileBytes(scratch) : std::nullopt;
+  if (!source) {
+    std::cerr << "Transpilation: no lookup tables, probe transpilation "
+                 "failed\n";
+    return;
+  }
+
+  LookupProbe planned{std::string(source->begin(), source->end()),
+                      std::move(tables), options.lut.probe_timeout_ms};
+  auto known = m_LutValues.find(planned.source);
+  if (known == m_LutValues.end()) {
+    std::cout << "Transpilation: " << planned.tables.size()
+              << " lookup table(s) to evaluate, plain code until the next "
+                 "build\n";
+    m_LutPending = std::move(planned);
+    return;
+  }
+  m_Tables = known->second;
+  size_t bytes = 0;
+  for (const auto &t : m_Tables)
+    bytes += t.bytes;
+  if (!m_Tables.empty())
+    std::cout << "Transpilation: " << m_Tables.size() << " lookup table(s), "
+              << bytes << " bytes of flash\n";
+}
+
+void ViewportMainSketchAppWindow::ApplyLookupProbe(const ProbeResult &result) {
+  if (!m_LutRunning)
+    return;
+  LookupProbe probe = std::move(*m_LutRunning);
+  m_LutRunning.reset();
+  std::string error;
+  if (!result.ok)
+    error = result.log;
+  else
+    ParseLookupProbe(result.output, probe.tables, error);
+  if (!error.empty()) {
+    std::cerr << "Transpilation: no lookup tables, " << error << "\n";
+    probe.tables.clear(); // not probed again for the same source
+  }
+  constexpr size_t kKeptProbes = 16;
+  if (m_LutValues.size() >= kKeptProbes)
+    m_LutValues.clear();
+  m_LutValues[probe.source] = std::move(probe.tables);
+
+  // The build the probe went ahead of, with the tables when they came in
+  if (Transpilation())
+    Build();
+}
+
+void ViewportMainSketchAppWindow::EmitLookupTableRead(
+    const LookupTable &table, std::ostringstream &out) {
+  const auto &entry = m_GraphIndex.nodes[table.root];
+  const auto &src = m_GraphIndex.nodes[table.src_node];
+  const std::string srcVar = VarNameForSlot(src, src.outputs[table.src_pin]);
+  out << "    // " << table.Entries() << "-entry table over " << srcVar
+      << " in [" << table.lo << ", " << table.hi << "]\n";
+  if (src.IsPure())
+    out << "    eval_" << SanitizeIdentifier(src.instance_id) << "();\n";
+  out << "    long k = (long)" << srcVar << " - (" << table.lo << "L);\n";
+  out << "    if (k < 0)\n        k = 0;\n";
+  out << "    else if (k > " << table.Entries() - 1 << ")\n        k = "
+      << table.Entries() - 1 << ";\n";
+  for (uint32_t o : table.outputs) {
+    const auto &p = entry.outputs[o];
+    out << "    " << VarNameForSlot(entry, p) << " = efx_lut(&"
+        << LookupTableName(entry, p) << "[k]);\n";
+  }
+}
+
+void ViewportMainSketchAppWindow::EmitLookupProbe(std::ostream &out) {
+  out << "    // Lookup table probe: every entry, then exit\n";
+  for (size_t t = 0; t < m_Tables.size(); ++t) {
+    const LookupTable &table = m_Tables[t];
+    const auto &entry = m_GraphIndex.nodes[table.root];
+    const auto &src = m_GraphIndex.nodes[table.src_node];
+    const std::string srcVar = VarNameForSlot(src, src.outputs[table.src_pin]);
+    const std::string tick = TickVarFor(table.root);
+    out << "    for (long v = " << table.lo << "L; v <= " << table.hi
+        << "L; ++v) {\n";
+    out << "        ++" << tick << ";\n";
+    if (src.IsPure())
+      out << "        eval_tick_" << SanitizeIdentifier(src.instance_id)
+          << " = " << TickVarFor(table.src_node) << ";\n";
+    out << "        " << srcVar << " = static_cast<decltype(" << srcVar
+        << ")>(v);\n";
+    out << "        eval_" << SanitizeIdentifier(entry.instance_id) << "();\n";
+    out << "        std::printf(\"@lut " << t << "\");\n";
+    for (size_t o = 0; o < table.outputs.size(); ++o) {
+      const std::string var =
+          VarNameForSlot(entry, entry.outputs[table.outputs[o]]);
+      if (table.types[o] == "float")
+        out << "        std::printf(\" %.9g\", (double)" << var << ");\n";
+      else if (table.types[o] == "double")
+        out << "        std::printf(\" %.17g\", (double)" << var << ");\n";
+      else
+        out << "        std::printf(\" %ld\", (long)" << var << ");\n";
+    }
+    out << "        std::printf(\"\\n\");\n";
+    out << "    }\n";
+  }
+  out << "    std::fflush(stdout);\n";
+  out << "    std::exit(0);\n";
+}
+
+bool ViewportMainSketchAppWindow::Transpilation() {
+  EFUSION_TRACE_SCOPE("Viewport::Transpilation", m_Path);
+  if (IsLoading())
+    return false;
+  return TranspileTo(fs::path(m_Path) / "transpilation" / "build" / "main.cpp",
+                     TranspileOptionsForSketch());
+}
+
+bool ViewportMainSketchAppWindow::TranspileTo(const fs::path &mainCpp,
+                                              const TranspileOptions &options) {
+  EFUSION_TRACE_SCOPE("Viewport::TranspileTo", mainCpp.string());
   namespace fs = std::filesystem;
 
+  MarkGraphDirty();
+  Validate();
+  if (m_Validation.HasErrors()) {
+    std::cerr << "Transpilation: aborted, graph has " << m_Validation.errors
+              << " error(s)\n";
+    for (const auto &d : m_Validation.diagnostics) {
+      if (d.severity != DiagnosticSeverity::Error)
+        continue;
+      std::cerr << "  [" << DiagnosticKindName(d.kind) << "] " << d.instance_id
+                << ": " << d.message << "\n";
+    }
+    return false;
+  }
+
   try {
     // 1) prepare paths
-    fs::path buildDir = fs::path(m_Path) / "transpilation" / "build";
-    fs::create_directories(buildDir);
+    fs::create_directories(mainCpp.parent_path());
+    if (!options.lut_probe) {
+      m_Tables.clear();
+      m_LutPending.reset();
+      if (options.lut.enabled)
+        TabulatePureSubgraphs(options);
+    }
+    m_Transpile = options;
+    const bool fixed = options.floats == FloatLowering::Fixed;
+    const bool reactive = options.execution == ExecutionMode::Reactive;
+    // State machine entry actions run from the transition itself
+    m_Reactive =
+        reactive
+            ? PlanReactive(
+                  m_GraphIndex, m_Tasks,
+                  [this](uint32_t node) { return UsesSkeleton(node); },
+                  [this](uint32_t node, uint32_t pin) {
+                    return IsMachineNode(node) &&
+                           m_GraphIndex.nodes[node].outputs[pin].id != "then";
+                  })
+            : ReactivePlan();
 
-    fs::path mainCpp = buildDir / "main.cpp";
     std::ofstream out(mainCpp);
     if (!out.is_open()) {
       std::cerr << "Transpilation: failed to open " << mainCpp << "\n";
-      return;
+      return false;
     }
 
     // 2) header includes
     out << "// Auto-generated transpilation\n";
     out << "#include <Arduino.h>\n";
     out << "#include <string>\n";
+    if (options.lut_probe)
+      out << "#include <cstdio>\n";
     out << "\n";
-
-    // 3) collect all node instances
-    auto &nodes = m_Graph.m_InstanciatedNodes;
-
-    // 4) collect variable declarations for data pins
-    std::set<std::string> declaredVars;           // var names
-    std::map<std::string, std::string> varToType; // var -> cpp type
-
-    // Helper lambda to register a pin variable
-    auto registerPinVar = [&](const Cherry::NodeSystem::NodeInstance &ni,
-                              const std::string &pinName,
-                              const std::string &pinTypeId) {
-      if (pinTypeId == "exec")
-        return; // no variable for exec
-      std::string var = VarNameForPin(ni, pinName);
-      std::string cppType = GetCppTypeForPinType(pinTypeId);
-      declaredVars.insert(var);
-      varToType[var] = cppType;
-    };
-
-    // Pre-pass: for each node instance, look up its schema in g_SchemasCache
-    // and register variables for inputs/outputs non-exec
-    for (const auto &ni : nodes) {
-      auto maybeSchema = FindSchemaInfoById(ni.TypeID);
-      if (!maybeSchema) {
-        // unknown schema: skip but keep remark
-        continue;
-      }
-      const SchemaInfo &schema = *maybeSchema;
-      // inputs
-      for (const auto &p : schema.inputs) {
-        registerPinVar(ni, p.id.empty() ? p.name : p.id, p.type);
+    if (fixed)
+      out << FixedPointPrelude(options.frac_bits);
+
+    // 3) collect all node instances, groups are already flattened by the
+    // index
+    const auto &nodes = m_IndexedInstances;
+    const GraphIndex &index = m_GraphIndex;
+    const uint32_t count = static_cast<uint32_t>(index.nodes.size());
+
+    // Buffer types of the graph's pins, struct and kernels once per type
+    std::set<PinTypeId> buffers;
+    for (const auto &entry : index.nodes)
+      for (const auto *pins : {&entry.inputs, &entry.outputs})
+        for (const auto &p : *pins)
+          if (const PinTypeInfo *t = m_Catalog->FindType(p.type))
+            if (IsBufferType(*t))
+              buffers.insert(p.type);
+    for (PinTypeId id : buffers) {
+      const PinTypeInfo &t = *m_Catalog->FindType(id);
+      const bool fixedElements =
+          fixed && t.element_id == BuiltinPinType::Float;
+      out << BufferTypeDefinition(t, fixedElements
+                                         ? "efx_q"
+                                         : GetCppTypeForPinType(t.element_id));
+    }
+    const bool tasks = m_Tasks.HasTasks();
+    if (tasks)
+      out << TaskRuntimePrelude();
+    if (reactive)
+      out << ReactiveRuntimePrelude(m_Reactive);
+    if (!options.lut_probe && !m_Tables.empty())
+      out << LookupTablePrelude();
+
+    // 4) global declarations for data pins. Inputs start at their instance
+    // value or schema default and are refreshed from their link before use.
+    out << "// Incremented once per loop(); pure nodes run at most once per "
+           "tick\n";
+    out << "static uint32_t g_efusion_tick = 0;\n";
+    for (uint32_t t = 0; t < m_Tasks.tasks.size(); ++t)
+      if (!m_Tasks.tasks[t].loop)
+        out << "static uint32_t g_efusion_tick_" << TaskName(t) << " = 0;\n";
+    out << "\n";
+    out << "// Global pin variables (automatically declared)\n";
+    for (uint32_t i = 0; i < count; ++i) {
+      const auto &entry = index.nodes[i];
+      for (const auto &p : entry.inputs) {
+        if (p.exec)
+          continue;
+        std::string init = InitialValueForInput(*nodes[i], p);
+        out << PinCppType(p) << " " << VarNameForSlot(entry, p)
+            << (init.empty() ? "" : " = " + init) << ";\n";
       }
-      // outputs
-      for (const auto &p : schema.outputs) {
-        registerPinVar(ni, p.id.empty() ? p.name : p.id, p.type);
+      for (const auto &p : entry.outputs) {
+        if (p.exec)
+          continue;
+        out << PinCppType(p) << " " << VarNameForSlot(entry, p) << ";\n";
       }
     }
-
-    // 5) write global declarations
-    out << "// Global pin variables (automatically declared)\n";
-    for (const auto &v : declaredVars) {
-      auto it = varToType.find(v);
-      std::string cppType = (it != varToType.end()) ? it->second : "auto";
-      out << cppType << " " << v << ";\n";
+    // Values of the previous run, for the change tests of reactive nodes
+    for (uint32_t i = 0; i < count; ++i) {
+      if (!IsScheduled(i) || m_Reactive.down[m_Reactive.bit[i]].empty())
+        continue;
+      const auto &entry = index.nodes[i];
+      for (const auto &p : entry.outputs)
+        if (!p.exec)
+          out << "static " << PinCppType(p) << " " << PrevVarForSlot(entry, p)
+              << ";\n";
+    }
+    for (const auto &m : m_Tasks.mailboxes) {
+      const auto &src = index.nodes[m.src_node];
+      out << "efx_mailbox<" << PinCppType(src.outputs[m.src_pin]) << "> "
+          << MailboxName(m) << ";\n";
     }
     out << "\n";
-
-    // 6) forward prototypes for node functions
-    for (const auto &ni : nodes) {
-      std::string inst = SanitizeIdentifier(ni.InstanceID);
-      out << "void node_" << inst << "();\n";
+    const TelemetryManifest telemetry = ResolveWatches(options);
+    if (!telemetry.vars.empty())
+      out << TelemetryRuntime(options.telemetry, telemetry);
+
+    // 5) forward prototypes for node functions
+    for (uint32_t i = 0; i < count; ++i) {
+      std::string inst = SanitizeIdentifier(index.nodes[i].instance_id);
+      if (index.nodes[i].IsPure()) {
+        out << "static uint32_t eval_tick_" << inst << " = UINT32_MAX;\n";
+        out << "void eval_" << inst << "();\n";
+      } else {
+        out << "void node_" << inst << "();\n";
+      }
     }
     out << "\n";
 
-    // 7) Build bodies for each node instance
+    // 6) primitives, once per schema. Skeletons exchange values with the
+    // graph through port_<schema>_<pin> globals.
     std::ostringstream bodies; // accumulate bodies before output
-    for (const auto &ni : nodes) {
-      auto maybeSchema = FindSchemaInfoById(ni.TypeID);
-      if (!maybeSchema) {
-        // fallback: stub
-        std::string inst = SanitizeIdentifier(ni.InstanceID);
-        bodies << "// Stub for unknown schema: " << ni.TypeID << " ("
-               << ni.InstanceID << ")\n";
-        bodies << "void node_" << inst << "() {\n";
-        bodies << "    // Unknown node type '" << ni.TypeID
-               << "'. Implement or provide skeleton.\n";
-        bodies << "}\n\n";
+    std::set<std::string> emittedSchemas;
+    std::map<std::string, StateMachineInfo> machines;
+    std::ostringstream scratch;
+    for (uint32_t i = 0; i < count; ++i) {
+      const auto &entry = index.nodes[i];
+      if (!emittedSchemas.insert(entry.type_id).second)
         continue;
-      }
-
-      const SchemaInfo &schema = *maybeSchema;
-
-      // special-case branch (we generate inline)
-      if (schema.id == "branch") {
-        PopulatePrimitiveBranch(schema, ni, bodies, declaredVars);
+      if (IsMachineNode(i)) {
+        StateMachineInfo m;
+        std::string error;
+        if (!ReadStateMachineFile(machinesDir() / entry.type_id /
+                                      "machine.json",
+                                  entry.type_id, m, error)) {
+          std::cerr << "Transpilation: " << error << "\n";
+          return false;
+        }
+        bodies << StateMachineDefinition(m);
+        machines.emplace(entry.type_id, std::move(m));
         continue;
       }
+      scratch.str("");
+      if (entry.type_id == "branch" || EmitBuiltinPrimitive(i, scratch))
+        continue;
+
+      const SchemaInfo &schema = *FindSchema(entry.type_id);
+      for (const auto &p : schema.inputs)
+        if (p.type_id != BuiltinPinType::Exec)
+          out << GetCppTypeForPinType(p.type_id) << " "
+              << SanitizeIdentifier("port_" + schema.id + "_" +
+                                    (p.id.empty() ? p.name : p.id))
+              << ";\n";
+      for (const auto &p : schema.outputs)
+        if (p.type_id != BuiltinPinType::Exec)
+          out << GetCppTypeForPinType(p.type_id) << " "
+              << SanitizeIdentifier("port_" + schema.id + "_" +
+                                    (p.id.empty() ? p.name : p.id))
+              << ";\n";
 
       // Otherwise try to find an existing skeleton file named <id>.cpp
       // in primitives/ or functions/ (we search both)
       std::vector<fs::path> candidateDirs = {
-          fs::path(m_Path) / "primitives" / schema.id,
-          fs::path(m_Path) / "functions" / schema.id,
-          fs::path(m_Path) / "types" / schema.id,
+          m_Library->Root() / "primitives" / schema.id,
+          m_Library->Root() / "functions" / schema.id,
+          m_Library->Root() / "types" / schema.id,
       };
 
       bool usedExternalSkeleton = false;
       for (auto &d : candidateDirs) {
         fs::path skeleton = d / (schema.id + ".cpp");
         if (fs::exists(skeleton)) {
-          // include skeleton contents as a helper function primitive_<id>
           std::ifstream sk(skeleton);
           if (sk.is_open()) {
             std::string content((std::istreambuf_iterator<char>(sk)),
                                 std::istreambuf_iterator<char>());
-            // Option A: insert the skeleton content directly into bodies.
             bodies << "// Included skeleton for primitive " << schema.id
                    << " (from " << skeleton << ")\n";
             bodies << content << "\n\n";
-            usedExternalSkeleton = true;
+            // Older skeletons were comments only, the stub still defines
+            // what the instances call
+            usedExternalSkeleton =
+                content.find(SkeletonFunctionName(schema)) != std::string::npos;
             break;
           }
         }
       }
 
-      // If external skeleton present, create a wrapper node function that calls
-      // it
-      std::string inst = SanitizeIdentifier(ni.InstanceID);
-      if (usedExternalSkeleton) {
-        bodies << "void node_" << inst << "() {\n";
-        bodies << "    // wrapper for primitive " << schema.id << "\n";
-        bodies << "    primitive_" << schema.id << "();\n";
+      if (!usedExternalSkeleton) {
+        bodies << "// Primitive " << schema.id << " (auto-generated stub)\n";
+        bodies << "void " << SkeletonFunctionName(schema) << "() {\n";
+        bodies << "    // TODO: implement primitive '" << schema.id
+               << "' or provide a skeleton file in primitives/" << schema.id
+               << "/" << schema.id << ".cpp\n";
         bodies << "}\n\n";
+      }
+    }
+    out << "\n";
+
+    // 7) Build bodies for each node instance
+    for (uint32_t i = 0; i < count; ++i) {
+      const auto &entry = index.nodes[i];
+      const SchemaInfo &schema = *FindSchema(entry.type_id);
+      std::string inst = SanitizeIdentifier(entry.instance_id);
+
+      // special-case branch (we generate inline)
+      if (schema.id == "branch") {
+        PopulatePrimitiveBranch(schema, i, bodies);
+        continue;
+      }
+      if (schema.kind_id == SchemaKind::Machine) {
+        PopulateStateMachine(machines.at(schema.id), i, bodies);
         continue;
       }
 
-      // Otherwise produce a minimal stub that calls a primitive_<id>()
-      // placeholder
-      bodies << "// Primitive " << schema.id
-             << " (auto-generated stub for instance " << ni.InstanceID << ")\n";
-      bodies << "void primitive_" << schema.id << "() {\n";
-      bodies << "    // TODO: implement primitive '" << schema.id
-             << "' or provide a skeleton file in primitives/" << schema.id
-             << "/" << schema.id << ".cpp\n";
-      bodies << "}\n\n";
+      const bool pure = entry.IsPure();
+      const LookupTable *table = TableFor(i);
+      for (size_t o = 0; table && o < table->outputs.size(); ++o)
+        bodies << LookupTableDefinition(
+            *table, o,
+            LookupTableName(entry, entry.outputs[table->outputs[o]]));
+      if (pure) {
+        bodies << "void eval_" << inst << "() {\n";
+        // Mark before pulling so a data cycle reuses last tick's value
+        // instead of recursing.
+        const std::string tick = TickVarFor(i);
+        bodies << "    if (eval_tick_" << inst << " == " << tick << ")\n";
+        bodies << "        return;\n";
+        bodies << "    eval_tick_" << inst << " = " << tick << ";\n";
+      } else {
+        bodies << "void node_" << inst << "() {\n";
+      }
+
+      if (table)
+        EmitLookupTableRead(*table, bodies);
+      else
+        EmitInputPulls(i, bodies);
+      if (!table && !EmitBuiltinPrimitive(i, bodies)) {
+        // Skeletons are hand-written against float ports, fixed-point
+        // values are converted at this boundary.
+        auto port = [&](const GraphIndex::PinSlot &p) {
+          return SanitizeIdentifier("port_" + schema.id + "_" + p.id);
+        };
+        for (const auto &p : entry.inputs) {
+          if (p.exec)
+            continue;
+          const std::string var = VarNameForSlot(entry, p);
+          bodies << "    " << port(p) << " = "
+                 << (IsFixedSlot(p) ? "efx_to_float(" + var + ")" : var)
+                 << ";\n";
+        }
+        bodies << "    " << SkeletonFunctionName(schema) << "();\n";
+        for (const auto &p : entry.outputs) {
+          if (p.exec)
+            continue;
+          bodies << "    " << VarNameForSlot(entry, p) << " = "
+                 << (IsFixedSlot(p) ? "efx_from_float(" + port(p) + ")"
+                                    : port(p))
+                 << ";\n";
+        }
+      }
 
-      bodies << "void node_" << inst << "() {\n";
-      bodies << "    // calls primitive for " << schema.id << "\n";
-      bodies << "    primitive_" << schema.id << "();\n";
+      // Publish to the tasks reading this node
+      for (const auto &m : m_Tasks.mailboxes)
+        if (m.src_node == i)
+          bodies << "    " << MailboxName(m) << ".write("
+                 << VarNameForSlot(entry, entry.outputs[m.src_pin]) << ");\n";
+
+      if (IsScheduled(i)) {
+        EmitReactivePropagation(i, bodies);
+      } else if (!pure) {
+        for (uint32_t o = 0; o < entry.outputs.size(); ++o)
+          if (entry.outputs[o].exec)
+            EmitExecSuccessors(i, o, bodies, "    ");
+      }
       bodies << "}\n\n";
     }
 
@@ -540,132 +1203,2058 @@ void ViewportMainSketchAppWindow::Transpilation() {
     // 8) write setup() and loop()
     // find setup and loop instances
     std::string setupInstance, loopInstance;
-    for (const auto &ni : nodes) {
-      if (ni.TypeID == "setup")
-        setupInstance = ni.InstanceID;
-      else if (ni.TypeID == "loop")
-        loopInstance = ni.InstanceID;
+    for (const auto *ni : nodes) {
+      if (ni->TypeID == "setup")
+        setupInstance = ni->InstanceID;
+      else if (ni->TypeID == "loop")
+        loopInstance = ni->InstanceID;
+    }
+
+    // Task entry points, one per backend of TaskRuntimePrelude()
+    for (uint32_t t = 0; tasks && t < m_Tasks.tasks.size(); ++t) {
+      if (m_Tasks.tasks[t].loop)
+        continue;
+      const std::string name = TaskName(t);
+      const int period =
+          std::max(1, TaskParameter(m_Tasks.tasks[t].root, "period_ms", 10));
+      out << "// ---- task " << name << ": every " << period << " ms ----\n";
+      out << "static void task_step_" << name << "() {\n";
+      out << "    ++g_efusion_tick_" << name << ";\n";
+      out << "    node_" << name << "();\n";
+      out << "}\n";
+      out << "#if defined(EFX_TASKS_FREERTOS)\n";
+      out << "static void task_entry_" << name << "(void *) {\n";
+      out << "    TickType_t last = xTaskGetTickCount();\n";
+      out << "    for (;;) {\n";
+      out << "        task_step_" << name << "();\n";
+      out << "        vTaskDelayUntil(&last, pdMS_TO_TICKS(" << period
+          << ") ? pdMS_TO_TICKS(" << period << ") : 1);\n";
+      out << "    }\n";
+      out << "}\n";
+      out << "#elif defined(EFX_TASKS_THREAD)\n";
+      out << "static void task_entry_" << name << "() {\n";
+      out << "    auto next = std::chrono::steady_clock::now();\n";
+      out << "    for (;;) {\n";
+      out << "        task_step_" << name << "();\n";
+      out << "        next += std::chrono::milliseconds(" << period << ");\n";
+      out << "        std::this_thread::sleep_until(next);\n";
+      out << "    }\n";
+      out << "}\n";
+      out << "#else\n";
+      out << "static unsigned long task_due_" << name << " = 0;\n";
+      out << "#endif\n\n";
     }
 
     out << "// ---- Arduino entry points ----\n";
     out << "void setup() {\n";
-    out << "    Serial.begin(115200);\n";
+    out << "    Serial.begin(" << options.telemetry.baud << ");\n";
     if (!setupInstance.empty()) {
       out << "    // Transpiled setup node\n";
       out << "    node_" << SanitizeIdentifier(setupInstance) << "();\n";
     } else {
       out << "    // No setup node found in graph\n";
     }
+    if (options.lut_probe)
+      EmitLookupProbe(out);
+    // Tasks start once setup is done, it may write what they read
+    for (uint32_t t = 0; tasks && t < m_Tasks.tasks.size(); ++t) {
+      if (m_Tasks.tasks[t].loop)
+        continue;
+      const std::string name = TaskName(t);
+      const int core = TaskParameter(m_Tasks.tasks[t].root, "core", 0);
+      out << "#if defined(EFX_TASKS_FREERTOS)\n";
+      out << "    xTaskCreatePinnedToCore(task_entry_" << name << ", \"" << name
+          << "\", EFX_TASK_STACK, nullptr, 1, nullptr, " << core
+          << " < portNUM_PROCESSORS ? " << core << " : tskNO_AFFINITY);\n";
+      out << "#elif defined(EFX_TASKS_THREAD)\n";
+      out << "    std::thread(task_entry_" << name << ").detach();\n";
+      out << "#endif\n";
+    }
     out << "}\n\n";
 
     out << "void loop() {\n";
-    if (!loopInstance.empty()) {
+    out << "    ++g_efusion_tick;\n";
+    if (reactive && !loopInstance.empty()) {
+      out << "    // Reactive loop chain: sample the inputs, then run the "
+             "dirty nodes\n";
+      out << BitMaskStatements("g_efusion_dirty", m_Reactive.sampled, true,
+                               "    ");
+      for (uint32_t b = 0; b < m_Reactive.order.size(); ++b)
+        out << "    if (efx_take(" << b << "))\n        node_"
+            << SanitizeIdentifier(index.nodes[m_Reactive.order[b]].instance_id)
+            << "();\n";
+    } else if (!loopInstance.empty()) {
       out << "    // Transpiled loop node (single call per loop)\n";
       out << "    node_" << SanitizeIdentifier(loopInstance) << "();\n";
-    } else {
+    } else if (!tasks) {
       out << "    // No loop node found in graph - idle\n";
       out << "    delay(1000);\n";
     }
+    for (uint32_t t = 0; tasks && t < m_Tasks.tasks.size(); ++t) {
+      if (m_Tasks.tasks[t].loop)
+        continue;
+      const std::string name = TaskName(t);
+      const int period =
+          std::max(1, TaskParameter(m_Tasks.tasks[t].root, "period_ms", 10));
+      out << "#if defined(EFX_TASKS_COOPERATIVE)\n";
+      out << "    if ((long)(millis() - task_due_" << name << ") >= 0) {\n";
+      out << "        task_due_" << name << " += " << period << ";\n";
+      out << "        task_step_" << name << "();\n";
+      out << "    }\n";
+      out << "#endif\n";
+    }
+    if (!telemetry.vars.empty())
+      out << "    efx_telemetry_step();\n";
+    // Float pin values after each tick, printed by the simulator's --probe
+    // mode for CompareFixedPoint()
+    out << "#ifdef EFUSION_SIM\n";
+    for (uint32_t i = 0; i < count; ++i) {
+      // Pins of other tasks are not ours to read
+      const uint32_t task = m_Tasks.owner[i];
+      if (task < m_Tasks.tasks.size() && !m_Tasks.tasks[task].loop)
+        continue;
+      const auto &entry = index.nodes[i];
+      for (const auto &p : entry.outputs) {
+        if (p.exec || (p.type != BuiltinPinType::Float &&
+                       p.storage != BuiltinPinType::Float))
+          continue;
+        const std::string var = VarNameForSlot(entry, p);
+        out << "    efusion_sim_probe(\"" << var << "\", "
+            << (fixed ? "(double)" + var + " / EFX_ONE" : var) << ");\n";
+      }
+    }
+    out << "#endif\n";
     out << "}\n";
 
+    EFUSION_TRACE_WRITE(static_cast<uint64_t>(out.tellp()));
     out.close();
 
-    std::cout << "Transpilation: main.cpp written to " << mainCpp << "\n";
+    // What the editor needs to decode the stream
+    const fs::path manifestFile = mainCpp.parent_path() / "telemetry.json";
+    std::error_code ec;
+    if (telemetry.vars.empty())
+      fs::remove(manifestFile, ec);
+    else if (!telemetry.Write(manifestFile))
+      std::cerr << "Transpilation: failed to write " << manifestFile << "\n";
 
+    std::cout << "Transpilation: main.cpp written to " << mainCpp << "\n";
+    return true;
   } catch (const std::exception &e) {
     std::cerr << "Transpilation exception: " << e.what() << "\n";
+    return false;
   }
 }
 
-void ViewportMainSketchAppWindow::DrawMainMenu() {
-  ImGui::Text("-------");
-  if (ImGui::Button("Setup")) {
-    m_Explorer.currentNode = m_NodeEngine.FindNodeByInstanceID("setup_1");
-    if (m_Explorer.currentNode)
-      m_Explorer.state = ExplorerState::ExploringNode;
-  }
-  if (ImGui::Button("Loop")) {
-    m_Explorer.currentNode = m_NodeEngine.FindNodeByInstanceID("loop_1");
-    if (m_Explorer.currentNode)
-      m_Explorer.state = ExplorerState::ExploringNode;
-  }
-  if (ImGui::Button("Quitter")) {
-    m_Explorer.state = ExplorerState::Exit;
+void ViewportMainSketchAppWindow::Build() {
+  if (IsLoading())
+    return;
+  if (m_Build->IsRunning()) {
+    std::cerr << "Build: a build is already running" << std::endl;
+    return;
   }
-}
-void ViewportMainSketchAppWindow::DrawNodeExplorer() {
-  Node *node = m_Explorer.currentNode;
-  if (!node) {
-    ImGui::Text("Node not founded");
-    m_Explorer.state = ExplorerState::MainMenu;
+  // Planned lookup tables are evaluated first, ApplyLookupProbe() builds
+  if (m_LutPending) {
+    ProbeJob job{m_LutPending->source,
+                 fs::path(m_Path) / "transpilation" / "lut",
+                 "--probe --loops 1",
+                 std::chrono::milliseconds(m_LutPending->timeout_ms)};
+    if (m_Build->Start(BuildSettingsForSketch(), std::move(job), false))
+      m_LutRunning = std::exchange(m_LutPending, std::nullopt);
     return;
   }
+  m_Build->Start(BuildSettingsForSketch());
+}
 
-  CherryKit::SeparatorText(("Exploring: " + node->Name).c_str());
-  ImGui::Spacing();
+void ViewportMainSketchAppWindow::DrawBuildStatus() {
+  const bool built = m_Build->Poll();
+  if (auto probe = m_Build->TakeProbe())
+    ApplyLookupProbe(*probe);
+  if (built) {
+    const BuildResult &r = *m_Build->LastResult();
+    (r.ok ? std::cout : std::cerr)
+        << "Build " << (r.ok ? "succeeded" : "failed") << " (" << r.toolchain
+        << ") in " << r.compile_ms << " ms, " << r.cache_hits << "/"
+        << r.units << " from cache\n"
+        << r.log << std::flush;
+    if (r.ok)
+      m_SizeReport = AttributeSizes(r.symbols, GeneratedSymbolOwners());
+  }
 
-  if (!node->Inputs.empty()) {
-    ImGui::Text("Inputs");
-    ImGui::Separator();
+  if (m_Build->IsRunning()) {
+    ImGui::Text(m_LutRunning ? "Evaluating lookup tables..." : "Building...");
+    return;
+  }
+  if (const auto &r = m_Build->LastResult())
+    ImGui::Text("Build %s (%s): %.0f ms, %zu/%zu cached, session hit rate "
+                "%.0f%%",
+                r->ok ? "ok" : "FAILED", r->toolchain.c_str(), r->compile_ms,
+                r->cache_hits, r->units, m_Build->HitRate() * 100.0);
+}
 
-    for (auto &input : node->Inputs) {
-      std::string pinStr = input.Name;
-      auto linked =
-          m_Graph.GetAllNodesLinkedToInputInstanceID(node->InstanceID, pinStr);
+void ViewportMainSketchAppWindow::CompareFixedPoint() {
+  if (m_ComparePending.valid())
+    return;
 
-      ImGui::Text("Pin: %s (%s)", input.Name.c_str(), pinStr.c_str());
+  const BuildSettings settings = BuildSettingsForSketch();
+  TranspileOptions floatOptions = TranspileOptionsForSketch();
+  floatOptions.floats = FloatLowering::Float;
+  TranspileOptions fixedOptions = floatOptions;
+  fixedOptions.floats = FloatLowering::Fixed;
+
+  // Transpile on this thread (it reads the graph), build and run in the
+  // background.
+  const fs::path root = m_Path;
+  const fs::path dir = root / "transpilation" / "compare";
+  const fs::path floatCpp = dir / "float" / "main.cpp";
+  const fs::path fixedCpp = dir / "fixed" / "main.cpp";
+  const bool transpiled = TranspileTo(floatCpp, floatOptions) &&
+                          TranspileTo(fixedCpp, fixedOptions);
+  if (!transpiled) {
+    m_Compare.emplace();
+    m_Compare->error = "transpilation failed";
+    return;
+  }
 
-      if (linked.empty()) {
-        ImGui::BulletText("No connection");
-      } else {
-        for (auto &conn : linked) {
-          Node *target = m_NodeEngine.FindNodeByInstanceID(conn);
-          if (target) {
-            if (ImGui::Selectable(("<- " + target->Name).c_str())) {
-              m_Explorer.currentNode = target;
-            }
-          } else {
-            ImGui::BulletText("Invalid connection : %s", conn.c_str());
-          }
-        }
+  const auto cancel = m_Build->CancelFlag();
+  m_ComparePending = std::async(std::launch::async, [=]() {
+    CommandCancelScope scope(cancel);
+    constexpr unsigned long kLoops = 1000;
+    FixedPointCompare c;
+    c.options = fixedOptions;
+    c.loops = kLoops;
+
+    std::string outputs[2];
+    const fs::path sources[2] = {floatCpp, fixedCpp};
+    for (int k = 0; k < 2; ++k) {
+      const fs::path exe = sources[k].parent_path() / SimExecutableName();
+      const BuildResult r =
+          BuildPipeline::RunHost(root, sources[k], exe, settings);
+      if (!r.ok) {
+        c.error = "build of " + sources[k].string() + " failed:\n" + r.log;
+        return c;
       }
-      ImGui::Spacing();
+      const std::string cmd = ShellQuote(exe.string()) + " --loops " +
+                              std::to_string(kLoops) + " --probe";
+      if (RunCommand(cmd, outputs[k]) != 0) {
+        c.error = exe.string() + " failed:\n" + outputs[k];
+        return c;
+      }
+    }
+    c.probes = CompareProbes(outputs[0], outputs[1]);
+    c.ok = true;
+    return c;
+  });
+}
+
+void ViewportMainSketchAppWindow::DrawFixedPointCompare() {
+  if (m_ComparePending.valid() &&
+      m_ComparePending.wait_for(std::chrono::seconds(0)) ==
+          std::future_status::ready) {
+    try {
+      m_Compare = m_ComparePending.get();
+    } catch (const std::exception &e) {
+      m_Compare.emplace();
+      m_Compare->error = e.what();
     }
+    if (!m_Compare->ok)
+      std::cerr << "CompareFixedPoint: " << m_Compare->error << std::endl;
   }
 
-  if (!node->Outputs.empty()) {
-    ImGui::Text("Outputs");
-    ImGui::Separator();
+  if (!ImGui::CollapsingHeader("Fixed-point accuracy"))
+    return;
+  if (m_ComparePending.valid()) {
+    ImGui::Text("Comparing...");
+    return;
+  }
+  if (ImGui::Button("Compare fixed vs float"))
+    CompareFixedPoint();
+  if (!m_Compare)
+    return;
+  if (!m_Compare->ok) {
+    ImGui::TextColored(ImVec4(1.0f, 0.3f, 0.3f, 1.0f), "Failed: %s",
+                       m_Compare->error.c_str());
+    return;
+  }
+
+  const int frac = m_Compare->options.frac_bits;
+  ImGui::Text("Q%d.%d, %lu loops, %zu float outputs probed", 31 - frac, frac,
+              m_Compare->loops, m_Compare->probes.size());
+  // One LSB of the Q format is the best a fixed-point pin can do
+  const double lsb = std::ldexp(1.0, -frac);
+  for (const auto &p : m_Compare->probes) {
+    const bool exact = p.max_abs <= lsb;
+    ImGui::TextColored(exact ? ImVec4(0.4f, 0.9f, 0.4f, 1.0f)
+                             : ImVec4(1.0f, 0.6f, 0.2f, 1.0f),
+                       "max %.3g  mean %.3g  (%zu samples)", p.max_abs,
+                       p.mean_abs, p.samples);
+    ImGui::SameLine();
+    ImGui::Text("%s", p.name.c_str());
+  }
+}
 
-    for (auto &output : node->Outputs) {
-      std::string pinStr = output.Name;
-      auto linked =
-          m_Graph.GetAllNodesLinkedToOutputInstanceID(node->InstanceID, pinStr);
+TelemetryManifest
+ViewportMainSketchAppWindow::ResolveWatches(const TranspileOptions &options) {
+  TelemetryManifest m;
+  m.baud = options.telemetry.baud;
+  m.frac_bits = options.frac_bits;
+  for (const auto &w : options.telemetry.watch) {
+    const size_t dot = w.rfind('.');
+    const uint32_t node = dot == std::string::npos
+                              ? GraphIndex::npos
+                              : m_GraphIndex.Find(w.substr(0, dot));
+    const GraphIndex::PinSlot *slot = nullptr;
+    if (node != GraphIndex::npos)
+      for (const auto &p : m_GraphIndex.nodes[node].outputs)
+        if (!p.exec && p.id == w.substr(dot + 1))
+          slot = &p;
+    if (!slot) {
+      std::cerr << "Telemetry: no data output " << w << ", not watched\n";
+      continue;
+    }
+    // Pins of other tasks are not ours to read
+    const uint32_t task = m_Tasks.owner[node];
+    if (task < m_Tasks.tasks.size() && !m_Tasks.tasks[task].loop) {
+      std::cerr << "Telemetry: " << w << " runs in task " << TaskName(task)
+                << ", not watched\n";
+      continue;
+    }
+    static const std::unordered_map<std::string, TelemetryKind> kinds = {
+        {"int", TelemetryKind::Int},       {"bool", TelemetryKind::Bool},
+        {"char", TelemetryKind::Char},     {"float", TelemetryKind::Float},
+        {"double", TelemetryKind::Double}, {"efx_q", TelemetryKind::Fixed}};
+    auto kind = kinds.find(PinCppType(*slot));
+    if (kind == kinds.end()) {
+      std::cerr << "Telemetry: " << w << " is not a scalar, not watched\n";
+      continue;
+    }
+    if (m.vars.size() == kMaxWatched) {
+      std::cerr << "Telemetry: more than " << kMaxWatched
+                << " watched pins, the rest are ignored\n";
+      break;
+    }
+    m.vars.push_back({m_GraphIndex.nodes[node].instance_id, slot->id,
+                      VarNameForSlot(m_GraphIndex.nodes[node], *slot),
+                      kind->second});
+  }
+  return m;
+}
 
-      ImGui::Text("Pin: %s (%s)", output.Name.c_str(), pinStr.c_str());
+void ViewportMainSketchAppWindow::LoadTelemetrySettings() {
+  m_Telemetry.settings = TranspileOptionsForSketch().telemetry;
+  m_Telemetry.loaded = true;
+}
 
-      if (linked.empty()) {
-        ImGui::BulletText("No connection");
-      } else {
-        for (auto &conn : linked) {
-          Node *target = m_NodeEngine.FindNodeByInstanceID(conn);
-          if (target) {
-            if (ImGui::Selectable(("-> " + target->Name).c_str())) {
-              m_Explorer.currentNode = target;
-            }
-          } else {
-            ImGui::BulletText("Invalid connection : %s", conn.c_str());
-          }
-        }
-      }
-      ImGui::Spacing();
+void ViewportMainSketchAppWindow::WatchSelection(bool watch) {
+  if (m_GraphDirty)
+    BuildGraphIndex();
+  json settings = json::object();
+  if (auto existing = ReadDocument(sketchSettingsFile()))
+    if (existing->is_object())
+      settings = *existing;
+  TelemetrySettings t =
+      TelemetrySettings::FromJson(settings.value("telemetry", json::object()));
+
+  for (const auto &id : SelectedInstanceIds()) {
+    const uint32_t node = m_GraphIndex.Find(id);
+    if (node == GraphIndex::npos)
+      continue;
+    for (const auto &p : m_GraphIndex.nodes[node].outputs) {
+      if (p.exec)
+        continue;
+      const std::string w = id + "." + p.id;
+      auto it = std::find(t.watch.begin(), t.watch.end(), w);
+      if (watch && it == t.watch.end())
+        t.watch.push_back(w);
+      else if (!watch && it != t.watch.end())
+        t.watch.erase(it);
     }
   }
+  settings["telemetry"] = t.ToJson();
+  if (!WriteDocument(sketchSettingsFile(), settings, DocumentFormat::Json,
+                     true))
+    std::cerr << "WatchSelection: failed to write " << sketchSettingsFile()
+              << std::endl;
+  m_Telemetry.settings = std::move(t);
+}
 
-  ImGui::Separator();
+void ViewportMainSketchAppWindow::StartTelemetry() {
+  StopTelemetry();
+  if (m_Telemetry.build.valid()) {
+    m_Telemetry.status = "the simulator is still building";
+    return;
+  }
+  const TranspileOptions options = TranspileOptionsForSketch();
+  m_Telemetry.settings = options.telemetry;
+  if (!options.telemetry.Enabled()) {
+    m_Telemetry.status = "no watched pin";
+    return;
+  }
+  const fs::path root = m_Path;
+  const fs::path mainCpp = root / "transpilation" / "build" / "main.cpp";
+  TelemetryManifest manifest;
+  if (!TranspileTo(mainCpp, options) ||
+      !TelemetryManifest::Read(mainCpp.parent_path() / "telemetry.json",
+                               manifest)) {
+    m_Telemetry.status = "transpilation failed";
+    return;
+  }
+  m_Telemetry.decoder = TelemetryDecoder(manifest);
+
+  const std::string &device = options.telemetry.device;
+  if (!device.empty()) {
+    std::string error;
+    m_Telemetry.status = m_Telemetry.link.OpenDevice(
+                             device, options.telemetry.baud, error)
+                             ? "reading " + device
+                             : error;
+    return;
+  }
+  // Simulator: built in the background, started by PollTelemetry()
+  const fs::path dir = root / "transpilation" / "telemetry";
+  std::error_code ec;
+  fs::create_directories(dir, ec);
+  const fs::path exe = dir / SimExecutableName();
+  const BuildSettings settings = BuildSettingsForSketch();
+  m_Telemetry.simulator = exe;
+  m_Telemetry.wanted = true;
+  const auto cancel = m_Build->CancelFlag();
+  m_Telemetry.build = std::async(std::launch::async, [=]() {
+    CommandCancelScope scope(cancel);
+    return BuildPipeline::RunHost(root, mainCpp, exe, settings);
+  });
+  m_Telemetry.status = "building the simulator...";
+}
+
+void ViewportMainSketchAppWindow::StopTelemetry() {
+  m_Telemetry.wanted = false;
+  if (m_Telemetry.link.IsOpen())
+    m_Telemetry.status = "stopped";
+  m_Telemetry.link.Close();
+}
+
+void ViewportMainSketchAppWindow::PollTelemetry() {
+  TelemetryView &t = m_Telemetry;
+  if (t.build.valid()) {
+    if (t.build.wait_for(std::chrono::seconds(0)) !=
+        std::future_status::ready)
+      return;
+    BuildResult r;
+    try {
+      r = t.build.get();
+    } catch (const std::exception &e) {
+      r.log = e.what();
+    }
+    if (!t.wanted)
+      return;
+    if (!r.ok) {
+      t.status = "simulator build failed";
+      std::cerr << "Telemetry: simulator build failed\n" << r.log << std::flush;
+      return;
+    }
+    std::string peer, error;
+    if (!t.link.OpenPty(peer, error) ||
+        !t.link.Spawn({t.simulator.string(), "--serial", peer}, error)) {
+      t.status = error;
+      t.link.Close();
+      return;
+    }
+    t.status = "simulator on " + peer;
+  }
+  if (!t.link.IsOpen())
+    return;
+  t.bytes.clear();
+  const bool alive = t.link.Read(t.bytes);
+  t.decoder.Feed(t.bytes.data(), t.bytes.size());
+  if (!alive) {
+    t.link.Close();
+    t.status += " (closed)";
+  }
+}
+
+void ViewportMainSketchAppWindow::DrawTelemetry() {
+  if (!ImGui::CollapsingHeader("Telemetry"))
+    return;
+  TelemetryView &t = m_Telemetry;
+  if (!t.loaded)
+    LoadTelemetrySettings();
+  ImGui::Text("%zu watched pin(s), %u baud, %s", t.settings.watch.size(),
+              t.settings.baud,
+              t.settings.device.empty() ? "host simulator"
+                                        : t.settings.device.c_str());
+  if (ImGui::Button("Watch selection"))
+    WatchSelection(true);
+  ImGui::SameLine();
+  if (ImGui::Button("Unwatch selection"))
+    WatchSelection(false);
+  ImGui::SameLine();
+  if (t.link.IsOpen() || t.build.valid()) {
+    if (ImGui::Button("Stop"))
+      StopTelemetry();
+  } else if (ImGui::Button("Start")) {
+    StartTelemetry();
+  }
+  if (!t.status.empty())
+    ImGui::Text("%s", t.status.c_str());
+
+  const auto &vars = t.decoder.Manifest().vars;
+  if (vars.empty())
+    return;
+  ImGui::Text("%zu frames, %zu lost, %zu bad, %s", t.decoder.frames,
+              t.decoder.lost, t.decoder.bad_frames,
+              t.decoder.Synced() ? "synced" : "waiting for a key frame");
+  for (size_t v = 0; v < vars.size(); ++v) {
+    ImGui::PushID(static_cast<int>(v));
+    const std::string value =
+        t.decoder.Synced() ? t.decoder.Format(v) : std::string("?");
+    if (ImGui::Selectable((vars[v].instance + "." + vars[v].pin + " = " +
+                           value)
+                              .c_str()))
+      FocusNode(vars[v].instance);
+    ImGui::PopID();
+  }
+}
+
+void ViewportMainSketchAppWindow::DrawTelemetryOverlay() {
+  const TelemetryDecoder &d = m_Telemetry.decoder;
+  if (!m_Telemetry.link.IsOpen() || !d.Synced())
+    return;
+  // Under each node, one line per watched output
+  ImDrawList *draw = ImGui::GetWindowDrawList();
+  const float line = ImGui::GetTextLineHeight();
+  std::unordered_map<std::string, int> rows;
+  const auto &vars = d.Manifest().vars;
+  for (size_t v = 0; v < vars.size(); ++v) {
+    Node *node = m_NodeEngine.FindNodeByInstanceID(vars[v].instance);
+    if (!node)
+      continue; // collapsed into a group
+    const ImVec2 pos = ed::GetNodePosition(node->ID);
+    const ImVec2 size = ed::GetNodeSize(node->ID);
+    const ImVec2 at = ed::CanvasToScreen(ImVec2(pos.x, pos.y + size.y + 4.0f));
+    const int row = rows[vars[v].instance]++;
+    const std::string text = vars[v].pin + " = " + d.Format(v);
+    draw->AddText(ImVec2(at.x, at.y + row * line), IM_COL32(120, 230, 140, 255),
+                  text.c_str());
+  }
+}
+
+void ViewportMainSketchAppWindow::DrawTracing() {
+  if (!ImGui::CollapsingHeader("Tracing"))
+    return;
+  const bool tracing = EmbeddedFusion::TracingEnabled();
+  if (ImGui::Button(tracing ? "Stop tracing" : "Start tracing"))
+    EmbeddedFusion::EnableTracing(!tracing);
+  ImGui::SameLine();
+  if (ImGui::Button("Export trace")) {
+    const fs::path file = fs::path(m_Path) / "transpilation" / "trace.json";
+    std::error_code ec;
+    fs::create_directories(file.parent_path(), ec);
+    EmbeddedFusion::LogTraceSummary();
+    if (EmbeddedFusion::ExportTrace(file))
+      std::cout << "Trace exported to " << file
+                << " (open in chrome://tracing or Perfetto)" << std::endl;
+  }
+  ImGui::Text("%s", tracing ? "Recording spans of every window and thread"
+                            : "Not recording");
+}
+
+std::unordered_map<std::string, std::vector<std::string>>
+ViewportMainSketchAppWindow::GeneratedSymbolOwners() {
+  if (m_GraphDirty)
+    BuildGraphIndex();
+
+  std::unordered_map<std::string, std::vector<std::string>> owners;
+  for (const auto &entry : m_GraphIndex.nodes) {
+    const std::string inst = SanitizeIdentifier(entry.instance_id);
+    for (const char *prefix : {"node_", "eval_", "eval_tick_"})
+      owners[prefix + inst].push_back(entry.instance_id);
+    for (const auto &p : entry.inputs)
+      if (!p.exec)
+        owners[VarNameForSlot(entry, p)].push_back(entry.instance_id);
+    for (const auto &p : entry.outputs) {
+      if (p.exec)
+        continue;
+      owners[VarNameForSlot(entry, p)].push_back(entry.instance_id);
+      owners[LookupTableName(entry, p)].push_back(entry.instance_id);
+    }
+
+    // Emitted once per schema, shared by its instances
+    const SchemaInfo *schema = FindSchema(entry.type_id);
+    if (!schema)
+      continue;
+    owners[SkeletonFunctionName(*schema)].push_back(entry.instance_id);
+    for (const auto *pins : {&schema->inputs, &schema->outputs})
+      for (const auto &p : *pins)
+        if (p.type_id != BuiltinPinType::Exec)
+          owners[SanitizeIdentifier("port_" + schema->id + "_" +
+                                    (p.id.empty() ? p.name : p.id))]
+              .push_back(entry.instance_id);
+  }
+  return owners;
+}
+
+void ViewportMainSketchAppWindow::DrawSizeReport() {
+  if (m_SizeReport.empty() || !ImGui::CollapsingHeader("Size by node"))
+    return;
+
+  const SizeReport &r = m_SizeReport;
+  auto percent = [](uint64_t part, uint64_t whole) {
+    return whole ? 100.0 * part / whole : 0.0;
+  };
+  ImGui::Text("Flash %llu B (%.0f%% from nodes), RAM %llu B (%.0f%% from "
+              "nodes)",
+              (unsigned long long)r.total.flash,
+              percent(r.attributed.flash, r.total.flash),
+              (unsigned long long)r.total.ram,
+              percent(r.attributed.ram, r.total.ram));
+
+  // Heat: share of the heaviest node, green to red
+  const size_t maxShown = 24;
+  const auto ranked = r.Ranked();
+  if (ranked.empty())
+    return;
+  const uint64_t heaviest = ranked.front().second.flash + ranked.front().second.ram;
+  for (size_t i = 0; i < ranked.size() && i < maxShown; ++i) {
+    const auto &[instance, f] = ranked[i];
+    const float heat =
+        heaviest ? static_cast<float>(f.flash + f.ram) / heaviest : 0.0f;
+    ImGui::PushID(instance.c_str());
+    ImGui::TextColored(ImVec4(heat, 1.0f - heat, 0.2f, 1.0f),
+                       "%6llu / %5llu B", (unsigned long long)f.flash,
+                       (unsigned long long)f.ram);
+    ImGui::SameLine();
+    ImGui::ProgressBar(heat, ImVec2(80.0f, 0.0f), "");
+    ImGui::SameLine();
+    const uint32_t node = m_GraphIndex.Find(instance);
+    if (ImGui::Selectable(node == GraphIndex::npos
+                              ? instance.c_str()
+                              : ExplorerLabel(node).c_str()))
+      FocusNode(instance);
+    ImGui::PopID();
+  }
+  if (ranked.size() > maxShown)
+    ImGui::Text("... %zu more", ranked.size() - maxShown);
+}
+
+void ViewportMainSketchAppWindow::BuildGraphIndex() {
+  m_GraphIndex.Clear();
+
+  // Flow types have no storage, their data pins fail validation
+  std::unordered_map<PinTypeId, PinTypeId> storage;
+  for (const auto &t : m_Catalog->types)
+    if (t.category_id != PinCategory::Flow)
+      storage.emplace(t.type_id, t.storage_id);
+
+  auto makeSlot = [&](const PinDef &p) {
+    GraphIndex::PinSlot slot;
+    slot.id = p.id.empty() ? p.name : p.id;
+    slot.key = p.GraphKey();
+    slot.type = p.type_id;
+    auto it = storage.find(p.type_id);
+    if (it != storage.end())
+      slot.storage = it->second;
+    slot.exec = p.type_id == BuiltinPinType::Exec;
+    slot.has_default = !p.defaultValue.is_null();
+    return slot;
+  };
+
+  m_IndexedInstances.clear();
+  auto addInstance = [&](const Cherry::NodeSystem::NodeInstance &ni) {
+    GraphIndex::NodeEntry entry;
+    entry.instance_id = ni.InstanceID;
+    entry.type_id = ni.TypeID;
+    if (const SchemaInfo *schema = FindSchema(ni.TypeID)) {
+      entry.known_schema = true;
+      for (const auto &p : schema->inputs)
+        entry.inputs.push_back(makeSlot(p));
+      for (const auto &p : schema->outputs)
+        entry.outputs.push_back(makeSlot(p));
+    }
+    m_GraphIndex.AddNode(std::move(entry));
+    m_IndexedInstances.push_back(&ni);
+  };
+
+  // Links are drawn on the nodes the node graph instantiates, a collapsed
+  // group stands for its members there. Members are endpoints too, for the
+  // links between them that their group recorded.
+  std::vector<GraphEndpoint> endpoints;
+  for (const auto &ni : m_Graph.m_InstanciatedNodes) {
+    auto group = IsGroupTypeId(ni.TypeID) ? m_Subgraphs.find(ni.InstanceID)
+                                          : m_Subgraphs.end();
+    if (group == m_Subgraphs.end()) {
+      addInstance(ni);
+      endpoints.push_back(GraphEndpoint::ForNode(
+          m_GraphIndex,
+          static_cast<uint32_t>(m_GraphIndex.nodes.size() - 1)));
+      continue;
+    }
+    for (const auto &member : group->second.nodes) {
+      addInstance(member);
+      endpoints.push_back(GraphEndpoint::ForNode(
+          m_GraphIndex,
+          static_cast<uint32_t>(m_GraphIndex.nodes.size() - 1)));
+    }
+    endpoints.push_back(
+        GraphEndpoint::ForGroup(m_GraphIndex, ni.InstanceID, group->second));
+  }
+
+  // The node graph's link list names both pins, nothing is guessed
+  LinkResolver links(m_GraphIndex, std::move(endpoints));
+  m_GraphIndex.links.reserve(m_Graph.m_InstanciatedLinks.size());
+  for (const auto &l : m_Graph.m_InstanciatedLinks)
+    links.Add(l.OutputInstanceID, l.OutputPinName, l.InputInstanceID,
+              l.InputPinName);
+  // Links between collapsed members only live in their group's record
+  for (const auto &kv : m_Subgraphs)
+    for (const auto &l : kv.second.links)
+      links.Add(l.src_instance, l.src_pin, l.dst_instance, l.dst_pin);
+
+  m_GraphIndex.Finalize();
+  m_GraphDirty = false;
+  m_Explorer.resultsDirty = true;
+}
+
+void ViewportMainSketchAppWindow::Validate() {
+  if (m_GraphDirty)
+    BuildGraphIndex();
+  m_ValidationDirty = false;
+  m_Validation = ValidateGraph(m_GraphIndex);
+  // Skeleton primitives share their port globals between instances
+  m_Tasks = PartitionTasks(m_GraphIndex,
+                           [this](uint32_t node) { return UsesSkeleton(node); });
+  ValidateTasks(m_GraphIndex, m_Tasks, m_Validation);
+}
+
+bool ViewportMainSketchAppWindow::UsesSkeleton(uint32_t node) {
+  std::ostringstream scratch;
+  const auto &entry = m_GraphIndex.nodes[node];
+  return entry.known_schema && entry.type_id != "branch" &&
+         !IsMachineNode(node) && !EmitBuiltinPrimitive(node, scratch);
+}
+
+int ViewportMainSketchAppWindow::TaskParameter(uint32_t node,
+                                               const std::string &pin,
+                                               int fallback) {
+  for (const auto &p : m_GraphIndex.nodes[node].inputs) {
+    if (p.id != pin)
+      continue;
+    try {
+      return std::stoi(InitialValueForInput(*m_IndexedInstances[node], p));
+    } catch (...) {
+      return fallback;
+    }
+  }
+  return fallback;
+}
+
+void ViewportMainSketchAppWindow::FocusNode(const std::string &instance_id) {
+  Node *node = m_NodeEngine.FindNodeByInstanceID(instance_id);
+  if (!node) {
+    // Collapsed members are shown through their group
+    for (const auto &kv : m_Subgraphs)
+      for (const auto &member : kv.second.nodes)
+        if (member.InstanceID == instance_id)
+          node = m_NodeEngine.FindNodeByInstanceID(kv.first);
+  }
+  if (!node)
+    return;
+  ed::SelectNode(node->ID);
+  ed::NavigateToSelection();
+}
+
+void ViewportMainSketchAppWindow::DrawDiagnostics() {
+  if (m_Validation.diagnostics.empty())
+    return;
+
+  // Keep the per-frame cost bounded on graphs with thousands of issues.
+  const size_t maxShown = 32;
+
+  ImGui::Text("%zu error(s), %zu warning(s) (%.2f ms)", m_Validation.errors,
+              m_Validation.warnings, m_Validation.elapsed_ms);
+  size_t shown = 0;
+  for (const auto &d : m_Validation.diagnostics) {
+    if (shown++ >= maxShown) {
+      ImGui::BulletText("... %zu more",
+                        m_Validation.diagnostics.size() - maxShown);
+      break;
+    }
+    std::string label =
+        std::string(d.severity == DiagnosticSeverity::Error ? "[E] "
+                                                            : "[W] ") +
+        DiagnosticKindName(d.kind) + " - " + d.instance_id +
+        (d.pin.empty() ? "" : "." + d.pin) + "##diag" + std::to_string(shown);
+    if (ImGui::Selectable(label.c_str())) {
+      FocusNode(d.instance_id);
+    }
+    if (ImGui::IsItemHovered())
+      ImGui::SetTooltip("%s", d.message.c_str());
+  }
+  ImGui::Separator();
+}
+
+void ViewportMainSketchAppWindow::DrawSpawnSearch() {
+  const size_t maxResults = 12;
+
+  ImGui::SetNextItemWidth(250.0f);
+  if (ImGui::InputTextWithHint("##spawn_search", "Search nodes...",
+                               m_SpawnQuery, sizeof(m_SpawnQuery)))
+    m_SpawnResultsDirty = true;
+  if (m_SpawnQuery[0] == '\0')
+    return;
+
+  if (m_SpawnResultsDirty) {
+    m_SpawnResults = m_Spawner.Search(m_SpawnQuery, maxResults);
+    m_SpawnResultsDirty = false;
+  }
+  if (m_SpawnResults.empty()) {
+    ImGui::TextDisabled("No matching node");
+    return;
+  }
+
+  std::string picked;
+  for (const auto &hit : m_SpawnResults) {
+    const auto &e = m_Spawner.At(hit.entry);
+    std::string label = (e.proper_name.empty() ? e.name : e.proper_name) +
+                        "  [" + e.category + "]##spawn_" + e.schema_id;
+    if (ImGui::Selectable(label.c_str()))
+      picked = e.schema_id;
+    if (ImGui::IsItemHovered() && !e.description.empty())
+      ImGui::SetTooltip("%s", e.description.c_str());
+  }
+
+  if (!picked.empty()) {
+    // Next to the last spawned node, the search box has no canvas position
+    ImVec2 pos(0.0f, 0.0f);
+    if (!m_Graph.m_InstanciatedNodes.empty()) {
+      const auto &last = m_Graph.m_InstanciatedNodes.back();
+      pos = ImVec2(last.Position.x + 160.0f, last.Position.y);
+    }
+    SpawnNode(picked, pos.x, pos.y, "");
+    m_SpawnQuery[0] = '\0';
+  }
+}
+
+std::vector<std::string> ViewportMainSketchAppWindow::SelectedInstanceIds() {
+  std::vector<std::string> ids;
+  int count = ed::GetSelectedObjectCount();
+  if (count <= 0)
+    return ids;
+  std::vector<ed::NodeId> selected(count);
+  count = ed::GetSelectedNodes(selected.data(), count);
+
+  std::unordered_set<uintptr_t> wanted;
+  for (int i = 0; i < count; ++i)
+    wanted.insert(selected[i].Get());
+  for (const auto &ni : m_Graph.m_InstanciatedNodes) {
+    Node *node = m_NodeEngine.FindNodeByInstanceID(ni.InstanceID);
+    if (node && wanted.count(node->ID.Get()))
+      ids.push_back(ni.InstanceID);
+  }
+  return ids;
+}
+
+void ViewportMainSketchAppWindow::EnsureGroupDataType(
+    const std::string &type_id) {
+  if (!m_GroupTypes.insert(type_id).second)
+    return;
+  m_Graph.AddNodeDataType(
+      type_id,
+      [](const Cherry::NodeSystem::NodeInstance &node) -> json {
+        return node.Datas;
+      },
+      [](Cherry::NodeSystem::NodeInstance &node, const json &j) {
+        node.Datas = j;
+      });
+}
+
+void ViewportMainSketchAppWindow::RegisterGroupSchema(
+    const std::string &type_id, const Subgraph &group) {
+  if (m_NodeCtx.GetSchema(type_id))
+    return;
+  m_NodeCtx.CreateSchema(type_id);
+  auto schema = m_NodeCtx.GetSchema(type_id);
+  if (!schema) {
+    std::cerr << "RegisterGroupSchema: failed to create " << type_id
+              << std::endl;
+    return;
+  }
+  schema->SetType(Cherry::NodeSystem::NodeType::Blueprint);
+  schema->SetLabel(group.label);
+  schema->SetSecondLabel(std::to_string(group.nodes.size()) + " nodes");
+  schema->SetHexHeaderColor("#4a4a7a");
+  for (const auto &p : group.inputs)
+    schema->AddInputPin(p.key, p.type);
+  for (const auto &p : group.outputs)
+    schema->AddOutputPin(p.key, p.type);
+}
+
+void ViewportMainSketchAppWindow::RestoreGroups() {
+  for (const auto &ni : m_Graph.m_InstanciatedNodes) {
+    if (!IsGroupTypeId(ni.TypeID) || !ni.Datas.is_object() ||
+        !ni.Datas.contains("subgraph"))
+      continue;
+    auto group = Subgraph::FromJson(ni.Datas["subgraph"]);
+    if (!group) {
+      std::cerr << "RestoreGroups: invalid subgraph in " << ni.InstanceID
+                << std::endl;
+      continue;
+    }
+    EnsureGroupDataType(ni.TypeID);
+    RegisterGroupSchema(ni.TypeID, *group);
+    m_Subgraphs[ni.InstanceID] = std::move(*group);
+  }
+}
+
+void ViewportMainSketchAppWindow::CollapseSelection() {
+  std::vector<std::string> selected = SelectedInstanceIds();
+  std::unordered_set<std::string> members;
+  for (const auto &id : selected)
+    if (!m_Subgraphs.count(id)) // groups do not nest
+      members.insert(id);
+  if (members.size() < 2)
+    return;
+
+  if (m_GraphDirty)
+    BuildGraphIndex();
+
+  std::string typeId;
+  for (size_t n = m_Subgraphs.size() + 1;; ++n) {
+    typeId = kGroupSchemaPrefix + std::to_string(n);
+    if (!m_GroupTypes.count(typeId))
+      break;
+  }
+
+  const std::string groupId = typeId + "_1";
+  Subgraph group;
+  group.label = "Group";
+  auto pinType = [this](const std::string &instance, const std::string &key,
+                        bool input) {
+    const uint32_t node = m_GraphIndex.Find(instance);
+    if (node == GraphIndex::npos)
+      return std::string();
+    const auto &entry = m_GraphIndex.nodes[node];
+    const uint32_t pin = entry.FindPin(key, input);
+    if (pin == GraphIndex::npos)
+      return std::string();
+    const auto &pins = input ? entry.inputs : entry.outputs;
+    return PinTypeRegistry::Name(pins[pin].type);
+  };
+
+  // Links between members go into the record, links crossing the boundary
+  // move onto the group pin forwarding to the member pin.
+  std::vector<PinLink> detached, boundary;
+  std::set<std::pair<std::string, std::string>> exposedIn, exposedOut;
+  for (const auto &l : m_Graph.m_InstanciatedLinks) {
+    const bool srcIn = members.count(l.OutputInstanceID) != 0;
+    const bool dstIn = members.count(l.InputInstanceID) != 0;
+    if (!srcIn && !dstIn)
+      continue;
+    PinLink link{l.OutputInstanceID, l.OutputPinName, l.InputInstanceID,
+                 l.InputPinName};
+    detached.push_back(link);
+    if (srcIn && dstIn) {
+      group.links.push_back(
+          {link.src_instance, link.src_pin, link.dst_instance, link.dst_pin});
+      continue;
+    }
+
+    if (srcIn) {
+      const std::string key = link.src_instance + "." + link.src_pin;
+      if (exposedOut.emplace(link.src_instance, link.src_pin).second)
+        group.outputs.push_back(
+            {key, pinType(link.src_instance, link.src_pin, false),
+             link.src_instance, link.src_pin});
+      link.src_instance = groupId;
+      link.src_pin = key;
+    } else {
+      const std::string key = link.dst_instance + "." + link.dst_pin;
+      if (exposedIn.emplace(link.dst_instance, link.dst_pin).second)
+        group.inputs.push_back(
+            {key, pinType(link.dst_instance, link.dst_pin, true),
+             link.dst_instance, link.dst_pin});
+      link.dst_instance = groupId;
+      link.dst_pin = key;
+    }
+    boundary.push_back(std::move(link));
+  }
+
+  // Members keep their current canvas position for a later expand
+  ImVec2 center(0.0f, 0.0f);
+  auto &nodes = m_Graph.m_InstanciatedNodes;
+  for (const auto &ni : nodes) {
+    if (!members.count(ni.InstanceID))
+      continue;
+    Cherry::NodeSystem::NodeInstance copy = ni;
+    if (Node *node = m_NodeEngine.FindNodeByInstanceID(ni.InstanceID))
+      copy.Position = ed::GetNodePosition(node->ID);
+    center.x += copy.Position.x;
+    center.y += copy.Position.y;
+    group.nodes.push_back(std::move(copy));
+  }
+  center.x /= group.nodes.size();
+  center.y /= group.nodes.size();
+
+  Cherry::NodeSystem::NodeInstance ni;
+  ni.TypeID = typeId;
+  ni.InstanceID = groupId;
+  ni.Position = center;
+  ni.Size = {160.f, 60.f};
+  ni.Datas = {{"subgraph", group.ToJson()}};
+
+  EnsureGroupDataType(typeId);
+  RegisterGroupSchema(typeId, group);
+  m_Subgraphs[ni.InstanceID] = std::move(group);
+
+  for (const auto &link : detached)
+    DisconnectPins(link);
+  nodes.erase(std::remove_if(nodes.begin(), nodes.end(),
+                             [&](const Cherry::NodeSystem::NodeInstance &n) {
+                               return members.count(n.InstanceID) != 0;
+                             }),
+              nodes.end());
+  m_Graph.AddNodeInstance(ni);
+  for (const auto &link : boundary)
+    ConnectPins(link);
+  MarkGraphDirty();
+
+  m_NodeEngine.BuildNodes();
+  m_NodeEngine.RefreshNodeGraph();
+  m_NodeEngine.RefreshNodeGraphLinks();
+  CaptureEdits();
+}
+
+void ViewportMainSketchAppWindow::ExpandGroup(const std::string &instance_id) {
+  auto it = m_Subgraphs.find(instance_id);
+  if (it == m_Subgraphs.end())
+    return;
+  Subgraph group = std::move(it->second);
+  m_Subgraphs.erase(it);
+
+  // Links drawn on the group's pins go back to the member pins behind them
+  std::vector<std::pair<PinLink, PinLink>> moved;
+  for (const auto &l : m_Graph.m_InstanciatedLinks) {
+    PinLink link{l.OutputInstanceID, l.OutputPinName, l.InputInstanceID,
+                 l.InputPinName};
+    PinLink inner = link;
+    const SubgraphPin *p = nullptr;
+    if (link.src_instance == instance_id &&
+        (p = group.FindPin(link.src_pin, false))) {
+      inner.src_instance = p->instance_id;
+      inner.src_pin = p->pin;
+    } else if (link.dst_instance == instance_id &&
+               (p = group.FindPin(link.dst_pin, true))) {
+      inner.dst_instance = p->instance_id;
+      inner.dst_pin = p->pin;
+    } else {
+      continue;
+    }
+    moved.emplace_back(std::move(link), std::move(inner));
+  }
+  for (const auto &m : moved)
+    DisconnectPins(m.first);
+
+  auto &nodes = m_Graph.m_InstanciatedNodes;
+  nodes.erase(std::remove_if(nodes.begin(), nodes.end(),
+                             [&](const Cherry::NodeSystem::NodeInstance &n) {
+                               return n.InstanceID == instance_id;
+                             }),
+              nodes.end());
+  for (const auto &member : group.nodes)
+    m_Graph.AddNodeInstance(member);
+  for (const auto &l : group.links)
+    ConnectPins({l.src_instance, l.src_pin, l.dst_instance, l.dst_pin});
+  for (const auto &m : moved)
+    ConnectPins(m.second);
+  MarkGraphDirty();
+
+  m_NodeEngine.BuildNodes();
+  m_NodeEngine.RefreshNodeGraph();
+  m_NodeEngine.RefreshNodeGraphLinks();
+  CaptureEdits();
+}
+
+void ViewportMainSketchAppWindow::ExpandSelectedGroups() {
+  for (const auto &id : SelectedInstanceIds())
+    if (m_Subgraphs.count(id))
+      ExpandGroup(id);
+}
+
+void ViewportMainSketchAppWindow::DrawGroupControls() {
+  if (ImGui::Button("Group selection"))
+    CollapseSelection();
+  ImGui::SameLine();
+  if (ImGui::Button("Expand group"))
+    ExpandSelectedGroups();
+}
+
+void ViewportMainSketchAppWindow::LoadDocumentFormat() {
+  m_DocumentFormat = DocumentFormat::Json;
+  auto settings = ReadDocument(sketchSettingsFile());
+  if (settings && settings->is_object())
+    m_DocumentFormat =
+        DocumentFormatFromString(settings->value("document_format", "json"));
+}
+
+void ViewportMainSketchAppWindow::SetDocumentFormat(DocumentFormat format) {
+  if (format == m_DocumentFormat)
+    return;
+  m_DocumentFormat = format;
+
+  // main_sketch.json marks the sketch root and may be empty
+  json settings = json::object();
+  if (auto existing = ReadDocument(sketchSettingsFile()))
+    if (existing->is_object())
+      settings = *existing;
+  settings["document_format"] = DocumentFormatName(format);
+  if (!WriteDocument(sketchSettingsFile(), settings, DocumentFormat::Json,
+                     true))
+    std::cerr << "SetDocumentFormat: failed to write " << sketchSettingsFile()
+              << std::endl;
+}
+
+std::string ViewportMainSketchAppWindow::StageGraphFile() {
+  return StageGraphForEngine(srcMainSketchFile(), srcMainStagedFile());
+}
+
+void ViewportMainSketchAppWindow::StartOpen() {
+  m_Loader.reset(); // a cancelled one still writes the staged file
+  auto snapshot = m_Library->Snapshot();
+  std::set<std::string> skipSchemas, skipTypes;
+  for (const auto &s : snapshot->schemas)
+    skipSchemas.insert(s.id);
+  for (const auto &t : snapshot->types)
+    skipTypes.insert(t.id);
+  m_OpenStep = OpenStep::Types;
+  m_Loader = std::make_unique<SketchLoader>(
+      m_Library->Root(), srcMainSketchFile(), srcMainStagedFile(),
+      std::move(skipSchemas), std::move(skipTypes));
+}
+
+bool ViewportMainSketchAppWindow::PollOpen() {
+  if (!m_Loader)
+    return true;
+  if (m_Loader->IsCancelled() || m_Loader->Failed())
+    return false;
+
+  // One step per frame, so the loading panel keeps drawing in between
+  using Step = SketchLoader::Step;
+  const Step reached = m_Loader->Reached();
+  switch (m_OpenStep) {
+  case OpenStep::Types:
+    if (reached <= Step::Catalog)
+      return false;
+    m_Library->Merge({std::move(m_Loader->catalog.types), {}});
+    SyncCatalog();
+    m_OpenStep = OpenStep::Schemas;
+    return false;
+  case OpenStep::Schemas:
+    m_Library->Merge({{},
+                      std::move(m_Loader->catalog.schemas),
+                      std::move(m_Loader->catalog.skeletons)});
+    PopulateMinimum(); // inject built-ins (types + primitives), syncs catalog
+    m_OpenStep = OpenStep::Graph;
+    return false;
+  case OpenStep::Graph:
+    if (reached != Step::Done)
+      return false;
+    FetchMainNodeGraph(&m_Loader->graph);
+    m_Loader.reset();
+    m_Library->LoadRemainingAsync();
+    return true;
+  }
+  return false;
+}
+
+void ViewportMainSketchAppWindow::DrawLoading() {
+  const std::string name = fs::path(m_Path).filename().string();
+  if (m_Loader->IsCancelled()) {
+    ImGui::Text("Opening %s was cancelled.", name.c_str());
+    if (ImGui::Button("Retry"))
+      StartOpen();
+    return;
+  }
+  if (m_Loader->Failed()) {
+    ImGui::Text("Opening %s failed: %s", name.c_str(),
+                m_Loader->Error().c_str());
+    if (ImGui::Button("Retry"))
+      StartOpen();
+    return;
+  }
+
+  using Step = SketchLoader::Step;
+  const Step reached = m_Loader->Reached();
+  const char *what = "";
+  float progress = 0.0f;
+  switch (m_OpenStep) {
+  case OpenStep::Types:
+    what = reached == Step::Scan ? "Scanning the graph"
+                                 : "Reading schemas and types";
+    progress = reached == Step::Scan ? 0.05f : 0.2f;
+    break;
+  case OpenStep::Schemas:
+    what = "Registering schemas";
+    progress = 0.5f;
+    break;
+  case OpenStep::Graph:
+    what = reached == Step::Done ? "Placing nodes" : "Reading the graph";
+    progress = 0.75f;
+    break;
+  }
+  ImGui::Text("Opening %s", name.c_str());
+  ImGui::ProgressBar(progress, ImVec2(-1.0f, 0.0f), what);
+  if (ImGui::Button("Cancel"))
+    m_Loader->Cancel();
+}
+
+bool ViewportMainSketchAppWindow::ExportGraphJson() {
+  auto doc = ReadDocument(srcMainSketchFile());
+  if (!doc || !WriteDocument(srcMainExportFile(), *doc, DocumentFormat::Json,
+                             true)) {
+    std::cerr << "ExportGraphJson: failed to export " << srcMainSketchFile()
+              << std::endl;
+    return false;
+  }
+  std::cout << "Graph exported to " << srcMainExportFile() << std::endl;
+  return true;
+}
+
+void ViewportMainSketchAppWindow::BenchmarkDocumentFormats() {
+  using clock = std::chrono::steady_clock;
+  const int runs = 5;
+  auto ms = [](clock::duration d) {
+    return std::chrono::duration<double, std::milli>(d).count();
+  };
+
+  m_FormatReport.clear();
+  const std::pair<const char *, fs::path> documents[] = {
+      {"graph", srcMainSketchFile()}, {"pin setup", srcSetupPinFile()}};
+  const std::pair<DocumentFormat, bool> formats[] = {
+      {DocumentFormat::Json, true},
+      {DocumentFormat::Json, false},
+      {DocumentFormat::Cbor, false},
+      {DocumentFormat::MsgPack, false}};
+
+  for (const auto &[label, path] : documents) {
+    auto doc = ReadDocument(path);
+    if (!doc)
+      continue;
+    fs::path scratch = path;
+    scratch += ".bench";
+
+    for (const auto &[format, pretty] : formats) {
+      // Best of `runs`, save = encode + write, load = read + decode
+      double save = 1e30, load = 1e30;
+      size_t size = 0;
+      for (int r = 0; r < runs; ++r) {
+        auto t0 = clock::now();
+        auto bytes = EncodeDocument(*doc, format, pretty);
+        WriteFileBytes(scratch, bytes);
+        auto t1 = clock::now();
+        auto back = ReadDocument(scratch);
+        auto t2 = clock::now();
+        if (!back)
+          break;
+        size = bytes.size();
+        save = std::min(save, ms(t1 - t0));
+        load = std::min(load, ms(t2 - t1));
+      }
+      if (size == 0)
+        continue;
+      char line[160];
+      std::snprintf(line, sizeof(line),
+                    "%-9s %-7s%s %9zu bytes  save %8.2f ms  load %8.2f ms",
+                    label, DocumentFormatName(format),
+                    pretty ? " (4)" : "    ", size, save, load);
+      m_FormatReport.push_back(line);
+      std::cout << line << std::endl;
+    }
+    std::error_code ec;
+    fs::remove(scratch, ec);
+  }
+}
+
+void ViewportMainSketchAppWindow::DrawFormatControls() {
+  static const char *const names[] = {"json", "cbor", "msgpack"};
+  int current = static_cast<int>(m_DocumentFormat);
+  ImGui::SetNextItemWidth(100.0f);
+  if (ImGui::Combo("Format", &current, names, 3))
+    SetDocumentFormat(static_cast<DocumentFormat>(current));
+  ImGui::SameLine();
+  if (ImGui::Button("Export JSON"))
+    ExportGraphJson();
+  ImGui::SameLine();
+  if (ImGui::Button("Benchmark formats"))
+    BenchmarkDocumentFormats();
+  for (const auto &line : m_FormatReport)
+    ImGui::Text("%s", line.c_str());
+}
+
+void ViewportMainSketchAppWindow::OpenMachine(const std::string &id) {
+  MachineEditor &ed = m_MachineEditor;
+  std::string error;
+  if (!ReadStateMachineFile(machinesDir() / id / "machine.json", id,
+                            ed.machine, error)) {
+    ed.status = error;
+    ed.open = false;
+    return;
+  }
+  ed.when.assign(ed.machine.transitions.size(), {});
+  for (size_t t = 0; t < ed.when.size(); ++t)
+    std::snprintf(ed.when[t].data(), ed.when[t].size(), "%s",
+                  ed.machine.transitions[t].when.c_str());
+  ed.status.clear();
+  ed.open = true;
+}
+
+bool ViewportMainSketchAppWindow::SaveMachine() {
+  MachineEditor &ed = m_MachineEditor;
+  StateMachineInfo &m = ed.machine;
+  for (size_t t = 0; t < m.transitions.size(); ++t)
+    m.transitions[t].when = ed.when[t].data();
+  for (const auto &t : m.transitions) {
+    if (t.when == "step") {
+      ed.status = "\"step\" is the exec input, not an event";
+      return false;
+    }
+  }
+  const fs::path file = machinesDir() / m.id / "machine.json";
+  if (!WriteStateMachineFile(file, m, m_DocumentFormat)) {
+    ed.status = "cannot write " + file.string();
+    return false;
+  }
+  m_Library->Edit(
+      [&](SchemaCatalog &c) { c.UpsertSchema(StateMachineSchema(m)); });
+  SyncCatalog();
+  // Registered node types keep their pins, placed nodes see new events
+  // and states once the sketch is reopened.
+  ed.status = "Saved " + file.string();
+  return true;
+}
+
+void ViewportMainSketchAppWindow::DrawStateMachines() {
+  if (!ImGui::CollapsingHeader("State machines"))
+    return;
+  MachineEditor &ed = m_MachineEditor;
+  for (const auto &s : m_Catalog->schemas)
+    if (s.kind_id == SchemaKind::Machine &&
+        ImGui::Selectable(s.id.c_str(), ed.open && ed.machine.id == s.id))
+      OpenMachine(s.id);
+
+  ImGui::SetNextItemWidth(150.0f);
+  ImGui::InputTextWithHint("##new_machine", "Machine id...", ed.newMachine,
+                           sizeof(ed.newMachine));
+  ImGui::SameLine();
+  if (ImGui::Button("New machine") && ed.newMachine[0] != '\0') {
+    const std::string id = SanitizeIdentifier(ed.newMachine);
+    if (FindSchema(id)) {
+      ed.status = id + " already names a node type";
+    } else {
+      ed.machine = StateMachineInfo();
+      ed.machine.id = id;
+      ed.machine.name = ed.newMachine;
+      ed.machine.states = {"idle"};
+      ed.when.clear();
+      ed.open = SaveMachine();
+      ed.newMachine[0] = '\0';
+    }
+  }
+  if (!ed.status.empty())
+    ImGui::TextDisabled("%s", ed.status.c_str());
+  if (!ed.open)
+    return;
+
+  StateMachineInfo &m = ed.machine;
+  ImGui::Separator();
+  ImGui::Text("%s: %zu states, %zu transitions", m.id.c_str(),
+              m.states.size(), m.transitions.size());
+
+  // States, the first one is initial and cannot be removed
+  size_t removeState = m.states.size();
+  for (size_t s = 0; s < m.states.size(); ++s) {
+    ImGui::PushID(static_cast<int>(s));
+    ImGui::BulletText("%s%s", m.states[s].c_str(), s == 0 ? " (initial)" : "");
+    if (s > 0) {
+      ImGui::SameLine();
+      if (ImGui::Button("x"))
+        removeState = s;
+    }
+    ImGui::PopID();
+  }
+  if (removeState < m.states.size()) {
+    std::vector<StateMachineInfo::Transition> kept;
+    std::vector<std::array<char, 32>> keptWhen;
+    for (size_t t = 0; t < m.transitions.size(); ++t) {
+      auto tr = m.transitions[t];
+      if (tr.from == removeState || tr.to == removeState)
+        continue;
+      tr.from -= tr.from > removeState;
+      tr.to -= tr.to > removeState;
+      kept.push_back(tr);
+      keptWhen.push_back(ed.when[t]);
+    }
+    m.states.erase(m.states.begin() + removeState);
+    m.transitions = std::move(kept);
+    ed.when = std::move(keptWhen);
+  }
+  ImGui::SetNextItemWidth(150.0f);
+  ImGui::InputTextWithHint("##new_state", "State name...", ed.newState,
+                           sizeof(ed.newState));
+  ImGui::SameLine();
+  if (ImGui::Button("Add state") && ed.newState[0] != '\0' &&
+      m.states.size() < kMaxMachineStates) {
+    // Also rejects names that only differ by what the enumerator drops
+    const size_t clash = FindStateClash(m, ed.newState);
+    if (clash < m.states.size()) {
+      ed.status = std::string("\"") + ed.newState + "\" clashes with state \"" +
+                  m.states[clash] + "\"";
+    } else {
+      m.states.push_back(ed.newState);
+      ed.newState[0] = '\0';
+    }
+  }
+
+  // Transitions, tried in this order
+  std::vector<const char *> names;
+  for (const auto &s : m.states)
+    names.push_back(s.c_str());
+  size_t removeTransition = m.transitions.size();
+  for (size_t t = 0; t < m.transitions.size(); ++t) {
+    auto &tr = m.transitions[t];
+    ImGui::PushID(static_cast<int>(1000 + t));
+    int from = tr.from, to = tr.to;
+    ImGui::SetNextItemWidth(100.0f);
+    if (ImGui::Combo("##from", &from, names.data(),
+                     static_cast<int>(names.size())))
+      tr.from = static_cast<uint8_t>(from);
+    ImGui::SameLine();
+    ImGui::Text("->");
+    ImGui::SameLine();
+    ImGui::SetNextItemWidth(100.0f);
+    if (ImGui::Combo("##to", &to, names.data(),
+                     static_cast<int>(names.size())))
+      tr.to = static_cast<uint8_t>(to);
+    ImGui::SameLine();
+    ImGui::SetNextItemWidth(100.0f);
+    ImGui::InputTextWithHint("##when", "always", ed.when[t].data(),
+                             ed.when[t].size());
+    ImGui::SameLine();
+    if (ImGui::Button("x"))
+      removeTransition = t;
+    ImGui::PopID();
+  }
+  if (removeTransition < m.transitions.size()) {
+    m.transitions.erase(m.transitions.begin() + removeTransition);
+    ed.when.erase(ed.when.begin() + removeTransition);
+  }
+  if (ImGui::Button("Add transition")) {
+    m.transitions.push_back({});
+    ed.when.push_back({});
+  }
+  ImGui::SameLine();
+  if (ImGui::Button("Save machine"))
+    SaveMachine();
+}
+
+void ViewportMainSketchAppWindow::ExploreNode(const std::string &instance_id) {
+  m_Explorer.currentInstance = instance_id;
+  m_Explorer.state = ExplorerState::ExploringNode;
+}
+
+std::string ViewportMainSketchAppWindow::ExplorerLabel(uint32_t node) {
+  const auto &entry = m_GraphIndex.nodes[node];
+  const SchemaInfo *schema = FindSchema(entry.type_id);
+  std::string title = schema ? (schema->proper_name.empty() ? schema->name
+                                                            : schema->proper_name)
+                             : entry.type_id;
+  if (title.empty())
+    title = entry.type_id;
+  return title + " (" + entry.instance_id + ")";
+}
+
+void ViewportMainSketchAppWindow::DrawExplorerSearch() {
+  const size_t maxResults = 20;
+
+  ImGui::SetNextItemWidth(200.0f);
+  if (ImGui::InputTextWithHint("##explorer_search", "Find node...",
+                               m_Explorer.query, sizeof(m_Explorer.query)))
+    m_Explorer.resultsDirty = true;
+  if (m_Explorer.query[0] == '\0')
+    return;
+
+  if (m_Explorer.resultsDirty) {
+    auto lower = [](std::string v) {
+      std::transform(v.begin(), v.end(), v.begin(),
+                     [](unsigned char c) { return std::tolower(c); });
+      return v;
+    };
+    const std::string q = lower(m_Explorer.query);
+    m_Explorer.results.clear();
+    for (uint32_t i = 0; i < m_GraphIndex.nodes.size() &&
+                         m_Explorer.results.size() < maxResults;
+         ++i) {
+      const auto &entry = m_GraphIndex.nodes[i];
+      if (lower(entry.instance_id).find(q) != std::string::npos ||
+          lower(entry.type_id).find(q) != std::string::npos)
+        m_Explorer.results.push_back(i);
+    }
+    m_Explorer.resultsDirty = false;
+  }
+
+  if (m_Explorer.results.empty())
+    ImGui::TextDisabled("No node found");
+  for (uint32_t i : m_Explorer.results) {
+    const std::string &id = m_GraphIndex.nodes[i].instance_id;
+    if (ImGui::Selectable((ExplorerLabel(i) + "##find_" + id).c_str())) {
+      ExploreNode(id);
+      FocusNode(id);
+    }
+  }
+}
+
+void ViewportMainSketchAppWindow::ResetHistory() {
+  m_History.Clear();
+  m_Shadow.clear();
+  m_Touched.clear();
+  m_LastTouched.clear();
+  IndexNodeSlots();
+  for (const auto &ni : m_Graph.m_InstanciatedNodes) {
+    ShadowNode &shadow = m_Shadow[ni.InstanceID];
+    shadow.node = ni;
+    for (const auto &key : GraphPinKeys(ni, true))
+      shadow.in[key] =
+          m_Graph.GetAllNodesLinkedToInputInstanceID(ni.InstanceID, key);
+    for (const auto &key : GraphPinKeys(ni, false))
+      shadow.out[key] =
+          m_Graph.GetAllNodesLinkedToOutputInstanceID(ni.InstanceID, key);
+  }
+}
+
+std::vector<std::string> ViewportMainSketchAppWindow::GraphPinKeys(
+    const Cherry::NodeSystem::NodeInstance &ni, bool inputs) {
+  std::vector<std::string> keys;
+  auto group = m_Subgraphs.find(ni.InstanceID);
+  if (group != m_Subgraphs.end()) {
+    for (const auto &p : inputs ? group->second.inputs : group->second.outputs)
+      keys.push_back(p.key);
+  } else if (const SchemaInfo *schema = FindSchema(ni.TypeID)) {
+    for (const auto &p : inputs ? schema->inputs : schema->outputs)
+      keys.push_back(p.GraphKey());
+  }
+  return keys;
+}
+
+void ViewportMainSketchAppWindow::IndexNodeSlots() {
+  m_NodeSlots.clear();
+  m_EditorNodes.clear();
+  const auto &nodes = m_Graph.m_InstanciatedNodes;
+  for (size_t i = 0; i < nodes.size(); ++i) {
+    m_NodeSlots.emplace(nodes[i].InstanceID, i);
+    if (Node *node = m_NodeEngine.FindNodeByInstanceID(nodes[i].InstanceID))
+      m_EditorNodes.emplace(node->ID.Get(), nodes[i].InstanceID);
+  }
+}
+
+Cherry::NodeSystem::NodeInstance *
+ViewportMainSketchAppWindow::FindInstance(const std::string &id) {
+  auto &nodes = m_Graph.m_InstanciatedNodes;
+  auto it = m_NodeSlots.find(id);
+  const bool valid = it != m_NodeSlots.end() && it->second < nodes.size() &&
+                     nodes[it->second].InstanceID == id;
+  if (!valid && (it != m_NodeSlots.end() || m_NodeSlots.size() != nodes.size())) {
+    IndexNodeSlots();
+    it = m_NodeSlots.find(id);
+  }
+  return it == m_NodeSlots.end() ? nullptr : &nodes[it->second];
+}
+
+const std::string *
+ViewportMainSketchAppWindow::InstanceOfEditorNode(ed::NodeId id) {
+  if (!id.Get())
+    return nullptr;
+  auto it = m_EditorNodes.find(id.Get());
+  if (it == m_EditorNodes.end()) {
+    // The node engine rebuilt its nodes since the last indexing
+    IndexNodeSlots();
+    it = m_EditorNodes.find(id.Get());
+  }
+  return it == m_EditorNodes.end() ? nullptr : &it->second;
+}
+
+void ViewportMainSketchAppWindow::TouchHoveredNode() {
+  if (const std::string *id = InstanceOfEditorNode(ed::GetHoveredNode()))
+    m_Touched.insert(*id);
+}
+
+void ViewportMainSketchAppWindow::CaptureEdits() {
+  using Kind = NodeDelta::Kind;
+  using Links = std::vector<std::string>;
+  auto &nodes = m_Graph.m_InstanciatedNodes;
+
+  // Added or removed nodes: every node is a candidate, the slots move
+  std::vector<std::string> dirty;
+  if (nodes.size() != m_Shadow.size() || m_NodeSlots.size() != nodes.size()) {
+    IndexNodeSlots();
+    for (const auto &ni : nodes)
+      dirty.push_back(ni.InstanceID);
+    for (const auto &kv : m_Shadow)
+      if (!m_NodeSlots.count(kv.first))
+        dirty.push_back(kv.first);
+  } else {
+    std::unordered_set<std::string> touched = m_Touched;
+    touched.insert(m_LastTouched.begin(), m_LastTouched.end());
+    m_LastTouched = std::move(m_Touched);
+    if (int count = ed::GetSelectedObjectCount(); count > 0) {
+      std::vector<ed::NodeId> selected(count);
+      count = ed::GetSelectedNodes(selected.data(), count);
+      for (int i = 0; i < count; ++i)
+        if (const std::string *id = InstanceOfEditorNode(selected[i]))
+          touched.insert(*id);
+    }
+    dirty.assign(touched.begin(), touched.end());
+  }
+  m_Touched.clear();
+
+  auto count = [](const Links &l, const std::string &id) {
+    return std::count(l.begin(), l.end(), id);
+  };
+  // Entries of `a` not in `b`, repeats counted
+  auto missing = [](Links a, Links b) {
+    std::sort(a.begin(), a.end());
+    std::sort(b.begin(), b.end());
+    Links d;
+    std::set_difference(a.begin(), a.end(), b.begin(), b.end(),
+                        std::back_inserter(d));
+    return d;
+  };
+  auto drop = [](Links &l, const std::string &id) {
+    auto it = std::find(l.begin(), l.end(), id);
+    if (it != l.end())
+      l.erase(it);
+  };
+
+  std::vector<NodeDelta> adds, removes, edits;
+  auto linkDelta = [&](Kind kind, PinLink link) {
+    NodeDelta d;
+    d.kind = kind;
+    d.instance_id = link.src_instance;
+    d.link = std::move(link);
+    edits.push_back(std::move(d));
+  };
+
+  // New nodes start unlinked in the shadow, their links are diffed below
+  for (const auto &id : dirty) {
+    auto *ni = FindInstance(id);
+    if (!ni || m_Shadow.count(id))
+      continue;
+    NodeDelta d;
+    d.kind = Kind::Add;
+    d.instance_id = id;
+    d.node = *ni;
+    if (Node *node = m_NodeEngine.FindNodeByInstanceID(id))
+      d.node.Position = ed::GetNodePosition(node->ID);
+    m_Shadow[id].node = d.node;
+    adds.push_back(std::move(d));
+  }
+
+  // Removed nodes take their links with them
+  for (const auto &id : dirty) {
+    auto it = m_Shadow.find(id);
+    if (it == m_Shadow.end() || FindInstance(id))
+      continue;
+    ShadowNode gone = std::move(it->second);
+    m_Shadow.erase(it);
+    for (auto &[pin, targets] : gone.out)
+      for (const auto &t : targets) {
+        auto other = m_Shadow.find(t);
+        if (other == m_Shadow.end())
+          continue;
+        for (auto &[dstPin, sources] : other->second.in)
+          if (count(sources, id)) {
+            drop(sources, id);
+            NodeDelta d;
+            d.kind = Kind::LinkRemove;
+            d.instance_id = id;
+            d.link = {id, pin, t, dstPin};
+            removes.push_back(std::move(d));
+            break;
+          }
+      }
+    for (auto &[pin, sources] : gone.in)
+      for (const auto &src : sources) {
+        auto other = m_Shadow.find(src);
+        if (other == m_Shadow.end())
+          continue;
+        for (auto &[srcPin, targets] : other->second.out)
+          if (count(targets, id)) {
+            drop(targets, id);
+            NodeDelta d;
+            d.kind = Kind::LinkRemove;
+            d.instance_id = src;
+            d.link = {src, srcPin, id, pin};
+            removes.push_back(std::move(d));
+            break;
+          }
+      }
+    NodeDelta d;
+    d.kind = Kind::Remove;
+    d.instance_id = id;
+    d.node = std::move(gone.node);
+    removes.push_back(std::move(d));
+  }
+
+  for (const auto &id : dirty) {
+    auto *ni = FindInstance(id);
+    auto it = m_Shadow.find(id);
+    if (!ni || it == m_Shadow.end())
+      continue;
+    ShadowNode &shadow = it->second;
+
+    ImVec2 pos = ni->Position;
+    if (Node *node = m_NodeEngine.FindNodeByInstanceID(id))
+      pos = ed::GetNodePosition(node->ID);
+    if (std::abs(shadow.node.Position.x - pos.x) > 0.5f ||
+        std::abs(shadow.node.Position.y - pos.y) > 0.5f) {
+      NodeDelta d;
+      d.kind = Kind::Move;
+      d.instance_id = id;
+      d.from = shadow.node.Position;
+      d.to = pos;
+      shadow.node.Position = pos;
+      edits.push_back(std::move(d));
+    }
+    if (shadow.node.Datas != ni->Datas) {
+      NodeDelta d;
+      d.kind = Kind::Data;
+      d.instance_id = id;
+      d.before = shadow.node.Datas;
+      d.after = ni->Datas;
+      shadow.node.Datas = ni->Datas;
+      edits.push_back(std::move(d));
+    }
+
+    // A link is in the output list of its source and in the input list of
+    // its target: the changed entries of this node's lists give the other
+    // end, whose pin is the one whose list changed the same way. The other
+    // end's shadow is updated too, so the link is recorded once.
+    for (const auto &pin : GraphPinKeys(*ni, false)) {
+      Links now = m_Graph.GetAllNodesLinkedToOutputInstanceID(id, pin);
+      Links &before = shadow.out[pin];
+      for (const auto &t : missing(now, before)) {
+        auto dst = m_Shadow.find(t);
+        const auto *dstNode = FindInstance(t);
+        if (dst == m_Shadow.end() || !dstNode)
+          continue;
+        for (const auto &dstPin : GraphPinKeys(*dstNode, true)) {
+          Links &known = dst->second.in[dstPin];
+          if (count(m_Graph.GetAllNodesLinkedToInputInstanceID(t, dstPin),
+                    id) > count(known, id)) {
+            known.push_back(id);
+            linkDelta(Kind::LinkAdd, {id, pin, t, dstPin});
+            break;
+          }
+        }
+      }
+      for (const auto &t : missing(before, now)) {
+        auto dst = m_Shadow.find(t);
+        if (dst == m_Shadow.end())
+          continue;
+        for (auto &[dstPin, known] : dst->second.in)
+          if (count(known, id) >
+              count(m_Graph.GetAllNodesLinkedToInputInstanceID(t, dstPin),
+                    id)) {
+            drop(known, id);
+            linkDelta(Kind::LinkRemove, {id, pin, t, dstPin});
+            break;
+          }
+      }
+      before = std::move(now);
+    }
+    for (const auto &pin : GraphPinKeys(*ni, true)) {
+      Links now = m_Graph.GetAllNodesLinkedToInputInstanceID(id, pin);
+      Links &before = shadow.in[pin];
+      for (const auto &src : missing(now, before)) {
+        auto from = m_Shadow.find(src);
+        const auto *srcNode = FindInstance(src);
+        if (from == m_Shadow.end() || !srcNode)
+          continue;
+        for (const auto &srcPin : GraphPinKeys(*srcNode, false)) {
+          Links &known = from->second.out[srcPin];
+          if (count(m_Graph.GetAllNodesLinkedToOutputInstanceID(src, srcPin),
+                    id) > count(known, id)) {
+            known.push_back(id);
+            linkDelta(Kind::LinkAdd, {src, srcPin, id, pin});
+            break;
+          }
+        }
+      }
+      for (const auto &src : missing(before, now)) {
+        auto from = m_Shadow.find(src);
+        if (from == m_Shadow.end())
+          continue;
+        for (auto &[srcPin, known] : from->second.out)
+          if (count(known, id) >
+              count(m_Graph.GetAllNodesLinkedToOutputInstanceID(src, srcPin),
+                    id)) {
+            drop(known, id);
+            linkDelta(Kind::LinkRemove, {src, srcPin, id, pin});
+            break;
+          }
+      }
+      before = std::move(now);
+    }
+  }
+
+  if (!adds.empty() || !removes.empty())
+    MarkGraphDirty();
+  for (const auto &d : edits) {
+    if (d.kind == Kind::LinkAdd || d.kind == Kind::LinkRemove)
+      MarkGraphDirty();
+    else if (d.kind == Kind::Data)
+      m_ValidationDirty = true;
+  }
+
+  // Replayed forward: nodes exist before their links are made
+  std::vector<NodeDelta> deltas = std::move(adds);
+  for (auto *part : {&removes, &edits})
+    deltas.insert(deltas.end(), std::make_move_iterator(part->begin()),
+                  std::make_move_iterator(part->end()));
+  m_Journal.Append(deltas);
+  m_History.Record(std::move(deltas));
+}
+
+void ViewportMainSketchAppWindow::ConnectPins(const PinLink &link) {
+  m_Graph.AddLink(link.src_instance, link.src_pin, link.dst_instance,
+                  link.dst_pin);
+}
+
+void ViewportMainSketchAppWindow::DisconnectPins(const PinLink &link) {
+  m_Graph.RemoveLink(link.src_instance, link.src_pin, link.dst_instance,
+                     link.dst_pin);
+}
+
+bool ViewportMainSketchAppWindow::ApplyDelta(const NodeDelta &d, bool undo) {
+  using Kind = NodeDelta::Kind;
+  auto &nodes = m_Graph.m_InstanciatedNodes;
+
+  switch (d.kind) {
+  case Kind::Add:
+  case Kind::Remove:
+    if ((d.kind == Kind::Add) == undo) {
+      if (auto *ni = FindInstance(d.instance_id)) {
+        nodes.erase(nodes.begin() + (ni - nodes.data()));
+        m_NodeSlots.clear(); // slots after it moved
+      }
+      m_Shadow.erase(d.instance_id);
+    } else {
+      m_Graph.AddNodeInstance(d.node);
+      m_NodeSlots.clear();
+      m_Shadow[d.instance_id] = ShadowNode{d.node, {}, {}};
+    }
+    return true;
+  case Kind::Move: {
+    const ImVec2 &pos = undo ? d.from : d.to;
+    if (auto *ni = FindInstance(d.instance_id))
+      ni->Position = pos;
+    if (Node *node = m_NodeEngine.FindNodeByInstanceID(d.instance_id))
+      ed::SetNodePosition(node->ID, pos);
+    m_Shadow[d.instance_id].node.Position = pos;
+    return false;
+  }
+  case Kind::Data: {
+    const json &value = undo ? d.before : d.after;
+    if (auto *ni = FindInstance(d.instance_id))
+      ni->Datas = value;
+    m_Shadow[d.instance_id].node.Datas = value;
+    m_ValidationDirty = true;
+    return false;
+  }
+  case Kind::LinkAdd:
+  case Kind::LinkRemove: {
+    const PinLink &l = d.link;
+    auto &targets = m_Shadow[l.src_instance].out[l.src_pin];
+    auto &sources = m_Shadow[l.dst_instance].in[l.dst_pin];
+    if ((d.kind == Kind::LinkAdd) != undo) {
+      ConnectPins(l);
+      targets.push_back(l.dst_instance);
+      sources.push_back(l.src_instance);
+    } else {
+      DisconnectPins(l);
+      auto t = std::find(targets.begin(), targets.end(), l.dst_instance);
+      if (t != targets.end())
+        targets.erase(t);
+      auto s = std::find(sources.begin(), sources.end(), l.src_instance);
+      if (s != sources.end())
+        sources.erase(s);
+    }
+    return true;
+  }
+  }
+  return false;
+}
+
+void ViewportMainSketchAppWindow::FinishStructuralChange() {
+  // Group nodes coming back need their subgraph, removed ones drop it
+  const auto &nodes = m_Graph.m_InstanciatedNodes;
+  std::unordered_set<std::string> present;
+  for (const auto &ni : nodes)
+    present.insert(ni.InstanceID);
+  for (auto it = m_Subgraphs.begin(); it != m_Subgraphs.end();) {
+    if (!present.count(it->first))
+      it = m_Subgraphs.erase(it);
+    else
+      ++it;
+  }
+  RestoreGroups();
+
+  MarkGraphDirty();
+  m_NodeEngine.BuildNodes();
+  m_NodeEngine.RefreshNodeGraph();
+  m_NodeEngine.RefreshNodeGraphLinks();
+  IndexNodeSlots();
+}
+
+void ViewportMainSketchAppWindow::ApplyHistory(const HistoryEntry &entry,
+                                               bool undo) {
+  m_Journal.Append(entry.deltas, undo);
+
+  bool structural = false;
+  const size_t count = entry.deltas.size();
+  for (size_t k = 0; k < count; ++k)
+    structural |= ApplyDelta(entry.deltas[undo ? count - 1 - k : k], undo);
+  if (structural)
+    FinishStructuralChange();
+}
+
+void ViewportMainSketchAppWindow::RecoverFromJournal() {
+  const fs::path graphFile = srcMainSketchFile();
+  const fs::path journal = srcMainJournalFile();
+
+  auto start = std::chrono::steady_clock::now();
+  bool structural = false;
+  size_t replayed =
+      GraphJournal::Replay(journal, graphFile, [&](const NodeDelta &d) {
+        structural |= ApplyDelta(d, false);
+      });
+  if (structural)
+    FinishStructuralChange();
+
+  m_Journal.Open(journal, graphFile);
+  if (replayed == 0) {
+    // Nothing usable: restart the journal against the current graph file
+    m_Journal.Compact(graphFile);
+  } else {
+    double ms = std::chrono::duration<double, std::milli>(
+                    std::chrono::steady_clock::now() - start)
+                    .count();
+    std::cout << "Recovered " << replayed << " unsaved edit(s) from "
+              << journal << " in " << ms << " ms" << std::endl;
+  }
+  ResetHistory();
+}
+
+void ViewportMainSketchAppWindow::Undo() {
+  if (IsLoading())
+    return;
+  // Anything not yet captured belongs before the step being undone
+  CaptureEdits();
+  if (const HistoryEntry *entry = m_History.Undo())
+    ApplyHistory(*entry, true);
+}
+
+void ViewportMainSketchAppWindow::Redo() {
+  if (IsLoading())
+    return;
+  if (const HistoryEntry *entry = m_History.Redo())
+    ApplyHistory(*entry, false);
+}
+
+void ViewportMainSketchAppWindow::DrawMainMenu() {
+  ImGui::Text("-------");
+  auto exploreFirstOfType = [this](const std::string &type_id) {
+    for (const auto &entry : m_GraphIndex.nodes) {
+      if (entry.type_id == type_id) {
+        ExploreNode(entry.instance_id);
+        return;
+      }
+    }
+  };
+  if (ImGui::Button("Setup"))
+    exploreFirstOfType("setup");
+  if (ImGui::Button("Loop"))
+    exploreFirstOfType("loop");
+  if (ImGui::Button("Quitter")) {
+    m_Explorer.state = ExplorerState::Exit;
+  }
+  DrawExplorerSearch();
+}
+
+void ViewportMainSketchAppWindow::DrawNodeExplorer() {
+  const uint32_t node = m_GraphIndex.Find(m_Explorer.currentInstance);
+  if (node == GraphIndex::npos) {
+    ImGui::Text("Node not founded");
+    m_Explorer.state = ExplorerState::MainMenu;
+    return;
+  }
+  const auto &entry = m_GraphIndex.nodes[node];
+
+  CherryKit::SeparatorText(("Exploring: " + ExplorerLabel(node)).c_str());
+  if (ImGui::Button("Jump to node"))
+    FocusNode(entry.instance_id);
+  ImGui::Spacing();
+
+  // Links are read from the cached index and bucketed by pin in one walk of
+  // the node's adjacency, so a frame costs O(pins + degree) with no call
+  // into the node graph or the engine.
+  using PinLinks = std::vector<std::vector<const GraphIndex::Link *>>;
+  PinLinks inLinks(entry.inputs.size()), outLinks(entry.outputs.size());
+  m_GraphIndex.ForEachInLink(node, [&](const GraphIndex::Link &l) {
+    if (l.dst_pin < inLinks.size())
+      inLinks[l.dst_pin].push_back(&l);
+  });
+  m_GraphIndex.ForEachOutLink(node, [&](const GraphIndex::Link &l) {
+    if (l.src_pin < outLinks.size())
+      outLinks[l.src_pin].push_back(&l);
+  });
+
+  std::string next;
+  auto drawPin = [&](const GraphIndex::PinSlot &pin, uint32_t p,
+                     const std::vector<const GraphIndex::Link *> &links,
+                     bool input) {
+    ImGui::Text("Pin: %s (%s)", pin.key.c_str(),
+                PinTypeRegistry::Name(pin.type).c_str());
+    for (const GraphIndex::Link *l : links) {
+      uint32_t other = input ? l->src_node : l->dst_node;
+      const std::string &id = m_GraphIndex.nodes[other].instance_id;
+      std::string label = (input ? "<- " : "-> ") + ExplorerLabel(other) +
+                          "##" + std::to_string(p) + "_" + id;
+      if (ImGui::Selectable(label.c_str()))
+        next = id;
+    }
+    if (links.empty())
+      ImGui::BulletText("No connection");
+    ImGui::Spacing();
+  };
+
+  if (!entry.inputs.empty()) {
+    ImGui::Text("Inputs");
+    ImGui::Separator();
+    for (uint32_t p = 0; p < entry.inputs.size(); ++p)
+      drawPin(entry.inputs[p], p, inLinks[p], true);
+  }
+
+  if (!entry.outputs.empty()) {
+    ImGui::Text("Outputs");
+    ImGui::Separator();
+    for (uint32_t p = 0; p < entry.outputs.size(); ++p)
+      drawPin(entry.outputs[p], p, outLinks[p], false);
+  }
+
+  ImGui::Separator();
   if (ImGui::Button("Back to menu")) {
     m_Explorer.state = ExplorerState::MainMenu;
   }
+
+  if (!next.empty())
+    ExploreNode(next);
 }
 
 }; // namespace ModuleUI
@@ -1,8 +1,30 @@
 #pragma once
 #include "../../../../../../lib/vortex/main/include/vortex.h"
 #include "../../../../../../lib/vortex/main/include/vortex_internals.h"
-
+#include "../../../../../src/trace.hpp"
+#include "./buffer_kernels.hpp"
+#include "./build_pipeline.hpp"
+#include "./document_format.hpp"
+#include "./fixed_point.hpp"
+#include "./graph_history.hpp"
+#include "./graph_journal.hpp"
+#include "./graph_validation.hpp"
+#include "./json_stream.hpp"
+#include "./lookup_table.hpp"
+#include "./pin_types.hpp"
+#include "./reactive_plan.hpp"
+#include "./schema_library.hpp"
+#include "./sketch_loader.hpp"
+#include "./state_machine.hpp"
+#include "./spawner_catalog.hpp"
+#include "./subgraph.hpp"
+#include "./telemetry.hpp"
+
+#include <algorithm>
+#include <array>
+#include <map>
 #include <set>
+#include <unordered_set>
 
 #ifndef VIEWPORT_MAIN_SKETCH_APP_WINDOW_HPP
 #define VIEWPORT_MAIN_SKETCH_APP_WINDOW_HPP
@@ -10,10 +32,28 @@
 static bool g_NeedRefresh = false;
 namespace ModuleUI {
 
+enum class ExplorerState { MainMenu, ExploringNode, Exit };
+
+// Node explorer panel state, one per window. Nodes are kept by instance id
+// (engine Node pointers do not survive a rebuild), connections are read
+// from the window's GraphIndex.
+struct Explorer {
+  ExplorerState state = ExplorerState::MainMenu;
+  std::string currentInstance;
+  char query[128] = {};
+  std::vector<uint32_t> results; // m_GraphIndex nodes matching query
+  bool resultsDirty = true;
+};
+
 class ViewportMainSketchAppWindow
     : public std::enable_shared_from_this<ViewportMainSketchAppWindow> {
 public:
   ViewportMainSketchAppWindow(const std::string &path, const std::string &name);
+  ~ViewportMainSketchAppWindow();
+  // Kills the toolchain commands of the window's background jobs (build,
+  // fixed-point comparison, simulator build), which then fail at once. For
+  // a window being closed: its jobs cannot be started again.
+  void CancelJobs() { m_Build->Cancel(); }
 
   void menubar();
   std::shared_ptr<Cherry::AppWindow> &GetAppWindow();
@@ -23,62 +63,63 @@ public:
   void Render();
   void RenderMenubar();
   void RenderRightMenubar();
-  void AddSchemasToNodeGraphSpawner();
+  void AddSchemasToNodeGraphSpawner(
+      const std::vector<const SchemaInfo *> &schemas);
 
   void Refresh();
   void Save();
+  void Undo();
+  void Redo();
 
-  // ---------------------- Internal caches / helpers ------------------------
-
-  struct PinTypeInfo {
-    std::string id;
-    std::string name;
-    std::string description;
-    std::string colorHex;
-    std::string category; // "primitive" or "custom"
-    std::string cpp_type;
-  };
+  // The sketch opens in the background (see SketchLoader): until the graph
+  // is in, the window shows its progress and ignores Save, Refresh, Build
+  // and history commands.
+  bool IsLoading() const { return m_Loader != nullptr; }
 
-  struct PinDef {
-    std::string id;
-    std::string name;
-    std::string type; // pin type id (refers to PinTypeInfo.id)
-    json defaultValue;
-  };
-
-  struct SchemaInfo {
-    std::string id;
-    std::string proper_name;
-    std::string proper_logo;
-    std::string name;
-    std::string name_secondary;
-    std::string description;
-    std::vector<PinDef> inputs;
-    std::vector<PinDef> outputs;
-    std::string kind; // "primitive" or "function" or other
-    std::string hexcolheader;
-    std::string hexcolbg;
-    std::string hexcolborder;
-    std::string hexcoltext;
-    std::string hexcoltextsecondary;
-    std::string nodetype;
-    std::string logopath;
-  };
+  // ---------------------- Internal caches / helpers ------------------------
+  // Types and schemas live in the SchemaLibrary shared by the sketches of
+  // the project (see EmbeddedFusion::SchemaRoot); m_Catalog is the snapshot
+  // this window has registered into its node context.
+
+  static Cherry::NodeSystem::PinShape PinShapeFor(PinCategory category) {
+    switch (category) {
+    case PinCategory::Flow:
+      return Cherry::NodeSystem::PinShape::Flow;
+    case PinCategory::Event:
+      return Cherry::NodeSystem::PinShape::Square;
+    default:
+      return Cherry::NodeSystem::PinShape::Circle;
+    }
+  }
 
-  std::vector<PinTypeInfo> g_TypesCache;
-  std::vector<SchemaInfo> g_SchemasCache;   // primitives + functions
-  std::vector<SchemaInfo> g_FunctionsCache; // separate storage optionally
+  const SchemaCatalog &Catalog() const { return *m_Catalog; }
+  // Registers types/schemas published (and schemas changed) since the last
+  // call into m_NodeCtx and the spawner.
+  void SyncCatalog();
 
   // Helpers: path helpers
-  fs::path typesDir() { return fs::path(m_Path) / "types"; }
-  fs::path primitivesDir() { return fs::path(m_Path) / "primitives"; }
-  fs::path functionsDir() { return fs::path(m_Path) / "functions"; }
+  fs::path typesDir() { return m_Library->Root() / "types"; }
+  fs::path primitivesDir() { return m_Library->Root() / "primitives"; }
+  fs::path functionsDir() { return m_Library->Root() / "functions"; }
+  fs::path machinesDir() { return m_Library->Root() / "machines"; }
   fs::path srcSetupPinFile() {
     return fs::path(m_Path) / "src" / "setup" / "pin_setup.json";
   }
   fs::path srcMainSketchFile() {
     return fs::path(m_Path) / "src" / "main" / "main_sketch.json";
   }
+  fs::path srcMainStagedFile() {
+    return fs::path(m_Path) / "src" / "main" / ".main_sketch.staged.json";
+  }
+  fs::path srcMainExportFile() {
+    return fs::path(m_Path) / "src" / "main" / "main_sketch.export.json";
+  }
+  fs::path sketchSettingsFile() {
+    return fs::path(m_Path) / "main_sketch.json";
+  }
+  fs::path srcMainJournalFile() {
+    return fs::path(m_Path) / "src" / "main" / "main_sketch.journal";
+  }
   fs::path pinSetupDir() { return fs::path(m_Path) / "src" / "setup"; }
   fs::path srcMainDir() { return fs::path(m_Path) / "src" / "main"; }
   static bool writeSchemaToFolder(const SchemaInfo &s, const fs::path &folder) {
@@ -136,9 +177,10 @@ public:
   }
 
   void SaveTypes() {
+    EFUSION_TRACE_SCOPE("Viewport::SaveTypes");
     try {
       fs::create_directories(typesDir());
-      for (const auto &t : g_TypesCache) {
+      for (const auto &t : m_Catalog->types) {
         fs::path folder = typesDir() / t.id;
         fs::create_directories(folder);
         json j;
@@ -148,6 +190,13 @@ public:
         j["color"] = t.colorHex;
         j["category"] = t.category;
         j["cpp_type"] = t.cpp_type;
+        if (t.layout_id != PinLayout::Scalar) {
+          j["layout"] = t.layout;
+          j["element"] = t.element;
+          j["length"] = t.length;
+        }
+        if (t.has_range)
+          j["range"] = {t.range_min, t.range_max};
 
         fs::path out = folder / "type.json";
         std::ofstream ofs(out);
@@ -155,34 +204,45 @@ public:
           std::cerr << "SaveTypes: failed to open " << out << std::endl;
           continue;
         }
-        ofs << j.dump(4);
+        const std::string text = j.dump(4);
+        ofs << text;
+        EFUSION_TRACE_WRITE(text.size());
       }
 
       // Also write a global pin_setup.json mirror for quick import (optional)
       json global;
       global["types"] = json::array();
-      for (const auto &t : g_TypesCache) {
-        global["types"].push_back({{"id", t.id},
-                                   {"name", t.name},
-                                   {"description", t.description},
-                                   {"color", t.colorHex},
-                                   {"category", t.category},
-                                   {"cpp_type", t.cpp_type}});
+      for (const auto &t : m_Catalog->types) {
+        json entry = {{"id", t.id},
+                      {"name", t.name},
+                      {"description", t.description},
+                      {"color", t.colorHex},
+                      {"category", t.category},
+                      {"cpp_type", t.cpp_type}};
+        if (t.layout_id != PinLayout::Scalar) {
+          entry["layout"] = t.layout;
+          entry["element"] = t.element;
+          entry["length"] = t.length;
+        }
+        if (t.has_range)
+          entry["range"] = {t.range_min, t.range_max};
+        global["types"].push_back(std::move(entry));
       }
       fs::create_directories(pinSetupDir());
-      std::ofstream out(srcSetupPinFile());
-      if (out.is_open())
-        out << global.dump(4);
+      if (!WriteDocument(srcSetupPinFile(), global, m_DocumentFormat, true))
+        std::cerr << "SaveTypes: failed to write " << srcSetupPinFile()
+                  << std::endl;
     } catch (const std::exception &e) {
       std::cerr << "SaveTypes exception: " << e.what() << std::endl;
     }
   }
 
   void SavePrimitives() {
+    EFUSION_TRACE_SCOPE("Viewport::SavePrimitives");
     try {
       fs::create_directories(primitivesDir());
-      for (const auto &s : g_SchemasCache) {
-        if (s.kind != "primitive")
+      for (const auto &s : m_Catalog->schemas) {
+        if (s.kind_id != SchemaKind::Primitive)
           continue;
         fs::path folder = primitivesDir() / s.id;
         fs::create_directories(folder);
@@ -224,17 +284,16 @@ public:
           std::cerr << "SavePrimitives: failed to open " << out << std::endl;
           continue;
         }
-        ofs << j.dump(4);
+        const std::string text = j.dump(4);
+        ofs << text;
+        EFUSION_TRACE_WRITE(text.size());
 
         fs::path cppSkeleton = folder / (s.id + ".cpp");
         if (!fs::exists(cppSkeleton)) {
           std::ofstream sk(cppSkeleton);
           if (sk.is_open()) {
-            sk << "// Primitive skeleton for: " << s.id << "\n";
-            sk << "// Description: " << s.description << "\n\n";
-            sk << "// TODO: implement primitive runtime or transpiler "
-                  "mapping\n";
-            sk << "void primitive_" << s.id << "() {\n    // ...\n}\n";
+            sk << SchemaLibrary::SkeletonSource(s);
+            EFUSION_TRACE_WRITE(static_cast<uint64_t>(sk.tellp()));
           }
         }
       }
@@ -244,10 +303,11 @@ public:
   }
 
   void SaveFunctions() {
+    EFUSION_TRACE_SCOPE("Viewport::SaveFunctions");
     try {
       fs::create_directories(functionsDir());
-      for (const auto &s : g_SchemasCache) {
-        if (s.kind != "function")
+      for (const auto &s : m_Catalog->schemas) {
+        if (s.kind_id != SchemaKind::Function)
           continue;
         fs::path folder = functionsDir() / s.id;
         fs::create_directories(folder);
@@ -289,17 +349,17 @@ public:
           std::cerr << "SaveFunctions: failed to open " << out << std::endl;
           continue;
         }
-        ofs << j.dump(4);
+        const std::string text = j.dump(4);
+        ofs << text;
+        EFUSION_TRACE_WRITE(text.size());
 
         // skeleton
         fs::path cppSkeleton = folder / (s.id + ".cpp");
         if (!fs::exists(cppSkeleton)) {
           std::ofstream sk(cppSkeleton);
           if (sk.is_open()) {
-            sk << "// Function skeleton for: " << s.id << "\n";
-            sk << "// Description: " << s.description << "\n\n";
-            sk << "// TODO: implement function logic\n";
-            sk << "void function_" << s.id << "() {\n    // ...\n}\n";
+            sk << SchemaLibrary::SkeletonSource(s);
+            EFUSION_TRACE_WRITE(static_cast<uint64_t>(sk.tellp()));
           }
         }
       }
@@ -308,7 +368,8 @@ public:
     }
   }
 
-  void SaveMainNodeGraph() {
+  bool SaveMainNodeGraph() {
+    EFUSION_TRACE_SCOPE("Viewport::SaveMainNodeGraph");
     try {
       fs::create_directories(srcMainDir());
       std::string graphFile = srcMainSketchFile().string();
@@ -319,364 +380,163 @@ public:
       if (!m_Graph.DumpGraphToJsonFile(&m_NodeCtx)) {
         std::cerr << "SaveMainNodeGraph: failed to dump graph to " << graphFile
                   << std::endl;
+        return false;
+      }
+      // The engine only writes json, re-encode it in the sketch's format
+      if (m_DocumentFormat != DocumentFormat::Json) {
+        auto doc = ReadDocument(graphFile);
+        if (!doc || !WriteDocument(graphFile, *doc, m_DocumentFormat)) {
+          std::cerr << "SaveMainNodeGraph: failed to encode " << graphFile
+                    << " as " << DocumentFormatName(m_DocumentFormat)
+                    << std::endl;
+          return false;
+        }
       }
+      return true;
     } catch (const std::exception &e) {
       std::cerr << "SaveMainNodeGraph exception: " << e.what() << std::endl;
+      return false;
     }
   }
 
   // ---------------------- Fetch functions ------------------------
 
-  static std::optional<PinTypeInfo> readTypeFromFolder(const fs::path &folder) {
+  // Registers a parsed schema into m_NodeCtx. Pins use the name recorded in
+  // PinDef::key so links saved in the graph keep resolving.
+  bool RegisterSchema(const SchemaInfo &info) {
     try {
-      fs::path f = folder / "type.json";
-      if (!fs::exists(f))
-        return std::nullopt;
-      std::ifstream in(f);
-      if (!in.is_open())
-        return std::nullopt;
-      json j;
-      in >> j;
-      PinTypeInfo t;
-      t.id = j.value("id", folder.filename().string());
-      t.name = j.value("name", t.id);
-      t.description = j.value("description", "");
-      t.colorHex = j.value("color", "#FFFFFF");
-      t.category = j.value("category", "custom");
-      t.cpp_type = j.value("cpp_type", "");
-      return t;
-    } catch (...) {
-      return std::nullopt;
-    }
-  }
+      m_NodeCtx.CreateSchema(info.id);
+      auto schema = m_NodeCtx.GetSchema(info.id);
+      if (!schema)
+        return false;
 
-  void FetchTypes() {
-    g_TypesCache.clear();
+      for (const auto &pin : info.inputs)
+        schema->AddInputPin(pin.key.empty() ? pin.name : pin.key, pin.type);
+      for (const auto &pin : info.outputs)
+        schema->AddOutputPin(pin.key.empty() ? pin.name : pin.key, pin.type);
 
-    try {
-      if (!fs::exists(typesDir())) {
-        // nothing to fetch
-        return;
+      if (info.nodetype == "blueprint") {
+        schema->SetType(Cherry::NodeSystem::NodeType::Blueprint);
       }
 
-      for (auto &p : fs::directory_iterator(typesDir())) {
-        if (!p.is_directory())
-          continue;
-        auto maybe = readTypeFromFolder(p.path());
-        if (maybe) {
-          g_TypesCache.push_back(*maybe);
-
-          // register pin in NodeContext
-          Cherry::NodeSystem::PinFormat pf(maybe->id, maybe->name,
-                                           maybe->colorHex);
-
-          Cherry::NodeSystem::PinShape shape =
-              Cherry::NodeSystem::PinShape::Circle;
-
-          if (maybe->category == "flow") {
-            shape = Cherry::NodeSystem::PinShape::Flow;
-          } else if (maybe->category == "primitive") {
-            shape = Cherry::NodeSystem::PinShape::Circle;
-          } else if (maybe->category == "event") {
-            shape = Cherry::NodeSystem::PinShape::Square;
-          }
-
-          try {
-            m_NodeCtx.SetupPinFormat(pf);
-          } catch (...) {
-            std::cerr << "FetchTypes: failed to SetupPinFormat for "
-                      << maybe->id << std::endl;
-          }
-        }
+      if (!info.name.empty()) {
+        schema->SetLabel(info.name);
       }
 
-      // Also try to import global pin_setup.json if exists
-      if (fs::exists(srcSetupPinFile())) {
-        std::ifstream in(srcSetupPinFile());
-        if (in.is_open()) {
-          json j;
-          in >> j;
-          if (j.contains("types") && j["types"].is_array()) {
-            for (auto &jt : j["types"]) {
-              PinTypeInfo t;
-              t.id = jt.value("id", "");
-              if (t.id.empty())
-                continue;
-              t.name = jt.value("name", t.id);
-              t.description = jt.value("description", "");
-              t.colorHex = jt.value("color", "#FFFFFF");
-              t.category = jt.value("category", "custom");
-              t.cpp_type = jt.value("cpp_type", "");
-
-              Cherry::NodeSystem::PinShape shape =
-                  Cherry::NodeSystem::PinShape::Circle;
-
-              if (t.category == "flow") {
-                shape = Cherry::NodeSystem::PinShape::Flow;
-              } else if (t.category == "primitive") {
-                shape = Cherry::NodeSystem::PinShape::Circle;
-              } else if (t.category == "event") {
-                shape = Cherry::NodeSystem::PinShape::Square;
-              }
-
-              // avoid duplicates
-              auto it = std::find_if(
-                  g_TypesCache.begin(), g_TypesCache.end(),
-                  [&](const PinTypeInfo &x) { return x.id == t.id; });
-              if (it == g_TypesCache.end()) {
-                g_TypesCache.push_back(t);
-                m_NodeCtx.SetupPinFormat(Cherry::NodeSystem::PinFormat(
-                    t.id, t.name, t.colorHex, shape));
-              }
-            }
-          }
-        }
+      if (!info.name_secondary.empty()) {
+        schema->SetSecondLabel(info.name_secondary);
       }
-    } catch (const std::exception &e) {
-      std::cerr << "FetchTypes exception: " << e.what() << std::endl;
-    }
-  }
 
-  static std::optional<SchemaInfo>
-  readSchemaFromFolder(const fs::path &folder) {
-    try {
-      fs::path f = folder / "config.json";
-      if (!fs::exists(f))
-        return std::nullopt;
-      std::ifstream in(f);
-      if (!in.is_open())
-        return std::nullopt;
-
-      json j;
-      in >> j;
-
-      SchemaInfo s;
-      s.id = j.value("id", folder.filename().string());
-      s.name = j.value("name", s.name);
-      s.name_secondary = j.value("name_secondary", s.name_secondary);
-      s.proper_name = j.value("proper_name", s.proper_name);
-      s.proper_logo = j.value("proper_logo", s.proper_logo);
-      s.description = j.value("description", "");
-      s.kind = j.value("kind", "primitive");
-      s.hexcolheader = j.value("hexcolheader", "#FFFFFF");
-      s.hexcolbg = j.value("hexcolbg", "#FFFFFF");
-      s.hexcolborder = j.value("hexcolborder", "#FFFFFF");
-      s.hexcoltext = j.value("hexcoltext", "#FFFFFF");
-      s.hexcoltextsecondary = j.value("hexcoltextsecondary", "#FFFFFF");
-      s.nodetype = j.value("nodetype", "default");
-      s.logopath = j.value("logopath", "");
-
-      if (j.contains("inputs") && j["inputs"].is_array()) {
-        for (auto &ji : j["inputs"]) {
-          PinDef p;
-          p.id = ji.value("id", "");
-          p.name = ji.value("name", p.id);
-          p.type = ji.value("type", "");
-          if (ji.contains("default"))
-            p.defaultValue = ji["default"];
-          s.inputs.push_back(p);
-        }
+      if (!info.hexcolheader.empty()) {
+        schema->SetHexHeaderColor(info.hexcolheader);
       }
 
-      if (j.contains("outputs") && j["outputs"].is_array()) {
-        for (auto &jo : j["outputs"]) {
-          PinDef p;
-          p.id = jo.value("id", "");
-          p.name = jo.value("name", p.id);
-          p.type = jo.value("type", "");
-          if (jo.contains("default"))
-            p.defaultValue = jo["default"];
-          s.outputs.push_back(p);
-        }
+      if (!info.hexcoltext.empty()) {
+        schema->SetLabelHexColor(info.hexcoltext);
       }
 
-      return s;
-    } catch (...) {
-      return std::nullopt;
-    }
-  }
-
-  void FetchPrimitives() {
-    // load primitives into cache and register schemas
-    try {
-      if (!fs::exists(primitivesDir()))
-        return;
-      for (auto &p : fs::directory_iterator(primitivesDir())) {
-        if (!p.is_directory())
-          continue;
-        auto maybe = readSchemaFromFolder(p.path());
-        if (!maybe)
-          continue;
-        maybe->kind = maybe->kind.empty() ? "primitive" : maybe->kind;
-        g_SchemasCache.push_back(*maybe);
-
-        // create schema in context
-        try {
-          m_NodeCtx.CreateSchema(maybe->id);
-          auto schema = m_NodeCtx.GetSchema(maybe->id);
-          if (schema) {
-            for (const auto &pin : maybe->inputs)
-              schema->AddInputPin(pin.name, pin.type);
-            for (const auto &pin : maybe->outputs)
-              schema->AddOutputPin(pin.name, pin.type);
-
-            if (maybe->nodetype == "blueprint") {
-              schema->SetType(Cherry::NodeSystem::NodeType::Blueprint);
-            }
-
-            if (!maybe->name.empty()) {
-              schema->SetLabel(maybe->name);
-            }
-
-            if (!maybe->name_secondary.empty()) {
-              schema->SetSecondLabel(maybe->name_secondary);
-            }
-
-            if (!maybe->hexcolheader.empty()) {
-              schema->SetHexHeaderColor(maybe->hexcolheader);
-            }
-
-            if (!maybe->hexcoltext.empty()) {
-              schema->SetLabelHexColor(maybe->hexcoltext);
-            }
-
-            if (!maybe->hexcoltextsecondary.empty()) {
-              schema->SetSecondLabelHexColor(maybe->hexcoltextsecondary);
-            }
-
-            if (!maybe->hexcolbg.empty()) {
-              if (maybe->hexcolbg == "def") {
-              } else {
-                schema->SetHexBackgroundColor(maybe->hexcolbg);
-              }
-            }
+      if (!info.hexcoltextsecondary.empty()) {
+        schema->SetSecondLabelHexColor(info.hexcoltextsecondary);
+      }
 
-            if (!maybe->hexcolborder.empty()) {
-              if (maybe->hexcolborder == "def") {
-              } else {
-                schema->SetHexBorderColor(maybe->hexcolborder);
-              }
-            }
+      if (!info.hexcolbg.empty() && info.hexcolbg != "def") {
+        schema->SetHexBackgroundColor(info.hexcolbg);
+      }
 
-            if (!maybe->logopath.empty()) {
-              schema->SetLogoPath(maybe->logopath);
-            }
-          } else {
-            std::cerr << "FetchPrimitives: GetSchema returned nullptr for "
-                      << maybe->id << std::endl;
-          }
-        } catch (...) {
-          std::cerr << "FetchPrimitives: failed to register schema "
-                    << maybe->id << std::endl;
-        }
+      if (!info.hexcolborder.empty() && info.hexcolborder != "def") {
+        schema->SetHexBorderColor(info.hexcolborder);
+      }
 
-        // ensure skeleton if missing
-        fs::path skeleton = p.path() / (maybe->id + ".cpp");
-        if (!fs::exists(skeleton)) {
-          std::ofstream sk(skeleton);
-          if (sk.is_open()) {
-            sk << "// Auto-generated primitive skeleton for " << maybe->id
-               << "\n";
-            sk << "// TODO: implement\n";
-          }
-        }
+      if (!info.logopath.empty()) {
+        schema->SetLogoPath(info.logopath);
       }
-    } catch (const std::exception &e) {
-      std::cerr << "FetchPrimitives exception: " << e.what() << std::endl;
+      return true;
+    } catch (...) {
+      return false;
     }
   }
 
-  void FetchFunctions() {
-    try {
-      if (!fs::exists(functionsDir()))
-        return;
-      for (auto &p : fs::directory_iterator(functionsDir())) {
-        if (!p.is_directory())
-          continue;
-        auto maybe = readSchemaFromFolder(p.path());
-        if (!maybe)
-          continue;
-        maybe->kind = maybe->kind.empty() ? "function" : maybe->kind;
-        g_SchemasCache.push_back(*maybe);
-        g_FunctionsCache.push_back(*maybe);
-
-        // register schema into context
-        try {
-          m_NodeCtx.CreateSchema(maybe->id);
-          auto schema = m_NodeCtx.GetSchema(maybe->id);
-          if (schema) {
-            for (const auto &pin : maybe->inputs)
-              schema->AddInputPin(pin.name, pin.type);
-            for (const auto &pin : maybe->outputs)
-              schema->AddOutputPin(pin.name, pin.type);
-
-            if (maybe->nodetype == "blueprint") {
-              schema->SetType(Cherry::NodeSystem::NodeType::Blueprint);
-            }
-            if (!maybe->name.empty()) {
-              schema->SetLabel(maybe->name);
-            }
-
-            if (!maybe->name_secondary.empty()) {
-              schema->SetSecondLabel(maybe->name_secondary);
-            }
-            if (!maybe->hexcolheader.empty()) {
-              schema->SetHexHeaderColor(maybe->hexcolheader);
-            }
-
-            if (!maybe->hexcoltext.empty()) {
-              schema->SetLabelHexColor(maybe->hexcoltext);
-            }
-
-            if (!maybe->hexcoltextsecondary.empty()) {
-              schema->SetSecondLabelHexColor(maybe->hexcoltextsecondary);
-            }
-
-            if (!maybe->hexcolbg.empty()) {
-              if (maybe->hexcolbg == "def") {
-              } else {
-                schema->SetHexBackgroundColor(maybe->hexcolbg);
-              }
-            }
-
-            if (!maybe->hexcolborder.empty()) {
-              if (maybe->hexcolborder == "def") {
-              } else {
-                schema->SetHexBorderColor(maybe->hexcolborder);
-              }
-            }
-
-            if (!maybe->logopath.empty()) {
-              schema->SetLogoPath(maybe->logopath);
-            }
-          }
-        } catch (...) {
-          std::cerr << "FetchFunctions: failed to register schema " << maybe->id
-                    << std::endl;
-        }
-
-        // ensure skeleton if missing
-        fs::path skeleton = p.path() / (maybe->id + ".cpp");
-        if (!fs::exists(skeleton)) {
-          std::ofstream sk(skeleton);
-          if (sk.is_open()) {
-            sk << "// Auto-generated function skeleton for " << maybe->id
-               << "\n";
-            sk << "// TODO: implement\n";
-          }
-        }
-      }
-    } catch (const std::exception &e) {
-      std::cerr << "FetchFunctions exception: " << e.what() << std::endl;
-    }
+  // True when `a` and `b` register the same m_NodeCtx schema. Snapshots
+  // hold their entries by value, so a changed entry is told by content.
+  static bool SameRegistration(const SchemaInfo &a, const SchemaInfo &b) {
+    auto samePins = [](const std::vector<PinDef> &x,
+                       const std::vector<PinDef> &y) {
+      return std::equal(x.begin(), x.end(), y.begin(), y.end(),
+                        [](const PinDef &p, const PinDef &q) {
+                          return p.key == q.key && p.name == q.name &&
+                                 p.type == q.type;
+                        });
+    };
+    return samePins(a.inputs, b.inputs) && samePins(a.outputs, b.outputs) &&
+           a.nodetype == b.nodetype && a.name == b.name &&
+           a.name_secondary == b.name_secondary &&
+           a.hexcolheader == b.hexcolheader && a.hexcolbg == b.hexcolbg &&
+           a.hexcolborder == b.hexcolborder && a.hexcoltext == b.hexcoltext &&
+           a.hexcoltextsecondary == b.hexcoltextsecondary &&
+           a.logopath == b.logopath;
   }
 
-  void Transpilation();
-  void FetchMainNodeGraph() {
+  // ---------------------- Lazy catalog loading ------------------------
+  // At open only the schemas referenced by the graph file (and the pin types
+  // their pins use) are loaded; the rest of the library is parsed on a
+  // background thread and merged from Render().
+  static std::set<std::string> ScanReferencedTypeIds(const fs::path &graphFile);
+
+  // Writes transpilation/build/main.cpp with the sketch's "transpile"
+  // options, false if the graph has errors or the file could not be
+  // written.
+  bool Transpilation();
+  bool TranspileTo(const fs::path &mainCpp, const TranspileOptions &options);
+  TranspileOptions TranspileOptionsForSketch();
+  BuildSettings BuildSettingsForSketch();
+  // Transpiles the sketch with float and with fixed-point pins, runs both
+  // host builds with probes on and compares the float pin values.
+  void CompareFixedPoint();
+  void DrawFixedPointCompare();
+  // Compiles the transpiled sketch in the background with the toolchain of
+  // the sketch's "build" settings, see BuildPipeline.
+  void Build();
+  void DrawBuildStatus();
+  // Generated symbol name -> instances it was emitted for, mirrors the
+  // naming of Transpilation().
+  std::unordered_map<std::string, std::vector<std::string>>
+  GeneratedSymbolOwners();
+  void DrawSizeReport();
+  // Live telemetry: streams the watched pins of the running sketch, from a
+  // board on the "device" of the telemetry settings or from the host
+  // simulator on a pseudo-terminal, and overlays their values on the graph.
+  TelemetryManifest ResolveWatches(const TranspileOptions &options);
+  void LoadTelemetrySettings();
+  void WatchSelection(bool watch);
+  void StartTelemetry();
+  void StopTelemetry();
+  void PollTelemetry();
+  void DrawTelemetry();
+  void DrawTelemetryOverlay();
+  // Trace spans of the whole module (see trace.hpp), exported next to the
+  // transpilation output.
+  void DrawTracing();
+  // `staged` is the graph as prepared by the sketch loader, otherwise the
+  // file is scanned and staged here.
+  void FetchMainNodeGraph(const StagedGraph *staged = nullptr) {
+    EFUSION_TRACE_SCOPE("Viewport::FetchMainNodeGraph", m_Path);
+    MarkGraphDirty();
     try {
       std::string graphFile = srcMainSketchFile().string();
-      m_Graph.SetGraphFile(graphFile);
+
+      // Group nodes keep their collapsed members in Datas, which is only
+      // read back for types with a registered data type.
+      m_Subgraphs.clear();
+      const std::set<std::string> typeIds =
+          staged ? staged->type_ids : ScanReferencedTypeIds(graphFile);
+      for (const auto &id : typeIds)
+        if (IsGroupTypeId(id))
+          EnsureGroupDataType(id);
+
+      m_Graph.SetGraphFile(staged && !staged->file.empty() ? staged->file
+                                                           : StageGraphFile());
       bool ok = m_Graph.PopulateGraphFromJsonFile(&m_NodeCtx);
+      m_Graph.SetGraphFile(graphFile);
       if (!ok) {
         std::cerr << "FetchMainNodeGraph: unable to load " << graphFile
                   << " (file missing or invalid). Creating empty graph."
@@ -691,9 +551,13 @@ public:
           out.close();
           m_Graph.PopulateGraphFromJsonFile(&m_NodeCtx);
         }
+        RecoverFromJournal();
         return;
       }
 
+      RestoreGroups();
+      RecoverFromJournal();
+
       for (const auto &ni : m_Graph.m_InstanciatedNodes) {
         std::string typeId = ni.TypeID;
         auto schema = m_NodeCtx.GetSchema(typeId);
@@ -793,109 +657,286 @@ public:
 
   void DrawMainMenu();
   void DrawNodeExplorer();
+  void DrawExplorerSearch();
+  void ExploreNode(const std::string &instance_id);
+  std::string ExplorerLabel(uint32_t node);
 
   // Transpilation :
-  // Helpers (place near top of file)
-  std::string SanitizeIdentifier(const std::string &s) {
-    std::string out;
-    for (char c : s) {
-      if (isalnum((unsigned char)c) || c == '_')
-        out.push_back(c);
-      else
-        out.push_back('_');
-    }
-    // avoid starting with digit
-    if (!out.empty() && isdigit((unsigned char)out.front()))
-      out = std::string("_") + out;
-    return out;
-  }
-
-  std::string GetCppTypeForPinType(const std::string &pinTypeId) {
-    static const std::unordered_map<std::string, std::string> base = {
-        {"bool", "bool"},     {"int", "int"},   {"float", "float"},
-        {"double", "double"}, {"char", "char"}, {"string", "std::string"},
-        {"exec", "void"}};
-
-    auto it = base.find(pinTypeId);
-    if (it != base.end())
-      return it->second;
-
-    if (!pinTypeId.empty())
-      return pinTypeId;
+  // C++ type of a pin type as the catalog declares it ("bool_input" is a
+  // bool). Flow types (exec, variant) have none: validation rejects their
+  // data pins before anything is emitted, "auto" is only a last resort.
+  std::string GetCppTypeForPinType(PinTypeId pinTypeId) {
+    if (const PinTypeInfo *t = m_Catalog->FindType(pinTypeId))
+      if (t->category_id != PinCategory::Flow && !t->cpp_type.empty())
+        return t->cpp_type;
+    if (IsBuiltinPinType(pinTypeId) &&
+        kBuiltinPinTypes[pinTypeId].category != PinCategory::Flow)
+      return kBuiltinPinTypes[pinTypeId].cpp_type;
     return "auto";
   }
 
   std::optional<SchemaInfo> FindSchemaInfoById(const std::string &id) {
-    for (const auto &s : g_SchemasCache)
-      if (s.id == id)
-        return s;
+    const SchemaInfo *s = FindSchema(id);
+    if (s)
+      return *s;
     return std::nullopt;
   }
 
+  const SchemaInfo *FindSchema(const std::string &id) {
+    return m_Catalog->FindSchema(id);
+  }
+
+  // Validation :
+  // The graph index is rebuilt lazily after a node or link is added or
+  // removed; validation runs over it in O(V + E) so it can be re-run after
+  // every edit.
+  void MarkGraphDirty() { m_GraphDirty = true; }
+  void BuildGraphIndex();
+  void Validate();
+  void DrawDiagnostics();
+  void FocusNode(const std::string &instance_id);
+  const ValidationReport &GetValidationReport() const { return m_Validation; }
+
+  // Spawn search over m_Spawner, results are only recomputed when the
+  // query or the catalog changes.
+  void DrawSpawnSearch();
+
+  // Groups :
+  // A selection collapses into one group node whose pins forward to the
+  // members' boundary pins. Members leave the node engine until the group
+  // is expanded; the graph index flattens groups back, so validation and
+  // transpilation never see them.
+  std::vector<std::string> SelectedInstanceIds();
+  void EnsureGroupDataType(const std::string &type_id);
+  void RegisterGroupSchema(const std::string &type_id, const Subgraph &group);
+  void RestoreGroups();
+  void CollapseSelection();
+  void ExpandGroup(const std::string &instance_id);
+  void ExpandSelectedGroups();
+  void DrawGroupControls();
+
+  // Document formats :
+  // The graph and the pin setup mirror can be stored as json, CBOR or
+  // MessagePack (setting "document_format" of the sketch's
+  // main_sketch.json). Readers detect the encoding, so switching only
+  // takes effect at the next Save.
+  void LoadDocumentFormat();
+  void SetDocumentFormat(DocumentFormat format);
+  // Path the engine should populate from: the graph file itself when it is
+  // json, otherwise a json copy decoded next to it.
+  std::string StageGraphFile();
+
+  // Background open: StartOpen() (re)starts the loader, PollOpen() applies
+  // what it has read and returns true once the window is usable.
+  void StartOpen();
+  bool PollOpen();
+  void DrawLoading();
+  bool ExportGraphJson();
+  void BenchmarkDocumentFormats();
+  void DrawFormatControls();
+
+  // State machine editor: states and transitions of one machine at a time,
+  // saved to machines/<id>/machine.json and published as a node type.
+  void DrawStateMachines();
+  void OpenMachine(const std::string &id);
+  bool SaveMachine();
+
+  // History :
+  // Edits are found at the end of each interaction by diffing the nodes it
+  // may have touched against m_Shadow (the last recorded state), and
+  // recorded as deltas in m_History. Touched are the selected nodes and
+  // those under the mouse when it went down or up, in this interaction or
+  // the previous one (text typed into a node lands after its click). Links
+  // are diffed per pin, as the node graph lists them. Only adding or
+  // removing nodes diffs the whole graph.
+  void CaptureEdits();
+  void TouchHoveredNode();
+  void ResetHistory();
+  void ApplyHistory(const HistoryEntry &entry, bool undo);
+  // Applies one delta forward (or backward with `undo`), returns true when
+  // nodes were added or removed; FinishStructuralChange() then rebuilds.
+  bool ApplyDelta(const NodeDelta &delta, bool undo);
+  void FinishStructuralChange();
+  // Link edits on the node graph, the counterpart of its
+  // GetAllNodesLinkedTo*InstanceID queries.
+  void ConnectPins(const PinLink &link);
+  void DisconnectPins(const PinLink &link);
+  // Pin keys of a node graph instance (a group's are its exposed pins)
+  std::vector<std::string> GraphPinKeys(
+      const Cherry::NodeSystem::NodeInstance &ni, bool inputs);
+  // m_Graph.m_InstanciatedNodes entry of `id`, through m_NodeSlots.
+  Cherry::NodeSystem::NodeInstance *FindInstance(const std::string &id);
+  const std::string *InstanceOfEditorNode(ed::NodeId id);
+  void IndexNodeSlots();
+  // Replays edits left in the journal by a crashed session.
+  void RecoverFromJournal();
+  GraphHistory &History() { return m_History; }
+
   std::string VarNameForPin(const Cherry::NodeSystem::NodeInstance &ni,
                             const std::string &pinName) {
     return SanitizeIdentifier(ni.InstanceID + "_" + pinName);
   }
-  void PopulatePrimitiveBranch(const SchemaInfo &schema,
-                               const Cherry::NodeSystem::NodeInstance &ni,
-                               std::ostringstream &outBody,
-                               std::set<std::string> &declaredVars) {
+
+  std::string VarNameForSlot(const GraphIndex::NodeEntry &node,
+                             const GraphIndex::PinSlot &pin) {
+    return SanitizeIdentifier(node.instance_id + "_" + pin.id);
+  }
+
+  // Float pins (or aliases stored as float) become efx_q when the current
+  // transpilation lowers floats to fixed point.
+  bool IsFixedSlot(const GraphIndex::PinSlot &pin) const {
+    return m_Transpile.floats == FloatLowering::Fixed &&
+           (pin.type == BuiltinPinType::Float ||
+            pin.storage == BuiltinPinType::Float);
+  }
+  std::string PinCppType(const GraphIndex::PinSlot &pin) {
+    return IsFixedSlot(pin) ? "efx_q" : GetCppTypeForPinType(pin.type);
+  }
+
+  // Tasks : see TaskPartition. Each task counts its own ticks and names
+  // its mailboxes after the reading task's root.
+  std::string TaskName(uint32_t task) {
+    return SanitizeIdentifier(
+        m_GraphIndex.nodes[m_Tasks.tasks[task].root].instance_id);
+  }
+  std::string TickVarFor(uint32_t node) {
+    const uint32_t task = m_Tasks.owner[node];
+    if (task >= m_Tasks.tasks.size() || m_Tasks.tasks[task].loop)
+      return "g_efusion_tick";
+    return "g_efusion_tick_" + TaskName(task);
+  }
+  std::string MailboxName(const TaskPartition::Mailbox &m) {
+    const auto &src = m_GraphIndex.nodes[m.src_node];
+    return "mb_" + VarNameForSlot(src, src.outputs[m.src_pin]) + "_" +
+           TaskName(m.reader);
+  }
+  // Literal value of an int input of a task node, `fallback` if it is not
+  // a constant.
+  int TaskParameter(uint32_t node, const std::string &pin, int fallback);
+  // Nodes lowered to a skeleton call (neither a builtin, a branch nor a
+  // state machine).
+  bool UsesSkeleton(uint32_t node);
+  bool IsMachineNode(uint32_t node) {
+    const SchemaInfo *s = FindSchema(m_GraphIndex.nodes[node].type_id);
+    return s && s->kind_id == SchemaKind::Machine;
+  }
+  // State machine node: one step of `m` per call, entry actions called
+  // directly from the transition (see state_machine.hpp).
+  void PopulateStateMachine(const StateMachineInfo &m, uint32_t node,
+                            std::ostringstream &out);
+
+  // Reactive mode : nodes of m_Reactive run from loop() when their dirty
+  // bit is set, and set their dependents' bits instead of calling their
+  // exec successors.
+  bool IsScheduled(uint32_t node) const {
+    return m_Transpile.execution == ExecutionMode::Reactive &&
+           m_Reactive.Scheduled(node);
+  }
+  std::string PrevVarForSlot(const GraphIndex::NodeEntry &node,
+                             const GraphIndex::PinSlot &pin) {
+    return "prev_" + VarNameForSlot(node, pin);
+  }
+  void EmitReactivePropagation(uint32_t node, std::ostringstream &out);
+
+  // Lookup tables : m_Tables are planned before the main pass and evaluated
+  // by a probe, a host build of the same transpilation whose setup() prints
+  // every entry (see lookup_table.hpp). The probe runs in the build job
+  // ahead of the next Build(); its values are kept by probe source and the
+  // sketch is transpiled again with them when the job finishes. Until then,
+  // and when the probe fails or times out, nodes keep their code.
+  void TabulatePureSubgraphs(const TranspileOptions &options);
+  void ApplyLookupProbe(const ProbeResult &result);
+  const LookupTable *TableFor(uint32_t node) const {
+    if (m_Transpile.lut_probe)
+      return nullptr;
+    for (const auto &t : m_Tables)
+      if (t.root == node)
+        return &t;
+    return nullptr;
+  }
+  std::string LookupTableName(const GraphIndex::NodeEntry &node,
+                              const GraphIndex::PinSlot &pin) {
+    return "lut_" + VarNameForSlot(node, pin);
+  }
+  void EmitLookupTableRead(const LookupTable &table, std::ostringstream &out);
+  void EmitLookupProbe(std::ostream &out);
+
+  // Data-flow lowering :
+  // A node is pure when its schema has no exec pin. Pure nodes are lowered
+  // to eval_<inst>() functions pulled on demand by their consumers and
+  // memoized on their task's tick (g_efusion_tick for loop()), so each runs
+  // at most once per tick whatever the number of consumers.
+  std::string CppLiteral(const json &value, const std::string &cppType);
+  std::string InitialValueForInput(const Cherry::NodeSystem::NodeInstance &ni,
+                                   const GraphIndex::PinSlot &pin);
+  void EmitInputPulls(uint32_t node, std::ostringstream &out);
+  bool EmitBuiltinPrimitive(uint32_t node, std::ostringstream &out);
+  void EmitExecSuccessors(uint32_t node, uint32_t outputPin,
+                          std::ostringstream &out, const std::string &indent);
+
+  // One side of a branch. In reactive mode the side not taken is blocked
+  // (before unblocking the taken one: both may lead to the same node).
+  void EmitBranchSide(uint32_t node, uint32_t taken, uint32_t other,
+                      std::ostringstream &outBody) {
+    const std::string indent = "        ";
+    if (!IsScheduled(node)) {
+      if (taken != GraphIndex::npos)
+        EmitExecSuccessors(node, taken, outBody, indent);
+      return;
+    }
+    if (other != GraphIndex::npos)
+      outBody << BitMaskStatements(
+          "g_efusion_blocked",
+          ExecSuccessorBits(m_GraphIndex, m_Reactive, node, other, true), true,
+          indent);
+    if (taken == GraphIndex::npos)
+      return;
+    outBody << BitMaskStatements(
+        "g_efusion_blocked",
+        ExecSuccessorBits(m_GraphIndex, m_Reactive, node, taken, true), false,
+        indent);
+    outBody << BitMaskStatements(
+        "g_efusion_dirty",
+        ExecSuccessorBits(m_GraphIndex, m_Reactive, node, taken, false), true,
+        indent);
+  }
+
+  void PopulatePrimitiveBranch(const SchemaInfo &schema, uint32_t node,
+                               std::ostringstream &outBody) {
     // schema corresponds to "branch" primitive
     // We expect input pin named "cond" (or schema.inputs containing type bool)
-    std::string instance = SanitizeIdentifier(ni.InstanceID);
+    const auto &entry = m_GraphIndex.nodes[node];
+    std::string instance = SanitizeIdentifier(entry.instance_id);
 
     // find condition pin name in schema inputs (fall back to "cond")
     std::string condPinName = "cond";
     for (const auto &p : schema.inputs) {
-      if (p.type == "bool" || p.id == "cond" || p.name == "Condition") {
+      if (p.type_id == BuiltinPinType::Bool || p.id == "cond" ||
+          p.name == "Condition") {
         condPinName = p.id.empty() ? p.name : p.id;
         break;
       }
     }
-
-    // variable name for condition
-    std::string condVar = VarNameForPin(ni, condPinName);
-    if (declaredVars.find(condVar) == declaredVars.end()) {
-      // declare condition variable (bool) at top-level; caller will collect
-      // these
-      declaredVars.insert(condVar);
+    std::string condVar = SanitizeIdentifier(entry.instance_id + "_" +
+                                             condPinName);
+
+    uint32_t truePin = GraphIndex::npos, falsePin = GraphIndex::npos;
+    for (uint32_t o = 0; o < entry.outputs.size(); ++o) {
+      if (entry.outputs[o].id == "true")
+        truePin = o;
+      else if (entry.outputs[o].id == "false")
+        falsePin = o;
     }
 
     // Function for this node
-    outBody << "// --- branch node: " << ni.InstanceID
+    outBody << "// --- branch node: " << entry.instance_id
             << " (schema: " << schema.id << ") ---\n";
     outBody << "void node_" << instance << "() {\n";
-    outBody << "    // evaluate condition (assumed stored in variable: "
-            << condVar << ")\n";
+    EmitInputPulls(node, outBody);
     outBody << "    if (" << condVar << ") {\n";
-
-    // follow true output connections
-    std::vector<std::string> trueTargets =
-        m_Graph.GetAllNodesLinkedToOutputInstanceID(ni.InstanceID, "true");
-    if (!trueTargets.empty()) {
-      // call first target (if multiple, call them in sequence)
-      for (auto &t : trueTargets) {
-        std::string tname = SanitizeIdentifier(t);
-        outBody << "        node_" << tname << "();\n";
-      }
-    } else {
-      outBody << "        // no target on True\n";
-    }
-
+    EmitBranchSide(node, truePin, falsePin, outBody);
     outBody << "    } else {\n";
-
-    // follow false output connections
-    std::vector<std::string> falseTargets =
-        m_Graph.GetAllNodesLinkedToOutputInstanceID(ni.InstanceID, "false");
-    if (!falseTargets.empty()) {
-      for (auto &t : falseTargets) {
-        std::string tname = SanitizeIdentifier(t);
-        outBody << "        node_" << tname << "();\n";
-      }
-    } else {
-      outBody << "        // no target on False\n";
-    }
-
+    EmitBranchSide(node, falsePin, truePin, outBody);
     outBody << "    }\n";
     outBody << "}\n\n";
   }
@@ -908,6 +949,99 @@ private:
   Cherry::NodeSystem::NodeGraph m_Graph;
   Cherry::NodeEngine m_NodeEngine;
 
+  std::shared_ptr<SchemaLibrary> m_Library;
+  std::shared_ptr<const SchemaCatalog> m_Catalog;
+
+  // Open in progress, applied one step per frame by PollOpen()
+  enum class OpenStep : uint8_t { Types, Schemas, Graph };
+  std::unique_ptr<SketchLoader> m_Loader;
+  OpenStep m_OpenStep = OpenStep::Types;
+  std::unordered_set<std::string> m_RegisteredSchemas;
+  std::unordered_set<PinTypeId> m_RegisteredTypes;
+
+  SpawnerCatalog m_Spawner;
+  char m_SpawnQuery[128] = {};
+  std::vector<SpawnerCatalog::Hit> m_SpawnResults;
+  bool m_SpawnResultsDirty = true;
+
+  GraphIndex m_GraphIndex;
+  // Node instance behind each m_GraphIndex node (top level or group member)
+  std::vector<const Cherry::NodeSystem::NodeInstance *> m_IndexedInstances;
+  std::unordered_map<std::string, Subgraph> m_Subgraphs; // by group instance
+  std::unordered_set<std::string> m_GroupTypes;
+
+  Explorer m_Explorer;
+
+  GraphHistory m_History;
+  GraphJournal m_Journal;
+
+  std::unique_ptr<BuildPipeline> m_Build;
+  SizeReport m_SizeReport; // of the last successful build
+  TranspileOptions m_Transpile; // of the transpilation in progress
+  ReactivePlan m_Reactive;      // idem, empty in polled mode
+  std::vector<LookupTable> m_Tables; // idem, with their values
+
+  struct LookupProbe {
+    std::string source; // probe main.cpp
+    std::vector<LookupTable> tables;
+    uint32_t timeout_ms = 0;
+  };
+  std::optional<LookupProbe> m_LutPending; // planned, for the next build
+  std::optional<LookupProbe> m_LutRunning; // in the build job
+  // Evaluated tables by probe source, empty when the probe failed
+  std::map<std::string, std::vector<LookupTable>> m_LutValues;
+
+  struct FixedPointCompare {
+    bool ok = false;
+    std::string error;
+    TranspileOptions options;
+    unsigned long loops = 0;
+    std::vector<ProbeStats> probes;
+  };
+  std::future<FixedPointCompare> m_ComparePending;
+  std::optional<FixedPointCompare> m_Compare;
+
+  struct TelemetryView {
+    bool loaded = false;
+    bool wanted = false; // start the simulator once built
+    TelemetrySettings settings;
+    TelemetryLink link;
+    TelemetryDecoder decoder;
+    std::future<BuildResult> build; // simulator, before it runs
+    fs::path simulator;
+    std::vector<uint8_t> bytes;
+    std::string status;
+  };
+  TelemetryView m_Telemetry;
+
+  DocumentFormat m_DocumentFormat = DocumentFormat::Json;
+  std::vector<std::string> m_FormatReport; // last benchmark, one line each
+
+  struct MachineEditor {
+    bool open = false;
+    StateMachineInfo machine;
+    std::vector<std::array<char, 32>> when; // per transition
+    char newMachine[32] = {};
+    char newState[32] = {};
+    std::string status;
+  };
+  MachineEditor m_MachineEditor;
+  struct ShadowNode {
+    Cherry::NodeSystem::NodeInstance node;
+    // Instances linked to each pin, by pin key
+    std::unordered_map<std::string, std::vector<std::string>> in, out;
+  };
+  std::unordered_map<std::string, ShadowNode> m_Shadow;
+  // Index in m_Graph.m_InstanciatedNodes and editor node of each instance,
+  // redone when nodes are added or removed.
+  std::unordered_map<std::string, size_t> m_NodeSlots;
+  std::unordered_map<uintptr_t, std::string> m_EditorNodes;
+  std::unordered_set<std::string> m_Touched, m_LastTouched;
+  ValidationReport m_Validation;
+  TaskPartition m_Tasks; // of the last validation
+  bool m_GraphDirty = true;
+  bool m_ValidationDirty = false; // node data changed, the index did not
+
   std::string m_Path;
 
   // Cherry
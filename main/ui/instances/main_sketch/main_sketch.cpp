@@ -17,8 +17,16 @@ MainSketchAppWindow::MainSketchAppWindow(const std::string &path,
   m_AppWindow->SetRightMenubarCallback([this]() { RenderRightMenubar(); });
   m_AppWindow->SetSaveMode(true);
   m_AppWindow->SetDockingMode(true);
+  m_AppWindow->SetClosable(true);
+  m_AppWindow->SetCloseCallback([this]() {
+    // Close() drops the module's reference, keep this alive until it returns
+    auto self = shared_from_this();
+    Close();
+  });
+  opened = true;
 
   m_Path = path;
+  m_Name = name;
 
   // Nodal Viewport
   m_Viewport = ModuleUI::ViewportMainSketchAppWindow::Create(
@@ -56,7 +64,23 @@ void MainSketchAppWindow::SetupRenderCallback() {
   });
 }
 
+void MainSketchAppWindow::Close() {
+  if (!opened)
+    return;
+  opened = false;
+  // Windows (and their job futures) may outlive this call, a build must not
+  // keep them, or the module shutting down, waiting.
+  m_Viewport->CancelJobs();
+  for (const auto &window :
+       {m_Viewport->GetAppWindow(), m_MySketch->GetAppWindow(), m_AppWindow}) {
+    window->SetRenderCallback(nullptr);
+    CherryApp.DeleteAppWindow(window);
+  }
+  EmbeddedFusion::ForgetMainSketchWindow(this);
+}
+
 void MainSketchAppWindow::RenderMenubar() {
+  EFUSION_TRACE_SCOPE("MainSketch::RenderMenubar");
 
   static bool tt = true;
   static bool first_Frame = true;
@@ -103,9 +127,28 @@ void MainSketchAppWindow::RenderMenubar() {
   if (CherryKit::ButtonImageText(
           "Transpilation", GetPath("resources/imgs/icons/misc/icon_add.png"))
           .GetDataAs<bool>("isClicked")) {
-    m_Viewport->Transpilation();
+    if (m_Viewport->Transpilation())
+      m_Viewport->Build();
+  }
+  CherryGUI::SetCursorPosX(CherryGUI::GetCursorPosX() + 3.0f);
+  CherryNextComponent.SetProperty("padding_y", "6.0f");
+  CherryNextComponent.SetProperty("padding_x", "10.0f");
+  if (CherryKit::ButtonImageText(
+          "Undo", GetPath("resources/imgs/icons/misc/icon_add.png"))
+          .GetDataAs<bool>("isClicked")) {
+    Undo();
+  }
+  CherryGUI::SetCursorPosX(CherryGUI::GetCursorPosX() + 3.0f);
+  CherryNextComponent.SetProperty("padding_y", "6.0f");
+  CherryNextComponent.SetProperty("padding_x", "10.0f");
+  if (CherryKit::ButtonImageText(
+          "Redo", GetPath("resources/imgs/icons/misc/icon_add.png"))
+          .GetDataAs<bool>("isClicked")) {
+    Redo();
   }
 }
+void MainSketchAppWindow::Undo() { m_Viewport->Undo(); }
+void MainSketchAppWindow::Redo() { m_Viewport->Redo(); }
 void MainSketchAppWindow::RenderRightMenubar() {}
 void MainSketchAppWindow::Render() {}
 }; // namespace ModuleUI
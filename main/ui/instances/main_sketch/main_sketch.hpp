@@ -19,6 +19,12 @@ public:
   static std::shared_ptr<MainSketchAppWindow> Create(const std::string &path,
                                                      const std::string &name);
   void SetupRenderCallback();
+  // Removes the window and its children from Cherry and drops the render
+  // callbacks, whose captured self references would otherwise keep the
+  // windows alive. Also the close path of the window's own close button, so
+  // it removes the window from the module's open list as well.
+  void Close();
+  bool IsOpen() const { return opened; }
   void Render();
   void RenderMenubar();
   void RenderRightMenubar();
@@ -28,9 +34,12 @@ public:
   void Undo();
   void Redo();
 
+  const std::string &GetSketchPath() const { return m_Path; }
+  const std::string &GetName() const { return m_Name; }
+
 private:
   VxContext *ctx;
-  bool opened;
+  bool opened = false;
 
   std::vector<std::function<void()>> m_SaveCallbacks;
   std::vector<std::function<void()>> m_RefreshCallbacks;
@@ -45,6 +54,7 @@ private:
   ComponentsPool m_ComponentPool;
 
   std::string m_Path;
+  std::string m_Name;
 };
 
 }; // namespace ModuleUI